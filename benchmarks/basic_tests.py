@@ -183,6 +183,37 @@ def sweep_forgive_test():
     assert diff.max().max() == 0.0
 
 
+def sweep_resume_test():
+    model_d = "ies_10par_xsec"
+    t_d = os.path.join(model_d,"template")
+    m_d = os.path.join(model_d,"master_sweep_resume")
+    if os.path.exists(m_d):
+        shutil.rmtree(m_d)
+    shutil.copytree(t_d,m_d)
+    pst = pyemu.Pst(os.path.join(m_d,"pest.pst"))
+    pe = pyemu.ParameterEnsemble.from_uniform_draw(pst,num_reals=50)
+    pe.to_csv(os.path.join(m_d,"sweep_in.csv"))
+    pst.pestpp_options["sweep_chunk"] = 7
+    pst.write(os.path.join(m_d,"pest_resume.pst"))
+    pyemu.os_utils.run("{0} pest_resume.pst".format(exe_path.replace("-ies","-swp")),cwd=m_d)
+    out_file = os.path.join(m_d,"sweep_out.csv")
+    df1 = pd.read_csv(out_file,index_col=0)
+    assert df1.shape[0] == pe.shape[0]
+
+    # interrupt the sweep part way through a chunk: keep the first rows and a partial line
+    lines = open(out_file,'r').readlines()
+    with open(out_file,'w') as f:
+        f.writelines(lines[:18])
+        f.write(lines[18][:len(lines[18])//2])
+    pyemu.os_utils.run("{0} pest_resume.pst /r".format(exe_path.replace("-ies","-swp")),cwd=m_d)
+    df2 = pd.read_csv(out_file,index_col=0)
+    assert df2.shape == df1.shape
+    assert list(df2.input_run_id) == list(df1.input_run_id)
+    diff = (df1.iloc[:,1:] - df2.iloc[:,1:]).abs()
+    print(diff.max())
+    assert diff.max().max() < 1.0e-6
+
+
 def inv_regul_test():
     model_d = "ies_10par_xsec"
     local=True
@@ -998,6 +1029,226 @@ def cmdline_test():
         raise Exception("should have failed")
     
 
+def serial_slots_exec_test():
+    model_d = "ies_10par_xsec"
+    t_d = os.path.join(model_d,"template")
+    m_d = os.path.join(model_d,"master_serial_slots")
+    if os.path.exists(m_d):
+        shutil.rmtree(m_d)
+    shutil.copytree(t_d,m_d)
+    # run the model through an executable script so the slots need the exec bit
+    # and put a link cycle in the model dir that the slot clone must not follow
+    with open(os.path.join(m_d,"forward_run.sh"),'w') as f:
+        f.write("#!/bin/sh\nmfnwt 10par_xsec.nam\n")
+    os.chmod(os.path.join(m_d,"forward_run.sh"),0o755)
+    os.symlink(".",os.path.join(m_d,"loop"))
+    pst = pyemu.Pst(os.path.join(m_d,"pest.pst"))
+    pst.model_command = ["./forward_run.sh"]
+    pe = pyemu.ParameterEnsemble.from_uniform_draw(pst,num_reals=20)
+    pe.to_csv(os.path.join(m_d,"sweep_in.csv"))
+    pst.write(os.path.join(m_d,"pest_one_slot.pst"))
+    pyemu.os_utils.run("{0} pest_one_slot.pst".format(exe_path.replace("-ies","-swp")),cwd=m_d)
+    df1 = pd.read_csv(os.path.join(m_d,"sweep_out.csv"),index_col=0)
+    assert df1.shape[0] == pe.shape[0]
+
+    pst.pestpp_options["serial_num_slots"] = 3
+    pst.write(os.path.join(m_d,"pest_slots.pst"))
+    pyemu.os_utils.run("{0} pest_slots.pst".format(exe_path.replace("-ies","-swp")),cwd=m_d)
+    df2 = pd.read_csv(os.path.join(m_d,"sweep_out.csv"),index_col=0)
+    assert df2.shape == df1.shape
+    assert df2.failed_flag.sum() == 0
+    for i in range(3):
+        assert os.access(os.path.join(m_d,"pestpp_slots","slot_{0}".format(i),"forward_run.sh"),os.X_OK)
+    diff = (df1.iloc[:,1:] - df2.iloc[:,1:]).abs()
+    print(diff.max())
+    assert diff.max().max() < 1.0e-6
+
+
+def run_storage_mmap_test():
+    model_d = "ies_10par_xsec"
+    t_d = os.path.join(model_d,"template")
+    pst = pyemu.Pst(os.path.join(t_d,"pest.pst"))
+    pst.control_data.noptmax = 2
+    pst.pestpp_options = {"ies_num_reals":10}
+    # run glm and ies with the default (stream) run storage and then the memory-mapped one
+    for engine in ["stream","mmap"]:
+        m_d = os.path.join(model_d,"master_storage_{0}".format(engine))
+        if os.path.exists(m_d):
+            shutil.rmtree(m_d)
+        shutil.copytree(t_d,m_d)
+        pst.pestpp_options["run_storage_mmap"] = engine == "mmap"
+        pst.write(os.path.join(m_d,"pest.pst"))
+        pyemu.os_utils.run("{0} pest.pst".format(exe_path.replace("-ies","-glm")),cwd=m_d)
+        pyemu.os_utils.run("{0} pest.pst".format(exe_path),cwd=m_d)
+    s_d = os.path.join(model_d,"master_storage_stream")
+    m_d = os.path.join(model_d,"master_storage_mmap")
+
+    par1 = pyemu.pst_utils.read_parfile(os.path.join(s_d,"pest.par"))
+    par2 = pyemu.pst_utils.read_parfile(os.path.join(m_d,"pest.par"))
+    diff = (par1.parval1 - par2.parval1).abs()
+    print(diff.max())
+    assert diff.max() < 1.0e-10
+    res1 = pyemu.pst_utils.read_resfile(os.path.join(s_d,"pest.rei"))
+    res2 = pyemu.pst_utils.read_resfile(os.path.join(m_d,"pest.rei"))
+    diff = (res1.modelled - res2.modelled).abs()
+    print(diff.max())
+    assert diff.max() < 1.0e-10
+
+    for f in ["pest.phi.actual.csv","pest.{0}.par.csv".format(pst.control_data.noptmax),
+              "pest.{0}.obs.csv".format(pst.control_data.noptmax)]:
+        df1 = pd.read_csv(os.path.join(s_d,f),index_col=0)
+        df2 = pd.read_csv(os.path.join(m_d,f),index_col=0)
+        assert df1.shape == df2.shape,f
+        diff = (df1 - df2).abs()
+        print(f,diff.max().max())
+        assert diff.max().max() < 1.0e-10,f
+
+
+def write_ecb(df, filename, float32=False):
+    # the columnar binary ensemble (.ecb) layout: header, name table, then one block per column
+    dtype = np.float32 if float32 else np.float64
+    names = b""
+    for name in list(df.index) + list(df.columns):
+        b = str(name).encode()
+        names += np.int32(len(b)).tobytes() + b
+    offset = 40 + len(names)
+    pad = (8 - offset % 8) % 8
+    with open(filename,'wb') as f:
+        f.write(b"PESTECB\0")
+        f.write(np.array([1, np.dtype(dtype).itemsize], dtype=np.int32).tobytes())
+        f.write(np.array([df.shape[0], df.shape[1], offset + pad], dtype=np.int64).tobytes())
+        f.write(names + b"\0" * pad)
+        f.write(df.values.astype(dtype).T.copy().tobytes())
+
+
+def read_ecb(filename):
+    # returns the ensemble and the value size (4 or 8)
+    b = open(filename,'rb').read()
+    assert b[:8] == b"PESTECB\0",filename
+    version, vsize = np.frombuffer(b, np.int32, 2, 8)
+    n_real, n_var, offset = np.frombuffer(b, np.int64, 3, 16)
+    pos = 40
+    names = []
+    for i in range(n_real + n_var):
+        l = int(np.frombuffer(b, np.int32, 1, pos)[0])
+        names.append(b[pos + 4:pos + 4 + l].decode())
+        pos += 4 + l
+    dtype = np.float32 if vsize == 4 else np.float64
+    vals = np.frombuffer(b, dtype, n_real * n_var, offset).reshape(n_var, n_real).T
+    df = pd.DataFrame(vals.astype(np.float64), index=names[:n_real], columns=[n.lower() for n in names[n_real:]])
+    return df, vsize
+
+
+def ies_columnar_roundtrip_test():
+    model_d = "ies_10par_xsec"
+    t_d = os.path.join(model_d,"template")
+    m_d = os.path.join(model_d,"master_columnar")
+    if os.path.exists(m_d):
+        shutil.rmtree(m_d)
+    shutil.copytree(t_d,m_d)
+    pst = pyemu.Pst(os.path.join(m_d,"pest.pst"))
+    par = pst.parameter_data
+    par.loc["k_03","partrans"] = "tied"
+    par.loc["k_03","partied"] = "k_02"
+    pst.control_data.noptmax = 1
+    pe = pyemu.ParameterEnsemble.from_gaussian_draw(pst,num_reals=10)
+    pe.to_csv(os.path.join(m_d,"par.csv"))
+    pe = pd.read_csv(os.path.join(m_d,"par.csv"),index_col=0)
+    pe.loc[:,"k_03"] = par.loc["k_03","parval1"]
+    pe.to_csv(os.path.join(m_d,"par.csv"))
+    oe = pyemu.ObservationEnsemble.from_gaussian_draw(pst,num_reals=10)
+    oe.to_csv(os.path.join(m_d,"obs.csv"))
+
+    def run(case,par_en,obs_en,**kwargs):
+        pst.pestpp_options = {"ies_num_reals":10,"ies_par_en":par_en,"ies_obs_en":obs_en}
+        pst.pestpp_options.update(kwargs)
+        pst.write(os.path.join(m_d,case + ".pst"))
+        pyemu.os_utils.run("{0} {1}.pst".format(exe_path,case),cwd=m_d)
+
+    def compare(case1,case2,f,tol=1.0e-10):
+        df1 = pd.read_csv(os.path.join(m_d,case1 + f),index_col=0)
+        df2 = pd.read_csv(os.path.join(m_d,case2 + f),index_col=0)
+        assert df1.shape == df2.shape,f
+        diff = ((df1 - df2) / df1.abs().clip(lower=1.0)).abs()
+        print(case2,f,diff.max().max())
+        assert diff.max().max() < tol,f
+
+    # csv in and out
+    run("pest_csv","par.csv","obs.csv")
+    # csv in, ecb out: the saved ensembles must match the csv ones
+    run("pest_ecb","par.csv","obs.csv",ies_save_columnar=True)
+    for f in [".0.par",".1.par",".1.obs"]:
+        df1 = pd.read_csv(os.path.join(m_d,"pest_csv" + f + ".csv"),index_col=0)
+        df2,vsize = read_ecb(os.path.join(m_d,"pest_ecb" + f + ".ecb"))
+        assert vsize == 8
+        assert df2.shape == df1.shape,f
+        diff = ((df1.values - df2.loc[:,df1.columns].values) / np.maximum(df1.abs().values,1.0))
+        assert np.abs(diff).max() < 1.0e-5,f
+    # ecb in (from the ecb run), csv out: the same results as the csv run
+    run("pest_rt","pest_ecb.0.par.ecb","pest_ecb.obs+noise.ecb")
+    for f in [".0.par.csv",".1.par.csv",".1.obs.csv",".phi.actual.csv"]:
+        compare("pest_csv","pest_rt",f)
+
+    # an ecb par en without the tied par column: the tied par gets its parval1
+    write_ecb(pe.drop("k_03",axis=1),os.path.join(m_d,"par_notied.ecb"))
+    run("pest_notied","par_notied.ecb","obs.csv")
+    for f in [".0.par.csv",".1.par.csv",".phi.actual.csv"]:
+        compare("pest_csv","pest_notied",f)
+
+    # float32: saved to single precision and read back
+    run("pest_f32","par.csv","obs.csv",ies_save_columnar=True,ies_columnar_float32=True)
+    df,vsize = read_ecb(os.path.join(m_d,"pest_f32.0.par.ecb"))
+    assert vsize == 4
+    # the saved tied par values are the tied ones, so only check the adjustable pars
+    cols = pst.adj_par_names
+    diff = (pe.loc[:,cols].values - df.loc[:,cols].values) / np.maximum(pe.loc[:,cols].abs().values,1.0)
+    assert np.abs(diff).max() < 1.0e-6
+    run("pest_f32rt","pest_f32.0.par.ecb","pest_f32.obs+noise.ecb")
+    compare("pest_csv","pest_f32rt",".phi.actual.csv",tol=1.0e-3)
+    # and a float32 file written here without the tied par
+    write_ecb(pe.drop("k_03",axis=1),os.path.join(m_d,"par_notied_f32.ecb"),float32=True)
+    run("pest_notied_f32","par_notied_f32.ecb","obs.csv")
+    compare("pest_csv","pest_notied_f32",".phi.actual.csv",tol=1.0e-3)
+
+
+def glm_model_plugin_test():
+    model_d = "plugin_test"
+    t_d = os.path.join(model_d,"template")
+    m_d = os.path.join(model_d,"master_plugin")
+    if os.path.exists(m_d):
+        shutil.rmtree(m_d)
+    shutil.copytree(t_d,m_d)
+    if "windows" in platform.platform().lower():
+        print("skipping glm_model_plugin_test, the plugin is only built with cc")
+        return
+    lib = "linear_plugin.so"
+    if "darwin" in platform.platform().lower():
+        lib = "linear_plugin.dylib"
+    pyemu.os_utils.run("cc -shared -fPIC -O2 -o {0} linear_plugin.c".format(lib),cwd=m_d)
+    glm_exe = exe_path.replace("-ies","-glm")
+
+    # the same model through the model input/output files (model.py) and in-process
+    pyemu.os_utils.run("{0} pest.pst".format(glm_exe),cwd=m_d)
+    pst = pyemu.Pst(os.path.join(m_d,"pest.pst"))
+    pst.pestpp_options["model_plugin"] = os.path.abspath(os.path.join(m_d,lib))
+    pst.write(os.path.join(m_d,"pest_plugin.pst"))
+    pyemu.os_utils.run("{0} pest_plugin.pst".format(glm_exe),cwd=m_d)
+
+    par1 = pyemu.pst_utils.read_parfile(os.path.join(m_d,"pest.par"))
+    par2 = pyemu.pst_utils.read_parfile(os.path.join(m_d,"pest_plugin.par"))
+    diff = (par1.parval1 - par2.parval1).abs()
+    print(diff.max())
+    assert diff.max() < 1.0e-8
+    res1 = pyemu.pst_utils.read_resfile(os.path.join(m_d,"pest.rei"))
+    res2 = pyemu.pst_utils.read_resfile(os.path.join(m_d,"pest_plugin.rei"))
+    diff = (res1.modelled - res2.modelled).abs()
+    print(diff.max())
+    assert diff.max() < 1.0e-8
+    # and both recover the pars the obs were made with
+    truth = pd.Series([2.0,0.5,3.0,1.5,0.8],index=["p{0}".format(i) for i in range(5)])
+    assert (par2.parval1.loc[truth.index] - truth).abs().max() < 0.01
+
+
 if __name__ == "__main__":
     
     #glm_long_name_test()
@@ -1008,6 +1259,11 @@ if __name__ == "__main__":
     #basic_test("ies_10par_xsec")
     #glm_save_binary_test()
     #sweep_forgive_test()
+    #sweep_resume_test()
+    #serial_slots_exec_test()
+    #run_storage_mmap_test()
+    #ies_columnar_roundtrip_test()
+    #glm_model_plugin_test()
     #inv_regul_test()
     #tie_by_group_test()
     #sen_basic_test()
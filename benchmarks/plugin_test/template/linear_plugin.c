@@ -0,0 +1,29 @@
+/* a tiny model for ++model_plugin: obs[j] = sum_i pars[i] / (1 + |i - j|).
+   model.py is the same model run through the model input/output files */
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define PLUGIN_EXPORT
+#endif
+
+#define NPAR 5
+#define NOBS 8
+
+PLUGIN_EXPORT int initialize(int npar, int nobs)
+{
+	return ((npar == NPAR) && (nobs == NOBS)) ? 0 : 1;
+}
+
+PLUGIN_EXPORT int evaluate(const double *pars, double *obs)
+{
+	int i, j;
+	for (j = 0; j < NOBS; j++)
+	{
+		obs[j] = 0.0;
+		for (i = 0; i < NPAR; i++)
+			obs[j] += pars[i] / (1.0 + abs(i - j));
+	}
+	return 0;
+}
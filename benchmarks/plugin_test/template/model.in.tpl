@@ -0,0 +1,6 @@
+ptf ~
+p0 ~p0                      ~
+p1 ~p1                      ~
+p2 ~p2                      ~
+p3 ~p3                      ~
+p4 ~p4                      ~
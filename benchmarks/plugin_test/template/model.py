@@ -0,0 +1,7 @@
+# the linear_plugin.c model run through the model input/output files
+npar, nobs = 5, 8
+pars = [float(line.split()[1]) for line in open("model.in", "r") if line.strip()]
+assert len(pars) == npar
+with open("model.out", "w") as f:
+    for j in range(nobs):
+        f.write("o{0} {1:.15e}\n".format(j, sum(pars[i] / (1.0 + abs(i - j)) for i in range(npar))))
@@ -0,0 +1,550 @@
+// macro-benchmark of the pestpp_common hot paths on a synthesized problem.  a control file,
+// template, instruction file and par/obs ensembles of the requested size are written to a
+// work directory and then each entry point is timed over a number of repetitions:
+//   tpl_write          TemplateFile::write_input_file()
+//   ins_read           InstructionFile::read_output_file()
+//   run_storage        RunStorage add_run()/update_run()/get_observations_vec() for nreals runs
+//   queue_add_run, queue_add_runs
+//                      queuing nreals runs one add_run() at a time vs one add_runs() batch
+//   csv_read_par/obs   ParameterEnsemble/ObservationEnsemble::from_csv()
+//   phi_update         L2PhiHandler::update()
+//   localized_upgrade  the LocalUpgradeThread solve behind calc_localized_upgrade_threaded(),
+//                      with one localization case per group and three lambdas
+//   jac_build_runs, jac_model_runs, jac_process_runs
+//                      Jacobian_1to1 through RunManagerSerial for the first jac_npar
+//                      parameters.  the serial run manager polls each model run once a
+//                      second, so jac_model_runs is dominated by that poll, not the model
+// the model is this program itself ("pestpp-bench-hotpaths model <in> <out>"), a cheap
+// linear map of the parameters, so everything runs offline with no external executables.
+//
+// results are written as csv (name, sizes, reps, mean/min/max seconds, checksum).  if a
+// baseline results file is given, any benchmark whose mean is more than tolerance slower
+// than the baseline is reported and the exit status is 2
+//
+// usage: pestpp-bench-hotpaths [npar=200] [nobs=400] [nreals=50] [ngroups=10] [reps=3]
+//   [threads=2] [work_dir=hotpath_bench] [results=hotpath_bench.csv] [baseline=<csv>]
+//   [tolerance=0.25] [jac_npar=10] (jac_npar=0 skips the jacobian)
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+#include <stdexcept>
+#include <Eigen/Dense>
+#include "config_os.h"
+#include "system_variables.h"
+#include "utilities.h"
+#include "Pest.h"
+#include "FileManager.h"
+#include "PerformanceLog.h"
+#include "OutputFileWriter.h"
+#include "covariance.h"
+#include "Ensemble.h"
+#include "EnsembleMethodUtils.h"
+#include "EnsembleSmoother.h"
+#include "Localizer.h"
+#include "Jacobian_1to1.h"
+#include "RunStorage.h"
+#include "RunManagerSerial.h"
+#include "model_interface.h"
+#include "ThreadPool.h"
+#ifdef OS_WIN
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+struct BenchConfig
+{
+	int npar = 200;
+	int nobs = 400;
+	int nreals = 50;
+	int ngroups = 10;
+	int reps = 3;
+	int threads = 2;
+	int jac_npar = 10;
+	double tolerance = 0.25;
+	string work_dir = "hotpath_bench";
+	string results = "hotpath_bench.csv";
+	string baseline;
+};
+
+struct BenchResult
+{
+	string name;
+	int reps;
+	double mean_sec, min_sec, max_sec;
+	double checksum;
+};
+
+//the built-in model: obs j is a fixed sparse linear map of the log parameters
+int run_model(const string &in_file, const string &out_file)
+{
+	ifstream in(in_file);
+	if (!in.good())
+	{
+		cerr << "model error: unable to open " << in_file << endl;
+		return 1;
+	}
+	int nobs;
+	vector<double> pars;
+	string line;
+	getline(in, line);
+	nobs = stoi(line);
+	while (getline(in, line))
+	{
+		vector<string> tokens;
+		pest_utils::tokenize(pest_utils::strip_cp(line), tokens);
+		if (tokens.size() > 1)
+			pars.push_back(log10(stod(tokens[1])));
+	}
+	ofstream out(out_file);
+	out << scientific << setprecision(12);
+	int npar = pars.size();
+	for (int j = 0; j < nobs; j++)
+	{
+		double v = pars[j % npar] + 0.5 * pars[(7 * j + 3) % npar] - 0.25 * pars[(13 * j + 5) % npar];
+		out << "obs " << v << endl;
+	}
+	return 0;
+}
+
+void make_dir(const string &dir)
+{
+#ifdef OS_WIN
+	_mkdir(dir.c_str());
+#else
+	mkdir(dir.c_str(), 0755);
+#endif
+}
+
+string par_name(int i) { stringstream ss; ss << "p" << setw(6) << setfill('0') << i; return ss.str(); }
+string obs_name(int j) { stringstream ss; ss << "o" << setw(6) << setfill('0') << j; return ss.str(); }
+
+void write_problem(const BenchConfig &cfg, const string &exe)
+{
+	ofstream tpl(cfg.work_dir + "/bench.in.tpl");
+	tpl << "ptf ~" << endl << cfg.nobs << endl;
+	for (int i = 0; i < cfg.npar; i++)
+		tpl << par_name(i) << " ~  " << par_name(i) << "           ~" << endl;
+	tpl.close();
+	ofstream ins(cfg.work_dir + "/bench.out.ins");
+	ins << "pif ~" << endl;
+	for (int j = 0; j < cfg.nobs; j++)
+		ins << "l1 w !" << obs_name(j) << "!" << endl;
+	ins.close();
+
+	mt19937 gen(1123456789);
+	normal_distribution<double> dist;
+	ofstream pst(cfg.work_dir + "/bench.pst");
+	pst << "pcf" << endl << "* control data" << endl << "restart estimation" << endl;
+	pst << cfg.npar << " " << cfg.nobs << " " << cfg.ngroups << " 0 " << cfg.ngroups << endl;
+	pst << "1 1 single point 1 0 0" << endl;
+	pst << "5.0 2.0 0.3 0.03 10" << endl << "5.0 5.0 0.001" << endl << "0.1" << endl;
+	pst << "1 0.01 3 3 0.01 3" << endl << "0 0 0" << endl;
+	pst << "* singular value decomposition" << endl << "1" << endl << cfg.npar << " 1.0e-6" << endl << "0" << endl;
+	pst << "* parameter groups" << endl;
+	for (int g = 0; g < cfg.ngroups; g++)
+		pst << "pg" << g << " relative 0.01 0.0 switch 2.0 parabolic" << endl;
+	pst << "* parameter data" << endl;
+	for (int i = 0; i < cfg.npar; i++)
+		pst << par_name(i) << " log factor " << pow(10.0, 0.1 * ((i % 7) - 3)) << " 0.01 100.0 pg" << i % cfg.ngroups << " 1.0 0.0 1" << endl;
+	pst << "* observation groups" << endl;
+	for (int g = 0; g < cfg.ngroups; g++)
+		pst << "og" << g << endl;
+	pst << "* observation data" << endl;
+	pst << scientific << setprecision(12);
+	for (int j = 0; j < cfg.nobs; j++)
+		pst << obs_name(j) << " " << 0.1 * dist(gen) << " 10.0 og" << j % cfg.ngroups << endl;
+	//absolute paths, since the runs are made from the current directory
+	string d = cfg.work_dir + OperSys::DIR_SEP;
+	pst << "* model command line" << endl << exe << " model " << d << "bench.in " << d << "bench.out" << endl;
+	pst << "* model input/output" << endl << d << "bench.in.tpl " << d << "bench.in" << endl;
+	pst << d << "bench.out.ins " << d << "bench.out" << endl;
+	pst << "++ies_num_reals(" << cfg.nreals << ")" << endl;
+	pst << "++ies_num_threads(" << cfg.threads << ")" << endl;
+	pst.close();
+}
+
+BenchResult time_it(const string &name, int reps, const function<double()> &f)
+{
+	BenchResult r;
+	r.name = name;
+	r.reps = reps;
+	r.mean_sec = 0.0;
+	r.min_sec = 1.0e+300;
+	r.max_sec = 0.0;
+	r.checksum = 0.0;
+	for (int i = 0; i < reps; i++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		r.checksum = f();
+		double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		r.mean_sec += sec;
+		r.min_sec = min(r.min_sec, sec);
+		r.max_sec = max(r.max_sec, sec);
+	}
+	r.mean_sec /= reps;
+	cout << setw(20) << left << name << right << " mean: " << setw(10) << fixed << setprecision(5) << r.mean_sec;
+	cout << " sec, min: " << setw(10) << r.min_sec << " sec, max: " << setw(10) << r.max_sec;
+	cout << " sec, checksum: " << scientific << setprecision(6) << r.checksum << endl;
+	return r;
+}
+
+//fold a single-rep result into a running total; the mean is divided out by the caller
+void merge_result(BenchResult &total, const BenchResult &r)
+{
+	total.reps += r.reps;
+	total.mean_sec += r.mean_sec;
+	total.min_sec = min(total.min_sec, r.min_sec);
+	total.max_sec = max(total.max_sec, r.max_sec);
+	total.checksum = r.checksum;
+}
+
+void write_results(const BenchConfig &cfg, const vector<BenchResult> &results)
+{
+	ofstream f(cfg.results);
+	if (!f.good())
+		throw runtime_error("unable to open results file " + cfg.results);
+	f << "name,npar,nobs,nreals,ngroups,threads,reps,mean_sec,min_sec,max_sec,checksum" << endl;
+	f << setprecision(9);
+	for (auto &r : results)
+	{
+		f << r.name << "," << cfg.npar << "," << cfg.nobs << "," << cfg.nreals << "," << cfg.ngroups << ",";
+		f << cfg.threads << "," << r.reps << "," << r.mean_sec << "," << r.min_sec << "," << r.max_sec << "," << r.checksum << endl;
+	}
+}
+
+//returns the number of benchmarks that regressed against the baseline
+int compare_to_baseline(const BenchConfig &cfg, const vector<BenchResult> &results)
+{
+	ifstream f(cfg.baseline);
+	if (!f.good())
+		throw runtime_error("unable to open baseline file " + cfg.baseline);
+	string line;
+	getline(f, line);
+	map<string, double> base;
+	while (getline(f, line))
+	{
+		vector<string> tokens;
+		pest_utils::tokenize(pest_utils::strip_cp(line), tokens, ",", false);
+		if (tokens.size() < 8)
+			continue;
+		base[tokens[0]] = stod(tokens[7]);
+	}
+	int n_regressed = 0;
+	cout << endl << "comparison to baseline " << cfg.baseline << " (tolerance " << defaultfloat << cfg.tolerance << "):" << endl;
+	for (auto &r : results)
+	{
+		auto it = base.find(r.name);
+		if ((it == base.end()) || (it->second <= 0.0))
+			continue;
+		double ratio = r.mean_sec / it->second;
+		bool regressed = ratio > 1.0 + cfg.tolerance;
+		if (regressed)
+			n_regressed++;
+		cout << setw(20) << left << r.name << right << " ratio: " << fixed << setprecision(3) << ratio;
+		cout << (regressed ? "  REGRESSION" : "") << endl;
+	}
+	return n_regressed;
+}
+
+int main(int argc, char* argv[])
+{
+	if ((argc > 1) && (string(argv[1]) == "model"))
+	{
+		if (argc < 4)
+		{
+			cerr << "usage: pestpp-bench-hotpaths model <input file> <output file>" << endl;
+			return 1;
+		}
+		return run_model(argv[2], argv[3]);
+	}
+
+	BenchConfig cfg;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg(argv[i]);
+		size_t pos = arg.find('=');
+		if (pos == string::npos)
+		{
+			cerr << "unrecognized argument '" << arg << "', expecting key=value" << endl;
+			return 1;
+		}
+		string key = pest_utils::lower_cp(arg.substr(0, pos)), value = arg.substr(pos + 1);
+		if (key == "npar") cfg.npar = stoi(value);
+		else if (key == "nobs") cfg.nobs = stoi(value);
+		else if (key == "nreals") cfg.nreals = stoi(value);
+		else if (key == "ngroups") cfg.ngroups = stoi(value);
+		else if (key == "reps") cfg.reps = stoi(value);
+		else if (key == "threads") cfg.threads = stoi(value);
+		else if (key == "jac_npar") cfg.jac_npar = stoi(value);
+		else if (key == "tolerance") cfg.tolerance = stod(value);
+		else if (key == "work_dir") cfg.work_dir = value;
+		else if (key == "results") cfg.results = value;
+		else if (key == "baseline") cfg.baseline = value;
+		else
+		{
+			cerr << "unrecognized argument '" << key << "'" << endl;
+			return 1;
+		}
+	}
+	if ((cfg.npar < 1) || (cfg.nobs < 1) || (cfg.nreals < 2) || (cfg.ngroups < 1) || (cfg.reps < 1) ||
+		(cfg.ngroups > min(cfg.npar, cfg.nobs)))
+	{
+		cerr << "invalid problem size: need npar, nobs, reps >= 1, nreals >= 2 and 1 <= ngroups <= min(npar, nobs)" << endl;
+		return 1;
+	}
+	Eigen::setNbThreads(1);
+
+	try
+	{
+		//the model command must work from the run directory, so use an absolute path to this program
+		string exe(argv[0]);
+		if ((exe.size() > 0) && (exe[0] != '/') && (exe.find(':') == string::npos))
+			exe = OperSys::getcwd() + OperSys::DIR_SEP + exe;
+		make_dir(cfg.work_dir);
+		if (cfg.work_dir[0] != '/')
+			cfg.work_dir = OperSys::getcwd() + OperSys::DIR_SEP + cfg.work_dir;
+		write_problem(cfg, exe);
+		string d = cfg.work_dir + OperSys::DIR_SEP;
+
+		cout << "hot path benchmark: " << cfg.npar << " pars, " << cfg.nobs << " obs, " << cfg.nreals << " reals, ";
+		cout << cfg.ngroups << " groups, " << cfg.threads << " threads, " << cfg.reps << " reps" << endl << endl;
+
+		//file names are built relative to the current directory, so the base name carries the work dir
+		FileManager file_manager(d + "bench", cfg.work_dir);
+		file_manager.open_default_files();
+		ofstream &frec = file_manager.rec_ofstream();
+		PerformanceLog plog(file_manager.open_ofile_ext("log"));
+		Pest pest_scenario;
+		pest_scenario.set_defaults();
+		pest_scenario.process_ctl_file(file_manager.open_ifile_ext("pst"), file_manager.build_filename("pst"), frec);
+		file_manager.close_file("pst");
+
+		vector<string> par_names = pest_scenario.get_ctl_ordered_par_names();
+		vector<string> obs_names = pest_scenario.get_ctl_ordered_obs_names();
+		Parameters pars = pest_scenario.get_ctl_parameters();
+		vector<BenchResult> results;
+
+		//model io
+		TemplateFile tpl(d + "bench.in.tpl");
+		results.push_back(time_it("tpl_write", cfg.reps, [&]() {
+			Parameters pro_pars = tpl.write_input_file(d + "bench.in", pars);
+			return (double)pro_pars.size();
+		}));
+		if (run_model(d + "bench.in", d + "bench.out") != 0)
+			throw runtime_error("built-in model failed");
+		InstructionFile ins(d + "bench.out.ins");
+		vector<double> sim;
+		results.push_back(time_it("ins_read", cfg.reps, [&]() {
+			ins.read_output_file(d + "bench.out", sim);
+			double s = 0.0;
+			for (auto v : sim)
+				s += v;
+			return s;
+		}));
+
+		//run storage throughput: nreals runs stored, filled and read back
+		vector<double> par_vals = pars.get_data_vec(par_names);
+		results.push_back(time_it("run_storage", cfg.reps, [&]() {
+			RunStorage rs(d + "bench.bench_rns");
+			rs.reset(par_names, obs_names);
+			vector<int> ids;
+			for (int r = 0; r < cfg.nreals; r++)
+				ids.push_back(rs.add_run(par_vals));
+			for (auto id : ids)
+				rs.update_run(id, par_vals.data(), par_vals.size(), sim.data(), sim.size());
+			double s = 0.0;
+			vector<double> obs_vec;
+			for (auto id : ids)
+			{
+				rs.get_observations_vec(id, obs_vec);
+				s += obs_vec[0];
+			}
+			return s;
+		}));
+
+		//run queuing: per-run add_run() against the batched add_runs()
+		results.push_back(time_it("queue_add_run", cfg.reps, [&]() {
+			RunStorage rs(d + "bench.bench_rns");
+			rs.reset(par_names, obs_names);
+			for (int r = 0; r < cfg.nreals; r++)
+				rs.add_run(par_vals);
+			return (double)rs.get_nruns();
+		}));
+		Eigen::MatrixXd queue_pars = Eigen::Map<Eigen::VectorXd>(par_vals.data(), par_vals.size()).transpose().replicate(cfg.nreals, 1);
+		results.push_back(time_it("queue_add_runs", cfg.reps, [&]() {
+			RunStorage rs(d + "bench.bench_rns");
+			rs.reset(par_names, obs_names);
+			rs.add_runs(queue_pars);
+			return (double)rs.get_nruns();
+		}));
+
+		//ensembles
+		mt19937 rand_gen(pest_scenario.get_pestpp_options().get_random_seed());
+		Covariance parcov, obscov;
+		parcov.from_parameter_bounds(pest_scenario, frec);
+		obscov.from_observation_weights(pest_scenario, frec);
+		ParameterEnsemble pe_base(&pest_scenario, &rand_gen);
+		pe_base.draw(cfg.nreals, pars, parcov, &plog, 0, frec);
+		ObservationEnsemble oe_base(&pest_scenario, &rand_gen);
+		oe_base.draw(cfg.nreals, obscov, &plog, 0, frec);
+		pe_base.to_csv(d + "bench.par.csv");
+		oe_base.to_csv(d + "bench.obs.csv");
+		results.push_back(time_it("csv_read_par", cfg.reps, [&]() {
+			ParameterEnsemble pe(&pest_scenario, &rand_gen);
+			pe.from_csv(d + "bench.par.csv");
+			return pe.get_eigen().sum();
+		}));
+		results.push_back(time_it("csv_read_obs", cfg.reps, [&]() {
+			ObservationEnsemble oe(&pest_scenario, &rand_gen);
+			oe.from_csv(d + "bench.obs.csv");
+			return oe.get_eigen().sum();
+		}));
+
+		//the "current" ensembles are a perturbation of the prior ones
+		pe_base.transform_ip(ParameterEnsemble::transStatus::NUM);
+		ParameterEnsemble pe = pe_base;
+		ObservationEnsemble oe = oe_base;
+		{
+			normal_distribution<double> dist;
+			Eigen::MatrixXd p = *pe.get_eigen_ptr(), o = *oe.get_eigen_ptr();
+			for (int i = 0; i < p.size(); i++)
+				p.data()[i] += 0.1 * dist(rand_gen);
+			for (int i = 0; i < o.size(); i++)
+				o.data()[i] += dist(rand_gen);
+			pe.set_eigen(p);
+			oe.set_eigen(o);
+		}
+		L2PhiHandler ph(&pest_scenario, &file_manager, &oe_base, &pe_base, &parcov, false);
+		results.push_back(time_it("phi_update", cfg.reps, [&]() {
+			ph.update(oe, pe);
+			return ph.get_mean(L2PhiHandler::phiType::COMPOSITE);
+		}));
+
+		//localized upgrade: one case per group, set up as in calc_localized_upgrade_threaded()
+		{
+			unordered_map<string, pair<vector<string>, vector<string>>> loc_map;
+			for (int g = 0; g < cfg.ngroups; g++)
+			{
+				pair<vector<string>, vector<string>> &p = loc_map["case" + to_string(g)];
+				for (int j = g; j < cfg.nobs; j += cfg.ngroups)
+					p.first.push_back(pest_utils::upper_cp(obs_name(j)));
+				for (int i = g; i < cfg.npar; i += cfg.ngroups)
+					p.second.push_back(pest_utils::upper_cp(par_name(i)));
+			}
+			Localizer localizer(&pest_scenario);
+			localizer.initialize(&plog);
+			Localizer::How how = localizer.get_how();
+			Eigen::VectorXd parcov_inv = parcov.e_ptr()->diagonal().cwiseSqrt().cwiseInverse();
+			Eigen::VectorXd weights(obs_names.size());
+			for (int j = 0; j < obs_names.size(); j++)
+				weights[j] = pest_scenario.get_observation_info_ptr()->get_weight(obs_names[j]);
+			Eigen::MatrixXd obs_resid = ph.get_obs_resid_subset(oe);
+			Eigen::MatrixXd obs_diff = oe.get_eigen_anomalies();
+			Eigen::MatrixXd par_resid = ph.get_par_resid_subset(pe);
+			Eigen::MatrixXd par_diff = pe.get_eigen_anomalies();
+			Eigen::MatrixXd Am_t;
+			vector<double> cur_lams{ 0.1, 1.0, 10.0 };
+			ParameterEnsemble pe_upgrade = pe.zeros_like();
+			results.push_back(time_it("localized_upgrade", cfg.reps, [&]() {
+				vector<ParameterEnsemble> pe_upgrades(cur_lams.size(), pe_upgrade);
+				LocalUpgradeThread worker(&plog, par_resid, par_diff, obs_resid, obs_diff, Am_t,
+					parcov_inv, weights, par_names, obs_names, localizer, pe_upgrades, loc_map, how);
+				if (cfg.threads < 2)
+					worker.work(0, 1, cur_lams);
+				else
+				{
+					ThreadPool pool(cfg.threads);
+					vector<future<void>> futures;
+					for (int i = 0; i < cfg.threads; i++)
+						futures.push_back(pool.submit([&worker, i, &cur_lams]() { worker.work(i, 1, cur_lams); }));
+					ThreadPool::wait_all(futures, "bench upgrade");
+				}
+				return pe_upgrades[0].get_eigen().sum();
+			}));
+		}
+
+		//jacobian through the serial run manager and the built-in model
+		if (cfg.jac_npar > 0)
+		{
+			const ModelExecInfo &exi = pest_scenario.get_model_exec_info();
+			RunManagerSerial run_manager(exi.comline_vec, exi.tplfile_vec, exi.inpfile_vec, exi.insfile_vec,
+				exi.outfile_vec, file_manager.build_filename("rns"), cfg.work_dir, 1);
+			const ParamTransformSeq &base_trans_seq = pest_scenario.get_base_par_tran_seq();
+			ParamTransformSeq par_transform = base_trans_seq;
+			run_manager.initialize(base_trans_seq.ctl2model_cp(pars), pest_scenario.get_ctl_observations());
+			OutputFileWriter output_file_writer(file_manager, pest_scenario, false, false);
+			Jacobian_1to1 jacobian(file_manager, output_file_writer);
+			vector<string> numeric_par_names = par_transform.ctl2numeric_cp(pars).get_keys();
+			sort(numeric_par_names.begin(), numeric_par_names.end());
+			if (numeric_par_names.size() > cfg.jac_npar)
+				numeric_par_names.resize(cfg.jac_npar);
+			Parameters ctl_pars = pars;
+			Observations ctl_obs = pest_scenario.get_ctl_observations();
+			set<string> out_of_bound_pars;
+			//the three phases have to run in order, so each rep times each phase once
+			vector<BenchResult> jac_results;
+			for (int rep = 0; rep < cfg.reps; rep++)
+			{
+				vector<BenchResult> rep_results;
+				rep_results.push_back(time_it("jac_build_runs", 1, [&]() {
+					jacobian.build_runs(ctl_pars, ctl_obs, numeric_par_names, par_transform,
+						pest_scenario.get_base_group_info(), pest_scenario.get_ctl_parameter_info(),
+						run_manager, out_of_bound_pars, false, true);
+					return (double)run_manager.get_nruns();
+				}));
+				rep_results.push_back(time_it("jac_model_runs", 1, [&]() {
+					jacobian.make_runs(run_manager);
+					return (double)run_manager.get_num_good_runs();
+				}));
+				rep_results.push_back(time_it("jac_process_runs", 1, [&]() {
+					jacobian.process_runs(par_transform, pest_scenario.get_base_group_info(), run_manager,
+						pest_scenario.get_prior_info(), false, false);
+					return Eigen::MatrixXd(jacobian.get_matrix(jacobian.observation_list(), jacobian.parameter_list())).sum();
+				}));
+				if (rep == 0)
+					jac_results = rep_results;
+				else
+					for (int i = 0; i < rep_results.size(); i++)
+						merge_result(jac_results[i], rep_results[i]);
+			}
+			for (auto &r : jac_results)
+			{
+				r.mean_sec /= r.reps;
+				results.push_back(r);
+			}
+		}
+
+		write_results(cfg, results);
+		cout << endl << "results written to " << cfg.results << endl;
+		if (!cfg.baseline.empty())
+		{
+			int n_regressed = compare_to_baseline(cfg, results);
+			if (n_regressed > 0)
+			{
+				cout << n_regressed << " benchmark(s) regressed" << endl;
+				return 2;
+			}
+		}
+	}
+	catch (exception &e)
+	{
+		cerr << "hot path benchmark error: " << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
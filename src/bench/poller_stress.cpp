@@ -0,0 +1,293 @@
+// loopback stress test for the SocketPoller backends used by the PANTHER master.  a client
+// thread opens num_agents loopback connections and sends num_msgs NetPackages on each one.
+// the messages of each agent are written in odd sized chunks, round robin over the agents,
+// so most messages arrive split across several reads and edge-triggered sockets must be
+// drained.  the server side is the same accept/poll/drain loop as RunManagerPanther::listen()
+// with non-blocking sockets and a NetRecvBuffer per socket.  every message is checked for the
+// right sequence number and size on the right socket.  the server answers each agent with a
+// payload larger than the socket buffers, which the agents only read once they have sent
+// everything, so the replies have to wait in a NetSendQueue.  select is skipped when the
+// descriptors would exceed FD_SETSIZE
+//
+// usage: pestpp-bench-poller [num_agents] [num_msgs] [backend] [payload_doubles]
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include "network_wrapper.h"
+#include "network_package.h"
+#ifdef OS_LINUX
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+int open_listener(int backlog, string &port)
+{
+	struct addrinfo hints;
+	struct addrinfo* servinfo;
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	std::pair<int, string> status = w_getaddrinfo("127.0.0.1", "0", &hints, &servinfo);
+	if (status.first != 0)
+		throw runtime_error("getaddrinfo failed: " + status.second);
+	int listener = -1;
+	if (w_bind_first_avl(servinfo, listener) == nullptr)
+		throw runtime_error("unable to bind loopback listener");
+	freeaddrinfo(servinfo);
+	w_listen(listener, backlog);
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	getsockname(listener, (struct sockaddr*)&addr, &addr_len);
+	port = to_string(ntohs(addr.sin_port));
+	return listener;
+}
+
+//odd sized so that chunk boundaries fall anywhere in a message
+const int64_t SEND_CHUNK = 7919;
+//size of the server's reply to each agent
+const int64_t REPLY_LEN = 512 * 1024;
+
+void run_agents(const string &port, int num_agents, int num_msgs, int payload_len, vector<int> &agent_socks, string &error)
+{
+	try
+	{
+		struct addrinfo hints;
+		memset(&hints, 0, sizeof hints);
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		for (int i = 0; i < num_agents; i++)
+		{
+			struct addrinfo* servinfo;
+			w_getaddrinfo("127.0.0.1", port.c_str(), &hints, &servinfo);
+			int sockfd = -1;
+			if (w_connect_first_avl(servinfo, sockfd) == nullptr)
+				throw runtime_error("agent " + to_string(i) + " unable to connect");
+			freeaddrinfo(servinfo);
+			agent_socks.push_back(sockfd);
+		}
+		//the first message tells the server which agent owns the socket
+		char data = '\0';
+		for (int i = 0; i < num_agents; i++)
+		{
+			NetPackage net_pack(NetPackage::PackType::READY, i, -1, "");
+			net_pack.send(agent_socks[i], &data, 0);
+		}
+		vector<double> payload(payload_len, 1.0);
+		vector<vector<int8_t>> streams(num_agents);
+		for (int i = 0; i < num_agents; i++)
+		{
+			for (int j = 0; j < num_msgs; j++)
+			{
+				NetPackage net_pack(NetPackage::PackType::RUN_FINISHED_BIN, i, j, "");
+				vector<int8_t> msg = net_pack.pack(payload.data(), payload.size() * sizeof(double));
+				streams[i].insert(streams[i].end(), msg.begin(), msg.end());
+			}
+		}
+		vector<int64_t> sent(num_agents, 0);
+		bool more = true;
+		while (more)
+		{
+			more = false;
+			for (int i = 0; i < num_agents; i++)
+			{
+				int64_t len = min(SEND_CHUNK, (int64_t)streams[i].size() - sent[i]);
+				if (len <= 0)
+					continue;
+				if ((w_sendall(agent_socks[i], &streams[i][sent[i]], &len) != 1))
+					throw runtime_error("agent " + to_string(i) + " send failed");
+				sent[i] += len;
+				more = true;
+			}
+		}
+		//now collect the replies that the server had to queue
+		for (int i = 0; i < num_agents; i++)
+		{
+			NetPackage net_pack;
+			pair<int, string> err = net_pack.recv(agent_socks[i]);
+			if (err.first != 1)
+				throw runtime_error("agent " + to_string(i) + " reply recv failed: " + err.second);
+			if ((net_pack.get_type() != NetPackage::PackType::START_RUN) || (net_pack.get_group_id() != i) || (net_pack.get_data().size() != REPLY_LEN))
+				throw runtime_error("agent " + to_string(i) + " received a bad reply");
+		}
+	}
+	catch (exception &e)
+	{
+		error = e.what();
+	}
+}
+
+bool run_backend(const string &backend, int num_agents, int num_msgs, int payload_len)
+{
+	unique_ptr<SocketPoller> poller = SocketPoller::create(backend);
+	string port;
+	int listener = open_listener(num_agents, port);
+	poller->add(listener);
+
+	vector<int> agent_socks;
+	string agent_error;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	thread agents(run_agents, port, num_agents, num_msgs, payload_len, std::ref(agent_socks), std::ref(agent_error));
+
+	map<int, int> sock_to_agent;
+	map<int, NetRecvBuffer> recv_buffers;
+	map<int, NetSendQueue> send_queues;
+	vector<int8_t> reply(REPLY_LEN, 1);
+	vector<int> next_msg(num_agents, 0);
+	long long total = (long long)num_agents * num_msgs, received = 0, n_wait = 0, n_ready = 0, n_queued = 0;
+	int n_replied = 0;
+	vector<int> ready_fds, write_fds;
+	string error;
+	try
+	{
+		while ((received < total) || (n_replied < num_agents))
+		{
+			if (chrono::duration<double>(chrono::steady_clock::now() - start).count() > 120.0)
+				throw runtime_error("timed out with " + to_string(received) + " of " + to_string(total) + " messages received");
+			if (poller->wait(ready_fds, write_fds, 1000) == -1)
+				throw runtime_error("wait failed");
+			n_wait++;
+			n_ready += ready_fds.size();
+			for (int fd : ready_fds)
+			{
+				if (fd == listener)
+				{
+					struct sockaddr_storage remote_addr;
+					socklen_t addr_len = sizeof remote_addr;
+					int newfd = w_accept(listener, (struct sockaddr *)&remote_addr, &addr_len);
+					if (newfd != -1)
+					{
+						poller->add(newfd, true);
+						w_set_nonblocking(newfd);
+						//a small send buffer so the replies do not fit and have to be queued
+						int sndbuf = 64 * 1024;
+						setsockopt(newfd, SOL_SOCKET, SO_SNDBUF, (const char*)&sndbuf, sizeof(sndbuf));
+					}
+					continue;
+				}
+				while (true)
+				{
+					NetPackage net_pack;
+					pair<int, string> err = recv_buffers[fd].recv(fd, net_pack);
+					if (err.first == NetRecvBuffer::INCOMPLETE)
+						break;
+					if (err.first <= 0)
+						throw runtime_error("recv failed on socket " + to_string(fd) + ": " + err.second);
+					int iagent = net_pack.get_group_id();
+					if (net_pack.get_type() == NetPackage::PackType::READY)
+					{
+						sock_to_agent[fd] = iagent;
+						NetPackage reply_pack(NetPackage::PackType::START_RUN, iagent, -1, "");
+						send_queues[fd].push(reply_pack.pack(reply.data(), reply.size()));
+						int n = send_queues[fd].flush(fd);
+						if (n == NetRecvBuffer::INCOMPLETE)
+						{
+							poller->set_write_wait(fd, true);
+							n_queued++;
+						}
+						else if (n == 1)
+							n_replied++;
+						else
+							throw runtime_error("reply send failed on socket " + to_string(fd));
+					}
+					else
+					{
+						if ((sock_to_agent.find(fd) == sock_to_agent.end()) || (sock_to_agent[fd] != iagent))
+							throw runtime_error("message for agent " + to_string(iagent) + " arrived on the wrong socket");
+						if (net_pack.get_run_id() != next_msg[iagent])
+							throw runtime_error("out of order message for agent " + to_string(iagent));
+						if (net_pack.get_data().size() != payload_len * sizeof(double))
+							throw runtime_error("short message for agent " + to_string(iagent));
+						next_msg[iagent]++;
+						received++;
+					}
+				}
+			}
+			for (int fd : write_fds)
+			{
+				int n = send_queues[fd].flush(fd);
+				if (n == 1)
+				{
+					poller->set_write_wait(fd, false);
+					n_replied++;
+				}
+				else if (n != NetRecvBuffer::INCOMPLETE)
+					throw runtime_error("queued reply send failed on socket " + to_string(fd));
+			}
+		}
+	}
+	catch (exception &e)
+	{
+		error = e.what();
+	}
+	agents.join();
+	double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	for (int fd : poller->get_fds())
+		w_close(fd);
+	for (int fd : agent_socks)
+		w_close(fd);
+
+	if (agent_error.size() > 0)
+		error = error + " agent error: " + agent_error;
+	cout << setw(8) << poller->get_name() << ": " << received << " of " << total << " messages, wall: " << fixed << setprecision(3) << wall;
+	cout << " sec, msgs/sec: " << setprecision(0) << received / wall << ", avg ready per wait: " << setprecision(1);
+	cout << (n_wait > 0 ? double(n_ready) / n_wait : 0.0) << ", queued replies: " << n_queued << endl;
+	if (error.size() > 0)
+	{
+		cout << "    FAILED: " << error << endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	int num_agents = 500, num_msgs = 20, payload_len = 2000;
+	string backend = "";
+	if (argc > 1) num_agents = stoi(argv[1]);
+	if (argc > 2) num_msgs = stoi(argv[2]);
+	if (argc > 3) backend = argv[3];
+	if (argc > 4) payload_len = stoi(argv[4]);
+#ifdef OS_LINUX
+	//each agent needs two descriptors
+	struct rlimit rl;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0)
+	{
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+#endif
+	w_init();
+	cout << "socket poller loopback stress test: " << num_agents << " agents, " << num_msgs << " messages per agent" << endl;
+	vector<string> backends;
+	if (backend.size() > 0)
+		backends.push_back(backend);
+	else
+	{
+		backends.push_back("select");
+#ifdef PESTPP_HAVE_EPOLL
+		backends.push_back("epoll");
+#endif
+	}
+	bool ok = true;
+	for (auto &b : backends)
+	{
+#ifdef OS_LINUX
+		if ((b == "select") && (2 * num_agents + 16 >= FD_SETSIZE))
+		{
+			cout << setw(8) << b << ": skipped, " << num_agents << " agents exceeds FD_SETSIZE (" << FD_SETSIZE << ")" << endl;
+			continue;
+		}
+#endif
+		ok = run_backend(b, num_agents, num_msgs, payload_len) && ok;
+	}
+	w_cleanup();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+// benchmark of the ways the localized ies upgrade can be spread over threads.  each mode runs
+// the real LocalUpgradeThread solve behind calc_localized_upgrade_threaded() on the same
+// synthesized problem: a control file of the requested size is written to a work directory,
+// the ensemble anomalies and residuals are random, and the parameters and observations are
+// split over ngroups localization cases of uneven size (case g holds about 2g+1 shares), so
+// that a worker that is handed the big cases late is left running alone:
+//   serial        work() on the calling thread
+//   threads       one std::thread per worker, each claiming cases with work() - the launch
+//                 used before the thread pool
+//   pool_workers  num_threads ThreadPool tasks, each claiming cases with work() - the launch
+//                 used by calc_localized_upgrade_threaded()
+//   pool_cases    one ThreadPool task per case with work_case(), so idle workers steal the
+//                 remaining cases from busy ones
+// reports wall time and process cpu time and the sum of the first lambda upgrade, which
+// must be the same for every mode
+//
+// usage: pestpp-bench-threadpool [num_threads] [npar] [nobs] [nreals] [ngroups] [reps]
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <random>
+#include <string>
+#include <cmath>
+#include <functional>
+#include <unordered_map>
+#include <stdexcept>
+#include <Eigen/Dense>
+#include "config_os.h"
+#include "system_variables.h"
+#include "utilities.h"
+#include "Pest.h"
+#include "FileManager.h"
+#include "PerformanceLog.h"
+#include "Ensemble.h"
+#include "EnsembleSmoother.h"
+#include "Localizer.h"
+#include "ThreadPool.h"
+
+#ifdef OS_WIN
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+string par_name(int i) { stringstream ss; ss << "p" << setw(6) << setfill('0') << i; return ss.str(); }
+string obs_name(int j) { stringstream ss; ss << "o" << setw(6) << setfill('0') << j; return ss.str(); }
+
+//case g gets the (g^2/ngroups^2, (g+1)^2/ngroups^2] fraction of the n names, so about 2g+1 shares
+int case_of(int i, int n, int ngroups)
+{
+	return min(ngroups - 1, int(ngroups * sqrt(double(i) / n)));
+}
+
+//only the control data is used, so the model files named here are never written
+void write_problem(const string &work_dir, int npar, int nobs, int nreals)
+{
+	ofstream pst(work_dir + "/bench.pst");
+	pst << "pcf" << endl << "* control data" << endl << "restart estimation" << endl;
+	pst << npar << " " << nobs << " 1 0 1" << endl;
+	pst << "1 1 single point 1 0 0" << endl;
+	pst << "5.0 2.0 0.3 0.03 10" << endl << "5.0 5.0 0.001" << endl << "0.1" << endl;
+	pst << "1 0.01 3 3 0.01 3" << endl << "0 0 0" << endl;
+	pst << "* singular value decomposition" << endl << "1" << endl << nreals << " 1.0e-6" << endl << "0" << endl;
+	pst << "* parameter groups" << endl << "pg relative 0.01 0.0 switch 2.0 parabolic" << endl;
+	pst << "* parameter data" << endl;
+	for (int i = 0; i < npar; i++)
+		pst << par_name(i) << " log factor 1.0 0.01 100.0 pg 1.0 0.0 1" << endl;
+	pst << "* observation groups" << endl << "og" << endl;
+	pst << "* observation data" << endl;
+	for (int j = 0; j < nobs; j++)
+		pst << obs_name(j) << " 0.0 1.0 og" << endl;
+	pst << "* model command line" << endl << "model" << endl;
+	pst << "* model input/output" << endl << "bench.in.tpl bench.in" << endl << "bench.out.ins bench.out" << endl;
+	pst << "++ies_num_reals(" << nreals << ")" << endl;
+}
+
+void time_it(const string &tag, int reps, const function<double()> &f)
+{
+	double wall = 1.0e+300, cpu = 0.0, checksum = 0.0;
+	for (int i = 0; i < reps; i++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		clock_t cstart = clock();
+		checksum = f();
+		double w = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		//std::clock() is process cpu time on posix (wall time with msvc)
+		double c = double(clock() - cstart) / CLOCKS_PER_SEC;
+		if (w < wall)
+		{
+			wall = w;
+			cpu = c;
+		}
+	}
+	cout << setw(14) << left << tag << right << " wall: " << setw(8) << fixed << setprecision(3) << wall << " sec,  cpu: " << setw(8) << cpu;
+	cout << " sec,  cpu/wall: " << setw(6) << setprecision(2) << cpu / wall << ",  checksum: " << scientific << setprecision(9) << checksum << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int num_threads = max(2, int(thread::hardware_concurrency()));
+	int npar = 4000, nobs = 2000, nreals = 100, ngroups = 100, reps = 3;
+	if (argc > 1) num_threads = stoi(argv[1]);
+	if (argc > 2) npar = stoi(argv[2]);
+	if (argc > 3) nobs = stoi(argv[3]);
+	if (argc > 4) nreals = stoi(argv[4]);
+	if (argc > 5) ngroups = stoi(argv[5]);
+	if (argc > 6) reps = stoi(argv[6]);
+	if ((num_threads < 1) || (nreals < 2) || (reps < 1) || (ngroups < 1) || (ngroups > min(npar, nobs)))
+	{
+		cerr << "invalid arguments: need num_threads, reps >= 1, nreals >= 2 and 1 <= ngroups <= min(npar, nobs)" << endl;
+		return 1;
+	}
+	Eigen::setNbThreads(1);
+	cout << "localized upgrade thread benchmark: " << num_threads << " threads (" << thread::hardware_concurrency();
+	cout << " hardware threads), " << npar << " pars, " << nobs << " obs, " << nreals << " reals, ";
+	cout << ngroups << " cases, best of " << reps << " reps" << endl;
+
+	try
+	{
+		string work_dir = "threadpool_bench";
+#ifdef OS_WIN
+		_mkdir(work_dir.c_str());
+#else
+		mkdir(work_dir.c_str(), 0755);
+#endif
+		write_problem(work_dir, npar, nobs, nreals);
+		FileManager file_manager(work_dir + OperSys::DIR_SEP + "bench", work_dir);
+		file_manager.open_default_files();
+		PerformanceLog plog(file_manager.open_ofile_ext("log"));
+		Pest pest_scenario;
+		pest_scenario.set_defaults();
+		pest_scenario.process_ctl_file(file_manager.open_ifile_ext("pst"), file_manager.build_filename("pst"), file_manager.rec_ofstream());
+		file_manager.close_file("pst");
+		vector<string> par_names = pest_scenario.get_ctl_ordered_par_names();
+		vector<string> obs_names = pest_scenario.get_ctl_ordered_obs_names();
+
+		unordered_map<string, pair<vector<string>, vector<string>>> loc_map;
+		for (int j = 0; j < nobs; j++)
+			loc_map["case" + to_string(case_of(j, nobs, ngroups))].first.push_back(obs_names[j]);
+		for (int i = 0; i < npar; i++)
+			loc_map["case" + to_string(case_of(i, npar, ngroups))].second.push_back(par_names[i]);
+
+		mt19937 gen(1123456789);
+		normal_distribution<double> dist;
+		Eigen::MatrixXd par_resid(nreals, npar), par_diff(nreals, npar), obs_resid(nreals, nobs), obs_diff(nreals, nobs);
+		for (Eigen::MatrixXd *m : { &par_resid, &par_diff, &obs_resid, &obs_diff })
+			for (int i = 0; i < m->size(); i++)
+				m->data()[i] = dist(gen);
+		Eigen::MatrixXd Am_t;
+		Eigen::VectorXd parcov_inv = Eigen::VectorXd::Ones(npar), weights = Eigen::VectorXd::Ones(nobs);
+		Localizer localizer(&pest_scenario);
+		localizer.initialize(&plog);
+		Localizer::How how = localizer.get_how();
+		vector<string> real_names;
+		for (int r = 0; r < nreals; r++)
+			real_names.push_back(to_string(r));
+		ParameterEnsemble pe_upgrade(&pest_scenario, &gen, Eigen::MatrixXd::Zero(nreals, npar), real_names, par_names);
+		vector<double> cur_lams{ 0.1, 1.0, 10.0 };
+
+		//runs one upgrade with a fresh worker, launched by the given function
+		auto run = [&](const function<void(LocalUpgradeThread&)> &launch) {
+			vector<ParameterEnsemble> pe_upgrades(cur_lams.size(), pe_upgrade);
+			LocalUpgradeThread worker(&plog, par_resid, par_diff, obs_resid, obs_diff, Am_t,
+				parcov_inv, weights, par_names, obs_names, localizer, pe_upgrades, loc_map, how);
+			launch(worker);
+			return pe_upgrades[0].get_eigen().sum();
+		};
+
+		time_it("serial", reps, [&]() {
+			return run([&](LocalUpgradeThread &worker) { worker.work(0, 1, cur_lams); });
+		});
+		time_it("threads", reps, [&]() {
+			return run([&](LocalUpgradeThread &worker) {
+				vector<thread> threads;
+				for (int i = 0; i < num_threads; i++)
+					threads.push_back(thread([&worker, i, &cur_lams]() { worker.work(i, 1, cur_lams); }));
+				for (auto &t : threads)
+					t.join();
+			});
+		});
+		time_it("pool_workers", reps, [&]() {
+			return run([&](LocalUpgradeThread &worker) {
+				ThreadPool pool(num_threads);
+				vector<future<void>> futures;
+				for (int i = 0; i < num_threads; i++)
+					futures.push_back(pool.submit([&worker, i, &cur_lams]() { worker.work(i, 1, cur_lams); }));
+				ThreadPool::wait_all(futures, "bench upgrade");
+			});
+		});
+		time_it("pool_cases", reps, [&]() {
+			return run([&](LocalUpgradeThread &worker) {
+				ThreadPool pool(num_threads);
+				vector<future<void>> futures;
+				for (int i = 0; i < worker.get_num_cases(); i++)
+					futures.push_back(pool.submit([&worker, i, &cur_lams]() { worker.work_case(i, 1, cur_lams); }));
+				ThreadPool::wait_all(futures, "bench upgrade");
+			});
+		});
+	}
+	catch (exception &e)
+	{
+		cerr << "error: " << e.what() << endl;
+		return 1;
+	}
+	return 0;
+}
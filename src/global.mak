@@ -113,6 +113,9 @@ else  # $(COMPILER))
     FFLAGS ?= $(OPT_FLAGS) -cpp
     FFREE = -free
     EXT_LIBS = -lpthread
+    ifneq ($(SYSTEM),win)
+        EXT_LIBS += -ldl
+    endif
 # else
 #     $(error COMPILER not understood: $(COMPILER). Use one of intel or gcc.)
 endif  # $(COMPILER)
@@ -10,6 +10,7 @@ using namespace std;
 //Static Memeber Initialization
 int64_t NetPackage::last_group_id = 0;
 int8_t NetPackage::security_code[5] = { 1, 3, 5, 7, 9 };
+const string NetPackage::BIN_RESULTS_TAG = "bin_results_v1";
 
 //Static Methods
 int NetPackage::get_new_group_id()
@@ -148,82 +149,144 @@ void NetPackage::reset(PackType _type, int _group, int _run_id, const string &_d
 	data.clear();
 }
 
-std::pair<int,std::string> NetPackage::send(int sockfd, const void *data, int64_t data_len_l)
+int64_t NetPackage::get_header_len()
 {
-	int n;
-
-	// first send security code
-	int64_t security_code_size = sizeof(security_code);
-	int i = 0;
-	n = w_sendall(sockfd, &security_code[0], &security_code_size);
-	
-	if (n < 1)
-	{
-		//cerr << "NetPackage::send error: could not send security code" << endl;
-		return pair<int,string>(n,"NetPackage::send error: could not send security code");
-	}
 	int64_t buf_sz = 0;
-	//calculate the size of buffer
-	buf_sz += sizeof(buf_sz);
-	buf_sz += sizeof(type);
-	buf_sz += sizeof(group);
-	buf_sz += sizeof(run_id);
-	buf_sz += sizeof(desc);
-	buf_sz += data_len_l;
-	//pack information into buffer
-	//unique_ptr<char[]> buf(new char[buf_sz]);
+	return sizeof(buf_sz) + sizeof(type) + sizeof(group) + sizeof(run_id) + sizeof(desc);
+}
+
+vector<int8_t> NetPackage::pack(const void *data, int64_t data_len_l) const
+{
+	int64_t code_sz = sizeof(security_code);
+	//buf_sz covers the header and the data but not the security code
+	int64_t buf_sz = get_header_len() + data_len_l;
 	vector<int8_t> buf;
-	buf.resize(buf_sz, '\0');
+	buf.resize(code_sz + buf_sz, '\0');
 	size_t i_start = 0;
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, &buf_sz, sizeof(buf_sz));
+	size_t i_end = buf.size();
+	w_memcpy_s(&buf[i_start], i_end - i_start, security_code, code_sz);
+	i_start += code_sz;
+	w_memcpy_s(&buf[i_start], i_end - i_start, &buf_sz, sizeof(buf_sz));
 	i_start += sizeof(buf_sz);
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, &type, sizeof(type));
+	w_memcpy_s(&buf[i_start], i_end - i_start, &type, sizeof(type));
 	i_start += sizeof(type);
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, &group, sizeof(group));
+	w_memcpy_s(&buf[i_start], i_end - i_start, &group, sizeof(group));
 	i_start += sizeof(group);
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, &run_id, sizeof(run_id));
+	w_memcpy_s(&buf[i_start], i_end - i_start, &run_id, sizeof(run_id));
 	i_start += sizeof(run_id);
-	w_memcpy_s(&buf[i_start], buf_sz-i_start, desc, sizeof(desc));
+	w_memcpy_s(&buf[i_start], i_end - i_start, desc, sizeof(desc));
 	i_start += sizeof(desc);
 	if (data_len_l > 0) {
-		w_memcpy_s(&buf[i_start], buf_sz-i_start, data, data_len_l);
-		i_start += data_len_l;
+		w_memcpy_s(&buf[i_start], i_end - i_start, data, data_len_l);
 	}
+	return buf;
+}
+
+std::pair<int,std::string> NetPackage::send(int sockfd, const void *data, int64_t data_len_l)
+{
+	int n;
+	//security code, header and data go out in a single send
+	vector<int8_t> buf = pack(data, data_len_l);
+	int64_t buf_sz = buf.size();
 	n = w_sendall(sockfd, buf.data(), &buf_sz);
 	if (n < 1)
 	{
 		//cerr << "NetPackage::send error: could not send data" << endl;
 		return pair<int,string> (n, "NetPackage::send error : could not send data");
 	}
-	if (i_start != buf_sz) {
+	if (buf_sz != buf.size()) {
 		stringstream ss;
-		ss << "NetPackage::send error: could only send" << i_start
-			<< " out of " << buf_sz << "bytes" << endl;
+		ss << "NetPackage::send error: could only send" << buf_sz
+			<< " out of " << buf.size() << "bytes" << endl;
 		return pair<int, string>(-2, ss.str());
 	}
 	stringstream ss;
-	ss << "sent " << buf_sz << " bytes";
+	ss << "sent " << buf_sz - sizeof(security_code) << " bytes";
 	return pair<int,string>(n,ss.str());  // return -2 on corrupt send, -1 on failure, 0 closed connection or 1 on success
 }
 
+pair<int, string> NetPackage::check_security_code(const int8_t *rcv_code)
+{
+	int sum = 0;
+	bool wrong_code = false;
+	for (int i = 0; i < sizeof(security_code); i++)
+	{
+		sum = sum + int(rcv_code[i]);
+		if (int(security_code[i]) != int(rcv_code[i]))
+		{
+			wrong_code = true;
+		}
+	}
+	if (sum == 0)
+	{
+		return pair<int, string>(-2, "NetPackage::recv empty security code");
+	}
+	if (wrong_code)
+	{
+		// corrupt message; message did not originate from a PEST++ application
+		stringstream ss;
+		ss << "NetPackage::recv wrong security code: ";
+		for (int i = 0; i < sizeof(security_code); i++)
+		{
+			ss << rcv_code[i] << "," << int(rcv_code[i]) << "; ";
+		}
+		return pair<int, string>(-2, ss.str());
+	}
+	return pair<int, string>(1, "");
+}
+
+pair<int, string> NetPackage::unpack_header(const int8_t *header_buf)
+{
+	int64_t buf_sz = 0;
+	size_t i_start = 0;
+	w_memcpy_s(&buf_sz, sizeof(buf_sz), &header_buf[i_start], sizeof(buf_sz));
+	i_start += sizeof(buf_sz);
+	w_memcpy_s(&type, sizeof(type), &header_buf[i_start], sizeof(type));
+	i_start += sizeof(type);
+	w_memcpy_s(&group, sizeof(group), &header_buf[i_start], sizeof(group));
+	i_start += sizeof(group);
+	w_memcpy_s(&run_id, sizeof(run_id), &header_buf[i_start], sizeof(run_id));
+	i_start += sizeof(run_id);
+	// This is done to remove possible system dependicies on whether char/uchar
+	// is use to represent a standard char
+	for (int i = 0; i < DESC_LEN; ++i)
+	{
+		if (!allowable_ascii_char(header_buf[i_start + i]))
+		{
+			stringstream ss;
+			ss << "non - ascii char in header buffer at position " << i << ": " << header_buf[i_start + i];
+			return pair<int, string>(-2, ss.str());
+		}
+		else
+		{
+			desc[i] = header_buf[i_start + i];
+		}
+	}
+	i_start += sizeof(desc);
+	desc[DESC_LEN - 1] = '\0';
+	data_len = buf_sz - i_start;
+	if (data_len < 0)
+	{
+		stringstream ss;
+		ss << "NetPackage::recv error: message size " << buf_sz << " is smaller than the header";
+		return pair<int, string>(-2, ss.str());
+	}
+	return pair<int, string>(1, "");
+}
+
 pair<int,string>  NetPackage::recv(int sockfd)
 {
 	long n;
 	int64_t header_sz = 0;
-	int64_t buf_sz = 0;
-	size_t i_start = 0;
 	int8_t rcv_security_code[5] = { 0, 0, 0, 0, 0 };
-	int temp,temp1,temp2, sum;
 	int64_t rcv_security_code_size = sizeof(rcv_security_code);
-	bool corrupt_desc = false;
 	stringstream ss;
 	try{
 		//get header (ie size, seq_id, id and name)
-		header_sz = sizeof(buf_sz) + sizeof(type) + sizeof(group) + sizeof(run_id) + sizeof(desc);
+		header_sz = get_header_len();
 		vector<int8_t> header_buf;
 		header_buf.resize(header_sz, '\0');
 		n = w_recvall(sockfd, &rcv_security_code[0], &rcv_security_code_size);
-		//int security_cmp = memcmp(security_code, rcv_security_code, sizeof(security_code))
 		if (n == -1)
 		{
 			return pair<int, string>(-1, "NetPackage::lost connection");
@@ -232,43 +295,14 @@ pair<int,string>  NetPackage::recv(int sockfd)
 		{
 			return pair<int, string>(0, "NetPackage::connection closed");
 		}
-		sum = 0;
-		bool wrong_code = false;
-		for (int i = 0; i < sizeof(security_code); i++)
+		pair<int, string> code_status = check_security_code(rcv_security_code);
+		if (code_status.first != 1)
 		{
-			temp1 = int(security_code[i]);
-			temp2 = int(rcv_security_code[i]);
-			sum = sum + temp2;
-			if (temp1 != temp2)
-			{
-				wrong_code = true;
-			}
-		}
-		if (sum == 0)
-		{
-			//cerr << "NetPackage::recv empty security code, terminating connection..." << endl;
-			return pair<int,string> (-2, "NetPackage::recv empty security code");
-		}
-		if (wrong_code) //(security_cmp != 0)
-		{
-			// corrupt message; message did not originate from a PEST++ application
-			//cerr << "NetPackage::recv wrong security code: ";
-			//cerr << " raw value, int cast: ";
-			ss.str("");
-			ss << "NetPackage::recv wrong security code: ";
-			for (int i = 0; i < sizeof(security_code); i++)
-			{
-				temp = int(rcv_security_code[i]);
-				ss << rcv_security_code[i] << "," << temp << "; ";
-			}
-			//cerr << endl;
-			n = -2;
-			return pair<int,string> (n,ss.str());
+			return code_status;
 		}
 
 		n = w_recvall(sockfd, &header_buf[0], &header_sz);
 		
-		ss << "recv'd " << buf_sz << " bytes";
 		if (n > 0 && header_sz != header_buf.size()) {
 			// corrupt message; message not the correct length
 			n = -2;
@@ -277,45 +311,22 @@ pair<int,string>  NetPackage::recv(int sockfd)
 				<< " bytes, but received " << header_sz << "bytes" << endl;
 		}
 		else if (n > 0) {
-			i_start = 0;
-			w_memcpy_s(&buf_sz, sizeof(buf_sz), &header_buf[i_start], sizeof(buf_sz));
-			i_start += sizeof(buf_sz);
-			w_memcpy_s(&type, sizeof(type), &header_buf[i_start], sizeof(type));
-			i_start += sizeof(type);
-			w_memcpy_s(&group, sizeof(group), &header_buf[i_start], sizeof(group));
-			i_start += sizeof(group);
-			w_memcpy_s(&run_id, sizeof(run_id), &header_buf[i_start], sizeof(run_id));
-			i_start += sizeof(run_id);
-			//w_memcpy_s(&desc, sizeof(desc), &header_buf[i_start], sizeof(desc));
-			// This is done to remove possible system dependicies on whether char/uchar
-			// is use to represent a standard char
-			for (int i = 0; i < DESC_LEN; ++i)
+			pair<int, string> header_status = unpack_header(header_buf.data());
+			if (header_status.first != 1)
 			{
-				if (!allowable_ascii_char(header_buf[i_start + i]))
-				{
-					corrupt_desc = true;
-					n = -2;
-					ss.str("");
-					ss << "non - ascii char in header buffer at position " << i << ": " << header_buf[i_start + i];
-					return pair<int,string> (n,ss.str());
-				}
-				else
-				{
-					desc[i] = header_buf[i_start + i];
-				}
+				return header_status;
 			}
-			i_start += sizeof(desc);
-			desc[DESC_LEN - 1] = '\0';
+			ss << "recv'd " << header_sz + data_len << " bytes";
 			//get data
-			data_len = buf_sz - i_start;
+			int64_t expected_len = data_len;
 			data.resize(data_len, '\0');
 			if (data_len > 0) {
 				n = w_recvall(sockfd, &data[0], &data_len);
-				if (data_len != buf_sz - header_sz)
+				if (data_len != expected_len)
 				{
 					n = -2;
 					ss.str("");
-					ss << "NetPackage::recv error reading data: expected" << buf_sz - header_sz
+					ss << "NetPackage::recv error reading data: expected" << expected_len
 						<< " bytes, but received " << data_len << "bytes" << endl;
 				}
 			}
@@ -345,6 +356,106 @@ void NetPackage::print_header(std::ostream &fout)
 }
 
 
+NetRecvBuffer::NetRecvBuffer()
+{
+	reset();
+}
+
+void NetRecvBuffer::reset()
+{
+	stage = Stage::SECURITY;
+	buf.assign(sizeof(NetPackage::security_code), 0);
+	n_recv = 0;
+}
+
+int NetRecvBuffer::fill(int sockfd)
+{
+	while (n_recv < (int64_t)buf.size())
+	{
+		int n = w_recv(sockfd, &buf[n_recv], buf.size() - n_recv, 0);
+		if (n == 0)
+			return 0;
+		if (n < 0)
+			return w_would_block() ? INCOMPLETE : -1;
+		n_recv += n;
+	}
+	return 1;
+}
+
+pair<int, string> NetRecvBuffer::recv(int sockfd, NetPackage &net_pack)
+{
+	while (true)
+	{
+		int n = (buf.empty()) ? 1 : fill(sockfd);
+		if (n == INCOMPLETE)
+			return pair<int, string>(INCOMPLETE, "");
+		if (n == 0)
+		{
+			reset();
+			return pair<int, string>(0, "NetPackage::connection closed");
+		}
+		if (n == -1)
+		{
+			reset();
+			return pair<int, string>(-1, "NetPackage::lost connection");
+		}
+		if (stage == Stage::SECURITY)
+		{
+			pair<int, string> status = NetPackage::check_security_code(buf.data());
+			if (status.first != 1)
+			{
+				reset();
+				return status;
+			}
+			stage = Stage::HEADER;
+			buf.assign(NetPackage::get_header_len(), 0);
+			n_recv = 0;
+		}
+		else if (stage == Stage::HEADER)
+		{
+			pair<int, string> status = net_pack.unpack_header(buf.data());
+			if (status.first != 1)
+			{
+				reset();
+				return status;
+			}
+			stage = Stage::DATA;
+			header.swap(buf);
+			buf.assign(net_pack.data_len, 0);
+			n_recv = 0;
+		}
+		else
+		{
+			stringstream ss;
+			ss << "recv'd " << header.size() + buf.size() << " bytes";
+			net_pack.unpack_header(header.data());
+			net_pack.data.swap(buf);
+			reset();
+			return pair<int, string>(1, ss.str());
+		}
+	}
+}
+
+int NetSendQueue::flush(int sockfd)
+{
+	while (!msgs.empty())
+	{
+		vector<int8_t> &msg = msgs.front();
+		while (front_sent < (int64_t)msg.size())
+		{
+			int n = w_send(sockfd, &msg[front_sent], msg.size() - front_sent, 0);
+			if (n == 0)
+				return 0;
+			if (n < 0)
+				return w_would_block() ? NetRecvBuffer::INCOMPLETE : -1;
+			front_sent += n;
+		}
+		msgs.pop_front();
+		front_sent = 0;
+	}
+	return 1;
+}
+
 //template std::string NetPackage::extract_string< std::vector<int8_t>::iterator>(std::vector<int8_t>::iterator first, std::vector<int8_t>::iterator last);
 template std::vector<int8_t> NetPackage::pack_string< std::string::iterator>(std::string::iterator first, std::string::iterator last);
 template std::vector<int8_t> NetPackage::pack_string< std::string::const_iterator>(std::string::const_iterator first, std::string::const_iterator last);
@@ -3,8 +3,11 @@
 #include <string>
 #include <cstdint>
 #include <vector>
+#include <deque>
 #include <memory>
 
+class NetRecvBuffer;
+
 class NetPackage
 {
 public:
@@ -20,7 +23,9 @@ public:
 	enum class PackType :uint32_t {
 		UNKN, OK, CONFIRM_OK, READY, REQ_RUNDIR, RUNDIR, REQ_LINPACK, LINPACK, PAR_NAMES, OBS_NAMES,
 		START_RUN, RUN_FINISHED, RUN_FAILED, RUN_KILLED, TERMINATE,PING,REQ_KILL,IO_ERROR,CORRUPT_MESG,
-		DEBUG_LOOP,DEBUG_FAIL_FREEZE};
+		DEBUG_LOOP,DEBUG_FAIL_FREEZE,RUN_FINISHED_BIN};
+	//sent by the master as the PAR_NAMES description to advertise RUN_FINISHED_BIN support
+	static const std::string BIN_RESULTS_TAG;
 	
 	static int get_new_group_id();
 	NetPackage(PackType _type=PackType::UNKN, int _group=-1, int _run_id=-1, const std::string &desc_str="");
@@ -30,6 +35,8 @@ public:
 	const static int NULL_DA_CYCLE = -9999;
 	std::pair<int,std::string> send(int sockfd, const void *data, int64_t data_len_l);
 	std::pair<int,std::string> recv(int sockfd);
+	//the complete message (security code, header and data) as it is sent over the wire
+	std::vector<int8_t> pack(const void *data, int64_t data_len_l) const;
 	void reset(PackType _type, int _group, int _run_id, const std::string &_desc);
 	PackType get_type() const {return type;}
 	int64_t get_run_id() const { return run_id; }
@@ -40,6 +47,12 @@ public:
 
 
 private:
+	friend class NetRecvBuffer;
+	static int64_t get_header_len();
+	//returns -2 and a message if rcv_code is not the security code, 1 otherwise
+	static std::pair<int, std::string> check_security_code(const int8_t *rcv_code);
+	//unpack a received header into this package and set data_len; returns -2 on a corrupt header
+	std::pair<int, std::string> unpack_header(const int8_t *header_buf);
 	bool verbose;
 	int64_t data_len;
 	static int64_t last_group_id;
@@ -51,5 +64,50 @@ private:
 	std::vector<int8_t> data;
 };
 
+//assembles a NetPackage from a non-blocking socket across as many recv() calls as it takes
+//to arrive, so a slow or large message never stalls the caller
+class NetRecvBuffer
+{
+public:
+	//returned by recv() when the socket has no more data but the message is not complete
+	static const int INCOMPLETE = 2;
+	NetRecvBuffer();
+	//read whatever is available on sockfd. returns 1 with the message in net_pack once it is
+	//complete, INCOMPLETE if more data is needed, 0 on a closed connection, -1 on failure and
+	//-2 on a corrupt message
+	std::pair<int, std::string> recv(int sockfd, NetPackage &net_pack);
+	//true if part of a message has been received
+	bool in_progress() const { return (stage != Stage::SECURITY) || (n_recv > 0); }
+	void reset();
+private:
+	enum class Stage { SECURITY, HEADER, DATA };
+	Stage stage;
+	//the header is kept until the data has arrived as the caller's package may change between calls
+	std::vector<int8_t> header;
+	std::vector<int8_t> buf;
+	int64_t n_recv;
+	//read into buf until it is full; returns 1 when full, INCOMPLETE, 0 or -1
+	int fill(int sockfd);
+};
+
+//outgoing messages for a non-blocking socket. messages that do not fit in the socket's send
+//buffer are kept, in order, until the socket can be written to again
+class NetSendQueue
+{
+public:
+	NetSendQueue() : front_sent(0) {}
+	void push(std::vector<int8_t> &&msg) { msgs.push_back(std::move(msg)); }
+	//send as much as the socket accepts. returns 1 once the queue is empty,
+	//NetRecvBuffer::INCOMPLETE if the socket is full, 0 on a closed connection or -1 on failure
+	int flush(int sockfd);
+	bool empty() const { return msgs.empty(); }
+	size_t size() const { return msgs.size(); }
+	void clear() { msgs.clear(); front_sent = 0; }
+private:
+	std::deque<std::vector<int8_t>> msgs;
+	//bytes of the front message already sent
+	int64_t front_sent;
+};
+
 
 #endif /* NET_PACKAGE_H_ */
@@ -23,6 +23,7 @@
 #include<sys/wait.h>
 #include <errno.h>
 #include <signal.h>
+#include <fcntl.h>
 #endif
 
 using namespace std;
@@ -398,3 +399,224 @@ void w_sleep(int millisec)
    #endif
 }
 
+int w_set_nonblocking(int sockfd, bool nonblocking)
+{
+#ifdef OS_WIN
+	u_long mode = nonblocking ? 1 : 0;
+	return (ioctlsocket(sockfd, FIONBIO, &mode) == 0) ? 0 : -1;
+#endif
+#ifdef OS_LINUX
+	int flags = fcntl(sockfd, F_GETFL, 0);
+	if (flags == -1)
+		return -1;
+	flags = nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	return (fcntl(sockfd, F_SETFL, flags) == 0) ? 0 : -1;
+#endif
+}
+
+bool w_would_block()
+{
+#ifdef OS_WIN
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#endif
+#ifdef OS_LINUX
+	return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+#endif
+}
+
+int SocketPoller::wait(vector<int> &ready_fds, int timeout_ms)
+{
+	vector<int> write_fds;
+	return wait(ready_fds, write_fds, timeout_ms);
+}
+
+unique_ptr<SocketPoller> SocketPoller::create(const string &backend)
+{
+	string b = pest_utils::lower_cp(backend);
+	if (b == "select")
+		return unique_ptr<SocketPoller>(new SelectPoller());
+	if ((b == "epoll") || (b.size() == 0))
+	{
+#ifdef PESTPP_HAVE_EPOLL
+		return unique_ptr<SocketPoller>(new EpollPoller());
+#else
+		if (b.size() > 0)
+			cerr << "epoll not available on this platform, using select" << endl;
+		return unique_ptr<SocketPoller>(new SelectPoller());
+#endif
+	}
+	throw runtime_error("SocketPoller::create() error: unrecognized backend '" + backend + "', should be 'select' or 'epoll'");
+}
+
+SelectPoller::SelectPoller() : fdmax(-1)
+{
+	FD_ZERO(&master);
+	FD_ZERO(&write_master);
+}
+
+void SelectPoller::add(int sockfd, bool edge_triggered)
+{
+#ifdef OS_LINUX
+	//on windows fd_set is a list of sockets bounded by FD_SETSIZE entries, elsewhere it is a bitmap
+	//indexed by descriptor so larger descriptors can not be watched at all
+	if (sockfd >= FD_SETSIZE)
+	{
+		stringstream ss;
+		ss << "SelectPoller::add() error: socket " << sockfd << " exceeds FD_SETSIZE (" << FD_SETSIZE << ")";
+		throw runtime_error(ss.str());
+	}
+#endif
+#ifdef OS_WIN
+	if ((fds.size() >= FD_SETSIZE) && (!contains(sockfd)))
+	{
+		stringstream ss;
+		ss << "SelectPoller::add() error: number of sockets exceeds FD_SETSIZE (" << FD_SETSIZE << ")";
+		throw runtime_error(ss.str());
+	}
+#endif
+	FD_SET(sockfd, &master);
+	fds.insert(sockfd);
+	if (sockfd > fdmax)
+		fdmax = sockfd;
+}
+
+void SelectPoller::remove(int sockfd)
+{
+	if (!contains(sockfd))
+		return;
+	set_write_wait(sockfd, false);
+	FD_CLR(sockfd, &master);
+	fds.erase(sockfd);
+	if (sockfd == fdmax)
+	{
+		fdmax = -1;
+		for (auto fd : fds)
+			fdmax = max(fdmax, fd);
+	}
+}
+
+void SelectPoller::set_write_wait(int sockfd, bool wait_write)
+{
+	if (wait_write && contains(sockfd))
+	{
+		FD_SET(sockfd, &write_master);
+		write_fds_set.insert(sockfd);
+	}
+	else if ((!wait_write) && (write_fds_set.find(sockfd) != write_fds_set.end()))
+	{
+		FD_CLR(sockfd, &write_master);
+		write_fds_set.erase(sockfd);
+	}
+}
+
+int SelectPoller::wait(vector<int> &ready_fds, vector<int> &write_fds, int timeout_ms)
+{
+	ready_fds.clear();
+	write_fds.clear();
+	fd_set read_fds = master;
+	fd_set w_fds = write_master;
+	timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	int n = w_select(fdmax + 1, &read_fds, write_fds_set.empty() ? NULL : &w_fds, NULL, &tv);
+	if (n <= 0)
+		return n;
+	for (auto fd : fds)
+	{
+		if (FD_ISSET(fd, &read_fds))
+			ready_fds.push_back(fd);
+	}
+	for (auto fd : write_fds_set)
+	{
+		if (FD_ISSET(fd, &w_fds))
+			write_fds.push_back(fd);
+	}
+	return ready_fds.size() + write_fds.size();
+}
+
+#ifdef PESTPP_HAVE_EPOLL
+EpollPoller::EpollPoller()
+{
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd == -1)
+		throw runtime_error("EpollPoller error: epoll_create1() failed: " + w_get_error_msg());
+	events.resize(256);
+}
+
+EpollPoller::~EpollPoller()
+{
+	close(epfd);
+}
+
+void EpollPoller::modify(int sockfd, uint32_t ev_mask)
+{
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = ev_mask;
+	ev.data.fd = sockfd;
+	int op = contains(sockfd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	if (epoll_ctl(epfd, op, sockfd, &ev) == -1)
+	{
+		stringstream ss;
+		ss << "EpollPoller::add() error for socket " << sockfd << ": " << w_get_error_msg();
+		throw runtime_error(ss.str());
+	}
+	fds.insert(sockfd);
+	fd_events[sockfd] = ev_mask;
+}
+
+void EpollPoller::add(int sockfd, bool edge_triggered)
+{
+	uint32_t ev_mask = EPOLLIN | EPOLLRDHUP;
+	if (edge_triggered)
+		ev_mask |= EPOLLET;
+	modify(sockfd, ev_mask);
+}
+
+void EpollPoller::remove(int sockfd)
+{
+	if (!contains(sockfd))
+		return;
+	//the kernel drops closed descriptors by itself, so a failure here is not an error
+	struct epoll_event ev;
+	epoll_ctl(epfd, EPOLL_CTL_DEL, sockfd, &ev);
+	fds.erase(sockfd);
+	fd_events.erase(sockfd);
+}
+
+void EpollPoller::set_write_wait(int sockfd, bool wait_write)
+{
+	auto it = fd_events.find(sockfd);
+	if (it == fd_events.end())
+		return;
+	uint32_t ev_mask = wait_write ? (it->second | EPOLLOUT) : (it->second & ~uint32_t(EPOLLOUT));
+	if (ev_mask != it->second)
+		modify(sockfd, ev_mask);
+}
+
+int EpollPoller::wait(vector<int> &ready_fds, vector<int> &write_fds, int timeout_ms)
+{
+	ready_fds.clear();
+	write_fds.clear();
+	//grow the event buffer with the registered set so one call can report every ready socket
+	if (events.size() < fds.size())
+		events.resize(fds.size());
+	int n = epoll_wait(epfd, events.data(), events.size(), timeout_ms);
+	if (n == -1)
+	{
+		if (errno == EINTR)
+			return 0;
+		cerr << "epoll_wait error: " << w_get_error_msg() << endl;
+		return -1;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		//errors and hang ups are reported as readable so the caller finds them on the next read
+		if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			ready_fds.push_back(events[i].data.fd);
+		if (events[i].events & EPOLLOUT)
+			write_fds.push_back(events[i].data.fd);
+	}
+	return n;
+}
+#endif
@@ -22,11 +22,18 @@
   #include <netdb.h>
   #include <sys/socket.h>
 #endif
+#ifdef __linux__
+  #define PESTPP_HAVE_EPOLL
+  #include <sys/epoll.h>
+#endif
 
 //common for all systems
 #include <iostream>
 #include <vector>
 #include <string>
+#include <memory>
+#include <unordered_set>
+#include <unordered_map>
 
 std::string w_init();
 std::string w_get_hostname();
@@ -54,5 +61,76 @@ void w_print_servinfo(struct addrinfo *res, std::ostream &fout);
 std::string w_get_addrinfo_string(struct addrinfo *p);
 std::string w_get_error_msg();
 void w_sleep(int millisec);
+//switch a socket between blocking and non-blocking mode; returns 0 on success, -1 on failure
+int w_set_nonblocking(int sockfd, bool nonblocking = true);
+//true if the last failed send/recv on a non-blocking socket only failed because it would block
+bool w_would_block();
+
+//readiness notification for a set of sockets.  wait() returns the sockets that are ready
+//to read; the cost of wait() for the epoll backend scales with the number of ready sockets
+//rather than the number registered.  sockets added as edge_triggered are only reported
+//when new data arrives, so the caller must drain them by reading until the socket's
+//NetRecvBuffer returns INCOMPLETE - backends that do not support edge triggering treat
+//them as level triggered, which is always safe.
+//sockets with queued sends can also be watched for room to write with set_write_wait()
+class SocketPoller
+{
+public:
+	virtual ~SocketPoller() {}
+	virtual void add(int sockfd, bool edge_triggered = false) = 0;
+	virtual void remove(int sockfd) = 0;
+	//report sockfd (which must have been added) in write_fds while it can be written to
+	virtual void set_write_wait(int sockfd, bool wait_write) = 0;
+	bool contains(int sockfd) const { return fds.find(sockfd) != fds.end(); }
+	size_t size() const { return fds.size(); }
+	std::vector<int> get_fds() const { return std::vector<int>(fds.begin(), fds.end()); }
+	//returns the number of ready sockets or -1 on error
+	int wait(std::vector<int> &ready_fds, int timeout_ms);
+	//as above but also returns the sockets in the write wait set that can be written to
+	virtual int wait(std::vector<int> &ready_fds, std::vector<int> &write_fds, int timeout_ms) = 0;
+	virtual std::string get_name() const = 0;
+	//backend is "select", "epoll" or "" for the best available
+	static std::unique_ptr<SocketPoller> create(const std::string &backend = "");
+protected:
+	std::unordered_set<int> fds;
+};
+
+class SelectPoller : public SocketPoller
+{
+public:
+	SelectPoller();
+	void add(int sockfd, bool edge_triggered = false);
+	void remove(int sockfd);
+	void set_write_wait(int sockfd, bool wait_write);
+	using SocketPoller::wait;
+	int wait(std::vector<int> &ready_fds, std::vector<int> &write_fds, int timeout_ms);
+	std::string get_name() const { return "select"; }
+private:
+	fd_set master;
+	fd_set write_master;
+	std::unordered_set<int> write_fds_set;
+	int fdmax;
+};
+
+#ifdef PESTPP_HAVE_EPOLL
+class EpollPoller : public SocketPoller
+{
+public:
+	EpollPoller();
+	~EpollPoller();
+	void add(int sockfd, bool edge_triggered = false);
+	void remove(int sockfd);
+	void set_write_wait(int sockfd, bool wait_write);
+	using SocketPoller::wait;
+	int wait(std::vector<int> &ready_fds, std::vector<int> &write_fds, int timeout_ms);
+	std::string get_name() const { return "epoll"; }
+private:
+	int epfd;
+	std::vector<struct epoll_event> events;
+	//registered event mask of each socket
+	std::unordered_map<int, uint32_t> fd_events;
+	void modify(int sockfd, uint32_t ev_mask);
+};
+#endif
 #endif /* NETWORK_H_ */
 
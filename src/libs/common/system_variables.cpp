@@ -24,6 +24,8 @@
 #include <sstream>
 #include <cmath>
 #include <vector>
+#include <fstream>
+#include <algorithm>
 #include "system_variables.h"
 
 #ifdef OS_WIN
@@ -33,6 +35,8 @@
 #ifdef OS_LINUX
 #include "stdio.h"
 #include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 #endif
 
@@ -95,6 +99,125 @@ void OperSys::chdir(const char *str)
    #endif
 }
 
+bool OperSys::make_dir(const string &dir)
+{
+   #ifdef OS_WIN
+	if (CreateDirectoryA(dir.c_str(), NULL) == 0)
+	{
+		DWORD attr = GetFileAttributesA(dir.c_str());
+		return (attr != INVALID_FILE_ATTRIBUTES) && (attr & FILE_ATTRIBUTE_DIRECTORY);
+	}
+	return true;
+   #endif
+   #ifdef OS_LINUX
+	if (::mkdir(dir.c_str(), 0755) != 0)
+	{
+		struct stat st;
+		return (stat(dir.c_str(), &st) == 0) && S_ISDIR(st.st_mode);
+	}
+	return true;
+   #endif
+}
+
+void OperSys::copy_dir(const string &src_dir, const string &dest_dir, const vector<string> &skip_names)
+{
+	if (!make_dir(dest_dir))
+		throw runtime_error("OperSys::copy_dir() error creating directory '" + dest_dir + "'");
+	//directories are recursed into, but links to directories are recreated as links
+	//(to the resolved target) so a link cycle cannot recurse forever
+	enum class EntryType { FILE, DIR, DIR_LINK };
+	struct Entry
+	{
+		string name;
+		EntryType type;
+		unsigned int mode;
+	};
+	vector<Entry> entries;
+   #ifdef OS_WIN
+	WIN32_FIND_DATAA fd;
+	HANDLE h = FindFirstFileA((src_dir + DIR_SEP + "*").c_str(), &fd);
+	if (h == INVALID_HANDLE_VALUE)
+		throw runtime_error("OperSys::copy_dir() error reading directory '" + src_dir + "'");
+	do
+	{
+		EntryType type = EntryType::FILE;
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			type = (fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ? EntryType::DIR_LINK : EntryType::DIR;
+		entries.push_back(Entry{ string(fd.cFileName), type, 0 });
+	} while (FindNextFileA(h, &fd) != 0);
+	FindClose(h);
+   #endif
+   #ifdef OS_LINUX
+	DIR *d = opendir(src_dir.c_str());
+	if (d == NULL)
+		throw runtime_error("OperSys::copy_dir() error reading directory '" + src_dir + "'");
+	struct dirent *ent;
+	while ((ent = readdir(d)) != NULL)
+	{
+		string name(ent->d_name);
+		string path = src_dir + DIR_SEP + name;
+		struct stat lst, st;
+		if (lstat(path.c_str(), &lst) != 0)
+			continue;
+		//dangling links have nothing to copy
+		if (stat(path.c_str(), &st) != 0)
+			continue;
+		EntryType type = EntryType::FILE;
+		if (S_ISDIR(st.st_mode))
+			type = S_ISLNK(lst.st_mode) ? EntryType::DIR_LINK : EntryType::DIR;
+		entries.push_back(Entry{ name, type, (unsigned int)(st.st_mode & 07777) });
+	}
+	closedir(d);
+   #endif
+	for (auto &e : entries)
+	{
+		if ((e.name == ".") || (e.name == ".."))
+			continue;
+		if (find(skip_names.begin(), skip_names.end(), e.name) != skip_names.end())
+			continue;
+		string src = src_dir + DIR_SEP + e.name;
+		string dest = dest_dir + DIR_SEP + e.name;
+		if (e.type == EntryType::DIR)
+		{
+			copy_dir(src, dest);
+			continue;
+		}
+		if (e.type == EntryType::DIR_LINK)
+		{
+		   #ifdef OS_WIN
+			if (CreateSymbolicLinkA(dest.c_str(), src.c_str(), SYMBOLIC_LINK_FLAG_DIRECTORY) == 0)
+				throw runtime_error("OperSys::copy_dir() error linking '" + dest + "' to '" + src + "'");
+		   #endif
+		   #ifdef OS_LINUX
+			char *target = realpath(src.c_str(), NULL);
+			if (target == NULL)
+				throw runtime_error("OperSys::copy_dir() error resolving link '" + src + "'");
+			string target_str(target);
+			free(target);
+			::unlink(dest.c_str());
+			if (symlink(target_str.c_str(), dest.c_str()) != 0)
+				throw runtime_error("OperSys::copy_dir() error linking '" + dest + "' to '" + target_str + "'");
+		   #endif
+			continue;
+		}
+		ifstream in(src, ios::binary);
+		ofstream out(dest, ios::binary | ios::trunc);
+		if ((!in.good()) || (!out.good()))
+			throw runtime_error("OperSys::copy_dir() error copying '" + src + "' to '" + dest + "'");
+		//streaming an empty rdbuf() sets the failbit
+		if (in.peek() != ifstream::traits_type::eof())
+			out << in.rdbuf();
+		out.close();
+		if (out.fail())
+			throw runtime_error("OperSys::copy_dir() error writing '" + dest + "'");
+	   #ifdef OS_LINUX
+		//keep the exec bit on model scripts and binaries
+		if (chmod(dest.c_str(), (mode_t)e.mode) != 0)
+			throw runtime_error("OperSys::copy_dir() error setting the mode of '" + dest + "'");
+	   #endif
+	}
+}
+
 char* OperSys::gets_s(char *str, size_t len)
 {
  #ifdef OS_WIN
@@ -123,14 +246,14 @@ bool OperSys::double_is_invalid(double x)
 
 
 #ifdef OS_WIN
-PROCESS_INFORMATION start(string &cmd_string)
+PROCESS_INFORMATION start(string &cmd_string, const string &work_dir)
 {
 	char* cmd_line = _strdup(cmd_string.c_str());
 	STARTUPINFO si;
 	PROCESS_INFORMATION pi;
 	ZeroMemory(&si, sizeof(si));
 	ZeroMemory(&pi, sizeof(pi));
-	if (!CreateProcess(NULL, cmd_line, NULL, NULL, false, 0, NULL, NULL, &si, &pi))
+	if (!CreateProcess(NULL, cmd_line, NULL, NULL, false, 0, NULL, work_dir.empty() ? NULL : work_dir.c_str(), &si, &pi))
 	{
 		std::string cmd_string(cmd_line);
 		throw std::runtime_error("CreateProcess() failed for command: " + cmd_string);
@@ -142,7 +265,7 @@ PROCESS_INFORMATION start(string &cmd_string)
 
 
 #ifdef OS_LINUX
-int start(string &cmd_string)
+int start(string &cmd_string, const string &work_dir)
 {
 	//split cmd_string on whitespaces
 	stringstream cmd_ss(cmd_string);
@@ -171,6 +294,11 @@ int start(string &cmd_string)
 	if (pid == 0)
 	{
 		setpgid(0, 0);
+		if ((!work_dir.empty()) && (::chdir(work_dir.c_str()) != 0))
+		{
+			//the child can not safely unwind the parent's (possibly multithreaded) stack
+			_exit(127);
+		}
 		int success = execvp(arg_v[0], const_cast<char* const*>(&(arg_v[0])));
 		if (success == -1)
 		{
@@ -21,6 +21,7 @@
 
 #include "config_os.h"
 #include <string>
+#include <vector>
 
 class OperSys
 {
@@ -32,16 +33,24 @@ public:
 	void string2pathname(std::string &s);
 	static std::string getcwd();
 	static void chdir(const char *str);
+	//create dir (the parent must exist); returns false only if it does not exist afterwards
+	static bool make_dir(const std::string &dir);
+	//recursively copy the contents of src_dir into dest_dir (created if needed), replacing
+	//existing files and keeping file modes.  links to directories are recreated as links.
+	//entries of src_dir whose names are in skip_names are not copied
+	static void copy_dir(const std::string &src_dir, const std::string &dest_dir,
+		const std::vector<std::string> &skip_names = std::vector<std::string>());
 	static char *gets_s(char *str, size_t len);
 	static bool double_is_invalid(double x);
 };
 
+//start cmd_string in work_dir, or in the current directory if work_dir is empty
 #ifdef OS_WIN
 #include <Windows.h>
-PROCESS_INFORMATION start(std::string &cmd_string);
+PROCESS_INFORMATION start(std::string &cmd_string, const std::string &work_dir = std::string());
 #endif
 #ifdef OS_LINUX
-int start(std::string &cmd_string);
+int start(std::string &cmd_string, const std::string &work_dir = std::string());
 #endif
 
 
@@ -0,0 +1,340 @@
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <stdexcept>
+#include "config_os.h"
+#include "CsvFileReader.h"
+#include "ThreadPool.h"
+#include "utilities.h"
+
+#ifdef OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+	inline bool is_space(char c)
+	{
+		return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+	}
+
+	string upper_token(const char *first, const char *last)
+	{
+		string s(first, last);
+		pest_utils::upper_ip(s);
+		return s;
+	}
+}
+
+CsvFileReader::CsvFileReader(const string &_filename, int _num_threads) : filename(_filename), data(nullptr), size(0),
+	map_base(nullptr), map_size(0)
+{
+	num_threads = _num_threads;
+	if (num_threads <= 0)
+		num_threads = max(1, (int)thread::hardware_concurrency());
+	open();
+	try
+	{
+		//header line
+		size_t pos = 0;
+		while ((pos < size) && (data[pos] != '\n'))
+			pos++;
+		if (pos == 0 && size == 0)
+			throw runtime_error("error reading header (first) line from csv file :" + filename);
+		string line(data, pos);
+		pest_utils::strip_ip(line);
+		pest_utils::upper_ip(line);
+		pest_utils::tokenize(line, header_tokens, ",", false);
+		scan_lines(min(pos + 1, size));
+		scan_rows();
+	}
+	catch (...)
+	{
+		close();
+		throw;
+	}
+}
+
+CsvFileReader::~CsvFileReader()
+{
+	close();
+}
+
+void CsvFileReader::open()
+{
+#ifdef OS_LINUX
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	struct stat f_stat;
+	if ((fd < 0) || (fstat(fd, &f_stat) != 0))
+	{
+		if (fd >= 0)
+			::close(fd);
+		throw runtime_error("error opening csv file " + filename + " for reading");
+	}
+	size = f_stat.st_size;
+	if (size > 0)
+	{
+		void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED)
+		{
+			map_base = ptr;
+			map_size = size;
+			data = static_cast<const char*>(ptr);
+		}
+	}
+	::close(fd);
+	if ((size == 0) || (map_base != nullptr))
+		return;
+#endif
+	//no mapping available - read the file into a single buffer
+	ifstream in(filename, ios::binary);
+	if (!in.good())
+		throw runtime_error("error opening csv file " + filename + " for reading");
+	in.seekg(0, ios::end);
+	size = (size_t)in.tellg();
+	in.seekg(0, ios::beg);
+	buffer.resize(size);
+	if (size > 0)
+		in.read(buffer.data(), size);
+	data = buffer.data();
+}
+
+void CsvFileReader::close()
+{
+#ifdef OS_LINUX
+	if (map_base != nullptr)
+		munmap(map_base, map_size);
+#endif
+	map_base = nullptr;
+	map_size = 0;
+	buffer.clear();
+	buffer.shrink_to_fit();
+	data = nullptr;
+	size = 0;
+}
+
+void CsvFileReader::scan_lines(size_t first)
+{
+	//split the data lines into one chunk per thread.  each chunk owns the lines that start
+	//inside it, so the chunk boundaries are moved forward to the next line start
+	size_t n_chunks = (size_t)num_threads;
+	if (size - first < 1048576)
+		n_chunks = 1;
+	vector<size_t> bounds;
+	for (size_t i = 0; i < n_chunks; i++)
+		bounds.push_back(first + (size - first) * i / n_chunks);
+	bounds.push_back(size);
+
+	vector<vector<size_t>> starts(n_chunks), ends(n_chunks);
+	auto scan = [&](size_t ichunk)
+	{
+		size_t pos = bounds[ichunk];
+		if ((ichunk > 0) && (pos > first) && (data[pos - 1] != '\n'))
+		{
+			while ((pos < size) && (data[pos] != '\n'))
+				pos++;
+			pos++;
+		}
+		while (pos < bounds[ichunk + 1])
+		{
+			size_t eol = pos;
+			while ((eol < size) && (data[eol] != '\n'))
+				eol++;
+			size_t s = pos, e = eol;
+			while ((s < e) && is_space(data[s]))
+				s++;
+			while ((e > s) && is_space(data[e - 1]))
+				e--;
+			if (e > s)
+			{
+				starts[ichunk].push_back(s);
+				ends[ichunk].push_back(e);
+			}
+			pos = eol + 1;
+		}
+	};
+	if (n_chunks == 1)
+		scan(0);
+	else
+	{
+		ThreadPool pool(n_chunks);
+		vector<future<void>> futures;
+		for (size_t i = 0; i < n_chunks; i++)
+			futures.push_back(pool.submit([&scan, i]() { scan(i); }));
+		ThreadPool::wait_all(futures, "csv line scan");
+	}
+	size_t n = 0;
+	for (auto &s : starts)
+		n += s.size();
+	line_starts.reserve(n);
+	line_ends.reserve(n);
+	for (size_t i = 0; i < n_chunks; i++)
+	{
+		line_starts.insert(line_starts.end(), starts[i].begin(), starts[i].end());
+		line_ends.insert(line_ends.end(), ends[i].begin(), ends[i].end());
+		vector<size_t>().swap(starts[i]);
+		vector<size_t>().swap(ends[i]);
+	}
+}
+
+vector<pair<size_t, size_t>> CsvFileReader::get_row_blocks() const
+{
+	//a few blocks per thread so that uneven line lengths still balance
+	size_t nrows = line_starts.size();
+	size_t n_blocks = min(nrows, (size_t)num_threads * 4);
+	vector<pair<size_t, size_t>> blocks;
+	for (size_t i = 0; i < n_blocks; i++)
+		blocks.push_back(make_pair(nrows * i / n_blocks, nrows * (i + 1) / n_blocks));
+	return blocks;
+}
+
+void CsvFileReader::scan_rows()
+{
+	size_t nrows = line_starts.size();
+	index_tokens.resize(nrows);
+	token_counts.resize(nrows);
+	auto work = [this](size_t first_row, size_t last_row)
+	{
+		for (size_t r = first_row; r < last_row; r++)
+		{
+			const char *b = data + line_starts[r], *e = data + line_ends[r];
+			const char *c = (const char*)memchr(b, ',', e - b);
+			index_tokens[r] = upper_token(b, (c == nullptr) ? e : c);
+			int count = 1;
+			for (; c != nullptr; c = (const char*)memchr(c + 1, ',', e - c - 1))
+				count++;
+			token_counts[r] = count;
+		}
+	};
+	vector<pair<size_t, size_t>> blocks = get_row_blocks();
+	if (blocks.size() <= 1)
+	{
+		work(0, nrows);
+		return;
+	}
+	ThreadPool pool(num_threads);
+	vector<future<void>> futures;
+	for (auto &b : blocks)
+		futures.push_back(pool.submit([&work, b]() { work(b.first, b.second); }));
+	ThreadPool::wait_all(futures, "csv row scan");
+}
+
+bool CsvFileReader::parse_double(const char *first, const char *last, double &value)
+{
+	while ((first < last) && is_space(*first))
+		first++;
+	while ((last > first) && is_space(*(last - 1)))
+		last--;
+	size_t len = last - first;
+	if (len == 0)
+		return false;
+	//strtod needs a terminated string - copy the (short) token to the stack
+	char buf[128];
+	string long_tok;
+	const char *tok = buf;
+	if (len < sizeof(buf))
+	{
+		memcpy(buf, first, len);
+		buf[len] = '\0';
+	}
+	else
+	{
+		long_tok.assign(first, last);
+		tok = long_tok.c_str();
+	}
+	char *end;
+	errno = 0;
+	value = strtod(tok, &end);
+	if ((size_t)(end - tok) != len)
+		return false;
+	//underflow is fine, overflow is not
+	if ((errno == ERANGE) && (std::isinf(value)))
+		return false;
+	return true;
+}
+
+void CsvFileReader::fill(const vector<int> &row_map, const vector<pair<int, int>> &col_map,
+	Eigen::MatrixXd &dest, bool transpose) const
+{
+	if (row_map.size() != line_starts.size())
+		throw runtime_error("CsvFileReader::fill() error: row_map.size() != number of data rows");
+	//file column to col_map entry
+	int max_col = 0;
+	for (auto &cm : col_map)
+		max_col = max(max_col, cm.first);
+	vector<int> col_lookup(max_col + 1, -1);
+	for (size_t k = 0; k < col_map.size(); k++)
+		col_lookup[col_map[k].first] = k;
+
+	vector<pair<size_t, size_t>> blocks = get_row_blocks();
+	//a header-only file has no data rows (and no blocks) to fill
+	if (blocks.empty())
+		return;
+	vector<string> errors(blocks.size());
+	auto work = [&](size_t iblock)
+	{
+		for (size_t r = blocks[iblock].first; r < blocks[iblock].second; r++)
+		{
+			if (row_map[r] < 0)
+				continue;
+			const char *b = data + line_starts[r], *e = data + line_ends[r];
+			int icol = 0;
+			while ((b <= e) && (icol <= max_col))
+			{
+				const char *c = (const char*)memchr(b, ',', e - b);
+				if (c == nullptr)
+					c = e;
+				int k = col_lookup[icol];
+				if (k >= 0)
+				{
+					double val;
+					if (!parse_double(b, c, val))
+					{
+						stringstream ss;
+						ss << "error converting token '" << string(b, c) << "' to double for " << header_tokens[icol];
+						ss << " on line " << r + 1 << " of " << filename;
+						errors[iblock] = ss.str();
+						return;
+					}
+					if (transpose)
+						dest(col_map[k].second, row_map[r]) = val;
+					else
+						dest(row_map[r], col_map[k].second) = val;
+				}
+				b = c + 1;
+				icol++;
+			}
+			if (icol <= max_col)
+			{
+				stringstream ss;
+				ss << "too few items on line " << r + 1 << " of " << filename << ", expecting at least " << max_col + 1;
+				errors[iblock] = ss.str();
+				return;
+			}
+		}
+	};
+	if (blocks.size() <= 1)
+		work(0);
+	else
+	{
+		ThreadPool pool(num_threads);
+		vector<future<void>> futures;
+		for (size_t i = 0; i < blocks.size(); i++)
+			futures.push_back(pool.submit([&work, i]() { work(i); }));
+		ThreadPool::wait_all(futures, "csv parse");
+	}
+	//report the first bad line in file order
+	for (auto &err : errors)
+		if (err.size() > 0)
+			throw runtime_error(err);
+}
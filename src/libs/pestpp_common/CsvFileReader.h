@@ -0,0 +1,55 @@
+#ifndef CSVFILEREADER_H_
+#define CSVFILEREADER_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <Eigen/Dense>
+
+//reads a comma-delimited file with a header line and a leading index column.  the file is
+//memory-mapped where supported (and read into one buffer otherwise), the line boundaries
+//are found with a parallel scan, and numeric fields are converted in parallel row blocks
+//straight into a preallocated matrix - no per-line strings or token vectors are created.
+//lines are stripped of leading and trailing whitespace and blank lines are skipped
+class CsvFileReader
+{
+public:
+	CsvFileReader(const std::string &_filename, int _num_threads = -1);
+	~CsvFileReader();
+	//header line tokens, upper case
+	const std::vector<std::string> &get_header_tokens() const { return header_tokens; }
+	//first token of each data line, upper case
+	const std::vector<std::string> &get_index_tokens() const { return index_tokens; }
+	//number of comma-delimited tokens on each data line
+	const std::vector<int> &get_token_counts() const { return token_counts; }
+	size_t get_num_rows() const { return line_starts.size(); }
+	//convert the file columns in col_map[k].first on every data row r with row_map[r] >= 0 and
+	//store them in dest(row_map[r], col_map[k].second), or in dest(col_map[k].second, row_map[r])
+	//if transpose is true
+	void fill(const std::vector<int> &row_map, const std::vector<std::pair<int, int>> &col_map,
+		Eigen::MatrixXd &dest, bool transpose = false) const;
+
+private:
+	std::string filename;
+	int num_threads;
+	const char *data;
+	size_t size;
+	std::vector<char> buffer;
+	void *map_base;
+	size_t map_size;
+	std::vector<std::string> header_tokens;
+	std::vector<std::string> index_tokens;
+	std::vector<int> token_counts;
+	//offset of the first and one-past-the-last (stripped) character of each data line
+	std::vector<size_t> line_starts;
+	std::vector<size_t> line_ends;
+
+	void open();
+	void close();
+	void scan_lines(size_t first);
+	void scan_rows();
+	std::vector<std::pair<size_t, size_t>> get_row_blocks() const;
+	static bool parse_double(const char *first, const char *last, double &value);
+};
+
+#endif //CSVFILEREADER_H_
@@ -100,13 +100,18 @@ void DifferentialEvolution::initialize_population(RunManagerAbstract &run_manage
 
 	RestartController::write_start_iteration(fout_restart, solver_type_name, iter, iter);
 	Parameters numeric_pars;
+	const vector<string> &run_par_names = run_manager.get_par_name_vec();
+	Eigen::MatrixXd run_pars(d, run_par_names.size());
+	vector<double> run_vec;
 	for (int i = 0; i < d; ++i)
 	{
 		numeric_pars.clear();
 		initialize_vector(numeric_pars);
 		par_transform.numeric2model_ip(numeric_pars);
-		run_manager.add_run(numeric_pars);
+		run_vec = numeric_pars.get_data_vec(run_par_names);
+		run_pars.row(i) = Eigen::Map<Eigen::VectorXd>(run_vec.data(), run_vec.size());
 	}
+	run_manager.add_runs(run_pars);
 	RestartController::write_upgrade_runs_built(fout_restart);
 	// make innitial population vector model runs
 	cout << endl;
@@ -184,6 +189,10 @@ void DifferentialEvolution::mutation(RunManagerAbstract &run_manager, double f,
 	Parameters xb;
 	Parameters xc;
 	Parameters x_trial;
+	//the trial vectors are queued as one batch once they are all built
+	const vector<string> &run_par_names = run_manager.get_par_name_vec();
+	Eigen::MatrixXd run_pars(d, run_par_names.size());
+	vector<double> run_vec;
 	for (int i_run = 0; i_run < d; ++i_run)
 	{
 		int xa_id = successful_run_ids[uni_run_ok(rand_engine)];
@@ -239,8 +248,10 @@ void DifferentialEvolution::mutation(RunManagerAbstract &run_manager, double f,
 			}
 		}
 		par_transform.numeric2model_ip(x_trial);
-		run_manager.add_run(x_trial);
+		run_vec = x_trial.get_data_vec(run_par_names);
+		run_pars.row(i_run) = Eigen::Map<Eigen::VectorXd>(run_vec.data(), run_vec.size());
 	}
+	run_manager.add_runs(run_pars);
 }
 
 int DifferentialEvolution::recombination(RunManagerAbstract &run_manager)
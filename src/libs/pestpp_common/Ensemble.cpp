@@ -1,9 +1,12 @@
 #include <random>
 #include <iomanip>
 #include <unordered_set>
+#include <unordered_map>
 #include <iterator>
 #include <limits>
 #include <cstddef>
+#include <cstring>
+#include <memory>
 #include "Ensemble.h"
 #include "RestartController.h"
 #include "utilities.h"
@@ -14,6 +17,8 @@
 #include "PerformanceLog.h"
 #include "system_variables.h"
 #include "pest_data_structs.h"
+#include "ThreadPool.h"
+#include "CsvFileReader.h"
 
 Ensemble::Ensemble(Pest *_pest_scenario_ptr, std::mt19937* _rand_gen_ptr): pest_scenario_ptr(_pest_scenario_ptr),
 rand_gen_ptr(_rand_gen_ptr)
@@ -111,6 +116,20 @@ void Ensemble::add_2_cols_ip(const vector<string> &other_var_names, const Eigen:
 	}
 }
 
+void Ensemble::add_2_cols_ip(const vector<int> &col_idxs, const Eigen::MatrixXd &mat)
+{
+	if (shape().first != mat.rows())
+		throw_ensemble_error("Ensemble::add_2_cols_ip(): first dimensions don't match");
+	if (col_idxs.size() != mat.cols())
+		throw_ensemble_error("Ensemble::add_2_cols_ip(): col_idxs.size() != mat.cols()");
+	int ncols = reals.cols();
+	for (int i = 0; i < col_idxs.size(); i++)
+	{
+		if ((col_idxs[i] < 0) || (col_idxs[i] >= ncols))
+			throw_ensemble_error("Ensemble::add_2_cols_ip(): column index out of range");
+		reals.col(col_idxs[i]) += mat.col(i);
+	}
+}
 
 void Ensemble::add_2_cols_ip(Ensemble &other)
 {
@@ -133,39 +152,15 @@ void Ensemble::add_2_cols_ip(Ensemble &other)
 }
 
 
-void draw_thread_function(int id, DrawThread &worker, int num_reals, int ies_verbose, map<string, int> idx_map, map<string, double> std_map, exception_ptr &eptr)
-{
-	try
-	{
-		worker.work(id, num_reals, ies_verbose, idx_map, std_map);
-	}
-	catch (...)
-	{
-		eptr = current_exception();
-	}
-
-	return;
-}
-
-
-void Ensemble::draw(int num_reals, Covariance cov, Transformable &tran, const vector<string> &draw_names,
-	const map<string, vector<string>> &grouper, PerformanceLog *plog, int level)
+void Ensemble::draw_serial(int num_reals, Covariance &cov, const vector<string> &draw_names, const map<string, vector<string>> &grouper,
+	PerformanceLog *plog, int level, Eigen::MatrixXd &draws)
 {
-	//draw names should be "active" var_names (nonzero weight obs and not fixed/tied pars)
-	//just a quick sanity check...
-	//if ((draw_names.size() > 50000) && (!cov.isdiagonal()))
-	//	cout << "  ---  Ensemble::draw() warning: non-diagonal cov used to draw for lots of variables...this might run out of memory..." << endl << endl;
-
 	//matrix to hold the standard normal draws
-	Eigen::MatrixXd draws(num_reals, draw_names.size());
+	draws.resize(num_reals, draw_names.size());
 
 	draws.setZero();
 	
 
-	//make sure the cov is aligned
-	if (cov.get_col_names() != draw_names)
-		cov = cov.get(draw_names);
-
 	//make standard normal draws
 	plog->log_event("making standard normal draws");
 	//RedSVD::sample_gaussian(draws);
@@ -229,55 +224,15 @@ void Ensemble::draw(int num_reals, Covariance cov, Transformable &tran, const ve
 			else
 			{
 				Eigen::setNbThreads(1);
-				vector<thread> threads;
-				vector<exception_ptr> exception_ptrs;
 				plog->log_event("launching draw threads");
-
+				ThreadPool pool(num_threads);
+				vector<future<void>> futures;
 				for (int i = 0; i < num_threads; i++)
 				{
-					exception_ptrs.push_back(exception_ptr());
-				}
-
-				for (int i = 0; i < num_threads; i++)
-				{
-					//threads.push_back(thread(&LocalUpgradeThread::work, &worker, i, iter, cur_lam));
-
-					threads.push_back(thread(draw_thread_function, i, std::ref(worker), num_reals, level, idx_map, std_map,std::ref(exception_ptrs[i])));
-
-				}
-				plog->log_event("waiting to join threads");
-				//for (auto &t : threads)
-				//	t.join();
-				for (int i = 0; i < num_threads; ++i)
-				{
-					if (exception_ptrs[i])
-					{
-						try
-						{
-							rethrow_exception(exception_ptrs[i]);
-						}
-						catch (const std::exception& e)
-						{
-							ss.str("");
-							ss << "thread " << i << "raised an exception: " << e.what();
-							throw runtime_error(ss.str());
-						}
-					}
-					threads[i].join();
-					if (exception_ptrs[i])
-					{
-						try
-						{
-							rethrow_exception(exception_ptrs[i]);
-						}
-						catch (const std::exception& e)
-						{
-							ss.str("");
-							ss << "thread " << i << "raised an exception: " << e.what();
-							throw runtime_error(ss.str());
-						}
-					}
+					futures.push_back(pool.submit([&worker, i, num_reals, level, &idx_map, &std_map]() { worker.work(i, num_reals, level, idx_map, std_map); }));
 				}
+				plog->log_event("waiting for draw tasks");
+				ThreadPool::wait_all(futures, "draw");
 				plog->log_event("threaded draws done");
 
 			}
@@ -401,6 +356,36 @@ void Ensemble::draw(int num_reals, Covariance cov, Transformable &tran, const ve
 			draws.transposeInPlace();
 		}
 	}
+}
+
+void Ensemble::draw(int num_reals, Covariance cov, Transformable &tran, const vector<string> &draw_names,
+	const map<string, vector<string>> &grouper, PerformanceLog *plog, int level)
+{
+	//draw names should be "active" var_names (nonzero weight obs and not fixed/tied pars)
+	//just a quick sanity check...
+	//if ((draw_names.size() > 50000) && (!cov.isdiagonal()))
+	//	cout << "  ---  Ensemble::draw() warning: non-diagonal cov used to draw for lots of variables...this might run out of memory..." << endl << endl;
+
+	//make sure the cov is aligned
+	if (cov.get_col_names() != draw_names)
+		cov = cov.get(draw_names);
+
+	Eigen::MatrixXd draws;
+	int block_size = pest_scenario_ptr->get_pestpp_options().get_ies_draw_block_size();
+	if (block_size > 0)
+	{
+		stringstream ss;
+		ss << "drawing in blocks of " << block_size << " realizations";
+		plog->log_event(ss.str());
+		//one value from the shared generator seeds all of the block streams
+		unsigned int seed = (*rand_gen_ptr)();
+		BlockDrawEngine engine(plog, cov, draw_names, grouper, seed, block_size,
+			pest_scenario_ptr->get_pestpp_options().get_ies_num_threads(),
+			pest_scenario_ptr->get_pestpp_options().get_ies_draw_cache_dir());
+		engine.draw(num_reals, draws);
+	}
+	else
+		draw_serial(num_reals, cov, draw_names, grouper, plog, level, draws);
 
 	//check for invalid values
 	plog->log_event("checking realization for invalid values");
@@ -1062,42 +1047,26 @@ map<string, int> Ensemble::get_real_map()
 //	
 //}
 
-pair<map<string,int>, map<string, int>> Ensemble::prepare_csv(const vector<string> &names, ifstream &csv, bool forgive)
+pair<map<string,int>, map<string, int>> Ensemble::prepare_csv(const vector<string> &names, CsvFileReader &csv, bool forgive)
 {
 	//prepare the input csv for reading checks for compatibility with var_names, forgives extra names in csv
-	if (!csv.good())
-	{
-		throw runtime_error("ifstream not good");
-	}
 
 	//process the header
 	//any missing header labels will be marked to ignore those columns later
-	string line;
-	vector<string> header_tokens;
-	if (!getline(csv, line))
-		throw runtime_error("error reading header (first) line from csv file :");
-	pest_utils::strip_ip(line);
-	pest_utils::upper_ip(line);
-	pest_utils::tokenize(line, header_tokens, ",", false);
+	const vector<string> &header_tokens = csv.get_header_tokens();
 	
-	//read the index labels
-	vector<string> index_tokens,tokens;
-	int lcount = 1, nerr = 0;
+	//the index labels
+	const vector<string> &index_tokens = csv.get_index_tokens();
+	const vector<int> &token_counts = csv.get_token_counts();
+	int nerr = 0;
 	stringstream ss;
-	
-	while (getline(csv, line))
+	for (int i = 0; i < token_counts.size(); i++)
 	{
-		pest_utils::strip_ip(line);
-		pest_utils::upper_ip(line);
-		tokens.clear();
-		pest_utils::tokenize(line, tokens, ",", false);
-		if (header_tokens.size() != tokens.size())
+		if (header_tokens.size() != token_counts[i])
 		{
-			ss << "wrong number of items on line " << lcount << ", expecting " << header_tokens.size() << " but found " << tokens.size() << endl;
+			ss << "wrong number of items on line " << i + 1 << ", expecting " << header_tokens.size() << " but found " << token_counts[i] << endl;
 			nerr++;
 		}
-		index_tokens.push_back(tokens[0]);
-		lcount++;
 	}
 
 	if (nerr > 0)
@@ -1545,6 +1514,53 @@ map<string, int> Ensemble::from_binary(string file_name, vector<string> &names,
 }
 
 
+void Ensemble::to_columnar(string file_name, bool float32)
+{
+	EnsembleColumnFile::write(file_name, real_names, var_names, reals, float32);
+}
+
+map<string, int> Ensemble::from_columnar(string file_name, const vector<string> &names, const vector<string> &required,
+	const vector<string> &read_names)
+{
+	//load an ensemble from a columnar binary file.  only the columns for names are read - names that
+	//are not in the file are left as zeros, except for required names, which must be present.
+	//if names is empty, all the columns in the file are read.  if read_names is not empty, only
+	//those columns are read and the rest of names are left as zeros (and not in the returned map)
+	EnsembleColumnFile ecf(file_name);
+	unordered_set<string> read_set(read_names.begin(), read_names.end());
+	real_names = ecf.get_real_names();
+	if (names.size() > 0)
+		var_names = names;
+	else
+		var_names = ecf.get_var_names();
+	vector<string> missing;
+	for (auto &name : required)
+		if (ecf.find(name) < 0)
+			missing.push_back(name);
+	if (missing.size() > 0)
+		throw_ensemble_error("Ensemble::from_columnar() error: the following names were not found in " + file_name, missing);
+
+	map<string, int> header_info;
+	vector<int> cols, dest_cols;
+	for (int i = 0; i < var_names.size(); i++)
+	{
+		if ((read_set.size() > 0) && (read_set.find(var_names[i]) == read_set.end()))
+			continue;
+		int icol = ecf.find(var_names[i]);
+		if (icol < 0)
+			continue;
+		header_info[var_names[i]] = icol;
+		cols.push_back(icol);
+		dest_cols.push_back(i);
+	}
+	reals.resize(real_names.size(), var_names.size());
+	if (cols.size() < var_names.size())
+		reals.setZero();
+	ecf.read(cols, dest_cols, reals);
+	org_real_names = real_names;
+	return header_info;
+}
+
 map<string,int> Ensemble::from_binary_old(string file_name, vector<string> &names, bool transposed)
 {
 	//load an ensemble from a binary jco-type file.  if transposed=true, reals is transposed and row/col names are swapped for var/real names.
@@ -1718,131 +1734,53 @@ map<string,int> Ensemble::from_binary_old(string file_name, vector<string> &name
 
 
 
-void Ensemble::read_csv_by_reals(int num_reals,ifstream &csv, map<string,int> &header_info, map<string,int> &index_info)
+void Ensemble::read_csv_by_reals(int num_reals, CsvFileReader &csv, map<string,int> &header_info, map<string,int> &index_info)
 {
 	//read a csv file to an Ensmeble
-	int lcount = 1;
-	//vector<vector<double>> vectors;
-	double val;
-	string line;
-	vector<string> tokens;
-	string real_id;
-
-	//real_names.clear();
+	if (csv.get_num_rows() != num_reals)
+		throw runtime_error("different number of reals found");
 	reals.resize(num_reals, var_names.size());
 	reals.setZero();
-	int irow = 0;
 
 	map<string, int> var_map;
 	for (int i = 0; i < var_names.size(); i++)
 		var_map[var_names[i]] = i;
 
-	while (getline(csv, line))
-	{
-		pest_utils::strip_ip(line);
-		tokens.clear();
-		pest_utils::tokenize(line, tokens, ",", false);
-		if (tokens[tokens.size() - 1].size() == 0)
-			tokens.pop_back();
-
-		try
-		{
-			pest_utils::convert_ip(tokens[0], real_id);
-		}
-		catch (exception &e)
-		{
-			stringstream ss;
-			ss << "error converting token '" << tokens[0] << "' to <string> real_name on line " << lcount << ": " << line << endl << e.what();
-			throw runtime_error(ss.str());
-		}
-		//real_names.push_back(real_id);
-		
-
-		for (auto &hi : header_info)
-		{
-			try
-			{
-				//val = pest_utils::convert_cp<double>(tokens[hi.second]);
-				val = stod(tokens[hi.second]);
-			}
-			catch (exception &e)
-			{
-				stringstream ss;
-				ss << "error converting token '" << tokens[hi.second] << "' to double for " << hi.first << " on line " << lcount << " : " << e.what();
-				throw runtime_error(ss.str());
-			}
-			reals(irow, var_map[hi.first]) = val;
-		}
-		lcount++;
-		irow++;
-
-	}
-	if (lcount-1 != num_reals)
-		throw runtime_error("different number of reals found");
-	
+	//each line is a realization, each header column a var
+	vector<int> row_map(num_reals);
+	for (int i = 0; i < num_reals; i++)
+		row_map[i] = i;
+	vector<pair<int, int>> col_map;
+	for (auto &hi : header_info)
+		col_map.push_back(make_pair(hi.second, var_map[hi.first]));
+	csv.fill(row_map, col_map, reals);
 }
 
 
-void Ensemble::read_csv_by_vars(int num_reals, ifstream &csv, map<string, int> &header_info, map<string, int> &index_info)
+void Ensemble::read_csv_by_vars(int num_reals, CsvFileReader &csv, map<string, int> &header_info, map<string, int> &index_info)
 {
 	//read a csv file to an Ensmeble
-	int lcount = 1;
-	//vector<vector<double>> vectors;
-	double val;
-	string line;
-	vector<string> tokens;
-	string var_name;
-
-	//real_names.clear();
 	reals.resize(num_reals, var_names.size());
 	reals.setZero();
-	int var_idx;
 
 	map<string, int> var_map;
 	for (int i = 0; i < var_names.size(); i++)
 		var_map[var_names[i]] = i;
 
-	while (getline(csv, line))
+	//each line is a var, each header column (after the index) a realization.  lines
+	//for vars that are not in var_names are skipped
+	const vector<string> &index_tokens = csv.get_index_tokens();
+	vector<int> row_map(index_tokens.size(), -1);
+	for (int i = 0; i < index_tokens.size(); i++)
 	{
-		
-		pest_utils::strip_ip(line);
-		pest_utils::upper_ip(line);
-		tokens.clear();
-		pest_utils::tokenize(line, tokens, ",", false);
-		if (tokens[tokens.size() - 1].size() == 0)
-			tokens.pop_back();
-
-		try
-		{
-			pest_utils::convert_ip(tokens[0], var_name);
-		}
-		catch (exception &e)
-		{
-			stringstream ss;
-			ss << "error converting token '" << tokens[0] << "' to <string> var_name on line " << lcount << ": " << line << endl << e.what();
-			throw runtime_error(ss.str());
-		}
-		//real_names.push_back(real_id);
-		var_idx = var_map[var_name];
-		for (auto &hi : header_info)
-		{
-			try
-			{
-				val = pest_utils::convert_cp<double>(tokens[hi.second]);
-			}
-			catch (exception &e)
-			{
-				stringstream ss;
-				ss << "error converting token '" << tokens[hi.second] << "' to double for " << hi.first << " on line " << lcount << " : " << e.what();
-				throw runtime_error(ss.str());
-			}
-			reals(hi.second-1, var_idx) = val;
-		}
-		lcount++;
-		
-
+		auto it = var_map.find(index_tokens[i]);
+		if (it != var_map.end())
+			row_map[i] = it->second;
 	}
-	
+	vector<pair<int, int>> col_map;
+	for (auto &hi : header_info)
+		col_map.push_back(make_pair(hi.second, hi.second - 1));
+	csv.fill(row_map, col_map, reals, true);
 }
 
 
@@ -1870,9 +1808,9 @@ ParameterEnsemble::ParameterEnsemble(Pest *_pest_scenario_ptr, std::mt19937* _ra
 
 
 
-void ParameterEnsemble::draw(int num_reals, Parameters par, Covariance &cov, PerformanceLog *plog, int level, ofstream& frec)
+map<string, vector<string>> ParameterEnsemble::prep_draw_names(Covariance &cov, PerformanceLog *plog, bool &reordered)
 {
-	///draw a parameter ensemble
+	//set var_names to the adjustable pars in cov, sorted by group if drawing by group
 	var_names = pest_scenario_ptr->get_ctl_ordered_adj_par_names(); //only draw for adjustable pars
 	vector<string> cov_names = cov.get_col_names();
 	set<string> scov_names(cov_names.begin(), cov_names.end());
@@ -1882,10 +1820,7 @@ void ParameterEnsemble::draw(int num_reals, Parameters par, Covariance &cov, Per
 		if (scov_names.find(name) != scov_names.end())
 			var_names.push_back(name);
 	}
-	
-	//Parameters par = pest_scenario_ptr->get_ctl_parameters();
-	par_transform.active_ctl2numeric_ip(par);//removes fixed/tied pars
-	tstat = transStatus::NUM;
+
 	ParameterGroupInfo pgi = pest_scenario_ptr->get_base_group_info();
 	//vector<string> group_names = pgi.get_group_names();
 	vector<string> group_names = pest_scenario_ptr->get_ctl_ordered_par_group_names();
@@ -1927,6 +1862,19 @@ void ParameterEnsemble::draw(int num_reals, Parameters par, Covariance &cov, Per
 			var_names = sorted_var_names;
 		}
 	}
+	reordered = !same;
+	return grouper;
+}
+
+void ParameterEnsemble::draw(int num_reals, Parameters par, Covariance &cov, PerformanceLog *plog, int level, ofstream& frec)
+{
+	///draw a parameter ensemble
+	bool reordered;
+	map<string, vector<string>> grouper = prep_draw_names(cov, plog, reordered);
+	
+	//Parameters par = pest_scenario_ptr->get_ctl_parameters();
+	par_transform.active_ctl2numeric_ip(par);//removes fixed/tied pars
+	tstat = transStatus::NUM;
 	Ensemble::draw(num_reals, cov, par, var_names, grouper, plog, level);
 	/*map<string, int> header_info;
 	for (int i = 0; i < var_names.size(); i++)
@@ -1943,7 +1891,7 @@ void ParameterEnsemble::draw(int num_reals, Parameters par, Covariance &cov, Per
 	}*/
 	//fill_fixed(header_info);
 	//save_fixed();
-	if (!same)
+	if (reordered)
 	{
 
 		reorder(vector<string>(), pest_scenario_ptr->get_ctl_ordered_adj_par_names());
@@ -1956,6 +1904,127 @@ void ParameterEnsemble::draw(int num_reals, Parameters par, Covariance &cov, Per
 
 }
 
+void ParameterEnsemble::draw_to_file(int num_reals, Parameters par, Covariance &cov, const string &file_name, PerformanceLog *plog)
+{
+	string ext = pest_utils::lower_cp(file_name);
+	size_t pos = ext.find_last_of('.');
+	ext = (pos == string::npos) ? string() : ext.substr(pos + 1);
+	bool binary = (ext == "jcb") || (ext == "jco") || (ext == "bin");
+	if ((!binary) && (ext != "csv"))
+		throw_ensemble_error("ParameterEnsemble::draw_to_file() error: file name must end in .csv, .jcb, .jco or .bin: " + file_name);
+
+	bool reordered;
+	map<string, vector<string>> grouper = prep_draw_names(cov, plog, reordered);
+	par_transform.active_ctl2numeric_ip(par);//removes fixed/tied pars
+	tstat = transStatus::NUM;
+	Covariance draw_cov, *cov_ptr = &cov;
+	if (cov.get_col_names() != var_names)
+	{
+		draw_cov = cov.get(var_names);
+		cov_ptr = &draw_cov;
+	}
+
+	const PestppOptions &ppo = pest_scenario_ptr->get_pestpp_options();
+	int block_size = ppo.get_ies_draw_block_size();
+	if (block_size <= 0)
+		block_size = 100;
+	unsigned int seed = (*rand_gen_ptr)();
+	BlockDrawEngine engine(plog, *cov_ptr, var_names, grouper, seed, block_size, ppo.get_ies_num_threads(),
+		ppo.get_ies_draw_cache_dir());
+
+	ofstream out;
+	if (binary)
+		out.open(file_name, ios::binary);
+	else
+		out.open(file_name);
+	if (!out.good())
+		throw_ensemble_error("ParameterEnsemble::draw_to_file() error opening file " + file_name + " for writing");
+
+	//same layout as to_binary() and to_csv_by_reals(): all the control file pars, in control space
+	vector<string> out_names = pest_scenario_ptr->get_ctl_ordered_par_names();
+	vector<string> all_real_names = get_generic_real_names(num_reals);
+	int n_var = out_names.size();
+	if (binary)
+	{
+		int n = num_reals * n_var;
+		out.write((char*)&n_var, sizeof(n_var));
+		out.write((char*)&num_reals, sizeof(num_reals));
+		out.write((char*)&n, sizeof(n));
+	}
+	else
+	{
+		out << "real_name";
+		for (auto &name : out_names)
+			out << ',' << pest_utils::lower_cp(name);
+		out << endl;
+	}
+
+	Eigen::VectorXd mean = par.get_data_eigen_vec(var_names);
+	Parameters pars = pest_scenario_ptr->get_ctl_parameters();
+	par_transform.active_ctl2numeric_ip(pars);
+	bool enforce_bounds = ppo.get_ies_enforce_bounds();
+	double val;
+	//each block is loaded into reals so the usual bound enforcement can be reused
+	engine.stream(num_reals, [&](int first_real, const Eigen::MatrixXd &block)
+	{
+		reals = block;
+		reals.rowwise() += mean.transpose();
+		real_names.assign(all_real_names.begin() + first_real, all_real_names.begin() + first_real + block.rows());
+		for (int i = 0; i < reals.rows(); i++)
+			for (int j = 0; j < reals.cols(); j++)
+				if (OperSys::double_is_invalid(reals(i, j)))
+					throw_ensemble_error("ParameterEnsemble::draw_to_file() error: invalid values in draws for realization " + real_names[i]);
+		if (enforce_bounds)
+			enforce_limits(plog, false);
+		for (int i = 0; i < reals.rows(); i++)
+		{
+			pars.update_without_clear(var_names, reals.row(i));
+			par_transform.numeric2ctl_ip(pars);
+			if (binary)
+			{
+				int irow = first_real + i;
+				for (int jcol = 0; jcol < n_var; jcol++)
+				{
+					val = pars[out_names[jcol]];
+					out.write((char*)&irow, sizeof(irow));
+					out.write((char*)&jcol, sizeof(jcol));
+					out.write((char*)&val, sizeof(val));
+				}
+			}
+			else
+			{
+				out << pest_utils::lower_cp(real_names[i]);
+				for (auto &name : out_names)
+					out << ',' << pars[name];
+				out << endl;
+			}
+		}
+		if (!out.good())
+			throw_ensemble_error("ParameterEnsemble::draw_to_file() error writing to " + file_name);
+	});
+	if (binary)
+	{
+		char name_buf[200];
+		for (auto &name : out_names)
+		{
+			pest_utils::string_to_fortran_char(pest_utils::lower_cp(name), name_buf, 200);
+			out.write(name_buf, 200);
+		}
+		for (auto &name : all_real_names)
+		{
+			pest_utils::string_to_fortran_char(pest_utils::lower_cp(name), name_buf, 200);
+			out.write(name_buf, 200);
+		}
+	}
+	out.close();
+	reals.resize(0, var_names.size());
+	real_names = all_real_names;
+	org_real_names = real_names;
+	stringstream ss;
+	ss << num_reals << " realizations drawn to " << file_name;
+	plog->log_event(ss.str());
+}
+
 void ParameterEnsemble::set_pest_scenario(Pest *_pest_scenario)
 {
 	pest_scenario_ptr = _pest_scenario;
@@ -1997,7 +2066,6 @@ map<int,int> ParameterEnsemble::add_runs(RunManagerAbstract *run_mgr_ptr,const v
 	Parameters pars_real = pars;
 	Eigen::VectorXd evec;
 	vector<double> svec;
-	int run_id;
 	vector<string> run_real_names;
 	if (real_idxs.size() > 0)
 		for (auto i : real_idxs)
@@ -2010,6 +2078,11 @@ map<int,int> ParameterEnsemble::add_runs(RunManagerAbstract *run_mgr_ptr,const v
 	for (int i = 0; i < real_names.size(); i++)
 		rmap[real_names[i]] = i;
 	vector<string> nn;
+	//the runs are queued as one batch, in run storage parameter order
+	const vector<string> &run_par_names = run_mgr_ptr->get_par_name_vec();
+	Eigen::MatrixXd run_pars(run_real_names.size(), run_par_names.size());
+	vector<int> run_idxs;
+	run_idxs.reserve(run_real_names.size());
 	for (auto &rname : run_real_names)
 	{
 		//idx = find(real_names.begin(), real_names.end(), rname) - real_names.begin();
@@ -2032,9 +2105,13 @@ map<int,int> ParameterEnsemble::add_runs(RunManagerAbstract *run_mgr_ptr,const v
 				ss << n << ",";
 			throw_ensemble_error(ss.str());
 		}
-		run_id = run_mgr_ptr->add_run(pars_real);
-		real_run_ids[idx]  = run_id;
+		svec = pars_real.get_data_vec(run_par_names);
+		run_pars.row(run_idxs.size()) = Eigen::Map<Eigen::VectorXd>(svec.data(), svec.size());
+		run_idxs.push_back(idx);
 	}
+	vector<int> run_ids = run_mgr_ptr->add_runs(run_pars);
+	for (int i = 0; i < run_idxs.size(); i++)
+		real_run_ids[run_idxs[i]] = run_ids[i];
 	return real_run_ids;
 }
 
@@ -2085,6 +2162,53 @@ void ParameterEnsemble::from_binary(string file_name)
 
 }
 
+void ParameterEnsemble::from_columnar(string file_name, const vector<string> &names)
+{
+	//load a (possibly partial) par en from a columnar binary file.  by default all the control
+	//file pars are loaded; any fixed or tied pars not in the file get their control file values
+	vector<string> load_names = names;
+	if (load_names.size() == 0)
+		load_names = pest_scenario_ptr->get_ctl_ordered_par_names();
+	ParameterInfo pi = pest_scenario_ptr->get_ctl_parameter_info();
+	ParameterRec::TRAN_TYPE ft = ParameterRec::TRAN_TYPE::FIXED;
+	ParameterRec::TRAN_TYPE tt = ParameterRec::TRAN_TYPE::TIED;
+	vector<string> required;
+	for (auto &name : load_names)
+	{
+		const ParameterRec *rec = pi.get_parameter_rec_ptr(name);
+		if (rec == nullptr)
+			throw_ensemble_error("ParameterEnsemble.from_columnar() error: par not in control file: " + name);
+		if ((rec->tranform_type != ft) && (rec->tranform_type != tt))
+			required.push_back(name);
+	}
+	map<string, int> header_info = Ensemble::from_columnar(file_name, load_names, required);
+	fixed_names.clear();
+	for (auto &name : var_names)
+	{
+		if (pi.get_parameter_rec_ptr(name)->tranform_type == ft)
+		{
+			fixed_names.push_back(name);
+		}
+	}
+	fill_fixed(header_info);
+	save_fixed();
+	//fill_fixed() only handles fixed pars
+	Parameters pars = pest_scenario_ptr->get_ctl_parameters();
+	int c = 0;
+	for (int i = 0; i < var_names.size(); i++)
+	{
+		if ((header_info.find(var_names[i]) == header_info.end()) &&
+			(pi.get_parameter_rec_ptr(var_names[i])->tranform_type == tt))
+		{
+			reals.col(i).setConstant(pars[var_names[i]]);
+			c++;
+		}
+	}
+	if (c > 0)
+		cout << "filled " << c << " tied pars not listed in user-supplied par ensemble with `parval1` values from control file" << endl;
+	tstat = transStatus::CTL;
+}
+
 //ParameterEnsemble ParameterEnsemble::get_new(const vector<string> &_real_names, const vector<string> &_var_names)
 //{
 //	
@@ -2098,9 +2222,7 @@ void ParameterEnsemble::from_binary(string file_name)
 
 void ParameterEnsemble::from_csv(string file_name)
 {
-	ifstream csv(file_name);
-	if (!csv.good())
-		throw runtime_error("error opening parameter csv " + file_name + " for reading");
+	CsvFileReader csv(file_name, pest_scenario_ptr->get_pestpp_options().get_ies_num_threads());
 	bool csv_by_reals = pest_scenario_ptr->get_pestpp_options().get_ies_csv_by_reals();
 	//var_names = pest_scenario_ptr->get_ctl_ordered_adj_par_names();
 	var_names = pest_scenario_ptr->get_ctl_ordered_par_names();
@@ -2135,12 +2257,6 @@ void ParameterEnsemble::from_csv(string file_name)
 	if (missing.size() > 0)
 		throw_ensemble_error("ParameterEnsemble.from_csv() error: the following adjustable pars not in csv:",missing);
 
-	csv.close();
-	csv.open(file_name);
-	if (!csv.good())
-		throw runtime_error("error re-opening parameter csv " + file_name + " for reading");
-	string line;
-	getline(csv, line);
 	if (csv_by_reals)
 		Ensemble::read_csv_by_reals(num_reals, csv, header_info, index_info);
 	else
@@ -2407,6 +2523,26 @@ void ParameterEnsemble::to_binary(string file_name)
 }
 
 
+void ParameterEnsemble::to_columnar(string file_name, bool float32)
+{
+	//write the par en to a columnar binary file - all control file pars, transformed back to CTL status
+	vector<string> vnames = pest_scenario_ptr->get_ctl_ordered_par_names();
+	Eigen::MatrixXd ctl_reals(real_names.size(), vnames.size());
+	Parameters pars;
+	for (int irow = 0; irow < real_names.size(); ++irow)
+	{
+		pars.update_without_clear(var_names, reals.row(irow));
+		if (tstat == transStatus::MODEL)
+			par_transform.model2ctl_ip(pars);
+		else if (tstat == transStatus::NUM)
+			par_transform.numeric2ctl_ip(pars);
+		replace_fixed(real_names[irow], pars);
+		for (int jcol = 0; jcol < vnames.size(); ++jcol)
+			ctl_reals(irow, jcol) = pars[vnames[jcol]];
+	}
+	EnsembleColumnFile::write(file_name, real_names, vnames, ctl_reals, float32);
+}
+
 void ParameterEnsemble::to_csv(string file_name)
 {
 	//write the par ensemble to csv file - transformed back to CTL status
@@ -2730,25 +2866,37 @@ vector<int> ObservationEnsemble::update_from_runs(map<int,int> &real_run_ids, Ru
 	//update the obs ensemble in place from the run manager
 	set<int> failed_runs = run_mgr_ptr->get_failed_run_ids();
 	vector<int> failed_real_idxs;
-	Parameters pars = pest_scenario_ptr->get_ctl_parameters();
-	Observations obs = pest_scenario_ptr->get_ctl_observations();
-	string real_name;
-	int ireal = 0;
+	//position of each var name in the run storage obs, resolved once for all the runs
+	vector<int> obs_pos;
+	const double *obs_ptr;
 	for (auto &real_run_id : real_run_ids)
 	{
 		if (failed_runs.find(real_run_id.second) != failed_runs.end())
 		{
 			failed_real_idxs.push_back(real_run_id.first);
-			//failed_real_idxs.push_back(ireal);
+			continue;
 		}
-
-		else
-		{
-			run_mgr_ptr->get_run(real_run_id.second, pars, obs);
-			//real_name = real_names[real_run_id.first];
-			update_from_obs(real_run_id.first, obs);
-			//update_from_obs(ireal, obs);
+		if (real_run_id.first >= real_names.size())
+			throw_ensemble_error("ObservtionEnsemble.update_from_runs() real idx out of range");
+		if (!run_mgr_ptr->get_observations_view(real_run_id.second, obs_ptr))
+			continue;
+		if (obs_pos.size() == 0)
+		{
+			const vector<string> &stor_names = run_mgr_ptr->get_obs_name_vec();
+			unordered_map<string, int> stor_idx;
+			for (int i = 0; i < stor_names.size(); i++)
+				stor_idx[stor_names[i]] = i;
+			obs_pos.reserve(var_names.size());
+			for (auto &name : var_names)
+			{
+				auto it = stor_idx.find(name);
+				if (it == stor_idx.end())
+					throw_ensemble_error("ObservationEnsemble.update_from_runs() obs not found in run storage: " + name);
+				obs_pos.push_back(it->second);
+			}
 		}
+		for (size_t j = 0; j < obs_pos.size(); j++)
+			reals(real_run_id.first, j) = obs_ptr[obs_pos[j]];
 	}
 	return failed_real_idxs;
 }
@@ -2760,30 +2908,47 @@ void ObservationEnsemble::from_binary(string file_name)
 	Ensemble::from_binary(file_name, names, true);
 }
 
+void ObservationEnsemble::from_columnar(string file_name, const vector<string> &read_names)
+{
+	//load an obs en from a columnar binary file.  the en always holds all the control file obs, but
+	//only the read_names columns (e.g. just the nonzero-weighted obs) are read from the file - the
+	//other obs get their control file values.  by default every column is read.  nonzero-weighted
+	//obs that are read must be present
+	vector<string> load_names = pest_scenario_ptr->get_ctl_ordered_obs_names();
+	vector<string> nz_names = pest_scenario_ptr->get_ctl_ordered_nz_obs_names();
+	unordered_set<string> nz_set(nz_names.begin(), nz_names.end());
+	const vector<string> &check_names = (read_names.size() > 0) ? read_names : load_names;
+	vector<string> required;
+	for (auto &name : check_names)
+		if (nz_set.find(name) != nz_set.end())
+			required.push_back(name);
+	Ensemble::from_columnar(file_name, load_names, required, read_names);
+	if (read_names.size() == 0)
+		return;
+	unordered_set<string> read_set(read_names.begin(), read_names.end());
+	Observations obs = pest_scenario_ptr->get_ctl_observations();
+	for (int i = 0; i < var_names.size(); i++)
+	{
+		if (read_set.find(var_names[i]) == read_set.end())
+			reals.col(i).setConstant(obs[var_names[i]]);
+	}
+}
+
 void ObservationEnsemble::from_csv(string file_name)
 {
 	//load the obs en from a csv file
 	var_names = pest_scenario_ptr->get_ctl_ordered_obs_names();
 	bool csv_by_reals = pest_scenario_ptr->get_pestpp_options().get_ies_csv_by_reals();
-	ifstream csv(file_name);
-	if (!csv.good())
-		throw runtime_error("error opening observation csv " + file_name + " for reading");
+	CsvFileReader csv(file_name, pest_scenario_ptr->get_pestpp_options().get_ies_num_threads());
 	pair<map<string,int>, map<string, int>> p = prepare_csv(pest_scenario_ptr->get_ctl_ordered_nz_obs_names(), csv, false);
 
 	map<string, int> header_info = p.first, index_info = p.second;
-	//blast through the file to get number of reals
-	string line;
 	int num_reals;
 	if (csv_by_reals)
 		num_reals = index_info.size();
 	else
 		num_reals = header_info.size();
 	
-	csv.close();
-	csv.open(file_name);
-	if (!csv.good())
-		throw runtime_error("error re-opening observation csv " + file_name + " for reading");
-	getline(csv, line);
 	//Ensemble::read_csv(num_reals, csv,header_info,index_info);
 	if (csv_by_reals)
 		Ensemble::read_csv_by_reals(num_reals, csv, header_info, index_info);
@@ -2822,11 +2987,6 @@ void DrawThread::work(int thread_id, int num_reals, int ies_verbose, map<string,
 {
 	stringstream ss;
 
-	unique_lock<mutex> cov_guard(cov_lock,defer_lock);
-	unique_lock<mutex> draw_guard(draw_lock,defer_lock);
-	//unique_lock<mutex> grouper_guard(grouper_lock,defer_lock);
-	unique_lock<mutex> pfm_guard(pfm_lock,defer_lock);
-	unique_lock<mutex> key_guard(key_lock, defer_lock);
 	int count = 0;
 	string group;
 	vector<string> names;
@@ -2837,69 +2997,29 @@ void DrawThread::work(int thread_id, int num_reals, int ies_verbose, map<string,
 	while (true)
 	{
 		//get the key for more work, or return if all work done
-		while (true)
 		{
-			if (key_guard.try_lock())
-			{
-				if (group_keys.size() == 0)
-				{
-					ss.str("");
-					ss << "draw thread: " << thread_id << " processed " << count << " groups";
-					if (ies_verbose > 1)
-					{
-						cout << ss.str() << endl;
-
-					}
-					while (true)
-					{
-						if (pfm_guard.try_lock())
-						{
-							performance_log->log_event(ss.str());
-							pfm_guard.unlock();
-							break;
-						}
-					}
-					key_guard.unlock();
-					return;
-				}
-			}
+			lock_guard<mutex> key_guard(key_lock);
+			if (group_keys.size() == 0)
+				break;
 			group = group_keys[group_keys.size() - 1];
 			group_keys.pop_back();
 			names = grouper[group];
-			if (names.size() == 0)
-			{
-				ss.str("");
-				ss << "no entries for grouper key:" << group;
-				while (true)
-				{
-					if (pfm_guard.try_lock())
-					{
-						performance_log->log_event(ss.str());
-						pfm_guard.unlock();
-						break;
-					}
-				}
-				key_guard.unlock();
-				continue;
-			}
-			key_guard.unlock();
-			break;
 		}
+		if (names.size() == 0)
+		{
+			ss.str("");
+			ss << "no entries for grouper key:" << group;
+			log_event(ss.str());
+			continue;
+		}
+		count++;
 		
 		if (ies_verbose > 1)
 		{
 			ss.str("");
 			ss << "...processing " << group << " with " <<names.size() << " elements" << endl;
 			cout << ss.str();
-			while (true)
-			{
-				if (pfm_guard.try_lock())
-				{
-					performance_log->log_event(ss.str());
-					pfm_guard.unlock();
-					break;
-				}
-			}
+			log_event(ss.str());
 		}
 
 		//if there is only one par in the group
@@ -2907,38 +3027,20 @@ void DrawThread::work(int thread_id, int num_reals, int ies_verbose, map<string,
 		{
 			ss.str("");
 			ss << "thread: " << thread_id << " - only one element in group " <<group << ", scaling by std";
-			while (true)
-			{
-				if (pfm_guard.try_lock())
-				{
-					performance_log->log_event(ss.str());
-					pfm_guard.unlock();
-					break;
-				}
-			}
+			log_event(ss.str());
 			int j = idx_map[names[0]];
-			while (true)
 			{
-				if (draw_guard.try_lock())
-				{
-					draws_ptr->col(j) *= std_map[names[0]];
-					draw_guard.unlock();
-					break;
-				}
+				lock_guard<mutex> draw_guard(draw_lock);
+				draws_ptr->col(j) *= std_map[names[0]];
 			}
 			
 			continue;
 		}
 
 		//get a sub cov
-		while (true)
 		{
-			if (cov_guard.try_lock())
-			{
-				gcov = cov.get(names);
-				cov_guard.unlock();
-				break;
-			}
+			lock_guard<mutex> cov_guard(cov_lock);
+			gcov = cov.get(names);
 		}
 		
 		if (ies_verbose > 2)
@@ -2954,15 +3056,7 @@ void DrawThread::work(int thread_id, int num_reals, int ies_verbose, map<string,
 		{
 			ss.str("");
 			ss << "thread: " << thread_id << " - DrawThread error: idx out of order for group: " << group;
-			while (true)
-			{
-				if (pfm_guard.try_lock())
-				{
-					performance_log->log_event(ss.str());
-					pfm_guard.unlock();
-					break;
-				}
-			}
+			log_event(ss.str());
 			throw runtime_error(ss.str());
 		}
 
@@ -2970,36 +3064,11 @@ void DrawThread::work(int thread_id, int num_reals, int ies_verbose, map<string,
 		double fac = gcov.e_ptr()->diagonal().minCoeff();
 		ss.str("");
 		ss << "thread: " << thread_id <<  " - min variance for group " << group << ": " << fac;
-		while (true)
-		{
-			if (pfm_guard.try_lock())
-			{
-				performance_log->log_event(ss.str());
-				pfm_guard.unlock();
-				break;
-			}
-		}
-		/*while (true)
-		{
-			if (draw_guard.try_lock())
-			{
-				block = draws_ptr->block(0, idx[0], num_reals, idx.size());
-				draw_guard.unlock();
-				break;
-			}
-		}*/
+		log_event(ss.str());
 		
 		ss.str("");
 		ss << "thread: " << thread_id <<  " - Randomized Eigen decomposition of full cov for " << names.size() << " element matrix" << endl;
-		while (true)
-		{
-			if (pfm_guard.try_lock())
-			{
-				performance_log->log_event(ss.str());
-				pfm_guard.unlock();
-				break;
-			}
-		}
+		log_event(ss.str());
 		eig.compute(*gcov.e_ptr() * (1.0 / fac), names.size());
 		//RedSVD::RedSVD<Eigen::SparseMatrix<double>> svd;
 		//svd.compute(*gcov.e_ptr(),gcov.get_col_names().size());// , gi.second.size());
@@ -3026,18 +3095,338 @@ void DrawThread::work(int thread_id, int num_reals, int ies_verbose, map<string,
 		}
 		//cout << "block " << block.rows() << " , " << block.cols() << endl;
 		//cout << " proj " << proj.rows() << " , " << proj.cols() << endl;
-		while (true)
 		{
-			if (draw_guard.try_lock())
+			lock_guard<mutex> draw_guard(draw_lock);
+			block = draws_ptr->block(0, idx[0], num_reals, idx.size());
+			draws_ptr->block(0, idx[0], num_reals, idx.size()) = (proj * block.transpose()).transpose();
+		}
+		
+
+	}
+	ss.str("");
+	ss << "draw thread: " << thread_id << " processed " << count << " groups";
+	if (ies_verbose > 1)
+	{
+		cout << ss.str() << endl;
+	}
+	log_event(ss.str());
+
+}
+
+void DrawThread::log_event(const string& message)
+{
+	lock_guard<mutex> pfm_guard(pfm_lock);
+	performance_log->log_event(message);
+}
+
+namespace
+{
+	inline void mix_draw_sig(unsigned long long &sig, unsigned long long v)
+	{
+		sig ^= v + 0x9e3779b97f4a7c15ULL + (sig << 6) + (sig >> 2);
+	}
+
+	unsigned long long get_draw_factor_sig(const vector<string> &names, const Eigen::SparseMatrix<double> &mat, bool use_abs)
+	{
+		unsigned long long sig = 0, bits;
+		mix_draw_sig(sig, (unsigned long long)use_abs);
+		mix_draw_sig(sig, (unsigned long long)names.size());
+		for (auto &name : names)
+			mix_draw_sig(sig, (unsigned long long)std::hash<string>()(name));
+		for (int k = 0; k < mat.outerSize(); ++k)
+		{
+			for (Eigen::SparseMatrix<double>::InnerIterator it(mat, k); it; ++it)
 			{
-				block = draws_ptr->block(0, idx[0], num_reals, idx.size());
-				draws_ptr->block(0, idx[0], num_reals, idx.size()) = (proj * block.transpose()).transpose();
-				draw_guard.unlock();
-				break;
+				mix_draw_sig(sig, (unsigned long long)it.index());
+				double v = it.value();
+				memcpy(&bits, &v, sizeof(bits));
+				mix_draw_sig(sig, bits);
 			}
+			mix_draw_sig(sig, (unsigned long long)k);
 		}
-		
+		return sig;
+	}
+
+	//the cache file name only carries a signature of the inputs, so the file also stores
+	//the inputs themselves (the names, the use_abs flag and every nonzero of the group cov)
+	//and a factor is only loaded if all of them match exactly
+	const char draw_factor_magic[] = "pestpp_draw_factor_1";
+
+	void write_ll(ofstream &out, long long v)
+	{
+		out.write((const char*)&v, sizeof(v));
+	}
+
+	bool read_ll(ifstream &in, long long &v)
+	{
+		in.read((char*)&v, sizeof(v));
+		return in.good();
+	}
+
+	bool load_draw_factor(const string &filename, const vector<string> &names, const Eigen::SparseMatrix<double> &mat,
+		bool use_abs, Eigen::MatrixXd &proj)
+	{
+		ifstream in(filename, ios::binary);
+		if (!in.good())
+			return false;
+		string magic(sizeof(draw_factor_magic), '\0');
+		in.read(&magic[0], magic.size());
+		if ((!in.good()) || (magic != string(draw_factor_magic, sizeof(draw_factor_magic))))
+			return false;
+		long long v;
+		if ((!read_ll(in, v)) || (v != (long long)use_abs))
+			return false;
+		if ((!read_ll(in, v)) || (v != (long long)names.size()))
+			return false;
+		string name;
+		for (auto &n : names)
+		{
+			if ((!read_ll(in, v)) || (v != (long long)n.size()))
+				return false;
+			name.resize(v);
+			if (v > 0)
+				in.read(&name[0], v);
+			if ((!in.good()) || (name != n))
+				return false;
+		}
+		if ((!read_ll(in, v)) || (v != (long long)mat.nonZeros()))
+			return false;
+		long long outer, inner;
+		double value;
+		for (int k = 0; k < mat.outerSize(); ++k)
+		{
+			for (Eigen::SparseMatrix<double>::InnerIterator it(mat, k); it; ++it)
+			{
+				if ((!read_ll(in, outer)) || (!read_ll(in, inner)))
+					return false;
+				in.read((char*)&value, sizeof(value));
+				if ((!in.good()) || (outer != k) || (inner != it.index()) || (value != it.value()))
+					return false;
+			}
+		}
+		long long rows, cols;
+		if ((!read_ll(in, rows)) || (!read_ll(in, cols)))
+			return false;
+		if ((rows != (long long)names.size()) || (cols <= 0) || (cols > rows))
+			return false;
+		proj.resize(rows, cols);
+		in.read((char*)proj.data(), rows * cols * sizeof(double));
+		return in.good();
+	}
+
+	bool save_draw_factor(const string &filename, const vector<string> &names, const Eigen::SparseMatrix<double> &mat,
+		bool use_abs, const Eigen::MatrixXd &proj)
+	{
+		ofstream out(filename, ios::binary);
+		if (!out.good())
+			return false;
+		out.write(draw_factor_magic, sizeof(draw_factor_magic));
+		write_ll(out, (long long)use_abs);
+		write_ll(out, (long long)names.size());
+		for (auto &n : names)
+		{
+			write_ll(out, (long long)n.size());
+			out.write(n.c_str(), n.size());
+		}
+		write_ll(out, (long long)mat.nonZeros());
+		for (int k = 0; k < mat.outerSize(); ++k)
+		{
+			for (Eigen::SparseMatrix<double>::InnerIterator it(mat, k); it; ++it)
+			{
+				write_ll(out, (long long)k);
+				write_ll(out, (long long)it.index());
+				double value = it.value();
+				out.write((const char*)&value, sizeof(value));
+			}
+		}
+		write_ll(out, (long long)proj.rows());
+		write_ll(out, (long long)proj.cols());
+		out.write((const char*)proj.data(), proj.rows() * proj.cols() * sizeof(double));
+		return out.good();
+	}
+}
+
+BlockDrawEngine::BlockDrawEngine(PerformanceLog *_performance_log, Covariance &cov, const vector<string> &_draw_names,
+	const map<string, vector<string>> &grouper, unsigned int _seed, int _block_size, int _num_threads,
+	const string &_cache_dir) : draw_names(_draw_names), cache_dir(_cache_dir)
+{
+	performance_log = _performance_log;
+	seed = _seed;
+	block_size = _block_size;
+	num_threads = max(1, _num_threads);
+	if (block_size <= 0)
+		throw runtime_error("BlockDrawEngine error: block_size must be greater than zero");
+	if (cov.get_col_names() != draw_names)
+		throw runtime_error("BlockDrawEngine error: cov columns not aligned with draw names");
+
+	std = cov.e_ptr()->diagonal().cwiseSqrt();
+	in_factor.assign(draw_names.size(), false);
+	if (cov.isdiagonal())
+		return;
+
+	//same split as the serial draws: the full cov if there is no grouper (with the abs
+	//of the eigen values), otherwise each multi-element group
+	vector<pair<string, vector<string>>> groups;
+	bool use_abs = grouper.size() == 0;
+	if (use_abs)
+		groups.push_back(make_pair(string("ALL"), draw_names));
+	else
+	{
+		for (auto &g : grouper)
+			if (g.second.size() > 1)
+				groups.push_back(g);
+	}
+	map<string, int> idx_map;
+	for (int i = 0; i < draw_names.size(); i++)
+		idx_map[draw_names[i]] = i;
+	factors.resize(groups.size());
+	if (num_threads > 1)
+		Eigen::setNbThreads(1);
+	unique_ptr<ThreadPool> pool;
+	if ((num_threads > 1) && (groups.size() > 1))
+		pool.reset(new ThreadPool(min(num_threads, (int)groups.size())));
+	run_tasks(pool.get(), groups.size(), [&](int i) { factor_group(cov, groups[i].first, groups[i].second, idx_map, use_abs, factors[i]); },
+		"draw factor");
+	for (auto &f : factors)
+		for (auto i : f.idx)
+			in_factor[i] = true;
+}
+
+void BlockDrawEngine::factor_group(Covariance &cov, const string &group, const vector<string> &names,
+	const map<string, int> &idx_map, bool use_abs, GroupFactor &factor)
+{
+	stringstream ss;
+	factor.name = group;
+	factor.idx.clear();
+	for (auto &name : names)
+	{
+		auto it = idx_map.find(name);
+		if (it == idx_map.end())
+			throw runtime_error("BlockDrawEngine error: group " + group + " name not in draw names: " + name);
+		factor.idx.push_back(it->second);
+	}
+	Covariance gcov;
+	{
+		lock_guard<mutex> cov_guard(cov_lock);
+		gcov = cov.get(names);
+	}
+	const Eigen::SparseMatrix<double> &mat = *gcov.e_ptr();
+	string filename;
+	if (cache_dir.size() > 0)
+	{
+		ss << cache_dir << "/" << pest_utils::lower_cp(group) << "." << hex << get_draw_factor_sig(names, mat, use_abs) << ".draw_factor";
+		filename = ss.str();
+		if (load_draw_factor(filename, names, mat, use_abs, factor.proj))
+		{
+			log_event("loaded cached draw factor for group " + group + " from " + filename);
+			return;
+		}
+	}
+
+	double fac = mat.diagonal().minCoeff();
+	ss.str("");
+	ss << "Randomized Eigen decomposition of cov for group " << group << " with " << names.size() << " elements, min variance: " << fac;
+	log_event(ss.str());
+	RedSVD::RedSymEigen<Eigen::SparseMatrix<double>> eig;
+	eig.compute(mat * (1.0 / fac), names.size());
+	Eigen::VectorXd evals = fac * eig.eigenvalues();
+	if (use_abs)
+		evals = evals.cwiseAbs();
+	factor.proj = eig.eigenvectors() * evals.cwiseSqrt().asDiagonal();
+
+	if (filename.size() > 0)
+	{
+		if (save_draw_factor(filename, names, mat, use_abs, factor.proj))
+			log_event("saved draw factor for group " + group + " to " + filename);
+		else
+			log_event("warning: unable to save draw factor for group " + group + " to " + filename);
+	}
+}
+
+void BlockDrawEngine::draw_block(int iblock, int nrows, Eigen::MatrixXd &block) const
+{
+	int ncols = draw_names.size();
+	block.resize(nrows, ncols);
+	seed_seq sseq{ seed, (unsigned int)iblock };
+	mt19937 gen(sseq);
+	for (int i = 0; i < nrows; i++)
+		for (int j = 0; j < ncols; j++)
+			block(i, j) = draw_standard_normal(gen);
 
+	for (int j = 0; j < ncols; j++)
+		if (!in_factor[j])
+			block.col(j) *= std[j];
+	Eigen::MatrixXd sub;
+	for (auto &f : factors)
+	{
+		int n = f.idx.size();
+		sub.resize(nrows, n);
+		for (int k = 0; k < n; k++)
+			sub.col(k) = block.col(f.idx[k]);
+		sub = sub * f.proj.transpose();
+		for (int k = 0; k < n; k++)
+			block.col(f.idx[k]) = sub.col(k);
 	}
+}
 
-}
\ No newline at end of file
+void BlockDrawEngine::draw(int num_reals, Eigen::MatrixXd &draws) const
+{
+	draws.resize(num_reals, draw_names.size());
+	int num_blocks = (num_reals + block_size - 1) / block_size;
+	unique_ptr<ThreadPool> pool;
+	if ((num_threads > 1) && (num_blocks > 1))
+		pool.reset(new ThreadPool(min(num_threads, num_blocks)));
+	run_tasks(pool.get(), num_blocks, [&](int iblock)
+	{
+		Eigen::MatrixXd block;
+		int first = iblock * block_size;
+		int nrows = min(block_size, num_reals - first);
+		draw_block(iblock, nrows, block);
+		draws.middleRows(first, nrows) = block;
+	}, "draw blocks");
+}
+
+void BlockDrawEngine::stream(int num_reals, const function<void(int, const Eigen::MatrixXd&)> &sink) const
+{
+	int num_blocks = (num_reals + block_size - 1) / block_size;
+	int wave = min(num_threads, max(1, num_blocks));
+	unique_ptr<ThreadPool> pool;
+	if (wave > 1)
+		pool.reset(new ThreadPool(wave));
+	vector<Eigen::MatrixXd> blocks(wave);
+	stringstream ss;
+	for (int first_block = 0; first_block < num_blocks; first_block += wave)
+	{
+		int n = min(wave, num_blocks - first_block);
+		run_tasks(pool.get(), n, [&](int k)
+		{
+			int first = (first_block + k) * block_size;
+			draw_block(first_block + k, min(block_size, num_reals - first), blocks[k]);
+		}, "draw blocks");
+		for (int k = 0; k < n; k++)
+			sink((first_block + k) * block_size, blocks[k]);
+		ss.str("");
+		ss << "streamed " << min(num_reals, (first_block + n) * block_size) << " of " << num_reals << " realizations";
+		log_event(ss.str());
+	}
+}
+
+void BlockDrawEngine::run_tasks(ThreadPool *pool, int num_tasks, const function<void(int)> &task, const string &tag) const
+{
+	if ((pool == nullptr) || (num_tasks <= 1))
+	{
+		for (int i = 0; i < num_tasks; i++)
+			task(i);
+		return;
+	}
+	vector<future<void>> futures;
+	for (int i = 0; i < num_tasks; i++)
+		futures.push_back(pool->submit([&task, i]() { task(i); }));
+	ThreadPool::wait_all(futures, tag);
+}
+
+void BlockDrawEngine::log_event(const string &message) const
+{
+	lock_guard<mutex> pfm_guard(pfm_lock);
+	performance_log->log_event(message);
+}
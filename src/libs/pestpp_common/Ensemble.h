@@ -6,11 +6,14 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 #include <mutex>
+#include <functional>
 #include "FileManager.h"
 #include "ObjectiveFunc.h"
 #include "OutputFileWriter.h"
 #include "PerformanceLog.h"
 #include "RunStorage.h"
+#include "CsvFileReader.h"
+#include "EnsembleColumnFile.h"
 #include "covariance.h"
 #include "RunManagerAbstract.h"
 #include "PerformanceLog.h"
@@ -31,18 +34,23 @@ public:
 	void to_csv(string file_name);
 	void to_binary_old(string file_name, bool transposed=false);
 	void to_binary(string file_name, bool transposed=false);
+	void to_columnar(string file_name, bool float32=false);
 	void from_eigen_mat(Eigen::MatrixXd mat, const vector<string> &_real_names, const vector<string> &_var_names);
 	pair<int, int> shape() { return pair<int, int>(reals.rows(), reals.cols()); }
 	void throw_ensemble_error(string message);
 	void throw_ensemble_error(string message,vector<string> vec);
 	const vector<string> get_var_names() const { return var_names; }
 	const vector<string> get_real_names() const { return real_names; }
+	const vector<string>* get_var_names_ptr() const { return &var_names; }
+	const vector<string>* get_real_names_ptr() const { return &real_names; }
 
 	const vector<string> get_real_names(vector<int> &indices);
 
 	void extend_cols(Eigen::MatrixXd &_reals, const vector<string> &_var_names);
 	void add_2_cols_ip(Ensemble &other);
 	void add_2_cols_ip(const vector<string> &_var_names, const Eigen::MatrixXd &mat);
+	//add mat.col(i) to column col_idxs[i] of reals
+	void add_2_cols_ip(const vector<int> &col_idxs, const Eigen::MatrixXd &mat);
 	Ensemble zero_like();
 
 	vector<string> get_generic_real_names(int num_reals);
@@ -108,11 +116,15 @@ protected:
 	vector<string> real_names;	
 	vector<string> org_real_names;
 	map<string, int> var_map;
-	void read_csv_by_reals(int num_reals,ifstream &csv, map<string,int> &header_info, map<string,int> &index_info);
-	void read_csv_by_vars(int num_reals, ifstream &csv, map<string, int> &header_info, map<string, int> &index_info);
+	void draw_serial(int num_reals, Covariance &cov, const vector<string> &draw_names, const map<string, vector<string>> &grouper,
+		PerformanceLog *plog, int level, Eigen::MatrixXd &draws);
+	void read_csv_by_reals(int num_reals, CsvFileReader &csv, map<string,int> &header_info, map<string,int> &index_info);
+	void read_csv_by_vars(int num_reals, CsvFileReader &csv, map<string, int> &header_info, map<string, int> &index_info);
 	map<string,int> from_binary_old(string file_name, vector<string> &names,  bool transposed);
 	map<string, int> from_binary(string file_name, vector<string> &names, bool transposed);
-	pair<map<string, int>, map<string, int>> prepare_csv(const vector<string> &names, ifstream &csv, bool forgive);
+	map<string, int> from_columnar(string file_name, const vector<string> &names, const vector<string> &required,
+		const vector<string> &read_names=vector<string>());
+	pair<map<string, int>, map<string, int>> prepare_csv(const vector<string> &names, CsvFileReader &csv, bool forgive);
 	void to_csv_by_reals(ofstream &csv);
 	void to_csv_by_vars(ofstream &csv);
 };
@@ -137,6 +149,7 @@ public:
 	//void from_csv(string file_name,const vector<string> &ordered_names);
 	void from_csv(string file_name);
 	void from_binary(string file_name);
+	void from_columnar(string file_name, const vector<string> &names=vector<string>());
 
 	void from_eigen_mat(Eigen::MatrixXd mat, const vector<string> &_real_names, const vector<string> &_var_names,
 		transStatus _tstat = transStatus::NUM);
@@ -153,8 +166,12 @@ public:
 	map<int,int> add_runs(RunManagerAbstract *run_mgr_ptr,const vector<int> &real_idxs=vector<int>());
 
 	void draw(int num_reals, Parameters par, Covariance &cov, PerformanceLog *plog, int level, ofstream& frec);
+	//draw the realizations block by block straight into file_name (csv by reals or binary, by extension)
+	//without holding the whole ensemble - only the var and real names are kept
+	void draw_to_file(int num_reals, Parameters par, Covariance &cov, const string &file_name, PerformanceLog *plog);
 	Covariance get_diagonal_cov_matrix();
 	void to_binary(string filename);
+	void to_columnar(string filename, bool float32=false);
 
 private:
 	ParamTransformSeq par_transform;
@@ -164,6 +181,7 @@ private:
 	vector<string> fixed_names;
 	map<pair<string, string>, double> fixed_map;
 	void replace_fixed(string real_name,Parameters &pars);
+	map<string, vector<string>> prep_draw_names(Covariance &cov, PerformanceLog *plog, bool &reordered);
 };
 
 class ObservationEnsemble : public Ensemble
@@ -183,6 +201,7 @@ public:
 	void from_csv(string file_name);
 	void from_eigen_mat(Eigen::MatrixXd mat, const vector<string> &_real_names, const vector<string> &_var_names);
 	void from_binary(string file_name);// { Ensemble::from_binary(file_name, true); }
+	void from_columnar(string file_name, const vector<string> &read_names=vector<string>());
 	vector<int> update_from_runs(map<int,int> &real_run_ids, RunManagerAbstract *run_mgr_ptr);
 	void draw(int num_reals, Covariance &cov, PerformanceLog *plog, int level, ofstream& frec);
 	void initialize_without_noise(int num_reals);
@@ -200,6 +219,7 @@ public:
 
 
 private:
+	void log_event(const string& message);
     //int num_real, ies_verbose;
 	Eigen::MatrixXd *draws_ptr;
 	PerformanceLog* performance_log;
@@ -212,5 +232,52 @@ private:
 	mutex cov_lock, draw_lock, key_lock, pfm_lock;
 };
 
+class ThreadPool;
+
+//block-wise prior draws.  the standard normal draws for realization block b come from their own
+//generator seeded with (seed, b), so the result depends only on the seed and the block size, not
+//on the number of threads.  each group of the covariance matrix is factored once, in parallel,
+//and the factors are optionally cached in cache_dir keyed on a signature of the group covariance
+class BlockDrawEngine
+{
+public:
+	//the columns of cov must be ordered as draw_names
+	BlockDrawEngine(PerformanceLog *_performance_log, Covariance &cov, const vector<string> &_draw_names,
+		const map<string, vector<string>> &grouper, unsigned int _seed, int _block_size, int _num_threads,
+		const string &_cache_dir = string());
+
+	//fill draws (num_reals x draw names)
+	void draw(int num_reals, Eigen::MatrixXd &draws) const;
+	//draw a block at a time and pass each block to sink(first real index, block) in realization
+	//order - no more than num_threads blocks are held at once
+	void stream(int num_reals, const std::function<void(int, const Eigen::MatrixXd&)> &sink) const;
+	//the projected draws for realization block iblock (nrows x draw names)
+	void draw_block(int iblock, int nrows, Eigen::MatrixXd &block) const;
+
+private:
+	struct GroupFactor
+	{
+		string name;
+		vector<int> idx;
+		Eigen::MatrixXd proj;
+	};
+	PerformanceLog *performance_log;
+	vector<string> draw_names;
+	unsigned int seed;
+	int block_size, num_threads;
+	string cache_dir;
+	//std dev scaling for the columns that are not in a group factor
+	Eigen::VectorXd std;
+	vector<bool> in_factor;
+	vector<GroupFactor> factors;
+	mutex cov_lock;
+	mutable mutex pfm_lock;
+
+	void factor_group(Covariance &cov, const string &group, const vector<string> &names,
+		const map<string, int> &idx_map, bool use_abs, GroupFactor &factor);
+	void run_tasks(ThreadPool *pool, int num_tasks, const std::function<void(int)> &task, const string &tag) const;
+	void log_event(const string &message) const;
+};
+
 
 #endif
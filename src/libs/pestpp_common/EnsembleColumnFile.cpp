@@ -0,0 +1,189 @@
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include "EnsembleColumnFile.h"
+#include "utilities.h"
+
+using namespace std;
+
+namespace
+{
+	const char ECB_MAGIC[8] = { 'P', 'E', 'S', 'T', 'E', 'C', 'B', '\0' };
+	const int32_t ECB_VERSION = 1;
+	//magic + version + value size + n_real + n_var + data offset
+	const int64_t ECB_HEADER_SIZE = 8 + 4 + 4 + 8 + 8 + 8;
+
+	void write_name(ofstream &out, const string &name)
+	{
+		int32_t len = name.size();
+		out.write((char*)&len, sizeof(len));
+		out.write(name.c_str(), len);
+	}
+
+	void read_names(ifstream &in, int64_t n, vector<string> &names, const string &filename)
+	{
+		names.resize(n);
+		int32_t len;
+		for (int64_t i = 0; i < n; i++)
+		{
+			in.read((char*)&len, sizeof(len));
+			if ((!in.good()) || (len < 0) || (len > 4096))
+				throw runtime_error("EnsembleColumnFile error: corrupt name table in " + filename);
+			names[i].resize(len);
+			if (len > 0)
+				in.read(&names[i][0], len);
+			pest_utils::upper_ip(names[i]);
+		}
+		if (!in.good())
+			throw runtime_error("EnsembleColumnFile error: corrupt name table in " + filename);
+	}
+}
+
+void EnsembleColumnFile::write(const string &filename, const vector<string> &real_names,
+	const vector<string> &var_names, const Eigen::MatrixXd &values, bool float32)
+{
+	if ((values.rows() != real_names.size()) || (values.cols() != var_names.size()))
+		throw runtime_error("EnsembleColumnFile::write() error: values shape does not match names for " + filename);
+	ofstream out(filename, ios::binary);
+	if (!out.good())
+		throw runtime_error("EnsembleColumnFile::write() error opening file " + filename + " for writing");
+	int32_t version = ECB_VERSION, value_size = float32 ? 4 : 8;
+	int64_t n_real = real_names.size(), n_var = var_names.size();
+	int64_t data_offset = ECB_HEADER_SIZE;
+	for (auto &name : real_names)
+		data_offset += 4 + name.size();
+	for (auto &name : var_names)
+		data_offset += 4 + name.size();
+	//start the column blocks on an 8-byte boundary
+	int64_t pad = (8 - (data_offset % 8)) % 8;
+	data_offset += pad;
+
+	out.write(ECB_MAGIC, sizeof(ECB_MAGIC));
+	out.write((char*)&version, sizeof(version));
+	out.write((char*)&value_size, sizeof(value_size));
+	out.write((char*)&n_real, sizeof(n_real));
+	out.write((char*)&n_var, sizeof(n_var));
+	out.write((char*)&data_offset, sizeof(data_offset));
+	for (auto &name : real_names)
+		write_name(out, name);
+	for (auto &name : var_names)
+		write_name(out, name);
+	const char zeros[8] = { 0 };
+	out.write(zeros, pad);
+
+	//MatrixXd is column major, so each column block is already contiguous
+	vector<float> fbuf;
+	for (int64_t j = 0; j < n_var; j++)
+	{
+		const double *col = values.data() + (j * n_real);
+		if (float32)
+		{
+			fbuf.assign(col, col + n_real);
+			out.write((char*)fbuf.data(), n_real * sizeof(float));
+		}
+		else
+			out.write((char*)col, n_real * sizeof(double));
+	}
+	if (!out.good())
+		throw runtime_error("EnsembleColumnFile::write() error writing file " + filename);
+	out.close();
+}
+
+EnsembleColumnFile::EnsembleColumnFile(const string &_filename) : filename(_filename)
+{
+	ifstream in(filename, ios::binary);
+	if (!in.good())
+		throw runtime_error("EnsembleColumnFile error opening file " + filename + " for reading");
+	char magic[8];
+	int32_t version, vsize;
+	int64_t n_real, n_var, offset;
+	in.read(magic, sizeof(magic));
+	in.read((char*)&version, sizeof(version));
+	in.read((char*)&vsize, sizeof(vsize));
+	in.read((char*)&n_real, sizeof(n_real));
+	in.read((char*)&n_var, sizeof(n_var));
+	in.read((char*)&offset, sizeof(offset));
+	if ((!in.good()) || (memcmp(magic, ECB_MAGIC, sizeof(magic)) != 0))
+		throw runtime_error("EnsembleColumnFile error: " + filename + " is not a columnar ensemble file");
+	if (version != ECB_VERSION)
+	{
+		stringstream ss;
+		ss << "EnsembleColumnFile error: unsupported version " << version << " in " << filename;
+		throw runtime_error(ss.str());
+	}
+	if (((vsize != 4) && (vsize != 8)) || (n_real < 0) || (n_var < 0) || (offset < ECB_HEADER_SIZE))
+		throw runtime_error("EnsembleColumnFile error: corrupt header in " + filename);
+	value_size = vsize;
+	data_offset = offset;
+	read_names(in, n_real, real_names, filename);
+	read_names(in, n_var, var_names, filename);
+	if ((int64_t)in.tellg() > data_offset)
+		throw runtime_error("EnsembleColumnFile error: name table overruns the data in " + filename);
+
+	in.seekg(0, ios::end);
+	int64_t expected = data_offset + (n_real * n_var * value_size);
+	if ((int64_t)in.tellg() != expected)
+	{
+		stringstream ss;
+		ss << "EnsembleColumnFile error: " << filename << " should be " << expected << " bytes but is " << (int64_t)in.tellg();
+		throw runtime_error(ss.str());
+	}
+
+	var_index.reserve(n_var);
+	for (int i = 0; i < n_var; i++)
+	{
+		if (!var_index.emplace(var_names[i], i).second)
+			throw runtime_error("EnsembleColumnFile error: duplicate variable name " + var_names[i] + " in " + filename);
+	}
+}
+
+int EnsembleColumnFile::find(const string &var_name) const
+{
+	auto it = var_index.find(var_name);
+	if (it == var_index.end())
+		return -1;
+	return it->second;
+}
+
+void EnsembleColumnFile::read(const vector<int> &cols, const vector<int> &dest_cols, Eigen::MatrixXd &dest) const
+{
+	if (cols.size() != dest_cols.size())
+		throw runtime_error("EnsembleColumnFile::read() error: cols.size() != dest_cols.size()");
+	int64_t n_real = real_names.size();
+	if (dest.rows() != n_real)
+		throw runtime_error("EnsembleColumnFile::read() error: dest.rows() != number of realizations in " + filename);
+	ifstream in(filename, ios::binary);
+	if (!in.good())
+		throw runtime_error("EnsembleColumnFile error opening file " + filename + " for reading");
+
+	//visit the blocks in file order so the reads only ever move forward
+	vector<size_t> order(cols.size());
+	for (size_t k = 0; k < order.size(); k++)
+		order[k] = k;
+	sort(order.begin(), order.end(), [&cols](size_t a, size_t b) { return cols[a] < cols[b]; });
+
+	vector<float> fbuf;
+	if (value_size == 4)
+		fbuf.resize(n_real);
+	int64_t block_size = n_real * value_size;
+	for (size_t k : order)
+	{
+		if ((cols[k] < 0) || (cols[k] >= (int)var_names.size()) || (dest_cols[k] < 0) || (dest_cols[k] >= dest.cols()))
+			throw runtime_error("EnsembleColumnFile::read() error: column index out of range for " + filename);
+		in.seekg(data_offset + (cols[k] * block_size));
+		double *dcol = dest.data() + ((int64_t)dest_cols[k] * n_real);
+		if (value_size == 8)
+			in.read((char*)dcol, block_size);
+		else
+		{
+			in.read((char*)fbuf.data(), block_size);
+			for (int64_t i = 0; i < n_real; i++)
+				dcol[i] = fbuf[i];
+		}
+		if (!in.good())
+			throw runtime_error("EnsembleColumnFile::read() error reading column " + var_names[cols[k]] + " from " + filename);
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef ENSEMBLECOLUMNFILE_H_
+#define ENSEMBLECOLUMNFILE_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <Eigen/Dense>
+
+//columnar binary ensemble container (".ecb").  the layout (native byte order) is:
+//  header: magic "PESTECB\0", int32 version, int32 value size (4 or 8), int64 n_real,
+//    int64 n_var, int64 data offset
+//  names: n_real realization names then n_var variable names, each as int32 length + chars
+//  data: starting at the data offset, one block of n_real values per variable, in variable
+//    order, so variable j starts at data offset + (j * n_real * value size)
+//the variable names form the column index, so any subset of columns can be read by seeking
+//straight to its blocks - the rest of the file is never touched
+class EnsembleColumnFile
+{
+public:
+	//write values (n_real rows by n_var cols) to filename, as float32 if requested
+	static void write(const std::string &filename, const std::vector<std::string> &real_names,
+		const std::vector<std::string> &var_names, const Eigen::MatrixXd &values, bool float32 = false);
+
+	//open filename and read the header and the names (upper case)
+	EnsembleColumnFile(const std::string &_filename);
+	const std::vector<std::string> &get_real_names() const { return real_names; }
+	const std::vector<std::string> &get_var_names() const { return var_names; }
+	bool is_float32() const { return value_size == 4; }
+	//file column of var_name (upper case), -1 if not in the file
+	int find(const std::string &var_name) const;
+	//read file column cols[k] into dest.col(dest_cols[k]) for each k.  dest must have n_real rows
+	void read(const std::vector<int> &cols, const std::vector<int> &dest_cols, Eigen::MatrixXd &dest) const;
+
+private:
+	std::string filename;
+	int value_size;
+	long long data_offset;
+	std::vector<std::string> real_names;
+	std::vector<std::string> var_names;
+	std::unordered_map<std::string, int> var_index;
+};
+
+#endif //ENSEMBLECOLUMNFILE_H_
@@ -3,6 +3,8 @@
 #include <iomanip>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include "Ensemble.h"
 #include "RestartController.h"
 #include "utilities.h"
@@ -57,6 +59,8 @@ L2PhiHandler::L2PhiHandler(Pest *_pest_scenario, FileManager *_file_manager,
 	//parcov.inv_ip();
 	oreal_names = oe_base->get_real_names();
 	preal_names = pe_base->get_real_names();
+	obs_group_names = pest_scenario->get_ctl_ordered_obs_group_names();
+	par_group_names = pest_scenario->get_ctl_ordered_par_group_names();
 	if (should_prep_csv)
 	{
 		prepare_csv(file_manager->open_ofile_ext("phi.actual.csv"), oreal_names);
@@ -65,7 +69,7 @@ L2PhiHandler::L2PhiHandler(Pest *_pest_scenario, FileManager *_file_manager,
 		prepare_csv(file_manager->open_ofile_ext("phi.regul.csv"), preal_names);
 		prepare_group_csv(file_manager->open_ofile_ext("phi.group.csv"));
 	}
-
+	reset_context();
 }
 
 Eigen::MatrixXd L2PhiHandler::get_obs_resid(ObservationEnsemble &oe, bool apply_ineq)
@@ -136,114 +140,320 @@ Eigen::VectorXd L2PhiHandler::get_q_vector()
 	return q;
 }
 
-map<string, double> L2PhiHandler::get_obs_group_contrib(Eigen::VectorXd &phi_vec)
+void L2PhiHandler::reset_context()
 {
-	map<string, double> group_phi_map;
-	double sum;
-	for (auto &og : obs_group_idx_map)
+	//the per-obs weights, values, group indices and inequality flags in oe_base column order
+	obs_ctx_names = oe_base->get_var_names();
+	int nobs = obs_ctx_names.size();
+	const ObservationInfo* oi = pest_scenario->get_ctl_observation_info_ptr();
+	const Observations& obs = pest_scenario->get_ctl_observations();
+	unordered_map<string, int> group_idx;
+	for (int i = 0; i < obs_group_names.size(); i++)
+		group_idx[obs_group_names[i]] = i;
+	unordered_set<string> lt_set(lt_obs_names.begin(), lt_obs_names.end());
+	unordered_set<string> gt_set(gt_obs_names.begin(), gt_obs_names.end());
+	obs_ctx_weights.resize(nobs);
+	obs_ctx_vals.resize(nobs);
+	obs_ctx_group.assign(nobs, 0);
+	obs_ctx_ineq.assign(nobs, 0);
+	for (int i = 0; i < nobs; i++)
 	{
-		sum = 0.0;
-		for (auto i : og.second)
-			sum += phi_vec[i];
-		group_phi_map[og.first] = sum;
+		const string &name = obs_ctx_names[i];
+		obs_ctx_weights(i) = oi->get_weight(name);
+		obs_ctx_vals(i) = obs.get_rec(name);
+		obs_ctx_group[i] = group_idx.at(oi->get_group(name));
+		if (lt_set.find(name) != lt_set.end())
+			obs_ctx_ineq[i] = 1;
+		else if (gt_set.find(name) != gt_set.end())
+			obs_ctx_ineq[i] = 2;
 	}
-
-	return group_phi_map;
+	no_nz_obs = pest_scenario->get_ctl_ordered_nz_obs_names().size() == 0;
+	vector<string> base_reals = oe_base->get_real_names();
+	obs_base_real_idx.clear();
+	for (int i = 0; i < base_reals.size(); i++)
+		obs_base_real_idx[base_reals[i]] = i;
+
+	//the per-par group indices in pe_base column order
+	par_ctx_names = pe_base->get_var_names();
+	const ParameterInfo& pi = pest_scenario->get_ctl_parameter_info();
+	group_idx.clear();
+	for (int i = 0; i < par_group_names.size(); i++)
+		group_idx[par_group_names[i]] = i;
+	par_ctx_group.assign(par_ctx_names.size(), -1);
+	//only groups that have pars are reported
+	par_group_has_pars.assign(par_group_names.size(), false);
+	for (int i = 0; i < par_ctx_names.size(); i++)
+	{
+		auto it = group_idx.find(pi.get_parameter_rec_ptr(par_ctx_names[i])->group);
+		if (it == group_idx.end())
+			continue;
+		par_ctx_group[i] = it->second;
+		par_group_has_pars[it->second] = true;
+	}
+	base_reals = pe_base->get_real_names();
+	par_base_real_idx.clear();
+	for (int i = 0; i < base_reals.size(); i++)
+		par_base_real_idx[base_reals[i]] = i;
+
+	obs_ens_vars.clear();
+	obs_ens_cols.clear();
+	par_ens_vars.clear();
+	par_ens_cols.clear();
+	obs_slot_map.clear();
+	obs_slot_gen.clear();
+	obs_slot_meas.clear();
+	obs_slot_actual.clear();
+	obs_slot_group.clear();
+	par_slot_map.clear();
+	par_slot_gen.clear();
+	par_slot_regul.clear();
+	par_slot_group.clear();
+	obs_gen = 0;
+	par_gen = 0;
 }
 
-map<string, double> L2PhiHandler::get_par_group_contrib(Eigen::VectorXd &phi_vec)
+vector<int> L2PhiHandler::map_ens_cols(const vector<string> &ens_vars, const vector<string> &ctx_names, const string &type)
 {
-	map<string, double> group_phi_map;
-	double sum;
-	for (auto &pg : par_group_idx_map)
+	unordered_map<string, int> ens_var_idx;
+	for (int i = 0; i < ens_vars.size(); i++)
+		ens_var_idx[ens_vars[i]] = i;
+	vector<int> cols(ctx_names.size());
+	for (int j = 0; j < ctx_names.size(); j++)
 	{
-		sum = 0.0;
-		for (auto i : pg.second)
-			sum += phi_vec[i];
-		group_phi_map[pg.first] = sum;
+		auto it = ens_var_idx.find(ctx_names[j]);
+		if (it == ens_var_idx.end())
+			throw runtime_error("L2PhiHandler error: " + type + " '" + ctx_names[j] + "' not in " + type + " ensemble");
+		cols[j] = it->second;
 	}
-	return group_phi_map;
+	return cols;
 }
 
-void L2PhiHandler::update(ObservationEnsemble & oe, ParameterEnsemble & pe)
+vector<int> L2PhiHandler::update_obs_slots(ObservationEnsemble &oe, const vector<int> *changed_rows)
 {
-	//build up obs group and par group idx maps for group reporting
-	obs_group_idx_map.clear();
-	vector<string> nnz_obs = oe_base->get_var_names();
-	ObservationInfo oinfo = pest_scenario->get_ctl_observation_info();
-	vector<int> idx;
-
-	/*for (auto& og : pest_scenario->get_ctl_ordered_obs_group_names())
+	int nobs = obs_ctx_names.size(), ngroups = obs_group_names.size();
+	if (oe_base->shape().second != nobs)
+		throw runtime_error("L2PhiHandler error: base obs ensemble changed without reset_context()");
+	const vector<string> &oe_vars = *oe.get_var_names_ptr();
+	if (oe_vars != obs_ens_vars)
 	{
-		idx.clear();
-		for (int i = 0; i < nnz_obs.size(); i++)
+		obs_ens_cols = map_ens_cols(oe_vars, obs_ctx_names, "obs");
+		obs_ens_vars = oe_vars;
+	}
+	const vector<string> &oe_reals = *oe.get_real_names_ptr();
+	int nreals = oe_reals.size();
+	vector<bool> changed(nreals, changed_rows == nullptr);
+	if (changed_rows != nullptr)
+		for (auto i : *changed_rows)
+			if ((i >= 0) && (i < nreals))
+				changed[i] = true;
+
+	//a realization is dirty if it was not part of the previous call or the caller reports it
+	//as changed.  realizations that are not in the base ensemble get no phi
+	obs_gen++;
+	vector<int> slots(nreals, -1), dirty, brows;
+	for (int i = 0; i < nreals; i++)
+	{
+		auto it = obs_slot_map.find(oe_reals[i]);
+		if ((it != obs_slot_map.end()) && (!changed[i]) && (obs_slot_gen[it->second] == obs_gen - 1))
 		{
-			if (oinfo.get_group(nnz_obs[i]) == og)
+			slots[i] = it->second;
+			obs_slot_gen[it->second] = obs_gen;
+			continue;
+		}
+		auto bit = obs_base_real_idx.find(oe_reals[i]);
+		if (bit == obs_base_real_idx.end())
+			continue;
+		if (it == obs_slot_map.end())
+		{
+			slots[i] = obs_slot_meas.size();
+			obs_slot_map[oe_reals[i]] = slots[i];
+			obs_slot_gen.push_back(0);
+			obs_slot_meas.push_back(0.0);
+			obs_slot_actual.push_back(0.0);
+			obs_slot_group.resize(obs_slot_group.size() + ngroups, 0.0);
+		}
+		else
+			slots[i] = it->second;
+		obs_slot_gen[slots[i]] = obs_gen;
+		dirty.push_back(i);
+		brows.push_back(bit->second);
+	}
+	if (dirty.size() == 0)
+		return slots;
+
+	//weighted residual kernel for the dirty realizations: (resid * weight)^2 summed over
+	//obs for meas (vs the base realization) and actual (vs the obs value) phi, with the actual
+	//contributions also summed by obs group
+	const Eigen::MatrixXd *o = oe.get_eigen_ptr(), *b = oe_base->get_eigen_ptr();
+	const double *odata = o->data(), *bdata = b->data();
+	long long onr = o->rows(), bnr = b->rows();
+	int ndirty = dirty.size();
+	vector<double> dmeas(ndirty, 0.0), dactual(ndirty, 0.0), dgroup(ndirty * ngroups, 0.0);
+	for (int j = 0; j < nobs; j++)
+	{
+		const double *ocol = odata + (obs_ens_cols[j] * onr), *bcol = bdata + (j * bnr);
+		double w = obs_ctx_weights(j), val = obs_ctx_vals(j);
+		int ineq = obs_ctx_ineq[j], g = obs_ctx_group[j];
+		for (int d = 0; d < ndirty; d++)
+		{
+			double sim = ocol[dirty[d]];
+			double m = sim - bcol[brows[d]], a = sim - val;
+			if (ineq == 1)
 			{
-				idx.push_back(i);
+				m = (m < 0.0) ? 0.0 : m;
+				a = (a < 0.0) ? 0.0 : a;
 			}
+			else if (ineq == 2)
+			{
+				m = (m > 0.0) ? 0.0 : m;
+				a = (a > 0.0) ? 0.0 : a;
+			}
+			m *= w;
+			a *= w;
+			a *= a;
+			dmeas[d] += m * m;
+			dactual[d] += a;
+			dgroup[(d * ngroups) + g] += a;
 		}
-		if (idx.size() > 0)
-			obs_group_idx_map[og] = idx;
-	}*/
-	for (auto& og : pest_scenario->get_ctl_ordered_obs_group_names())
-		obs_group_idx_map[og] = vector<int>();
+	}
+	for (int d = 0; d < ndirty; d++)
+	{
+		int slot = slots[dirty[d]];
+		obs_slot_meas[slot] = dmeas[d];
+		obs_slot_actual[slot] = dactual[d];
+		copy(dgroup.begin() + (d * ngroups), dgroup.begin() + ((d + 1) * ngroups), obs_slot_group.begin() + (slot * ngroups));
+	}
+	return slots;
+}
 
-	for (int i = 0; i < nnz_obs.size(); i++)
+vector<int> L2PhiHandler::update_par_slots(ParameterEnsemble &pe, int num_rows, const vector<int> *changed_rows)
+{
+	pe_base->transform_ip(ParameterEnsemble::transStatus::NUM);
+	pe.transform_ip(ParameterEnsemble::transStatus::NUM);
+	int npar = par_ctx_names.size(), ngroups = par_group_names.size();
+	if (pe_base->shape().second != npar)
+		throw runtime_error("L2PhiHandler error: base par ensemble changed without reset_context()");
+	if (npar != parcov_inv_diag.size())
+		throw runtime_error("L2PhiHandler error: number of base pars != size of parcov diagonal");
+	const vector<string> &pe_vars = *pe.get_var_names_ptr();
+	if (pe_vars != par_ens_vars)
 	{
-		obs_group_idx_map[oinfo.get_group(nnz_obs[i])].push_back(i);
+		par_ens_cols = map_ens_cols(pe_vars, par_ctx_names, "par");
+		par_ens_vars = pe_vars;
 	}
-	
-	
-	//update the various phi component vectors
+	const vector<string> &pe_reals = *pe.get_real_names_ptr();
+	num_rows = min(num_rows, (int)pe_reals.size());
+	vector<bool> changed(num_rows, changed_rows == nullptr);
+	if (changed_rows != nullptr)
+		for (auto i : *changed_rows)
+			if ((i >= 0) && (i < num_rows))
+				changed[i] = true;
+
+	par_gen++;
+	vector<int> slots(num_rows), dirty, brows;
+	for (int i = 0; i < num_rows; i++)
+	{
+		auto it = par_slot_map.find(pe_reals[i]);
+		if ((it != par_slot_map.end()) && (!changed[i]) && (par_slot_gen[it->second] == par_gen - 1))
+		{
+			slots[i] = it->second;
+			par_slot_gen[it->second] = par_gen;
+			continue;
+		}
+		auto bit = par_base_real_idx.find(pe_reals[i]);
+		if (bit == par_base_real_idx.end())
+			throw runtime_error("L2PhiHandler error: par realization '" + pe_reals[i] + "' not in base parameter ensemble");
+		if (it == par_slot_map.end())
+		{
+			slots[i] = par_slot_regul.size();
+			par_slot_map[pe_reals[i]] = slots[i];
+			par_slot_gen.push_back(0);
+			par_slot_regul.push_back(0.0);
+			par_slot_group.resize(par_slot_group.size() + ngroups, 0.0);
+		}
+		else
+			slots[i] = it->second;
+		par_slot_gen[slots[i]] = par_gen;
+		dirty.push_back(i);
+		brows.push_back(bit->second);
+	}
+	if (dirty.size() == 0)
+		return slots;
+
+	//(par - base par)^2 / prior variance, summed over pars and by par group
+	const Eigen::MatrixXd *p = pe.get_eigen_ptr(), *b = pe_base->get_eigen_ptr();
+	const double *pdata = p->data(), *bdata = b->data();
+	long long pnr = p->rows(), bnr = b->rows();
+	int ndirty = dirty.size();
+	vector<double> dregul(ndirty, 0.0), dgroup(ndirty * ngroups, 0.0);
+	for (int j = 0; j < npar; j++)
+	{
+		const double *pcol = pdata + (par_ens_cols[j] * pnr), *bcol = bdata + (j * bnr);
+		double inv_var = parcov_inv_diag(j);
+		int g = par_ctx_group[j];
+		for (int d = 0; d < ndirty; d++)
+		{
+			double diff = pcol[dirty[d]] - bcol[brows[d]];
+			diff = diff * diff * inv_var;
+			dregul[d] += diff;
+			if (g >= 0)
+				dgroup[(d * ngroups) + g] += diff;
+		}
+	}
+	for (int d = 0; d < ndirty; d++)
+	{
+		int slot = slots[dirty[d]];
+		par_slot_regul[slot] = dregul[d];
+		copy(dgroup.begin() + (d * ngroups), dgroup.begin() + ((d + 1) * ngroups), par_slot_group.begin() + (slot * ngroups));
+	}
+	return slots;
+}
+
+void L2PhiHandler::update(ObservationEnsemble & oe, ParameterEnsemble & pe, const vector<int> *changed_rows)
+{
+	//update the various phi components - only realizations that changed (or were not part of)
+	//the previous update are recomputed, the rest come straight from the cache
+	const vector<string> &oe_reals = *oe.get_real_names_ptr();
+	vector<int> slots = update_obs_slots(oe, changed_rows);
+	int ngroups = obs_group_names.size();
 	meas.clear();
+	actual.clear();
 	obs_group_phi_map.clear();
-	Eigen::VectorXd q = get_q_vector();
-	map<string, Eigen::VectorXd> meas_map = calc_meas(oe, q);
-	for (auto &pv : meas_map)
+	for (int i = 0; i < oe_reals.size(); i++)
 	{
-		meas[pv.first] = pv.second.sum();
-
+		int slot = slots[i];
+		if (no_nz_obs)
+			meas[oe_reals[i]] = 0.0;
+		if (slot < 0)
+			continue;
+		if (!no_nz_obs)
+			meas[oe_reals[i]] = obs_slot_meas[slot];
+		actual[oe_reals[i]] = obs_slot_actual[slot];
+		map<string, double> &group_phi = obs_group_phi_map[oe_reals[i]];
+		for (int g = 0; g < ngroups; g++)
+			group_phi[obs_group_names[g]] = obs_slot_group[(slot * ngroups) + g];
 	}
+
 	if (org_reg_factor != 0.0)
 	{
-		par_group_idx_map.clear();
-		vector<string> pars = pe_base->get_var_names();
-		ParameterInfo pi = pest_scenario->get_ctl_parameter_info();
-		for (auto& pg : pest_scenario->get_ctl_ordered_par_group_names())
-		{
-			idx.clear();
-			for (int i = 0; i < pars.size(); i++)
-			{
-				if (pi.get_parameter_rec_ptr(pars[i])->group == pg)
-					idx.push_back(i);
-			}
-			if (idx.size() > 0)
-				par_group_idx_map[pg] = idx;
-		}
-		regul.clear();
-		map<string, Eigen::VectorXd> reg_map = calc_regul(pe);//, *reg_factor);
-		//for (auto &pv : calc_regul(pe))
-		string name;
 		//big assumption - if oe is a diff shape, then this
 		//must be a subset, so just use the first X rows of pe
-		for (int i = 0; i < oe.shape().first; i++)
+		const vector<string> &pe_reals = *pe.get_real_names_ptr();
+		vector<int> pslots = update_par_slots(pe, oe.shape().first, changed_rows);
+		int npgroups = par_group_names.size();
+		regul.clear();
+		for (int i = 0; i < pslots.size(); i++)
 		{
-			//name = preal_names[i];
-			name = pe.get_real_names()[i];
-			//cout << name << endl;
-			regul[name] = reg_map[name].sum();
-			par_group_phi_map[name] = get_par_group_contrib(reg_map[name]);
+			int slot = pslots[i];
+			regul[pe_reals[i]] = par_slot_regul[slot];
+			map<string, double> group_phi;
+			for (int g = 0; g < npgroups; g++)
+				if (par_group_has_pars[g])
+					group_phi[par_group_names[g]] = par_slot_group[(slot * npgroups) + g];
+			par_group_phi_map[pe_reals[i]] = group_phi;
 		}
 	}
-	
-	actual.clear();
-	for (auto &pv : calc_actual(oe, q))
-	{
-		actual[pv.first] = pv.second.sum();
-		obs_group_phi_map[pv.first] = get_obs_group_contrib(pv.second);
-	}
- 	composite.clear();
+	composite.clear();
 	composite = calc_composite(meas, regul);
 }
 
@@ -656,91 +866,26 @@ void L2PhiHandler::prepare_group_csv(ofstream &csv, vector<string> extra)
 
 vector<int> L2PhiHandler::get_idxs_greater_than(double bad_phi, double bad_phi_sigma, ObservationEnsemble &oe)
 {
+	vector<int> unchanged;
+	vector<int> slots = update_obs_slots(oe, &unchanged);
+	vector<string> names = oe.get_real_names();
 	map<string, double> _meas;
-	Eigen::VectorXd q = get_q_vector();
-	for (auto &pv : calc_meas(oe, q))
-		_meas[pv.first] = pv.second.sum();
+	for (int i = 0; i < names.size(); i++)
+	{
+		if (no_nz_obs)
+			_meas[names[i]] = 0.0;
+		else if (slots[i] >= 0)
+			_meas[names[i]] = obs_slot_meas[slots[i]];
+	}
 	double mean = calc_mean(&_meas);
 	double std = calc_std(&_meas);
 	vector<int> idxs;
-	vector<string> names = oe.get_real_names();
 	for (int i=0;i<names.size();i++)
 		if ((_meas[names[i]] > bad_phi) || (_meas[names[i]] > mean + (std * bad_phi_sigma)))
 			idxs.push_back(i);
 	return idxs;
 }
 
-map<string, Eigen::VectorXd> L2PhiHandler::calc_meas(ObservationEnsemble & oe, Eigen::VectorXd &q_vec)
-{
-	map<string, Eigen::VectorXd> phi_map;
-	Eigen::VectorXd oe_base_vec, oe_vec, diff, w_vec;
-	//Eigen::VectorXd q = get_q_vector();
-	vector<string> act_obs_names = pest_scenario->get_ctl_ordered_nz_obs_names();
-	vector<string> base_real_names = oe_base->get_real_names(), oe_real_names = oe.get_real_names();
-	vector<string>::iterator start = base_real_names.begin(), end = base_real_names.end();
-
-	
-	double phi;
-	string rname;
-
-	if (act_obs_names.size() == 0)
-	{
-		for (auto name : oe.get_real_names())
-			phi_map[name] = Eigen::VectorXd();
-		return phi_map;
-	}
-
-	Eigen::MatrixXd resid = get_obs_resid(oe);
-	ObservationInfo oi = pest_scenario->get_ctl_observation_info();
-	vector<string> names = oe_base->get_var_names();
-	w_vec.resize(names.size());
-	for (int i=0;i<names.size();i++)
-	{
-		w_vec(i) = oi.get_weight(names[i]);
-	}
-	
-	assert(oe_real_names.size() == resid.rows());
-	for (int i = 0; i<resid.rows(); i++)
-	{
-		rname = oe_real_names[i];
-		if (find(start, end, rname) == end)
-			continue;
-		diff = resid.row(i);
-		
-		diff = diff.cwiseProduct(w_vec);
-		
-		phi = (diff.cwiseProduct(diff)).sum();
-		phi_map[rname] = diff.cwiseProduct(diff);
-	}
-	return phi_map;
-}
-
-map<string, Eigen::VectorXd> L2PhiHandler::calc_regul(ParameterEnsemble & pe)
-{
-	map<string, Eigen::VectorXd> phi_map;
-	vector<string> real_names = pe.get_real_names();
-	pe_base->transform_ip(ParameterEnsemble::transStatus::NUM);
-	pe.transform_ip(ParameterEnsemble::transStatus::NUM);
-	Eigen::MatrixXd diff_mat = get_par_resid(pe);
-
-
-	Eigen::VectorXd diff;
-	for (int i = 0; i < real_names.size(); i++)
-	{
-		diff = diff_mat.row(i);
-		diff = diff.cwiseProduct(diff);
-		//cout << diff << endl;
-		diff = diff.cwiseProduct(parcov_inv_diag);
-		//cout << diff << endl;
-		//cout << parcov_inv_diag << endl;
-		//phi_map[real_names[i]] = _reg_fac * diff;
-		phi_map[real_names[i]] = diff;
-		
-	}
-	return phi_map;
-}
-
-
 void L2PhiHandler::apply_ineq_constraints(Eigen::MatrixXd &resid, vector<string> &names)
 {
 	
@@ -792,32 +937,6 @@ void L2PhiHandler::apply_ineq_constraints(Eigen::MatrixXd &resid, vector<string>
 }
 
 
-map<string, Eigen::VectorXd> L2PhiHandler::calc_actual(ObservationEnsemble & oe, Eigen::VectorXd &q_vec)
-{
-	map<string, Eigen::VectorXd> phi_map;
-	Eigen::MatrixXd resid = get_actual_obs_resid(oe);
-	vector<string> base_real_names = oe_base->get_real_names(), oe_real_names = oe.get_real_names();
-	vector<string>::iterator start = base_real_names.begin(), end = base_real_names.end();
-	double phi;
-	string rname;
-
-	Eigen::MatrixXd oe_reals = oe.get_eigen(vector<string>(), oe_base->get_var_names());
-	Eigen::VectorXd diff;
-	for (int i = 0; i<oe.shape().first; i++)
-	{
-		rname = oe_real_names[i];
-		if (find(start, end, rname) == end)
-			continue;
-		//diff = (oe_vec - obs_val_vec).cwiseProduct(q);
-		diff = resid.row(i);
-		diff = diff.cwiseProduct(q_vec);
-		//phi = (diff.cwiseProduct(diff)).sum();
-		phi_map[rname] = diff.cwiseProduct(diff);
-	}
-	return phi_map;
-}
-
-
 map<string, double> L2PhiHandler::calc_composite(map<string, double> &_meas, map<string, double> &_regul)
 {
 	map<string, double> phi_map;
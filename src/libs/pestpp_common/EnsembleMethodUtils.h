@@ -2,6 +2,7 @@
 #define ENSEMBLEMETHODUTILS_H_
 
 #include <map>
+#include <unordered_map>
 #include <random>
 #include <mutex>
 #include <thread>
@@ -27,7 +28,12 @@ public:
 	L2PhiHandler(Pest *_pest_scenario, FileManager *_file_manager,
 		       ObservationEnsemble *_oe_base, ParameterEnsemble *_pe_base,
 		       Covariance *_parcov, bool should_prep_csv = true);
-	void update(ObservationEnsemble &oe, ParameterEnsemble &pe);
+	//changed_rows are the rows of oe (and pe) whose values differ from the previous update() -
+	//only those and realizations that were not part of the previous update() are recomputed.
+	//nullptr recomputes all
+	void update(ObservationEnsemble &oe, ParameterEnsemble &pe, const vector<int> *changed_rows = nullptr);
+	//rebuild the per-variable context after the base ensembles or the weights change
+	void reset_context();
 	double get_mean(phiType pt);
 	double get_std(phiType pt);
 	double get_max(phiType pt);
@@ -40,6 +46,7 @@ public:
 	void report(bool echo=true);
 	void write(int iter_num, int total_runs, bool write_group = true);
 	void write_group(int iter_num, int total_runs, vector<double> extra);
+	//uses the meas phi of the oe realizations as of the previous update()
 	vector<int> get_idxs_greater_than(double bad_phi, double bad_phi_sigma, ObservationEnsemble &oe);
 
 	Eigen::MatrixXd get_obs_resid(ObservationEnsemble &oe, bool apply_ineq=true);
@@ -64,9 +71,6 @@ private:
 	void prepare_csv(ofstream &csv,vector<string> &names);
 	void prepare_group_csv(ofstream &csv, vector<string> extra = vector<string>());
 
-	map<string, Eigen::VectorXd> calc_meas(ObservationEnsemble &oe, Eigen::VectorXd &_q_vec);
-	map<string, Eigen::VectorXd> calc_regul(ParameterEnsemble &pe);// , double _reg_fac);
-	map<string, Eigen::VectorXd> calc_actual(ObservationEnsemble &oe, Eigen::VectorXd &_q_vec);
 	map<string, double> calc_composite(map<string,double> &_meas, map<string,double> &_regul);
 	//map<string, double>* get_phi_map(PhiHandler::phiType &pt);
 	void write_csv(int iter_num, int total_runs,ofstream &csv, phiType pt,
@@ -91,13 +95,35 @@ private:
 	vector<string> lt_obs_names;
 	vector<string> gt_obs_names;
 
-	map<string, vector<int>> obs_group_idx_map;
-	map<string, vector<int>> par_group_idx_map;
 	map<string, map<string, double>> obs_group_phi_map, par_group_phi_map;
 
-	map<string, double> get_obs_group_contrib(Eigen::VectorXd &phi_vec);
-	map<string, double> get_par_group_contrib(Eigen::VectorXd &phi_vec);
-
+	//phi components and group contributions are cached per realization name in contiguous
+	//slots, so update() only recomputes the realizations the caller reports as changed.  the
+	//slot generations record which slots were part of the previous call, only those are reused.
+	//the obs and par "contexts" hold the per-variable weights, values, group indices and
+	//inequality flags in base ensemble column order - they are built once from the base
+	//ensembles and rebuilt (with the cache reset) by reset_context()
+	vector<string> obs_group_names, par_group_names;
+	vector<string> obs_ctx_names, par_ctx_names;
+	Eigen::VectorXd obs_ctx_weights, obs_ctx_vals;
+	vector<int> obs_ctx_group, obs_ctx_ineq, par_ctx_group;
+	vector<bool> par_group_has_pars;
+	bool no_nz_obs;
+	unordered_map<string, int> obs_base_real_idx, par_base_real_idx;
+	//the ensemble column of each context variable for the last ensemble var ordering seen
+	vector<string> obs_ens_vars, par_ens_vars;
+	vector<int> obs_ens_cols, par_ens_cols;
+	unordered_map<string, int> obs_slot_map, par_slot_map;
+	vector<int> obs_slot_gen, par_slot_gen;
+	int obs_gen, par_gen;
+	vector<double> obs_slot_meas, obs_slot_actual, obs_slot_group;
+	vector<double> par_slot_regul, par_slot_group;
+
+	//slot of each oe row (-1 for rows not in oe_base), recomputing the changed ones
+	vector<int> update_obs_slots(ObservationEnsemble &oe, const vector<int> *changed_rows);
+	//slot of each of the first num_rows pe rows, recomputing the changed ones
+	vector<int> update_par_slots(ParameterEnsemble &pe, int num_rows, const vector<int> *changed_rows);
+	vector<int> map_ens_cols(const vector<string> &ens_vars, const vector<string> &ctx_names, const string &type);
 };
 
 class ParChangeSummarizer
@@ -14,6 +14,7 @@
 #include "SVDPackage.h"
 #include "eigen_tools.h"
 #include "EnsembleMethodUtils.h"
+#include "ThreadPool.h"
 
 
 
@@ -30,7 +31,7 @@ IterEnsembleSmoother::IterEnsembleSmoother(Pest &_pest_scenario, FileManager &_f
 	pe.set_rand_gen(&rand_gen);
 	oe.set_rand_gen(&rand_gen);
 	localizer.set_pest_scenario(&pest_scenario);
-	
+	pe_streamed = false;
 }
 
 void IterEnsembleSmoother::throw_ies_error(string message)
@@ -39,7 +40,6 @@ void IterEnsembleSmoother::throw_ies_error(string message)
 	cout << endl << "   ************   " << endl << "    IterEnsembleSmoother error: " << message << endl << endl;
 	file_manager.rec_ofstream() << endl << "   ************   " << endl << "    IterEnsembleSmoother error: " << message << endl << endl;
 	file_manager.close_file("rec");
-	performance_log->~PerformanceLog();
 	throw runtime_error("IterEnsembleSmoother error: " + message);
 }
 
@@ -85,6 +85,14 @@ bool IterEnsembleSmoother::initialize_pe(Covariance &cov)
 
 			}
 		}
+		string stream_file = pest_scenario.get_pestpp_options().get_ies_draw_stream_file();
+		if (stream_file.size() > 0)
+		{
+			message(1, "streaming parameter realizations to ", stream_file);
+			pe.draw_to_file(num_reals, draw_par, cov, stream_file, performance_log);
+			pe_streamed = true;
+			return true;
+		}
 		pe.draw(num_reals, draw_par,cov, performance_log, pest_scenario.get_pestpp_options().get_ies_verbose_level(), file_manager.rec_ofstream());
 		// stringstream ss;
 		// ss << file_manager.get_base_filename() << ".0.par.csv";
@@ -130,11 +138,32 @@ bool IterEnsembleSmoother::initialize_pe(Covariance &cov)
 				throw_ies_error(string("error processing par jcb"));
 			}
 		}
+		else if (par_ext.compare("ecb") == 0)
+		{
+			message(1, "loading par ensemble from columnar binary file", par_csv);
+			try
+			{
+				//every control file par is needed for the model runs, so only columns that are
+				//not control file pars are skipped
+				pe.from_columnar(par_csv, pest_scenario.get_ctl_ordered_par_names());
+			}
+			catch (const exception &e)
+			{
+				ss << "error processing par ecb: " << e.what();
+				throw_ies_error(ss.str());
+			}
+			catch (...)
+			{
+				throw_ies_error(string("error processing par ecb"));
+			}
+		}
 		else
 		{
-			ss << "unrecognized par csv extension " << par_ext << ", looking for csv, jcb, or jco";
+			ss << "unrecognized par csv extension " << par_ext << ", looking for csv, jcb, jco, or ecb";
 			throw_ies_error(ss.str());
 		}
+		if (pe.shape().first == 0)
+			throw_ies_error("par ensemble file " + par_csv + " has no realizations");
 
 		pe.transform_ip(ParameterEnsemble::transStatus::NUM);
 		
@@ -313,11 +342,33 @@ bool IterEnsembleSmoother::initialize_oe(Covariance &cov)
 				throw_ies_error(string("error processing obs binary file"));
 			}
 		}
+		else if (obs_ext.compare("ecb") == 0)
+		{
+			message(1, "loading obs ensemble from columnar binary file", obs_csv);
+			try
+			{
+				//only the nonzero-weighted obs of the obs+noise en are used, the rest of the
+				//columns are not read and those obs get their control file values
+				oe.from_columnar(obs_csv, act_obs_names);
+			}
+			catch (const exception &e)
+			{
+				stringstream ss;
+				ss << "error processing obs columnar binary file: " << e.what();
+				throw_ies_error(ss.str());
+			}
+			catch (...)
+			{
+				throw_ies_error(string("error processing obs columnar binary file"));
+			}
+		}
 		else
 		{
-			ss << "unrecognized obs ensemble extension " << obs_ext << ", looking for csv, jcb, or jco";
+			ss << "unrecognized obs ensemble extension " << obs_ext << ", looking for csv, jcb, jco, or ecb";
 			throw_ies_error(ss.str());
 		}
+		if (oe.shape().first == 0)
+			throw_ies_error("obs ensemble file " + obs_csv + " has no realizations");
 		if (pp_args.find("IES_NUM_REALS") != pp_args.end())
 		{
 			int num_reals = pest_scenario.get_pestpp_options().get_ies_num_reals();
@@ -588,9 +639,27 @@ void IterEnsembleSmoother::initialize_restart()
 			throw_ies_error(string("error processing restart obs binary file"));
 		}
 	}
+	else if (obs_ext.compare("ecb") == 0)
+	{
+		message(1, "loading restart obs ensemble from columnar binary file", obs_restart_csv);
+		try
+		{
+			//the restart outputs are saved as the 0th iteration obs en, so read every obs
+			oe.from_columnar(obs_restart_csv);
+		}
+		catch (const exception &e)
+		{
+			ss << "error processing restart obs columnar binary file: " << e.what();
+			throw_ies_error(ss.str());
+		}
+		catch (...)
+		{
+			throw_ies_error(string("error processing restart obs columnar binary file"));
+		}
+	}
 	else
 	{
-		ss << "unrecognized restart obs ensemble extension " << obs_ext << ", looking for csv, jcb, or jco";
+		ss << "unrecognized restart obs ensemble extension " << obs_ext << ", looking for csv, jcb, jco, or ecb";
 		throw_ies_error(ss.str());
 	}
 	if (par_restart_csv.size() > 0)
@@ -630,9 +699,26 @@ void IterEnsembleSmoother::initialize_restart()
 				throw_ies_error(string("error processing restart par binary file"));
 			}
 		}
+		else if (par_ext.compare("ecb") == 0)
+		{
+			message(1, "loading restart par ensemble from columnar binary file", par_restart_csv);
+			try
+			{
+				pe.from_columnar(par_restart_csv, pest_scenario.get_ctl_ordered_par_names());
+			}
+			catch (const exception &e)
+			{
+				ss << "error processing restart par columnar binary file: " << e.what();
+				throw_ies_error(ss.str());
+			}
+			catch (...)
+			{
+				throw_ies_error(string("error processing restart par columnar binary file"));
+			}
+		}
 		else
 		{
-			ss << "unrecognized restart par ensemble extension " << par_ext << ", looking for csv, jcb, or jco";
+			ss << "unrecognized restart par ensemble extension " << par_ext << ", looking for csv, jcb, jco, or ecb";
 			throw_ies_error(ss.str());
 		}
 		if (pe.shape().first != oe.shape().first)
@@ -715,7 +801,12 @@ void IterEnsembleSmoother::initialize_restart()
 				Observations obs = pest_scenario.get_ctl_observations();
 				oe_base.replace(base_par_idx, obs, BASE_REAL_NAME);
 				ss.str("");
-				if (pest_scenario.get_pestpp_options().get_ies_save_binary())
+				if (pest_scenario.get_pestpp_options().get_ies_save_columnar())
+				{
+					ss << file_manager.get_base_filename() << ".obs+noise.ecb";
+					oe_base.to_columnar(ss.str(), pest_scenario.get_pestpp_options().get_ies_columnar_float32());
+				}
+				else if (pest_scenario.get_pestpp_options().get_ies_save_binary())
 				{
 					ss << file_manager.get_base_filename() << ".obs+noise.jcb";
 					oe_base.to_binary(ss.str());
@@ -1087,6 +1178,11 @@ void IterEnsembleSmoother::initialize()
 	int num_reals = pest_scenario.get_pestpp_options().get_ies_num_reals();
 
 	pe_drawn = initialize_pe(parcov);
+	if (pe_streamed)
+	{
+		message(0, "'ies_draw_stream_file' given, prior parameter realizations saved, quitting");
+		return;
+	}
 
 	if (pest_scenario.get_pestpp_options().get_ies_use_prior_scaling())
 	{
@@ -1221,7 +1317,12 @@ void IterEnsembleSmoother::initialize()
 	message(2, "checking for denormal values in pe");
 	pe.check_for_normal("initial transformed parameter ensemble");
 	ss.str("");
-	if (pest_scenario.get_pestpp_options().get_ies_save_binary())
+	if (pest_scenario.get_pestpp_options().get_ies_save_columnar())
+	{
+		ss << file_manager.get_base_filename() << ".0.par.ecb";
+		pe.to_columnar(ss.str(), pest_scenario.get_pestpp_options().get_ies_columnar_float32());
+	}
+	else if (pest_scenario.get_pestpp_options().get_ies_save_binary())
 	{
 		ss << file_manager.get_base_filename() << ".0.par.jcb";
 		pe.to_binary(ss.str());
@@ -1235,7 +1336,12 @@ void IterEnsembleSmoother::initialize()
 	message(2, "checking for denormal values in base oe");
 	oe.check_for_normal("obs+noise observation ensemble");
 	ss.str("");
-	if (pest_scenario.get_pestpp_options().get_ies_save_binary())
+	if (pest_scenario.get_pestpp_options().get_ies_save_columnar())
+	{
+		ss << file_manager.get_base_filename() << ".obs+noise.ecb";
+		oe.to_columnar(ss.str(), pest_scenario.get_pestpp_options().get_ies_columnar_float32());
+	}
+	else if (pest_scenario.get_pestpp_options().get_ies_save_binary())
 	{
 		ss << file_manager.get_base_filename() << ".obs+noise.jcb";
 		oe.to_binary(ss.str());
@@ -1359,7 +1465,12 @@ void IterEnsembleSmoother::initialize()
 	}
 	
 	ss.str("");
-	if (pest_scenario.get_pestpp_options().get_ies_save_binary())
+	if (pest_scenario.get_pestpp_options().get_ies_save_columnar())
+	{
+		ss << file_manager.get_base_filename() << ".0.obs.ecb";
+		oe.to_columnar(ss.str(), pest_scenario.get_pestpp_options().get_ies_columnar_float32());
+	}
+	else if (pest_scenario.get_pestpp_options().get_ies_save_binary())
 	{
 		ss << file_manager.get_base_filename() << ".0.obs.jcb";
 		oe.to_binary(ss.str());
@@ -1392,7 +1503,8 @@ void IterEnsembleSmoother::initialize()
 	ph.update(oe, pe);
 	message(0, "pre-drop initial phi summary");
 	ph.report(true);
-	drop_bad_phi(pe, oe);
+	vector<int> unchanged;
+	drop_bad_phi(pe, oe, false, &unchanged);
 	if (oe.shape().first == 0)
 	{
 		throw_ies_error(string("all realizations dropped as 'bad'"));
@@ -1446,6 +1558,7 @@ void IterEnsembleSmoother::initialize()
 				throw_ies_error("all non-zero weighted observations in conflict state, cannot continue");
 			}
 			zero_weight_obs(in_conflict);
+			ph.reset_context();
 			if (ppo->get_ies_localizer().size() > 0)
 			{
 				message(1, "updating localizer");
@@ -1519,6 +1632,7 @@ void IterEnsembleSmoother::initialize()
 	}
 	message(1, "current lambda:", last_best_lam);
 	message(0, "initialization complete");
+	performance_log->write_phase_summary("initialization");
 }
 
 void IterEnsembleSmoother::zero_weight_obs(vector<string>& obs_to_zero_weight, bool update_obscov, bool update_oe_base)
@@ -1664,7 +1778,7 @@ Eigen::MatrixXd IterEnsembleSmoother::get_Am(const vector<string> &real_names, c
 	return Am;
 }
 
-void IterEnsembleSmoother::drop_bad_phi(ParameterEnsemble &_pe, ObservationEnsemble &_oe, bool is_subset)
+void IterEnsembleSmoother::drop_bad_phi(ParameterEnsemble &_pe, ObservationEnsemble &_oe, bool is_subset, const vector<int> *changed_rows)
 {
 	//don't use this assert because _pe maybe full size, but _oe might be subset size
 	if (!is_subset)
@@ -1673,6 +1787,7 @@ void IterEnsembleSmoother::drop_bad_phi(ParameterEnsemble &_pe, ObservationEnsem
 		
 	double bad_phi = pest_scenario.get_pestpp_options().get_ies_bad_phi();
 	double bad_phi_sigma = pest_scenario.get_pestpp_options().get_ies_bad_phi_sigma();
+	ph.update(_oe, _pe, changed_rows);
 	vector<int> idxs = ph.get_idxs_greater_than(bad_phi,bad_phi_sigma, _oe);
 
 	if (pest_scenario.get_pestpp_options().get_ies_debug_bad_phi())
@@ -1771,6 +1886,8 @@ void IterEnsembleSmoother::iterate_2_solution()
 	ofstream &frec = file_manager.rec_ofstream();
 	
 	bool accept;
+	if (pe_streamed)
+		return;
 	for (int i = 0; i < pest_scenario.get_control_info().noptmax; i++)
 	{
 		iter++;
@@ -1780,7 +1897,12 @@ void IterEnsembleSmoother::iterate_2_solution()
 		performance_log->log_event(ss.str());
 		accept = solve_new();
 		report_and_save();
-		ph.update(oe,pe);
+		{
+			//an accepted solve leaves the phi handler current for oe and pe
+			PerformanceLog::Scope scope(performance_log, "ies phi update");
+			vector<int> unchanged;
+			ph.update(oe, pe, accept ? &unchanged : nullptr);
+		}
 		last_best_mean = ph.get_mean(L2PhiHandler::phiType::COMPOSITE);
 		last_best_std = ph.get_std(L2PhiHandler::phiType::COMPOSITE);
 		ph.report(true);
@@ -1790,7 +1912,9 @@ void IterEnsembleSmoother::iterate_2_solution()
 		ss.str("");
 		ss << file_manager.get_base_filename() << "." << iter << ".pcs.csv";
 		pcs.summarize(pe,iter,ss.str());
-			
+		ss.str("");
+		ss << "iteration " << iter;
+		performance_log->write_phase_summary(ss.str());
 			
 		if (accept)
 			consec_bad_lambda_cycles = 0;
@@ -1868,61 +1992,43 @@ bool IterEnsembleSmoother::should_terminate()
 
 
 
-LocalUpgradeThread::LocalUpgradeThread(PerformanceLog *_performance_log, unordered_map<string, Eigen::VectorXd> &_par_resid_map, unordered_map<string, Eigen::VectorXd> &_par_diff_map,
-	unordered_map<string, Eigen::VectorXd> &_obs_resid_map, unordered_map<string, Eigen::VectorXd> &_obs_diff_map,
-	Localizer &_localizer, unordered_map<string, double> &_parcov_inv_map, unordered_map<string, double> &_weight_map,
-	ParameterEnsemble &_pe_upgrade, unordered_map<string,pair<vector<string>,vector<string>>> &_cases,
-	unordered_map<string, Eigen::VectorXd> &_Am_map, Localizer::How &_how): par_resid_map(_par_resid_map),
-	par_diff_map(_par_diff_map), obs_resid_map(_obs_resid_map),obs_diff_map(_obs_diff_map),localizer(_localizer),
-	pe_upgrade(_pe_upgrade),cases(_cases), parcov_inv_map(_parcov_inv_map), weight_map(_weight_map), Am_map(_Am_map)
-{
-	performance_log = _performance_log;
-	how = _how;
-	parcov_inv_map = _parcov_inv_map;
-	weight_map = _weight_map;
-	count = 0;
-
-	for (auto &c : cases)
-	{
-		keys.push_back(c.first);
-	}
-	//sort(keys.begin(), keys.end());
-	total = keys.size();
-	//random_shuffle(keys.begin(), keys.end());
-
-}
-
-
-void LocalUpgradeThread::work(int thread_id, int iter, double cur_lam)
+namespace
 {
-	class local_utils
+	class upgrade_utils
 	{
 	public:
-		static Eigen::DiagonalMatrix<double, Eigen::Dynamic> get_matrix_from_map(vector<string> &names, unordered_map<string, double> &dmap)
+		static void get_indices(const vector<string> &names, const unordered_map<string, int> &idx_map, vector<int> &idxs)
 		{
-			Eigen::VectorXd vec(names.size());
-			int i = 0;
-			for (auto name : names)
+			idxs.resize(names.size());
+			for (int i = 0; i < names.size(); i++)
 			{
-				vec[i] = dmap.at(name);
-				++i;
+				auto it = idx_map.find(names[i]);
+				if (it == idx_map.end())
+					throw runtime_error("LocalUpgradeThread error: name '" + names[i] + "' not found in upgrade matrices");
+				idxs[i] = it->second;
 			}
-			Eigen::DiagonalMatrix<double, Eigen::Dynamic> m = vec.asDiagonal();
-			return m;
 		}
-		static Eigen::MatrixXd get_matrix_from_map(int num_reals, vector<string> &names, unordered_map<string, Eigen::VectorXd> &emap)
+		//copy the columns idxs of mat into the (reused) buffer and view it as a (mat.rows() x idxs.size()) matrix
+		static Eigen::Map<Eigen::MatrixXd> gather_cols(const Eigen::MatrixXd &mat, const vector<int> &idxs, vector<double> &buffer)
 		{
-			Eigen::MatrixXd mat(num_reals, names.size());
-			mat.setZero();
-
-			for (int j = 0; j < names.size(); j++)
+			size_t nrows = mat.rows();
+			if (buffer.size() < nrows * idxs.size())
+				buffer.resize(nrows * idxs.size());
+			for (int j = 0; j < idxs.size(); j++)
 			{
-				mat.col(j) = emap[names[j]];
+				const double *col = mat.data() + ((size_t)idxs[j] * nrows);
+				copy(col, col + nrows, buffer.data() + (j * nrows));
 			}
-
-			return mat;
+			return Eigen::Map<Eigen::MatrixXd>(buffer.data(), nrows, idxs.size());
 		}
-		static void save_mat(int verbose_level, int tid, int iter, int t_count, string prefix, Eigen::MatrixXd &mat)
+		static Eigen::VectorXd gather(const Eigen::VectorXd &vec, const vector<int> &idxs)
+		{
+			Eigen::VectorXd sub(idxs.size());
+			for (int i = 0; i < idxs.size(); i++)
+				sub[i] = vec[idxs[i]];
+			return sub;
+		}
+		static void save_mat(int verbose_level, int tid, int iter, int t_count, string prefix, const Eigen::Ref<const Eigen::MatrixXd> &mat)
 		{
 			if (verbose_level < 2)
 				return;
@@ -1952,355 +2058,293 @@ void LocalUpgradeThread::work(int thread_id, int iter, double cur_lam)
 			}
 		}
 	};
-	
-	stringstream ss;
-	
-	
-	unique_lock<mutex> ctrl_guard(ctrl_lock, defer_lock);
-	int maxsing, num_reals, verbose_level, pcount=0,t_count;
-	double eigthresh;
-	bool use_approx;
-	bool use_prior_scaling;
-	bool use_localizer = false;
-	bool loc_by_obs = true;
+}
 
-	while (true)
+
+LocalUpgradeThread::LocalUpgradeThread(PerformanceLog *_performance_log, const Eigen::MatrixXd &_par_resid, const Eigen::MatrixXd &_par_diff,
+	const Eigen::MatrixXd &_obs_resid, const Eigen::MatrixXd &_obs_diff, const Eigen::MatrixXd &_Am_t,
+	const Eigen::VectorXd &_parcov_inv, const Eigen::VectorXd &_weights,
+	const vector<string> &par_names, const vector<string> &obs_names,
+	Localizer &_localizer, vector<ParameterEnsemble> &_pe_upgrades,
+	unordered_map<string, pair<vector<string>, vector<string>>> &_cases, Localizer::How &_how): cases(_cases),
+	pe_upgrades(_pe_upgrades), localizer(_localizer), par_resid(_par_resid), par_diff(_par_diff), obs_resid(_obs_resid),
+	obs_diff(_obs_diff), Am_t(_Am_t), parcov_inv(_parcov_inv), weights(_weights)
+{
+	performance_log = _performance_log;
+	how = _how;
+	count = 0;
+
+	//the solve settings are read once here, before any workers are started
+	Pest *pest_scenario = pe_upgrades[0].get_pest_scenario_ptr();
+	maxsing = pest_scenario->get_svd_info().maxsing;
+	eigthresh = pest_scenario->get_svd_info().eigthresh;
+	use_approx = pest_scenario->get_pestpp_options().get_ies_use_approx();
+	use_prior_scaling = pest_scenario->get_pestpp_options().get_ies_use_prior_scaling();
+	num_reals = pe_upgrades[0].shape().first;
+	verbose_level = pest_scenario->get_pestpp_options().get_ies_verbose_level();
+	//if (pe_upgrades[0].get_pest_scenario_ptr()->get_pestpp_options().get_ies_localize_how()[0] == 'P')
+	loc_by_obs = (how != Localizer::How::PARAMETERS);
+
+	par_idx_map.reserve(par_names.size());
+	for (int i = 0; i < par_names.size(); i++)
+		par_idx_map[par_names[i]] = i;
+	obs_idx_map.reserve(obs_names.size());
+	for (int i = 0; i < obs_names.size(); i++)
+		obs_idx_map[obs_names[i]] = i;
+
+	for (auto &c : cases)
 	{
-		if (ctrl_guard.try_lock())
-		{
-			maxsing = pe_upgrade.get_pest_scenario_ptr()->get_svd_info().maxsing;
-			eigthresh = pe_upgrade.get_pest_scenario_ptr()->get_svd_info().eigthresh;
-			use_approx = pe_upgrade.get_pest_scenario_ptr()->get_pestpp_options().get_ies_use_approx();
-			use_prior_scaling = pe_upgrade.get_pest_scenario_ptr()->get_pestpp_options().get_ies_use_prior_scaling();
-			num_reals = pe_upgrade.shape().first;
-			verbose_level = pe_upgrade.get_pest_scenario_ptr()->get_pestpp_options().get_ies_verbose_level();
-			ctrl_guard.unlock();
-			//if (pe_upgrade.get_pest_scenario_ptr()->get_pestpp_options().get_ies_localize_how()[0] == 'P')
-			if (how == Localizer::How::PARAMETERS)
-				loc_by_obs = false;
-			break;
-		}
+		keys.push_back(c.first);
 	}
+	//sort(keys.begin(), keys.end());
+	total = keys.size();
+	//random_shuffle(keys.begin(), keys.end());
+
+}
+
+
+void LocalUpgradeThread::log_progress()
+{
+	//called under next_lock with count not yet incremented
+	if (count % 1000 == 0)
+	{
+		stringstream ss;
+		ss << "upgrade thread progress: " << count << " of " << total << " parts done";
+		if (verbose_level > 1)
+			cout << ss.str() << endl;
+		performance_log->log_event(ss.str());
+	}
+}
+
+
+void LocalUpgradeThread::work(int thread_id, int iter, const vector<double> &cur_lams)
+{
+	int pcount = 0, t_count;
 	ofstream f_thread;
 	if (verbose_level > 2)
 	{
-		ss.str("");
+		stringstream ss;
 		ss << "thread_" << thread_id << "part_map.csv";
 		f_thread.open(ss.str());
-		ss.str("");
 	}
-	Eigen::MatrixXd par_resid, par_diff, Am;
-	Eigen::MatrixXd obs_resid, obs_diff, loc;
-	Eigen::DiagonalMatrix<double, Eigen::Dynamic> weights, parcov_inv;
-	vector<string> par_names, obs_names;
+	//thread-local workspace, reused (and only ever grown) across cases
+	Workspace ws;
 	while (true)
 	{
-		unique_lock<mutex> next_guard(next_lock, defer_lock);
-		par_names.clear();
-		obs_names.clear();
-		use_localizer = false;
+		int icase;
 		//the end condition
-		//the end condition
-		while (true)
-		{	
-			if (next_guard.try_lock())
+		{
+			lock_guard<mutex> next_guard(next_lock);
+			if (count == keys.size())
 			{
-				if (count == keys.size())
-				{
-					if (verbose_level > 1)
-					{
-						cout << "upgrade thread: " << thread_id << " processed " << pcount << " upgrade parts" << endl;
-					}
-					if (f_thread.good())
-						f_thread.close();
-					return;
-				}
-				string k = keys[count];
-				pair<vector<string>, vector<string>> p = cases.at(k);
-				par_names = p.second;
-				obs_names = p.first;
-				if (localizer.get_use())
+				if (verbose_level > 1)
 				{
-					if ((loc_by_obs) && (par_names.size() == 1) && (k == par_names[0]))
-						use_localizer = true;
-					else if ((!loc_by_obs) && (obs_names.size() == 1) && (k == obs_names[0]))
-					{
-						use_localizer = true;
-						//loc_by_obs = false;
-					}
-				}
-				if (count % 1000 == 0)
-				{
-					ss.str("");
-					ss << "upgrade thread progress: " << count << " of " << total << " parts done";
-					if (verbose_level > 1)
-						cout << ss.str() << endl;
-					performance_log->log_event(ss.str());
+					cout << "upgrade thread: " << thread_id << " processed " << pcount << " upgrade parts" << endl;
 				}
-				count++;
-				t_count = count;
-				pcount++;
-				next_guard.unlock();
-				break;
+				if (f_thread.good())
+					f_thread.close();
+				return;
 			}
+			log_progress();
+			icase = count;
+			count++;
+			t_count = count;
+			pcount++;
 		}
-		
 
 		if (verbose_level > 2)
 		{
+			const pair<vector<string>, vector<string>> &p = cases.at(keys[icase]);
 			f_thread << t_count << "," << iter;
-			for (auto name : par_names)
+			for (auto &name : p.second)
 				f_thread << "," << name;
-			for (auto name : obs_names)
+			for (auto &name : p.first)
 				f_thread << "," << name;
 			f_thread << endl;
 		}
+		solve_case(thread_id, iter, icase, cur_lams, ws);
+	}
 
-		par_resid.resize(0, 0);
-		par_diff.resize(0, 0);
-		obs_resid.resize(0, 0);
-		obs_diff.resize(0, 0);
-		loc.resize(0, 0);
-		Am.resize(0, 0);
-		weights.resize(0);
-		parcov_inv.resize(0);
-		Am.resize(0, 0);
-
-		unique_lock<mutex> obs_diff_guard(obs_diff_lock, defer_lock);
-		unique_lock<mutex> obs_resid_guard(obs_resid_lock, defer_lock);
-		unique_lock<mutex> par_diff_guard(par_diff_lock, defer_lock);
-		unique_lock<mutex> par_resid_guard(par_resid_lock, defer_lock);
-		unique_lock<mutex> loc_guard(loc_lock, defer_lock);
-		unique_lock<mutex> weight_guard(weight_lock, defer_lock);
-		unique_lock<mutex> parcov_guard(parcov_lock, defer_lock);
-		unique_lock<mutex> am_guard(am_lock, defer_lock);
-
-		while (true)
-		{
-			if (((use_approx) || (par_resid.rows() > 0)) &&
-				(weights.size() > 0) &&
-				(parcov_inv.size() > 0) &&
-				(par_diff.rows() > 0) &&
-				(obs_resid.rows() > 0) &&
-				(obs_diff.rows() > 0) &&
-				((!use_localizer) || (loc.rows() > 0)) && 
-				((use_approx) || (Am.rows() > 0)))
-				break;
-			if ((use_localizer) && (loc.rows() == 0) && (loc_guard.try_lock()))
-			{
-				if (loc_by_obs)
-					loc = localizer.get_localizing_par_hadamard_matrix(num_reals, obs_names[0], par_names);
-				else
-					loc = localizer.get_localizing_obs_hadamard_matrix(num_reals, par_names[0], obs_names);
-				loc_guard.unlock();
-			}
-			if ((obs_diff.rows() == 0) && (obs_diff_guard.try_lock()))
-			{
-				//piggy back here for thread safety
-				//if (pe_upgrade.get_pest_scenario_ptr()->get_pestpp_options().get_svd_pack() == PestppOptions::SVD_PACK::PROPACK)
-				//	use_propack = true;
-				obs_diff = local_utils::get_matrix_from_map(num_reals, obs_names, obs_diff_map);
-				obs_diff_guard.unlock();
-			}
-			if ((obs_resid.rows() == 0) && (obs_resid_guard.try_lock()))
-			{
-				obs_resid = local_utils::get_matrix_from_map(num_reals, obs_names, obs_resid_map);
-				obs_resid_guard.unlock();
-			}
-			if ((par_diff.rows() == 0) && (par_diff_guard.try_lock()))
-			{
-				par_diff = local_utils::get_matrix_from_map(num_reals, par_names, par_diff_map);
-				par_diff_guard.unlock();
-			}
-			if ((par_resid.rows() == 0) && (par_resid_guard.try_lock()))
-			{
-				par_resid = local_utils::get_matrix_from_map(num_reals, par_names, par_resid_map);
-				par_resid_guard.unlock();
-			}
-			if ((weights.rows() == 0) && (weight_guard.try_lock()))
-			{
-				weights = local_utils::get_matrix_from_map(obs_names, weight_map);
-				weight_guard.unlock();
-			}
-			if ((parcov_inv.rows() == 0) && (parcov_guard.try_lock()))
-			{
-				parcov_inv = local_utils::get_matrix_from_map(par_names, parcov_inv_map);
-				parcov_guard.unlock();
-			}
-			if ((!use_approx) && (Am.rows() == 0) && (am_guard.try_lock()))
-			{
-				//Am = local_utils::get_matrix_from_map(num_reals, par_names, Am_map).transpose();
-				int am_cols = Am_map[par_names[0]].size();
-				Am.resize(par_names.size(),am_cols);
-				Am.setZero();
-
-				for (int j = 0; j < par_names.size(); j++)
-				{
-					Am.row(j) = Am_map[par_names[j]];
-				}
-				am_guard.unlock();
-			}
-		}
-		
-		par_diff.transposeInPlace();
-		obs_diff.transposeInPlace();
-		obs_resid.transposeInPlace();
-		par_resid.transposeInPlace();
-
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "obs_resid", obs_resid);
-		Eigen::MatrixXd scaled_residual = weights * obs_resid;
-		
-		
+}
 
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "par_resid", par_resid);
-		Eigen::MatrixXd scaled_par_resid;
-		if ((!use_approx) && (iter > 1))
-		{
-			if (use_prior_scaling)
-			{
-				scaled_par_resid = parcov_inv * par_resid;
-			}
-			else
-			{
-				scaled_par_resid = par_resid;
-			}
-		}
 
-		stringstream ss;
+void LocalUpgradeThread::work_case(int icase, int iter, const vector<double> &cur_lams)
+{
+	if ((icase < 0) || (icase >= total))
+		throw runtime_error("LocalUpgradeThread::work_case() error: case index out of range");
+	//the pool worker id names the verbose files, as thread_id does for work()
+	int thread_id = max(0, ThreadPool::get_worker_id());
+	{
+		lock_guard<mutex> next_guard(next_lock);
+		log_progress();
+		count++;
+	}
+	Workspace ws;
+	solve_case(thread_id, iter, icase, cur_lams, ws);
+}
 
-		double scale = (1.0 / (sqrt(double(num_reals - 1))));
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "obs_diff", obs_diff);
 
-		if (use_localizer)
-			local_utils::save_mat(verbose_level, thread_id, iter, t_count, "loc", loc);
-		if (use_localizer)
+void LocalUpgradeThread::solve_case(int thread_id, int iter, int icase, const vector<double> &cur_lams, Workspace &ws)
+{
+	//everything below only reads the shared matrices, so no locks are needed until the put
+	const string &k = keys[icase];
+	const pair<vector<string>, vector<string>> &p = cases.at(k);
+	const vector<string> *par_names = &p.second, *obs_names = &p.first;
+	int t_count = icase + 1;
+	bool use_localizer = false;
+	if (localizer.get_use())
+	{
+		if ((loc_by_obs) && (par_names->size() == 1) && (k == (*par_names)[0]))
+			use_localizer = true;
+		else if ((!loc_by_obs) && (obs_names->size() == 1) && (k == (*obs_names)[0]))
 		{
-			if (loc_by_obs)
-				par_diff = par_diff.cwiseProduct(loc);
-			else	
-				obs_diff = obs_diff.cwiseProduct(loc);
-
+			use_localizer = true;
+			//loc_by_obs = false;
 		}
-		
-		obs_diff = scale * (weights * obs_diff);
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "par_diff", par_diff);
-		if (use_prior_scaling)
-			par_diff = scale * parcov_inv * par_diff;
-		else
-			par_diff = scale * par_diff;
+	}
 
+	upgrade_utils::get_indices(*par_names, par_idx_map, ws.par_idxs);
+	upgrade_utils::get_indices(*obs_names, obs_idx_map, ws.obs_idxs);
+	if (use_localizer)
+	{
+		if (loc_by_obs)
+			ws.loc = localizer.get_localizing_par_hadamard_vector((*obs_names)[0], *par_names);
+		else
+			ws.loc = localizer.get_localizing_obs_hadamard_vector((*par_names)[0], *obs_names);
+	}
+	//(num_reals x case vars) views of the case columns
+	Eigen::Map<Eigen::MatrixXd> obs_resid_c = upgrade_utils::gather_cols(obs_resid, ws.obs_idxs, ws.obs_resid_buf);
+	Eigen::Map<Eigen::MatrixXd> obs_diff_c = upgrade_utils::gather_cols(obs_diff, ws.obs_idxs, ws.obs_diff_buf);
+	Eigen::Map<Eigen::MatrixXd> par_resid_c = upgrade_utils::gather_cols(par_resid, ws.par_idxs, ws.par_resid_buf);
+	Eigen::Map<Eigen::MatrixXd> par_diff_c = upgrade_utils::gather_cols(par_diff, ws.par_idxs, ws.par_diff_buf);
+	ws.weights_s = upgrade_utils::gather(weights, ws.obs_idxs);
+	ws.parcov_inv_s = upgrade_utils::gather(parcov_inv, ws.par_idxs);
 
-		//performance_log->log_event("SVD of obs diff");
-		Eigen::MatrixXd ivec, upgrade_1, s, V, Ut;
-		
-		
-		SVD_REDSVD rsvd;
-		rsvd.solve_ip(obs_diff, s, Ut, V, eigthresh, maxsing);
-		
-		Ut.transposeInPlace();
-		obs_diff.resize(0, 0);
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "Ut", Ut);
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "s", s);
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "V", V);
-
-		Eigen::MatrixXd s2 = s.cwiseProduct(s);
-
-		ivec = ((Eigen::VectorXd::Ones(s2.size()) * (cur_lam + 1.0)) + s2).asDiagonal().inverse();
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "ivec", ivec);
-		Eigen::MatrixXd X1 = Ut * scaled_residual;
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "X1", X1);
-		Eigen::MatrixXd X2 = ivec * X1;
-		X1.resize(0, 0);
-
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "X2", X2);
-		Eigen::MatrixXd X3 = V * s.asDiagonal() * X2;
-		X2.resize(0, 0);
-
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "X3", X3);
+	if (verbose_level > 2)
+	{
+		upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "obs_resid", obs_resid_c.transpose());
+		upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "par_resid", par_resid_c.transpose());
+		upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "obs_diff", obs_diff_c.transpose());
+	}
+	Eigen::MatrixXd scaled_residual = ws.weights_s.asDiagonal() * obs_resid_c.transpose();
+	
+	Eigen::MatrixXd scaled_par_resid;
+	if ((!use_approx) && (iter > 1))
+	{
 		if (use_prior_scaling)
 		{
-			upgrade_1 = -1.0 * parcov_inv * par_diff * X3;
+			scaled_par_resid = ws.parcov_inv_s.asDiagonal() * par_resid_c.transpose();
 		}
 		else
 		{
-			upgrade_1 = -1.0 * par_diff * X3;
+			scaled_par_resid = par_resid_c.transpose();
 		}
-		upgrade_1.transposeInPlace();
-		local_utils::save_mat(verbose_level, thread_id, iter, t_count, "upgrade_1",upgrade_1);
-		X3.resize(0, 0);
-
+	}
 
-		Eigen::MatrixXd upgrade_2;
-		if ((!use_approx) && (iter > 1))
-		{
-			local_utils::save_mat(verbose_level, thread_id, iter, t_count, "Am",Am);
-			Eigen::MatrixXd x4 = Am.transpose() * scaled_par_resid;
-			local_utils::save_mat(verbose_level, thread_id, iter, t_count, "X4", x4);
-			
-			par_resid.resize(0, 0);
+	stringstream ss;
 
-			Eigen::MatrixXd x5 = Am * x4;
-			x4.resize(0, 0);
-			Am.resize(0, 0);
+	double scale = (1.0 / (sqrt(double(num_reals - 1))));
 
-			local_utils::save_mat(verbose_level, thread_id, iter, t_count, "X5", x5);
-			Eigen::MatrixXd x6 = par_diff.transpose() * x5;
-			x5.resize(0, 0);
+	if ((use_localizer) && (verbose_level > 2))
+	{
+		Eigen::MatrixXd loc_mat = ws.loc.replicate(1, num_reals);
+		upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "loc", loc_mat);
+	}
+	if (use_localizer)
+	{
+		//the hadamard product with the (row-constant) localizing matrix is a scaling of the case columns
+		if (loc_by_obs)
+			par_diff_c = par_diff_c * ws.loc.asDiagonal();
+		else	
+			obs_diff_c = obs_diff_c * ws.loc.asDiagonal();
 
-			local_utils::save_mat(verbose_level, thread_id, iter, t_count, "X6", x6);
-			Eigen::MatrixXd x7 = V * ivec *V.transpose() * x6;
-			x6.resize(0, 0);
+	}
+	
+	ws.obs_diff_s = scale * (ws.weights_s.asDiagonal() * obs_diff_c.transpose());
+	if (verbose_level > 2)
+		upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "par_diff", par_diff_c.transpose());
+	if (use_prior_scaling)
+		ws.par_diff_s = scale * ws.parcov_inv_s.asDiagonal() * par_diff_c.transpose();
+	else
+		ws.par_diff_s = scale * par_diff_c.transpose();
 
-			if (use_prior_scaling)
-			{
-				upgrade_2 = -1.0 * parcov_inv * par_diff * x7;
-			}
-			else
-			{
-				upgrade_2 = -1.0 * (par_diff * x7);
-			}
-			x7.resize(0, 0);
 
-			upgrade_1 = upgrade_1 + upgrade_2.transpose();
-			local_utils::save_mat(verbose_level, thread_id, iter, t_count, "upgrade_2", upgrade_2);
-			upgrade_2.resize(0, 0);
+	//performance_log->log_event("SVD of obs diff");
+	Eigen::MatrixXd s, V, Ut;
+	
+	
+	SVD_REDSVD rsvd;
+	rsvd.solve_ip(ws.obs_diff_s, s, Ut, V, eigthresh, maxsing);
+	
+	Ut.transposeInPlace();
+	upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "Ut", Ut);
+	upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "s", s);
+	upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "V", V);
+
+	//everything up to here is independent of lambda.  with ivec = diag(1/(lam + 1 + s^2)):
+	//  upgrade_1 = -parcov_inv * par_diff * V * diag(s) * ivec * Ut * scaled_residual
+	//  upgrade_2 = -parcov_inv * par_diff * V * ivec * V^T * par_diff^T * Am * Am^T * scaled_par_resid
+	//so both terms share the factor parcov_inv * par_diff * V and each lambda only needs
+	//one product with a lambda-scaled (sing x num_reals) matrix
+	Eigen::VectorXd sv = s.col(0);
+	Eigen::VectorXd s2 = sv.cwiseProduct(sv);
+	Eigen::MatrixXd pd_V;
+	if (use_prior_scaling)
+		pd_V = ws.parcov_inv_s.asDiagonal() * ws.par_diff_s * V;
+	else
+		pd_V = ws.par_diff_s * V;
+	Eigen::MatrixXd X1 = Ut * scaled_residual;
+	Ut.resize(0, 0);
+	upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "X1", X1);
 
-		}
-		
-		unique_lock<mutex> put_guard(put_lock, defer_lock);
-		while (true)
-		{
-			if (put_guard.try_lock())
-			{
-				pe_upgrade.add_2_cols_ip(par_names, upgrade_1);
-				put_guard.unlock();
-				break;
-			}
-		}
-	}
+	Eigen::MatrixXd Vt_x6;
+	if ((!use_approx) && (iter > 1))
+	{
+		//(Am cols x case pars) - the case rows of Am, transposed
+		Eigen::Map<Eigen::MatrixXd> Am_t_c = upgrade_utils::gather_cols(Am_t, ws.par_idxs, ws.am_buf);
+		if (verbose_level > 2)
+			upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "Am", Am_t_c.transpose());
+		Eigen::MatrixXd x4 = Am_t_c * scaled_par_resid;
+		upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "X4", x4);
 
-}
+		Eigen::MatrixXd x5 = Am_t_c.transpose() * x4;
+		x4.resize(0, 0);
 
+		upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "X5", x5);
+		Eigen::MatrixXd x6 = ws.par_diff_s.transpose() * x5;
+		x5.resize(0, 0);
 
+		upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, "X6", x6);
+		Vt_x6 = V.transpose() * x6;
+	}
+	V.resize(0, 0);
 
-void upgrade_thread_function(int id, int iter,double cur_lam, LocalUpgradeThread &worker, exception_ptr &eptr)
-{
-	try
+	vector<Eigen::MatrixXd> upgrades(cur_lams.size());
+	Eigen::MatrixXd lam_mat;
+	for (int ilam = 0; ilam < cur_lams.size(); ilam++)
 	{
-		worker.work(id, iter, cur_lam);
+		Eigen::VectorXd ivec = ((Eigen::VectorXd::Ones(s2.size()) * (cur_lams[ilam] + 1.0)) + s2).cwiseInverse();
+		lam_mat = ivec.cwiseProduct(sv).asDiagonal() * X1;
+		if (Vt_x6.size() > 0)
+			lam_mat += ivec.asDiagonal() * Vt_x6;
+		upgrades[ilam] = -1.0 * (pd_V * lam_mat).transpose();
+		ss.str("");
+		ss << "upgrade_lam" << ilam;
+		upgrade_utils::save_mat(verbose_level, thread_id, iter, t_count, ss.str(), upgrades[ilam]);
 	}
-	catch (...)
+	
 	{
-		eptr = current_exception();
+		lock_guard<mutex> put_guard(put_lock);
+		for (int ilam = 0; ilam < cur_lams.size(); ilam++)
+			pe_upgrades[ilam].add_2_cols_ip(ws.par_idxs, upgrades[ilam]);
 	}
-	
-	return;
 }
 
 
-ParameterEnsemble IterEnsembleSmoother::calc_localized_upgrade_threaded(double cur_lam, unordered_map<string, pair<vector<string>, vector<string>>> &loc_map)
+vector<ParameterEnsemble> IterEnsembleSmoother::calc_localized_upgrade_threaded(const vector<double> &cur_lams, unordered_map<string, pair<vector<string>, vector<string>>> &loc_map)
 {
 	stringstream ss;
+	PerformanceLog::Scope scope(performance_log, "ies localized upgrade");
 	
 	ObservationEnsemble oe_upgrade(oe.get_pest_scenario_ptr(), &rand_gen, oe.get_eigen(vector<string>(), act_obs_names, false), oe.get_real_names(), act_obs_names);
 	ParameterEnsemble pe_upgrade(pe.get_pest_scenario_ptr(),&rand_gen, pe.get_eigen(vector<string>(), act_par_names, false), pe.get_real_names(), act_par_names);
@@ -2319,10 +2363,8 @@ ParameterEnsemble IterEnsembleSmoother::calc_localized_upgrade_threaded(double c
 		loc_map["all"] = p;
 	}
 	
-	//prep the fast look par cov info
-	message(2, "preparing fast-look containers for threaded localization solve");
-	unordered_map<string, double> parcov_inv_map;
-	parcov_inv_map.reserve(pe_upgrade.shape().second);
+	//prep the dense containers for the threaded solve - the workers gather the columns of each case by index
+	message(2, "preparing dense containers for threaded localization solve");
 	Eigen::VectorXd parcov_inv;// = parcov.get(par_names).inv().e_ptr()->toDense().cwiseSqrt().asDiagonal();
 	if (!parcov.isdiagonal())
 	{
@@ -2342,32 +2384,15 @@ ParameterEnsemble IterEnsembleSmoother::calc_localized_upgrade_threaded(double c
 	parcov_inv = parcov_inv.cwiseSqrt().cwiseInverse();
 
 	vector<string> par_names = pe_upgrade.get_var_names();
-	for (int i = 0; i < parcov_inv.size(); i++)
-		parcov_inv_map[par_names[i]] = parcov_inv[i];
 
-
-	//prep the fast lookup weights info
-	unordered_map<string, double> weight_map;
-	weight_map.reserve(oe_upgrade.shape().second);
 	vector<string> obs_names = oe_upgrade.get_var_names();
-	double w;
+	Eigen::VectorXd weights(obs_names.size());
 	for (int i = 0; i < obs_names.size(); i++)
 	{
-		w = pest_scenario.get_observation_info_ptr()->get_weight(obs_names[i]);
 		//don't want to filter on weight here - might be changing weights, etc...
-		//if (w == 0.0)
-		//	continue;
-		weight_map[obs_names[i]] = w;
+		weights[i] = pest_scenario.get_observation_info_ptr()->get_weight(obs_names[i]);
 	}
 	
-	//prep a fast look for obs, par and resid matrices - stored as column vectors in a map
-	unordered_map<string, Eigen::VectorXd> par_resid_map, obs_resid_map, Am_map;
-	unordered_map<string, Eigen::VectorXd> par_diff_map, obs_diff_map;
-	par_resid_map.reserve(par_names.size());
-	par_diff_map.reserve(par_names.size());
-	Am_map.reserve(par_names.size());
-	obs_resid_map.reserve(obs_names.size());
-	obs_diff_map.reserve(obs_names.size());
 	
 	//check for the 'center_on' real - it may have been dropped...
 	string center_on = pest_scenario.get_pestpp_options().get_ies_center_on();
@@ -2387,125 +2412,48 @@ ParameterEnsemble IterEnsembleSmoother::calc_localized_upgrade_threaded(double c
 		}
 	}
 
-	Eigen::MatrixXd mat = ph.get_obs_resid_subset(oe_upgrade);
-	for (int i = 0; i < obs_names.size(); i++)
-	{
-		obs_resid_map[obs_names[i]] = mat.col(i);
-	}
-	mat = oe_upgrade.get_eigen_anomalies(center_on);
-	for (int i = 0; i < obs_names.size(); i++)
-	{
-		obs_diff_map[obs_names[i]] = mat.col(i);
-	}
-	mat = ph.get_par_resid_subset(pe_upgrade);
-	for (int i = 0; i <par_names.size(); i++)
-	{
-		par_resid_map[par_names[i]] = mat.col(i);
-	}	
-	mat = pe_upgrade.get_eigen_anomalies(center_on);
-	for (int i = 0; i <par_names.size(); i++)
-	{
-		par_diff_map[par_names[i]] = mat.col(i);
-	}
+	//(num_reals x num vars), column major, so each var is one contiguous column
+	Eigen::MatrixXd obs_resid = ph.get_obs_resid_subset(oe_upgrade);
+	Eigen::MatrixXd obs_diff = oe_upgrade.get_eigen_anomalies(center_on);
+	Eigen::MatrixXd par_resid = ph.get_par_resid_subset(pe_upgrade);
+	Eigen::MatrixXd par_diff = pe_upgrade.get_eigen_anomalies(center_on);
+	Eigen::MatrixXd Am_t;
 	if (!pest_scenario.get_pestpp_options().get_ies_use_approx())
 	{
-		mat = get_Am(pe_upgrade.get_real_names(), pe_upgrade.get_var_names());
-		for (int i = 0; i < par_names.size(); i++)
-		{
-			Am_map[par_names[i]] = mat.row(i);
-		}
+		Am_t = get_Am(pe_upgrade.get_real_names(), pe_upgrade.get_var_names()).transpose();
 	}
-	mat.resize(0, 0);
-	// clear the upgrade ensemble
+	scope.add_counter("cases", loc_map.size());
+	scope.add_counter("pars", par_names.size());
+	scope.add_counter("obs", obs_names.size());
+	scope.add_counter("reals", par_resid.rows());
+	// clear the upgrade ensemble - one per lambda, all filled from the same factorization of each case
 	pe_upgrade.set_zeros();
+	vector<ParameterEnsemble> pe_upgrades(cur_lams.size(), pe_upgrade);
 	Localizer::How _how = localizer.get_how();
-	LocalUpgradeThread worker(performance_log, par_resid_map, par_diff_map, obs_resid_map, obs_diff_map,
-		localizer, parcov_inv_map, weight_map, pe_upgrade, loc_map, Am_map, _how);
+	LocalUpgradeThread worker(performance_log, par_resid, par_diff, obs_resid, obs_diff, Am_t,
+		parcov_inv, weights, par_names, obs_names, localizer, pe_upgrades, loc_map, _how);
 
 	if ((num_threads < 1) || (loc_map.size() == 1))
 	//if (num_threads < 1)
 	{
-		worker.work(0, iter, cur_lam);
+		worker.work(0, iter, cur_lams);
 	}
 	else
 	{
 		Eigen::setNbThreads(1);
-		vector<thread> threads;
-		vector<exception_ptr> exception_ptrs;
 		message(2, "launching threads");
-		
-		for (int i = 0; i <num_threads; i++)
-		{
-			exception_ptrs.push_back(exception_ptr());
-		}
-
+		ThreadPool pool(num_threads);
+		vector<future<void>> futures;
 		for (int i = 0; i < num_threads; i++)
 		{
-			//threads.push_back(thread(&LocalUpgradeThread::work, &worker, i, iter, cur_lam));
-			
-			threads.push_back(thread(upgrade_thread_function, i, iter, cur_lam, std::ref(worker),std::ref( exception_ptrs[i])));
-			
-		}
-		message(2, "waiting to join threads");
-		//for (auto &t : threads)
-		//	t.join();
-		ss.str("");
-		int num_exp = 0;
-
-		for (int i = 0; i < num_threads; ++i)
-		{
-			bool found = false;
-			if (exception_ptrs[i])
-			{
-				found = true;
-				num_exp++;
-				try
-				{
-					rethrow_exception(exception_ptrs[i]);
-				}
-				catch (const std::exception& e)
-				{
-					//ss.str("");
-					ss << " thread " << i << "raised an exception: " << e.what();
-					//throw runtime_error(ss.str());
-				}
-				catch (...)
-				{
-					//ss.str("");
-					ss << " thread " << i << "raised an exception";
-					//throw runtime_error(ss.str());
-				}
-			}
-			threads[i].join();
-			if ((exception_ptrs[i]) && (!found))
-			{
-				num_exp++;
-				try
-				{
-					rethrow_exception(exception_ptrs[i]);
-				}
-				catch (const std::exception& e)
-				{
-					//ss.str("");
-					ss << " thread " << i << "raised an exception: " << e.what();
-					//throw runtime_error(ss.str());
-				}
-				catch (...)
-				{
-					//ss.str("");
-					ss << " thread " << i << "raised an exception: ";
-					//throw runtime_error(ss.str());
-				}
-			}
-		}
-		if (num_exp > 0)
-		{
-			throw runtime_error(ss.str());
+			futures.push_back(pool.submit([&worker, i, this, &cur_lams]() { worker.work(i, iter, cur_lams); }));
 		}
+		message(2, "waiting for upgrade tasks");
+		ThreadPool::wait_all(futures, "upgrade");
 		message(2, "threaded localized upgrade calculation done");
 	}
 	
-	return pe_upgrade;
+	return pe_upgrades;
 }
 
 
@@ -2555,16 +2503,17 @@ void IterEnsembleSmoother::update_reals_by_phi(ParameterEnsemble &_pe, Observati
 	
 	for (int i = 0; i < pe_base_names.size(); i++)
 		pe_idx_to_name[i] = pe_base_names[i];
-	//store map of current phi values
-	ph.update(oe, pe);
+	//store map of the new phi values
+	ph.update(_oe, _pe);
 	L2PhiHandler::phiType pt = L2PhiHandler::phiType::COMPOSITE;
 	map<string, double> *phi_map = ph.get_phi_map(pt);
-	map<string, double> cur_phi_map;
+	map<string, double> new_phi_map;
 	for (auto p : *phi_map)
-		cur_phi_map[p.first] = p.second;
+		new_phi_map[p.first] = p.second;
 
-	//now get a phi map of the new phi values
-	ph.update(_oe, _pe);
+	//now get a phi map of the current phi values - this goes last so the final update only
+	//needs to recompute the replaced realizations
+	ph.update(oe, pe);
 	phi_map = ph.get_phi_map(pt);
 	
 	double acc_fac = pest_scenario.get_pestpp_options().get_ies_accept_phi_fac();
@@ -2572,11 +2521,12 @@ void IterEnsembleSmoother::update_reals_by_phi(ParameterEnsemble &_pe, Observati
 	string oname, pname;
 	Eigen::VectorXd real;
 	stringstream ss;
+	vector<int> changed_rows;
 	for (int i=0;i<_oe.shape().first;i++)
 	{
 		oname = oe_names[i];
-		new_phi = phi_map->at(oname);
-		cur_phi = cur_phi_map.at(oname);
+		new_phi = new_phi_map.at(oname);
+		cur_phi = phi_map->at(oname);
 		if (new_phi < cur_phi * acc_fac)
 		{
 			//pname = pe_names[i];
@@ -2592,15 +2542,17 @@ void IterEnsembleSmoother::update_reals_by_phi(ParameterEnsemble &_pe, Observati
 			pe.update_real_ip(pname, real);
 			real = _oe.get_real_vector(oname);
 			oe.update_real_ip(oname, real);
+			changed_rows.push_back(oe_name_to_idx[oname]);
 		}
 	}
-	ph.update(oe, pe);
+	ph.update(oe, pe, &changed_rows);
 
 }
 
 bool IterEnsembleSmoother::solve_new()
 {
 	stringstream ss;
+	PerformanceLog::Scope scope(performance_log, "ies solve");
 	ofstream &frec = file_manager.rec_ofstream();
 	if (pe.shape().first <= error_min_reals)
 	{
@@ -2650,16 +2602,18 @@ bool IterEnsembleSmoother::solve_new()
 	}
 
 
+	//the upgrades for all the lambdas come out of one pass over the localization cases
+	vector<double> cur_lams;
 	for (auto &lam_mult : lam_mults)
+		cur_lams.push_back(last_best_lam * lam_mult);
+	message(1, "starting upgrade calcs for lambdas: ", cur_lams);
+	message(2, "see .log file for more details");
+	vector<ParameterEnsemble> pe_upgrades = calc_localized_upgrade_threaded(cur_lams, loc_map);
+
+	for (int ilam = 0; ilam < cur_lams.size(); ilam++)
 	{
-		ss.str("");
-		double cur_lam = last_best_lam * lam_mult;
-		ss << "starting calcs for lambda" << cur_lam;
-		message(1, "starting lambda calcs for lambda", cur_lam);
-		message(2, "see .log file for more details");
-		ParameterEnsemble pe_upgrade;
-		
-		pe_upgrade = calc_localized_upgrade_threaded(cur_lam, loc_map);
+		double cur_lam = cur_lams[ilam];
+		ParameterEnsemble &pe_upgrade = pe_upgrades[ilam];
 
 		for (auto sf : pest_scenario.get_pestpp_options().get_lambda_scale_vec())
 		{
@@ -2679,7 +2633,12 @@ bool IterEnsembleSmoother::solve_new()
 			ss.str("");
 			ss << file_manager.get_base_filename() << "." << iter << "." << cur_lam << ".lambda." << sf << ".scale.par";
 
-			if (pest_scenario.get_pestpp_options().get_ies_save_binary())
+			if (pest_scenario.get_pestpp_options().get_ies_save_columnar())
+			{
+				ss << ".ecb";
+				pe_lam_scale.to_columnar(ss.str(), pest_scenario.get_pestpp_options().get_ies_columnar_float32());
+			}
+			else if (pest_scenario.get_pestpp_options().get_ies_save_binary())
 			{
 				ss << ".jcb";
 				pe_lam_scale.to_binary(ss.str());
@@ -2717,6 +2676,7 @@ bool IterEnsembleSmoother::solve_new()
 	message(1, "last stdev: ", last_best_std);
 
 	ObservationEnsemble oe_lam_best;
+	vector<int> unchanged;
 	bool echo = false;
 	if (verbose_level > 1)
 		echo = true;
@@ -2731,7 +2691,12 @@ bool IterEnsembleSmoother::solve_new()
 			ss.str("");
 			ss << file_manager.get_base_filename() << "." << iter << "." << lam_vals[i] << ".lambda." << scale_vals[i] << ".scale.obs";
 
-			if (pest_scenario.get_pestpp_options().get_ies_save_binary())
+			if (pest_scenario.get_pestpp_options().get_ies_save_columnar())
+			{
+				ss << ".ecb";
+				oe_lams[i].to_columnar(ss.str(), pest_scenario.get_pestpp_options().get_ies_columnar_float32());
+			}
+			else if (pest_scenario.get_pestpp_options().get_ies_save_binary())
 			{
 				ss << ".jcb";
 				oe_lams[i].to_binary(ss.str());
@@ -2751,7 +2716,8 @@ bool IterEnsembleSmoother::solve_new()
 			continue;
 		}
 		
-		ph.update(oe_lams[i], pe_lams[i]);
+		//drop_bad_phi() already computed phi for this lambda
+		ph.update(oe_lams[i], pe_lams[i], &unchanged);
 		
 		message(0, "phi summary for lambda, scale fac:", vals,echo);
 		ph.report(echo);
@@ -2889,16 +2855,20 @@ bool IterEnsembleSmoother::solve_new()
 		performance_log->log_event("assembling ensembles");
 		pe_lams[best_idx].drop_rows(pe_keep_names);
 		pe_lams[best_idx].append_other_rows(remaining_pe_lam);
-		//append the remaining obs en
+		//append the remaining obs en - only these rows need new phi, the subset rows were
+		//evaluated for this lambda above
+		vector<int> remaining_rows;
+		for (int i = 0; i < remaining_oe_lam.shape().first; i++)
+			remaining_rows.push_back(oe_lam_best.shape().first + i);
 		oe_lam_best.append_other_rows(remaining_oe_lam);
 		assert(pe_lams[best_idx].shape().first == oe_lam_best.shape().first);
-		drop_bad_phi(pe_lams[best_idx], oe_lam_best);
+		drop_bad_phi(pe_lams[best_idx], oe_lam_best, false, &remaining_rows);
 		if (oe_lam_best.shape().first == 0)
 		{
 			throw_ies_error(string("all realization dropped after finishing subset runs...something might be wrong..."));
 		}
 		performance_log->log_event("updating phi");
-		ph.update(oe_lam_best, pe_lams[best_idx]);
+		ph.update(oe_lam_best, pe_lams[best_idx], &unchanged);
 		best_mean = ph.get_mean(L2PhiHandler::phiType::COMPOSITE);
 		best_std = ph.get_std(L2PhiHandler::phiType::COMPOSITE);
 		message(1, "phi summary for entire ensemble using lambda,scale_fac ", vector<double>({ lam_vals[best_idx],scale_vals[best_idx] }));
@@ -2912,7 +2882,7 @@ bool IterEnsembleSmoother::solve_new()
 		
 	}
 
-	ph.update(oe_lam_best, pe_lams[best_idx]);
+	ph.update(oe_lam_best, pe_lams[best_idx], &unchanged);
 	best_mean = ph.get_mean(L2PhiHandler::phiType::COMPOSITE);
 	best_std = ph.get_std(L2PhiHandler::phiType::COMPOSITE);
 	message(1, "last best mean phi * acceptable phi factor: ", last_best_mean * acc_fac);
@@ -2955,7 +2925,7 @@ bool IterEnsembleSmoother::solve_new()
 		//message(0, "not updating parameter ensemble");
 		message(0, "only updating realizations with reduced phi");
 		update_reals_by_phi(pe_lams[best_idx], oe_lam_best);
-		ph.update(oe, pe);
+		ph.update(oe, pe, &unchanged);
 		//re-check phi
 		best_mean = ph.get_mean(L2PhiHandler::phiType::COMPOSITE);
 		best_std = ph.get_std(L2PhiHandler::phiType::COMPOSITE);
@@ -3000,7 +2970,12 @@ void IterEnsembleSmoother::report_and_save()
 	cout << "   number of model runs:            " << run_mgr_ptr->get_total_runs() << endl;
 
 	stringstream ss;
-	if (pest_scenario.get_pestpp_options().get_ies_save_binary())
+	if (pest_scenario.get_pestpp_options().get_ies_save_columnar())
+	{
+		ss << file_manager.get_base_filename() << "." << iter << ".obs.ecb";
+		oe.to_columnar(ss.str(), pest_scenario.get_pestpp_options().get_ies_columnar_float32());
+	}
+	else if (pest_scenario.get_pestpp_options().get_ies_save_binary())
 	{
 		ss << file_manager.get_base_filename() << "." << iter << ".obs.jcb";
 		oe.to_binary(ss.str());
@@ -3013,7 +2988,12 @@ void IterEnsembleSmoother::report_and_save()
 	frec << "      current obs ensemble saved to " << ss.str() << endl;
 	cout << "      current obs ensemble saved to " << ss.str() << endl;
 	ss.str("");
-	if (pest_scenario.get_pestpp_options().get_ies_save_binary())
+	if (pest_scenario.get_pestpp_options().get_ies_save_columnar())
+	{
+		ss << file_manager.get_base_filename() << "." << iter << ".par.ecb";
+		pe.to_columnar(ss.str(), pest_scenario.get_pestpp_options().get_ies_columnar_float32());
+	}
+	else if (pest_scenario.get_pestpp_options().get_ies_save_binary())
 	{
 		ss << file_manager.get_base_filename() << "." << iter << ".par.jcb";
 		pe.to_binary(ss.str());
@@ -3183,6 +3163,9 @@ vector<ObservationEnsemble> IterEnsembleSmoother::run_lambda_ensembles(vector<Pa
 	stringstream ss;
 	ss << "queuing " << pe_lams.size() << " ensembles";
 	performance_log->log_event(ss.str());
+	PerformanceLog::Scope scope(performance_log, "ies run_lambda_ensembles");
+	for (auto &pe_lam : pe_lams)
+		scope.add_counter("runs", pe_lam.shape().first);
 	run_mgr_ptr->reinitialize();
 	
 	set_subset_idx(pe_lams[0].shape().first);
@@ -3317,6 +3300,8 @@ vector<int> IterEnsembleSmoother::run_ensemble(ParameterEnsemble &_pe, Observati
 	stringstream ss;
 	ss << "queuing " << _pe.shape().first << " runs";
 	performance_log->log_event(ss.str());
+	PerformanceLog::Scope scope(performance_log, "ies run_ensemble");
+	scope.add_counter("runs", (real_idxs.size() > 0) ? real_idxs.size() : _pe.shape().first);
 	run_mgr_ptr->reinitialize();
 	map<int, int> real_run_ids;
 	try
@@ -24,44 +24,57 @@ class LocalUpgradeThread
 {
 public:
 
-	LocalUpgradeThread(PerformanceLog *_performance_log, unordered_map<string, Eigen::VectorXd> &_par_resid_map, unordered_map<string, Eigen::VectorXd> &_par_diff_map,
-		unordered_map<string, Eigen::VectorXd> &_obs_resid_map, unordered_map<string, Eigen::VectorXd> &_obs_diff_map,
-		Localizer &_localizer, unordered_map<string, double> &_parcov_inv_map,
-		unordered_map<string, double> &_weight_map, ParameterEnsemble &_pe_upgrade,
-		unordered_map<string, pair<vector<string>, vector<string>>> &_cases,
-		unordered_map<string, Eigen::VectorXd> &_Am_map, Localizer::How &_how);
-
-	//Eigen::DiagonalMatrix<double, Eigen::Dynamic> get_matrix_from_map(vector<string> &names, map<string, double> &dmap);	
-	//Eigen::MatrixXd get_matrix_from_map(int num_reals, vector<string> &names, map<string, Eigen::VectorXd> &emap);
-
-
-	void work(int thread_id, int iter, double cur_lam);
+	//the ensemble quantities are dense (num_reals x num vars) matrices with their columns ordered
+	//as par_names/obs_names and Am_t is (Am cols x num pars).  these are only read by the workers
+	LocalUpgradeThread(PerformanceLog *_performance_log, const Eigen::MatrixXd &_par_resid, const Eigen::MatrixXd &_par_diff,
+		const Eigen::MatrixXd &_obs_resid, const Eigen::MatrixXd &_obs_diff, const Eigen::MatrixXd &_Am_t,
+		const Eigen::VectorXd &_parcov_inv, const Eigen::VectorXd &_weights,
+		const vector<string> &par_names, const vector<string> &obs_names,
+		Localizer &_localizer, vector<ParameterEnsemble> &_pe_upgrades,
+		unordered_map<string, pair<vector<string>, vector<string>>> &_cases, Localizer::How &_how);
+
+	//each case is factored once and its upgrade for cur_lams[i] is added to pe_upgrades[i].
+	//work() claims cases until none are left; work_case() solves just case icase (0 to
+	//get_num_cases() - 1), so each case can be submitted as its own task.  use one or the other
+	//for a given instance
+	void work(int thread_id, int iter, const vector<double> &cur_lams);
+	void work_case(int icase, int iter, const vector<double> &cur_lams);
+	int get_num_cases() const { return total; }
 
 
 private:
+	//per-worker scratch, reused (and only ever grown) across the cases a worker solves
+	struct Workspace
+	{
+		vector<int> par_idxs, obs_idxs;
+		vector<double> par_resid_buf, par_diff_buf, obs_resid_buf, obs_diff_buf, am_buf;
+		Eigen::MatrixXd obs_diff_s, par_diff_s;
+		Eigen::VectorXd loc, weights_s, parcov_inv_s;
+	};
+
 	PerformanceLog * performance_log;
 	Localizer::How how;
 	vector<string> keys;
 	int count, total;
-	//double eigthresh, cur_lam;
-	//int maxsing, num_reals,iter, thread_id;
-	//bool use_approx, use_prior_scaling;
+	double eigthresh;
+	int maxsing, num_reals, verbose_level;
+	bool use_approx, use_prior_scaling, loc_by_obs;
 
 	unordered_map<string, pair<vector<string>, vector<string>>> &cases;
 
-	ParameterEnsemble &pe_upgrade;
+	vector<ParameterEnsemble> &pe_upgrades;
 	//PhiHandler &ph;
 	Localizer &localizer;
-	unordered_map<string, double> &parcov_inv_map;
-	unordered_map<string, double> &weight_map;
-
-	unordered_map<string, Eigen::VectorXd> &par_resid_map, &par_diff_map, &Am_map;
-	unordered_map<string, Eigen::VectorXd> &obs_resid_map, &obs_diff_map;
+	const Eigen::MatrixXd &par_resid, &par_diff, &obs_resid, &obs_diff, &Am_t;
+	const Eigen::VectorXd &parcov_inv, &weights;
+	//par/obs name to column in the matrices above
+	unordered_map<string, int> par_idx_map, obs_idx_map;
 
-	mutex ctrl_lock, weight_lock, loc_lock, parcov_lock;
-	mutex obs_resid_lock, obs_diff_lock, par_resid_lock;
-	mutex par_diff_lock, am_lock, put_lock;
+	mutex put_lock;
 	mutex next_lock;
+
+	void log_progress();
+	void solve_case(int thread_id, int iter, int icase, const vector<double> &cur_lams, Workspace &ws);
 	
 };
 
@@ -128,11 +141,13 @@ private:
 	Eigen::DiagonalMatrix<double,Eigen::Dynamic> obscov_inv_sqrt, parcov_inv_sqrt;
 
 	bool oe_drawn, pe_drawn;
+	//the prior par ensemble was streamed to ies_draw_stream_file - nothing else to do
+	bool pe_streamed;
 
 	//bool solve_old();
 	bool solve_new();
 
-	ParameterEnsemble calc_localized_upgrade_threaded(double cur_lam, unordered_map<string, pair<vector<string>, vector<string>>> &loc_map);
+	vector<ParameterEnsemble> calc_localized_upgrade_threaded(const vector<double> &cur_lams, unordered_map<string, pair<vector<string>, vector<string>>> &loc_map);
 
 	vector<int> run_ensemble(ParameterEnsemble &_pe, ObservationEnsemble &_oe, const vector<int> &real_idxs=vector<int>());
 	vector<ObservationEnsemble> run_lambda_ensembles(vector<ParameterEnsemble> &pe_lams, vector<double> &lam_vals, vector<double> &scale_vals);
@@ -144,7 +159,8 @@ private:
 	void initialize_restart();
 	void initialize_parcov();
 	void initialize_obscov();
-	void drop_bad_phi(ParameterEnsemble &_pe, ObservationEnsemble &_oe, bool is_subset=false);
+	//changed_rows are passed through to L2PhiHandler::update()
+	void drop_bad_phi(ParameterEnsemble &_pe, ObservationEnsemble &_oe, bool is_subset=false, const vector<int> *changed_rows=nullptr);
 	template<typename T, typename A>
 	void message(int level, const string &_message, vector<T, A> _extras, bool echo=true);
 	void message(int level, const string &_message);
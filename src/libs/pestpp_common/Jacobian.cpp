@@ -254,6 +254,11 @@ bool Jacobian::build_runs(Parameters &ctl_pars, Observations &ctl_obs, vector<st
 	Parameters numeric_pars = par_transform.ctl2numeric_cp(ctl_pars);
 
 	vector<double> del_numeric_par_vec;
+	//the perturbed runs are collected (row-major, in run storage parameter order) and queued as one batch
+	const vector<string> &run_par_names = run_manager.get_par_name_vec();
+	vector<double> run_pars;
+	vector<string> run_info_txt;
+	vector<double> run_info_value;
 	for (const auto &ipar_name : numeric_par_names)
 	{
 		debug_print(ipar_name);
@@ -269,7 +274,10 @@ bool Jacobian::build_runs(Parameters &ctl_pars, Observations &ctl_obs, vector<st
 			{
 				numeric_parameters.update_rec(ipar_name, ipar_val);
 				Parameters model_parameters = par_transform.numeric2model_cp(numeric_parameters);
-				run_manager.add_run(model_parameters, ipar_name, ipar_val);
+				vector<double> run_vec = model_parameters.get_data_vec(run_par_names);
+				run_pars.insert(run_pars.end(), run_vec.begin(), run_vec.end());
+				run_info_txt.push_back(ipar_name);
+				run_info_value.push_back(ipar_val);
 			}
 		}
 		else
@@ -280,6 +288,9 @@ bool Jacobian::build_runs(Parameters &ctl_pars, Observations &ctl_obs, vector<st
 			failed_parameter_names.insert(ipar_name);
 		}
 	}
+	Eigen::MatrixXd run_par_mat = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(run_pars.data(),
+		run_info_txt.size(), run_par_names.size());
+	run_manager.add_runs(run_par_mat, run_info_txt, run_info_value);
 	debug_print(failed_parameter_names);
 	debug_msg("Jacobian::build_runs method: end");
 	
@@ -77,7 +77,11 @@ bool Jacobian_1to1::build_runs(Parameters &ctl_pars, Observations &ctl_obs, vect
 	Parameters base_derivative_parameters = par_transform.numeric2active_ctl_cp(base_numeric_parameters);
 	Parameters base_model_parameters = par_transform.numeric2model_cp(base_numeric_parameters);
 	//Loop through derivative parameters and build the parameter sets necessary for computing the jacobian
-	
+	//the perturbed runs are collected (row-major, in run storage parameter order) and queued as one batch
+	const vector<string> &run_par_names = run_manager.get_par_name_vec();
+	vector<double> run_pars;
+	vector<string> run_info_txt;
+	vector<double> run_info_value;
 	for (auto &i_name : numeric_par_names)
 	{
 		assert(base_derivative_parameters.find(i_name) != base_derivative_parameters.end());
@@ -97,11 +101,10 @@ bool Jacobian_1to1::build_runs(Parameters &ctl_pars, Observations &ctl_obs, vect
 				{
 					model_parameters[ipar.first] = ipar.second;
 				}
-				int id = run_manager.add_run(model_parameters, i_name, par);
-				if (par_run_map.count(i_name) == 0)
-					par_run_map[i_name] = vector<int>{ id };
-				else
-					par_run_map[i_name].push_back(id);
+				vector<double> run_vec = model_parameters.get_data_vec(run_par_names);
+				run_pars.insert(run_pars.end(), run_vec.begin(), run_vec.end());
+				run_info_txt.push_back(i_name);
+				run_info_value.push_back(par);
 				//reset the perturbed parameters back to the values associated with the base condition
 				for (const auto &ipar : new_pars)
 				{
@@ -117,6 +120,11 @@ bool Jacobian_1to1::build_runs(Parameters &ctl_pars, Observations &ctl_obs, vect
 			failed_to_increment_parmaeters.insert(i_name, derivative_par_value);
 		}
 	}
+	Eigen::MatrixXd run_par_mat = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(run_pars.data(),
+		run_info_txt.size(), run_par_names.size());
+	vector<int> run_ids = run_manager.add_runs(run_par_mat, run_info_txt, run_info_value);
+	for (int i = 0; i < run_ids.size(); i++)
+		par_run_map[run_info_txt[i]].push_back(run_ids[i]);
 	output_file_writer_ptr->write_jco_run_id(run_manager.get_cur_groupid(), par_run_map);
 	ofstream &fout_restart = file_manager.get_ofstream("rst");
 	debug_print(failed_parameter_names);
@@ -157,7 +165,11 @@ bool Jacobian_1to1::build_runs(ModelRun &init_model_run, vector<string> numeric_
 	Parameters base_derivative_parameters = par_transform.numeric2active_ctl_cp(base_numeric_parameters);
 	Parameters base_model_parameters = par_transform.numeric2model_cp(base_numeric_parameters);
 	//Loop through derivative parameters and build the parameter sets necessary for computing the jacobian
-	
+	//the perturbed runs are collected (row-major, in run storage parameter order) and queued as one batch
+	const vector<string> &run_par_names = run_manager.get_par_name_vec();
+	vector<double> run_pars;
+	vector<string> run_info_txt;
+	vector<double> run_info_value;
 	for (auto &i_name : numeric_par_names)
 	{
 		assert(base_derivative_parameters.find(i_name) != base_derivative_parameters.end());
@@ -177,12 +189,10 @@ bool Jacobian_1to1::build_runs(ModelRun &init_model_run, vector<string> numeric_
 				{
 					model_parameters[ipar.first] = ipar.second;
 				}
-				int id = run_manager.add_run(model_parameters, i_name, par);
-
-				if (par_run_map.count(i_name) == 0)
-					par_run_map[i_name] = vector<int>{ id };
-				else
-					par_run_map[i_name].push_back(id);
+				vector<double> run_vec = model_parameters.get_data_vec(run_par_names);
+				run_pars.insert(run_pars.end(), run_vec.begin(), run_vec.end());
+				run_info_txt.push_back(i_name);
+				run_info_value.push_back(par);
 				//reset the perturbed parameters back to the values associated with the base condition
 				for (const auto &ipar : new_pars)
 				{
@@ -198,6 +208,11 @@ bool Jacobian_1to1::build_runs(ModelRun &init_model_run, vector<string> numeric_
 			failed_to_increment_parmaeters.insert(i_name, derivative_par_value);
 		}
 	}
+	Eigen::MatrixXd run_par_mat = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(run_pars.data(),
+		run_info_txt.size(), run_par_names.size());
+	vector<int> run_ids = run_manager.add_runs(run_par_mat, run_info_txt, run_info_value);
+	for (int i = 0; i < run_ids.size(); i++)
+		par_run_map[run_info_txt[i]].push_back(run_ids[i]);
 	output_file_writer_ptr->write_jco_run_id(run_manager.get_cur_groupid(), par_run_map);
 
 	ofstream &fout_restart = file_manager.get_ofstream("rst");
@@ -2,6 +2,7 @@
 #include <iomanip>
 #include <unordered_set>
 #include <iterator>
+#include <algorithm>
 #include "Ensemble.h"
 #include "RestartController.h"
 #include "utilities.h"
@@ -12,6 +13,7 @@
 #include "PerformanceLog.h"
 #include "system_variables.h"
 #include "Localizer.h"
+#include "ThreadPool.h"
 
 bool Localizer::initialize(PerformanceLog *performance_log, bool forgive_missing)
 {
@@ -112,9 +114,11 @@ void Localizer::process_mat(PerformanceLog *performance_log, bool forgive_missin
 	for (int i=0;i<mat.nrow();i++)
 	{
 		o = row_names[i];
+		//obs_map only holds the rows that are kept, so its size is the row index after any missing
+		//rows are dropped
 		if (obs_names.find(o) != obs_names.end())
 		{
-			obs2row_map[o] = i;
+			obs2row_map[o] = obs_map.size();
 			obs_map.push_back(vector<string>{o});
 			if (dup_check.find(o) != dup_check.end())
 				dups.push_back(o);
@@ -127,7 +131,7 @@ void Localizer::process_mat(PerformanceLog *performance_log, bool forgive_missin
 				throw runtime_error("Localizer::process_mat() error: listed observation group '" + o + "' has no non-zero weight observations");
 			for (auto &oo : obgnme_map[o])
 			{
-				obs2row_map[oo] = i;
+				obs2row_map[oo] = obs_map.size() - 1;
 				if (dup_check.find(oo) != dup_check.end())
 					dups.push_back(oo);
 				dup_check.emplace(oo);
@@ -189,7 +193,7 @@ void Localizer::process_mat(PerformanceLog *performance_log, bool forgive_missin
 		p = col_names[i];
 		if (par_names.find(p) != par_names.end())
 		{
-			par2col_map[p] = i;
+			par2col_map[p] = par_map.size();
 			par_map.push_back(vector<string>{p});
 			if (dup_check.find(p) != dup_check.end())
 				dups.push_back(p);
@@ -202,7 +206,7 @@ void Localizer::process_mat(PerformanceLog *performance_log, bool forgive_missin
 				throw runtime_error("Localizer::process_mat() error:  listed parameter group '" + p + "' has no adjustable parameters");
 			for (auto &pp : pargp_map[p])
 			{
-				par2col_map[pp] = i;
+				par2col_map[pp] = par_map.size() - 1;
 				if (dup_check.find(pp) != dup_check.end())
 					dups.push_back(pp);
 				dup_check.emplace(pp);
@@ -323,10 +327,28 @@ void Localizer::process_mat(PerformanceLog *performance_log, bool forgive_missin
 		}
 
 	}
-
+	build_index();
 	
 }
 
+void Localizer::build_index()
+{
+	row_index.clear();
+	col_index.clear();
+	vector<string> row_names = mat.get_row_names();
+	vector<string> col_names = mat.get_col_names();
+	row_index.reserve(row_names.size());
+	for (int i = 0; i < row_names.size(); i++)
+		row_index[row_names[i]] = i;
+	col_index.reserve(col_names.size());
+	for (int i = 0; i < col_names.size(); i++)
+		col_index[col_names[i]] = i;
+	loc_csc = *mat.e_ptr();
+	loc_csc.makeCompressed();
+	loc_csr = loc_csc;
+	loc_csr.makeCompressed();
+}
+
 
 void Localizer::report(ofstream &f_rec)
 {
@@ -464,42 +486,15 @@ unordered_map<string, pair<vector<string>, vector<string>>> Localizer::get_local
 	else
 	{
 		Eigen::setNbThreads(1);
-		vector<thread> threads;
-		vector<exception_ptr> exception_ptrs;
 		performance_log->log_event("launching autoadaloc threads");
-
-		for (int i = 0; i < num_threads; i++)
-		{
-			exception_ptrs.push_back(exception_ptr());
-		}
-
+		ThreadPool pool(num_threads);
+		vector<future<void>> futures;
 		for (int i = 0; i < num_threads; i++)
 		{
-			//threads.push_back(thread(&LocalUpgradeThread::work, &worker, i, iter, cur_lam));
-
-			threads.push_back(thread(aal_upgrade_thread_function, i, std::ref(worker), std::ref(exception_ptrs[i])));
-
-		}
-		performance_log->log_event("waiting to join threads");
-		//for (auto &t : threads)
-		//	t.join();
-		for (int i = 0; i < num_threads; ++i)
-		{
-			if (exception_ptrs[i])
-			{
-				try
-				{
-					rethrow_exception(exception_ptrs[i]);
-				}
-				catch (const std::exception& e)
-				{
-					ss.str("");
-					ss << "thread " << i << "raised an exception: " << e.what();
-					throw runtime_error(ss.str());
-				}
-			}
-			threads[i].join();
+			futures.push_back(pool.submit([&worker, i]() { worker.work(i); }));
 		}
+		performance_log->log_event("waiting for autoadaloc tasks");
+		ThreadPool::wait_all(futures, "autoadaloc");
 		performance_log->log_event("threaded localized upgrade calculation done");
 
 	}
@@ -588,22 +583,6 @@ unordered_map<string, pair<vector<string>, vector<string>>> Localizer::get_local
 
 
 
-void aal_upgrade_thread_function(int id, AutoAdaLocThread &worker, exception_ptr &eptr)
-{
-	try
-	{
-		worker.work(id);
-	}
-	catch (...)
-	{
-		eptr = current_exception();
-	}
-
-	return;
-}
-
-
-
 AutoAdaLocThread::AutoAdaLocThread(PerformanceLog *_performance_log, ofstream *_f_out, int _iter, int _ies_verbose, int _npar, int _nobs, vector<int> &_par_indices,
 	Eigen::MatrixXd &_pe_diff, Eigen::MatrixXd &_oe_diff, Eigen::ArrayXd &_par_std, Eigen::ArrayXd &_obs_std, vector<string> &_par_names, vector<string> &_obs_names,
 	vector<Eigen::Triplet<double>> &_triplets, double _sigma_dist,map<string,set<string>> &_list_obs): pe_diff(_pe_diff), oe_diff(_oe_diff), par_indices(_par_indices), par_std(_par_std), obs_std(_obs_std),par_names(_par_names),
@@ -639,114 +618,58 @@ void AutoAdaLocThread::work(int thread_id)
 	obs_ss_shift.resize(nreals);
 	Eigen::ArrayXd bg_cc_vec(nreals - 1);
 	set<string> sobs;
-	unique_lock<mutex> par_indices_guard(par_indices_lock, defer_lock);
-	unique_lock<mutex> oe_diff_gaurd(oe_diff_lock, defer_lock);
-	unique_lock<mutex> f_out_guard(f_out_lock, defer_lock);
-	unique_lock<mutex> triplets_guard(triplets_lock, defer_lock);
-	unique_lock<mutex>pfm_guard(pfm_lock, defer_lock);
-	unique_lock<mutex>par_names_guard(par_names_lock, defer_lock);
 	bool use_list_obs = true;
 	while (true)
 	{
-
-		while (true)
 		{
-			if (par_indices_guard.try_lock())
+			unique_lock<mutex> par_indices_guard(par_indices_lock);
+			if (par_indices.size() == 0)
 			{
-				if (par_indices.size() == 0)
-				{
-					ss.str("");
-					ss << "autoadaloc thread: " << thread_id << " processed " << pcount << " parameters ";
-					if (ies_verbose > 1)
-					{
-						cout << ss.str() << endl;
-					}
-					while (true)
-					{
-						if (pfm_guard.try_lock())
-						{
-							performance_log->log_event(ss.str());
-							pfm_guard.unlock();
-							break;
-						}
-					}
-					par_indices_guard.unlock();
-					return;
-				}
-				if (par_indices.size() % 10000 == 0)
-				{
-					ss.str("");
-					ss << "autoadaloc iter " << iter << " progress: " << par_indices.size() << " of " << npar << " parameters done";
-					while (true)
-					{
-						if (pfm_guard.try_lock())
-						{
-							performance_log->log_event(ss.str());
-							pfm_guard.unlock();
-							break;
-						}
-					}
-					if (ies_verbose > 1)
-						cout << ss.str() << endl;
-				}
-				
-				jpar = par_indices[par_indices.size() - 1];
-				par_indices.pop_back();
-				if (par_std[jpar] == 0.0)
-				{
-					par_indices_guard.unlock();
-					continue;
-				}
-				par_ss = pe_diff.col(jpar) * (1.0 / par_std[jpar]);
-				
-				if (list_obs.size() > 0)
-				{
-					sobs = list_obs[par_names[jpar]];
-					use_list_obs = true;
-				}
-				else
+				par_indices_guard.unlock();
+				ss.str("");
+				ss << "autoadaloc thread: " << thread_id << " processed " << pcount << " parameters ";
+				if (ies_verbose > 1)
 				{
-					use_list_obs = false;
+					cout << ss.str() << endl;
 				}
-				pcount++;
-				par_indices_guard.unlock();
-				break;
+				log_event(ss.str());
+				return;
 			}
+			if (par_indices.size() % 10000 == 0)
+			{
+				ss.str("");
+				ss << "autoadaloc iter " << iter << " progress: " << par_indices.size() << " of " << npar << " parameters done";
+				log_event(ss.str());
+				if (ies_verbose > 1)
+					cout << ss.str() << endl;
+			}
+			
+			jpar = par_indices[par_indices.size() - 1];
+			par_indices.pop_back();
+			if (par_std[jpar] == 0.0)
+			{
+				continue;
+			}
+			if (list_obs.size() > 0)
+			{
+				sobs = list_obs[par_names[jpar]];
+				use_list_obs = true;
+			}
+			else
+			{
+				use_list_obs = false;
+			}
+			pcount++;
 		}
+		//pe_diff, oe_diff and the name vectors are only read while the
+		//threads are running, so they dont need to be guarded
+		par_ss = pe_diff.col(jpar) * (1.0 / par_std[jpar]);
 
 		
 		string oname;
 		bool no_obs = true;
 		for (int iobs = 0; iobs < nobs; iobs++)
 		{
-			while (true)
-			{
-				/*if (oe_diff_gaurd.try_lock())
-				{
-					if (obs_std[iobs] == 0.0)
-					{
-						oe_diff_gaurd.unlock();
-						continue;
-					}
-					string oname = obs_names[iobs];
-					if ((sobs.size() > 0) && (sobs.find(oname) == sobs.end()))
-					{
-						oe_diff_gaurd.unlock();
-						continue;
-					}
-					obs_ss = oe_diff.col(iobs) * (1.0 / obs_std[iobs]);
-					oe_diff_gaurd.unlock();
-					break;*/
-				if (oe_diff_gaurd.try_lock())
-				{
-					
-					obs_ss = oe_diff.col(iobs);
-					oname = obs_names[iobs];
-					oe_diff_gaurd.unlock();
-					break;
-				}
-
-			}
 			if (obs_std[iobs] == 0.0) 
 			{
 				continue;
@@ -755,11 +678,12 @@ void AutoAdaLocThread::work(int thread_id)
 			if ((use_list_obs) && (sobs.size() == 0))
 				continue;
 
+			oname = obs_names[iobs];
 			if ((sobs.size() > 0) && (sobs.find(oname) == sobs.end()))
 			{
 				continue;
 			}
-			obs_ss = obs_ss * (1.0 / obs_std[iobs]);
+			obs_ss = oe_diff.col(iobs) * (1.0 / obs_std[iobs]);
 			cc = (par_ss.transpose() * obs_ss)[0] * scale;
 			obs_ss_shift = 1.0 * obs_ss; //force a copy
 			for (int ireal = 0; ireal < nreals - 1; ireal++)
@@ -785,33 +709,18 @@ void AutoAdaLocThread::work(int thread_id)
 			thres = bg_mean + (sign * sigma_dist * bg_std);
 			if (ies_verbose > 1)
 			{
-				
-				while (true)
-				{
-					if (f_out_guard.try_lock())
-					{
-						*f_out << obs_names[iobs] << "," << par_names[jpar] << "," << cc << "," << bg_mean << "," << bg_std << "," << thres << "," << (((sign * cc) - (sign * thres)) > 0.0);
-						for (int i = 0; i < nreals - 1; i++)
-							*f_out << "," << bg_cc_vec[i];
-						*f_out << endl;
-						f_out_guard.unlock();
-						break;
-
-					}
-				}
-				
+				lock_guard<mutex> f_out_guard(f_out_lock);
+				*f_out << obs_names[iobs] << "," << par_names[jpar] << "," << cc << "," << bg_mean << "," << bg_std << "," << thres << "," << (((sign * cc) - (sign * thres)) > 0.0);
+				for (int i = 0; i < nreals - 1; i++)
+					*f_out << "," << bg_cc_vec[i];
+				*f_out << endl;
 			}
 			if (((sign * cc) - (sign * thres)) > 0.0)
 			{
 				//cout << par_names[jpar] << " " << obs_names[iobs] << " " << cc << " " << bg_mean << " " << bg_std << " " << thres << " kept " << endl;
-				while (true)
 				{
-					if (triplets_guard.try_lock())
-					{
-						triplets.push_back(Eigen::Triplet<double>(iobs, jpar, cc));
-						triplets_guard.unlock();
-						break;
-					}
+					lock_guard<mutex> triplets_guard(triplets_lock);
+					triplets.push_back(Eigen::Triplet<double>(iobs, jpar, cc));
 				}
 				no_obs = false;
 				
@@ -821,72 +730,81 @@ void AutoAdaLocThread::work(int thread_id)
 		}
 		if (no_obs)
 		{
-			string pname;
-			while (true)
-			{
-				if (par_names_guard.try_lock())
-				{
-					pname = par_names[jpar];
-					par_names_guard.unlock();
-					break;
-				}
-			}
 			ss.str("");
 
-			ss << "autoadaloc warning: parameter " << pname << " is completely localized -it maps to no observations";
-			while (true)
-			{
-				if (pfm_guard.try_lock())
-				{
-					performance_log->log_event(ss.str());
-					pfm_guard.unlock();
-					break;
-				}
-			}
+			ss << "autoadaloc warning: parameter " << par_names[jpar] << " is completely localized -it maps to no observations";
+			log_event(ss.str());
 		}
 	}
 }
 
+void AutoAdaLocThread::log_event(const string& message)
+{
+	lock_guard<mutex> pfm_guard(pfm_lock);
+	performance_log->log_event(message);
+}
+
 
-Eigen::MatrixXd Localizer::get_localizing_obs_hadamard_matrix(int num_reals, string col_name, vector<string> &obs_names)
+namespace
 {
+	//value at (outer, inner) of compressed storage, zero if not stored
+	template<typename SparseType>
+	double compressed_coeff(const SparseType &m, int outer, int inner)
+	{
+		const int *first = m.innerIndexPtr() + m.outerIndexPtr()[outer];
+		const int *last = m.innerIndexPtr() + m.outerIndexPtr()[outer + 1];
+		const int *it = lower_bound(first, last, inner);
+		if ((it == last) || (*it != inner))
+			return 0.0;
+		return m.valuePtr()[it - m.innerIndexPtr()];
+	}
+}
 
-	vector<double> values;
-	vector<string> mat_cols = mat.get_col_names();
-	vector<string>::iterator it = find(mat_cols.begin(), mat_cols.end(), col_name);
-	if (it == mat_cols.end())
-		throw runtime_error("Localizer::get_localizing_obs_hadamard_matrix() error: col_name not found in localizer matrix: " + col_name);
-	int idx = it - mat_cols.begin();
-	Eigen::VectorXd mat_vec = mat.e_ptr()->col(idx);
-	int col_idx;
-	Eigen::MatrixXd loc(obs_names.size(), num_reals);
-	for (int i=0;i<obs_names.size();i++)
+Eigen::VectorXd Localizer::get_localizing_obs_hadamard_vector(const string &col_name, const vector<string> &obs_names) const
+{
+	auto it = col_index.find(col_name);
+	if (it == col_index.end())
+		throw runtime_error("Localizer::get_localizing_obs_hadamard_vector() error: col_name not found in localizer matrix: " + col_name);
+	int idx = it->second;
+	Eigen::VectorXd loc(obs_names.size());
+	for (int i = 0; i < obs_names.size(); i++)
 	{
-		col_idx = obs2row_map[obs_names[i]];
-		loc.row(i).setConstant(mat_vec[col_idx]);
+		auto oit = obs2row_map.find(obs_names[i]);
+		if (oit == obs2row_map.end())
+			throw runtime_error("Localizer::get_localizing_obs_hadamard_vector() error: obs not found in localizer matrix: " + obs_names[i]);
+		loc[i] = compressed_coeff(loc_csc, idx, oit->second);
 	}
 	return loc;
-
 }
 
 
-Eigen::MatrixXd Localizer::get_localizing_par_hadamard_matrix(int num_reals, string row_name, vector<string> &par_names)
+Eigen::VectorXd Localizer::get_localizing_par_hadamard_vector(const string &row_name, const vector<string> &par_names) const
 {
-
-	vector<double> values;
-	vector<string> mat_rows = mat.get_row_names();
-	vector<string>::iterator it = find(mat_rows.begin(), mat_rows.end(), row_name);
-	if (it == mat_rows.end())
-		throw runtime_error("Localizer::get_localizing_par_hadamard_matrix() error: row_name not found in localizer matrix: " + row_name);
-	int idx = it - mat_rows.begin();
-	Eigen::VectorXd mat_vec = mat.e_ptr()->row(idx);
-	int col_idx;
-	Eigen::MatrixXd loc(par_names.size(), num_reals);
-	for (int i = 0; i<par_names.size(); i++)
+	auto it = row_index.find(row_name);
+	if (it == row_index.end())
+		throw runtime_error("Localizer::get_localizing_par_hadamard_vector() error: row_name not found in localizer matrix: " + row_name);
+	int idx = it->second;
+	Eigen::VectorXd loc(par_names.size());
+	for (int i = 0; i < par_names.size(); i++)
 	{
-		col_idx = par2col_map[par_names[i]];
-		loc.row(i).setConstant(mat_vec[col_idx]);
+		auto pit = par2col_map.find(par_names[i]);
+		if (pit == par2col_map.end())
+			throw runtime_error("Localizer::get_localizing_par_hadamard_vector() error: par not found in localizer matrix: " + par_names[i]);
+		loc[i] = compressed_coeff(loc_csr, idx, pit->second);
 	}
 	return loc;
+}
 
+
+Eigen::MatrixXd Localizer::get_localizing_obs_hadamard_matrix(int num_reals, string col_name, vector<string> &obs_names)
+{
+	Eigen::VectorXd loc_vec = get_localizing_obs_hadamard_vector(col_name, obs_names);
+	return loc_vec.replicate(1, num_reals);
+}
+
+
+Eigen::MatrixXd Localizer::get_localizing_par_hadamard_matrix(int num_reals, string row_name, vector<string> &par_names)
+{
+	Eigen::VectorXd loc_vec = get_localizing_par_hadamard_vector(row_name, par_names);
+	return loc_vec.replicate(1, num_reals);
 }
@@ -43,9 +43,9 @@ private:
 	ofstream *f_out;
 	map<string, set<string>> list_obs;
 	map<int, string> idx2obs;
-	mutex pe_diff_lock, oe_diff_lock, par_indices_lock, pfm_lock;
-	mutex f_out_lock, par_names_lock, obs_names_lock;
-	mutex triplets_lock;
+	mutex par_indices_lock, pfm_lock;
+	mutex f_out_lock, triplets_lock;
+	void log_event(const string& message);
 };
 
 
@@ -61,6 +61,12 @@ public:
 	void set_pest_scenario(Pest *_pest_scenario_ptr) { pest_scenario_ptr = _pest_scenario_ptr; }
 	Eigen::MatrixXd get_localizing_obs_hadamard_matrix(int num_reals,string col_name,vector<string> &obs_names);
 	Eigen::MatrixXd get_localizing_par_hadamard_matrix(int num_reals, string row_name, vector<string> &par_names);
+	//the hadamard matrices above are constant along each row, so the localization of a case is
+	//just a scaling of the rows of its (obs or par) x reals diff matrix.  these return the row
+	//scale factors using the prebuilt index maps and compressed storage, and are safe to call
+	//from several threads at once
+	Eigen::VectorXd get_localizing_obs_hadamard_vector(const string &col_name, const vector<string> &obs_names) const;
+	Eigen::VectorXd get_localizing_par_hadamard_vector(const string &row_name, const vector<string> &par_names) const;
 	How get_how() { return how; }
 	bool get_use() { return use; }
 	bool get_autoadaloc() { return autoadaloc; }
@@ -77,7 +83,14 @@ private:
 	string filename;
 	unordered_map<string,pair<vector<string>, vector<string>>> localizer_map;
 	map<string, set<string>> listed_obs;
-	map<string, int> obs2row_map, par2col_map;
+	unordered_map<string, int> obs2row_map, par2col_map;
+	//localizer row and col name to index, and compressed column (csc) and row (csr) copies of
+	//the localizer so that a column or row can be searched without densifying it
+	unordered_map<string, int> row_index, col_index;
+	Eigen::SparseMatrix<double> loc_csc;
+	Eigen::SparseMatrix<double, Eigen::RowMajor> loc_csr;
+
+	void build_index();
 
 	void process_mat(PerformanceLog *performance_log, bool forgive_missing=false);	
 };
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <sstream>
 #include <cstring>
+#include <atomic>
 #include "PerformanceLog.h"
 #include "config_os.h"
 
@@ -19,8 +20,46 @@ void PerformanceLog::writetime(stringstream &os, time_t tc) {
 	tp.put(os,os,' ',localtime(&tc),pat,pat+strlen(pat));
 }
 
+namespace
+{
+	//nesting depth of the open scopes on this thread
+	thread_local int scope_depth = 0;
+}
+
+PerformanceLog::Scope::Scope(PerformanceLog *_plog, const char *_name) : plog(_plog), name(_name), depth(0)
+{
+	if (plog == nullptr)
+		return;
+	depth = scope_depth++;
+	start = chrono::steady_clock::now();
+}
+
+PerformanceLog::Scope::~Scope()
+{
+	if (plog == nullptr)
+		return;
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+	scope_depth--;
+	plog->end_scope(*this, end);
+}
+
+void PerformanceLog::Scope::add_counter(const char *key, double value)
+{
+	if (plog == nullptr)
+		return;
+	for (auto &c : counters)
+	{
+		if (c.first == key)
+		{
+			c.second += value;
+			return;
+		}
+	}
+	counters.push_back(make_pair(key, value));
+}
+
 PerformanceLog::PerformanceLog(ofstream &_fout)
-: fout(_fout)
+: fout(_fout), trace_on(false), num_trace_events(0)
 {
 	prev_time = system_clock::now();
 	//fout << "PEST++ performance logger started at:  " << time_to_string(prev_time) << endl;
@@ -83,6 +122,153 @@ string PerformanceLog::elapsed_time_to_string(std::chrono::system_clock::time_po
 }
 
 
+int PerformanceLog::get_thread_index()
+{
+	//small, stable ids are easier to read in the trace viewer than hashed thread ids
+	static atomic<int> next_index(0);
+	static thread_local int index = next_index++;
+	return index;
+}
+
+namespace
+{
+	void write_json_string(ostream &os, const char *s)
+	{
+		os << '"';
+		for (; *s != '\0'; s++)
+		{
+			if ((*s == '"') || (*s == '\\'))
+				os << '\\' << *s;
+			else if ((unsigned char)*s < 0x20)
+				os << ' ';
+			else
+				os << *s;
+		}
+		os << '"';
+	}
+}
+
+void PerformanceLog::PhaseStats::add(const PhaseStats &other)
+{
+	calls += other.calls;
+	total_sec += other.total_sec;
+	max_sec = max(max_sec, other.max_sec);
+	add_counters(other.counters);
+}
+
+void PerformanceLog::PhaseStats::add_counters(const vector<pair<const char*, double>> &others)
+{
+	for (auto &oc : others)
+	{
+		bool found = false;
+		for (auto &c : counters)
+		{
+			if ((c.first == oc.first) || (strcmp(c.first, oc.first) == 0))
+			{
+				c.second += oc.second;
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			counters.push_back(oc);
+	}
+}
+
+void PerformanceLog::end_scope(const Scope &scope, chrono::steady_clock::time_point end)
+{
+	double sec = chrono::duration<double>(end - scope.start).count();
+	int tid = get_thread_index();
+	lock_guard<mutex> stats_guard(stats_lock);
+	PhaseStats &ps = phase_stats[scope.name];
+	ps.calls++;
+	ps.total_sec += sec;
+	ps.max_sec = max(ps.max_sec, sec);
+	ps.add_counters(scope.counters);
+	if (!trace_on)
+		return;
+	//"X" (complete) events - the viewer nests them per thread from the timestamps
+	if (num_trace_events > 0)
+		ftrace << ",";
+	ftrace << endl << "{\"name\":";
+	write_json_string(ftrace, scope.name);
+	ftrace << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid;
+	ftrace << ",\"ts\":" << chrono::duration<double, micro>(scope.start - trace_origin).count();
+	ftrace << ",\"dur\":" << chrono::duration<double, micro>(end - scope.start).count();
+	ftrace << ",\"args\":{\"depth\":" << scope.depth;
+	for (auto &c : scope.counters)
+	{
+		ftrace << ",";
+		write_json_string(ftrace, c.first);
+		ftrace << ":" << c.second;
+	}
+	ftrace << "}}";
+	num_trace_events++;
+}
+
+void PerformanceLog::enable_trace(const string &filename)
+{
+	lock_guard<mutex> stats_guard(stats_lock);
+	if (trace_on)
+		return;
+	ftrace.open(filename);
+	if (!ftrace.good())
+		throw runtime_error("PerformanceLog error: unable to open trace file " + filename);
+	ftrace << setprecision(12);
+	ftrace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	trace_origin = chrono::steady_clock::now();
+	num_trace_events = 0;
+	trace_on = true;
+	fout << time_to_string(system_clock::now()) << ",0,writing trace events to " << filename << endl;
+}
+
+void PerformanceLog::close_trace()
+{
+	lock_guard<mutex> stats_guard(stats_lock);
+	if (!trace_on)
+		return;
+	ftrace << endl << "]}" << endl;
+	ftrace.close();
+	trace_on = false;
+}
+
+void PerformanceLog::write_phase_summary(const string &title)
+{
+	unordered_map<const char*, PhaseStats> raw_stats;
+	{
+		lock_guard<mutex> stats_guard(stats_lock);
+		raw_stats.swap(phase_stats);
+	}
+	map<string, PhaseStats> stats;
+	for (auto &ps : raw_stats)
+		stats[ps.first].add(ps.second);
+	if (stats.size() == 0)
+		return;
+	//phases nest, so the totals are inclusive of any phases timed inside them
+	log_event("phase summary for " + title + " (inclusive seconds)");
+	stringstream ss;
+	for (auto &ps : stats)
+	{
+		ss.str("");
+		ss << "  phase: " << ps.first << ", calls: " << ps.second.calls << ", total_sec: " << ps.second.total_sec;
+		ss << ", mean_sec: " << ps.second.total_sec / ps.second.calls << ", max_sec: " << ps.second.max_sec;
+		for (auto &c : ps.second.counters)
+			ss << ", " << c.first << ": " << c.second;
+		fout << time_to_string(system_clock::now()) << ",0," << ss.str() << endl;
+	}
+	fout.flush();
+	lock_guard<mutex> stats_guard(stats_lock);
+	if (trace_on)
+		ftrace.flush();
+}
+
+bool PerformanceLog::trace_enabled()
+{
+	lock_guard<mutex> stats_guard(stats_lock);
+	return trace_on;
+}
+
 PerformanceLog::~PerformanceLog()
 {
+	close_trace();
 }
@@ -5,20 +5,72 @@
 #include <fstream>
 #include <chrono>
 #include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 class PerformanceLog
 {
 public:
+	//scoped (RAII) timer for one phase.  phases nest per thread and each one is added to the
+	//per-phase summary when it ends and, if tracing is on, written to the trace file as a
+	//complete event.  names and counter keys are expected to be string literals.  a null
+	//log makes the scope a no-op, so it can be left in place everywhere
+	class Scope
+	{
+	public:
+		Scope(PerformanceLog *_plog, const char *_name);
+		~Scope();
+		//counters are summed over all calls of a phase (e.g. bytes read, runs dispatched)
+		void add_counter(const char *key, double value);
+	private:
+		PerformanceLog *plog;
+		const char *name;
+		int depth;
+		std::chrono::steady_clock::time_point start;
+		std::vector<std::pair<const char*, double>> counters;
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+		friend class PerformanceLog;
+	};
+
 	PerformanceLog(std::ofstream &_fout);
 	void log_event(const std::string &message);
+	//start writing a chrome trace_event (json) file of all the scopes that end from now on
+	void enable_trace(const std::string &filename);
+	bool trace_enabled();
+	//log the per-phase totals accumulated since the last summary and reset them
+	void write_phase_summary(const std::string &title);
 	~PerformanceLog();
 private:
+	struct PhaseStats
+	{
+		long long calls = 0;
+		double total_sec = 0.0;
+		double max_sec = 0.0;
+		std::vector<std::pair<const char*, double>> counters;
+		void add(const PhaseStats &other);
+		void add_counters(const std::vector<std::pair<const char*, double>> &others);
+	};
 	std::ofstream &fout;
 	std::chrono::system_clock::time_point prev_time;
 	std::map<std::string, std::chrono::system_clock::time_point> tagged_events;
+	std::mutex stats_lock;
+	//keyed by the name literal itself, so ending a scope doesnt build a string - the
+	//summary merges entries by name in case the same name comes from different literals
+	std::unordered_map<const char*, PhaseStats> phase_stats;
+	bool trace_on;
+	std::ofstream ftrace;
+	long long num_trace_events;
+	std::chrono::steady_clock::time_point trace_origin;
 	std::string time_to_string(const std::chrono::system_clock::time_point &tmp_time);
 	std::string elapsed_time_to_string(std::chrono::system_clock::time_point &current_time, std::chrono::system_clock::time_point &prev_time);
 	void writetime(std::stringstream &os, time_t tc);
+	void end_scope(const Scope &scope, std::chrono::steady_clock::time_point end);
+	void close_trace();
+	static int get_thread_index();
 };
 
 #endif //PERFORMANCE_LOG_H_
@@ -22,6 +22,7 @@
 #include <map>
 #include <algorithm>
 #include <sstream>
+#include <functional>
 #include "SVDSolver.h"
 #include "RunManagerAbstract.h"
 #include "QSqrtMatrix.h"
@@ -124,6 +125,7 @@ void SVDSolver::set_svd_package(PestppOptions::SVD_PACK _svd_pack)
 	svd_package->set_max_sing(svd_info.maxsing);
 	svd_package->set_eign_thres(svd_info.eigthresh);
 	svd_package->set_performance_log(performance_log);
+	jtqj_factors.valid = false;
 }
 
 SVDSolver::~SVDSolver(void)
@@ -277,6 +279,9 @@ ModelRun SVDSolver::solve(RunManagerAbstract &run_manager, TerminationController
 		tmp_str.str("");
 		tmp_str << "completed iteration " << global_iter_num;
 		performance_log->log_event(tmp_str.str());
+		tmp_str.str("");
+		tmp_str << "iteration " << global_iter_num;
+		performance_log->write_phase_summary(tmp_str.str());
 		// write files that get wrtten at the end of each iteration
 		stringstream filename;
 		string complete_filename;
@@ -365,6 +370,69 @@ VectorXd SVDSolver::calc_residual_corrections(const Jacobian &jacobian, const Pa
 }
 
 
+namespace
+{
+	bool same_sparse(const Eigen::SparseMatrix<double> &a, const Eigen::SparseMatrix<double> &b)
+	{
+		if ((a.rows() != b.rows()) || (a.cols() != b.cols()) || (a.nonZeros() != b.nonZeros()))
+			return false;
+		for (int k = 0; k < a.outerSize(); ++k)
+		{
+			Eigen::SparseMatrix<double>::InnerIterator ita(a, k), itb(b, k);
+			for (; ita && itb; ++ita, ++itb)
+			{
+				if ((ita.index() != itb.index()) || (ita.value() != itb.value()))
+					return false;
+			}
+			if (ita || itb)
+				return false;
+		}
+		return true;
+	}
+}
+
+SVDSolver::JtQJFactors& SVDSolver::get_JtQJ_factors(const Eigen::SparseMatrix<double> &jac, const Eigen::SparseMatrix<double> &q_mat,
+	const vector<string> &obs_name_vec, const vector<string> &numeric_par_names)
+{
+	//the lambdas tested in an iteration (and the freeze tests before them) all see the same
+	//normal matrix unless more parameters are frozen, so the factorization is only redone when
+	//the jacobian, the weights or the free parameters actually change
+	if ((jtqj_factors.valid) && (jtqj_factors.normal_form == glm_normal_form) &&
+		(jtqj_factors.obs_names == obs_name_vec) && (jtqj_factors.par_names == numeric_par_names) &&
+		(same_sparse(jtqj_factors.jac, jac)) && (same_sparse(jtqj_factors.q_mat, q_mat)))
+	{
+		performance_log->log_event("reusing SVD factorization of JtQJ matrix");
+		return jtqj_factors;
+	}
+	jtqj_factors.valid = false;
+	performance_log->log_event("forming JtQJ matrix");
+	Eigen::SparseMatrix<double> JtQJ = jac.transpose() * q_mat * jac;
+	if (glm_normal_form == PestppOptions::GLMNormalForm::DIAG)
+	{
+		//Compute Scaling Matrix Sii
+		performance_log->log_event("commencing to scale JtQJ matrix- first SVD...");
+		svd_package->solve_ip(JtQJ, jtqj_factors.Sigma, jtqj_factors.U, jtqj_factors.Vt, jtqj_factors.Sigma_trunc, 0.0);
+		VectorXd Sigma_inv_sqrt = jtqj_factors.Sigma.array().inverse().sqrt();
+		Eigen::SparseMatrix<double> S = jtqj_factors.Vt.transpose() * Sigma_inv_sqrt.asDiagonal() * jtqj_factors.U.transpose();
+		VectorXd S_diag = S.diagonal();
+		MatrixXd S_tmp = S_diag.asDiagonal();
+		jtqj_factors.S = S_tmp.sparseView();
+	}
+	else
+	{
+		performance_log->log_event("commencing SVD factorization of JtQJ matrix");
+		svd_package->solve_ip(JtQJ, jtqj_factors.Sigma, jtqj_factors.U, jtqj_factors.Vt, jtqj_factors.Sigma_trunc);
+		performance_log->log_event("SVD factorization complete");
+	}
+	jtqj_factors.normal_form = glm_normal_form;
+	jtqj_factors.obs_names = obs_name_vec;
+	jtqj_factors.par_names = numeric_par_names;
+	jtqj_factors.jac = jac;
+	jtqj_factors.q_mat = q_mat;
+	jtqj_factors.valid = true;
+	return jtqj_factors;
+}
+
 void SVDSolver::calc_lambda_upgrade_vec_JtQJ(const Jacobian &jacobian, const QSqrtMatrix &Q_sqrt, const DynamicRegularization &regul,
 	const Eigen::VectorXd &Residuals, const vector<string> &obs_name_vec,
 	const Parameters &base_active_ctl_pars, const Parameters &prev_frozen_active_ctl_pars,
@@ -379,9 +447,6 @@ void SVDSolver::calc_lambda_upgrade_vec_JtQJ(const Jacobian &jacobian, const QSq
 	par_transform.active_ctl2numeric_ip(pars_nf);
 	vector<string> numeric_par_names = pars_nf.get_keys();
 
-	//get the dss map to zero out insen pars
-	map<string, double> dss = pest_scenario.calc_par_dss(jacobian, par_transform);
-
 	//Compute effect of frozen parameters on the residuals vector
 	Parameters delta_freeze_pars = prev_frozen_active_ctl_pars;
 	Parameters base_freeze_pars(base_active_ctl_pars, delta_freeze_pars.get_keys());
@@ -400,38 +465,25 @@ void SVDSolver::calc_lambda_upgrade_vec_JtQJ(const Jacobian &jacobian, const QSq
 	//q_mat = (q_mat * q_mat).eval();
 	Eigen::SparseMatrix<double> jac = jacobian.get_matrix(obs_name_vec, numeric_par_names);
 	
-	performance_log->log_event("forming JtQJ matrix");
-	Eigen::SparseMatrix<double> JtQJ = jac.transpose() * q_mat * jac;
-	
 	Eigen::VectorXd upgrade_vec;
 	stringstream info_str;
 	//PestppOptions::GLMNormalForm mar_mat = pest_scenario.get_pestpp_options().get_glm_normal_form();
 	if (glm_normal_form == PestppOptions::GLMNormalForm::DIAG)
 	{
-		
-		Eigen::SparseMatrix<double> S;
-		//Compute Scaling Matrix Sii
-		performance_log->log_event("commencing to scale JtQJ matrix- first SVD...");
-		svd_package->solve_ip(JtQJ, Sigma, U, Vt, Sigma_trunc, 0.0);
-		VectorXd Sigma_inv_sqrt = Sigma.array().inverse().sqrt();
-		S = Vt.transpose() * Sigma_inv_sqrt.asDiagonal() * U.transpose();
-		VectorXd S_diag = S.diagonal();
-		MatrixXd S_tmp = S_diag.asDiagonal();
-		S = S_tmp.sparseView();
-		
+		//S only depends on JtQJ, so it is shared by all lambdas.  the lambda-scaled matrix is
+		//truncated in the scaled space, so it still needs its own SVD
+		JtQJFactors &factors = get_JtQJ_factors(jac, q_mat, obs_name_vec, numeric_par_names);
+		const Eigen::SparseMatrix<double> &S = factors.S;
+
 		stringstream info_str1;
 		info_str1 << "S info: " << "rows = " << S.rows() << ": cols = " << S.cols() << ": size = " << S.size() << ": nonzeros = " << S.nonZeros();
 		performance_log->log_event(info_str1.str());
 		performance_log->log_event("JS");
-		
+
 		Eigen::SparseMatrix<double> JS = jac * S;
 		performance_log->log_event("JS.transpose() * q_mat * JS + lambda * S.transpose() * S");
-		
-		JtQJ = JS.transpose() * q_mat * JS + lambda * S.transpose() * S;
-		
-		info_str.str("");
-		info_str << "S info: " << "rows = " << S.rows() << ": cols = " << S.cols() << ": size = " << S.size() << ": nonzeros = " << S.nonZeros();
-		performance_log->log_event(info_str.str());
+
+		Eigen::SparseMatrix<double> JtQJ = JS.transpose() * q_mat * JS + lambda * S.transpose() * S;
 
 		// Returns truncated Sigma, U and Vt arrays with small singular parameters trimed off
 		performance_log->log_event("commencing SVD factorization of lambda-scaled JtQJ");
@@ -451,24 +503,44 @@ void SVDSolver::calc_lambda_upgrade_vec_JtQJ(const Jacobian &jacobian, const QSq
 		info_str.str("");
 		info_str << "jac info: " << "rows = " << jac.rows() << ": cols = " << jac.cols() << ": size = " << jac.size() << ": nonzeros = " << jac.nonZeros();
 		performance_log->log_event(info_str.str());
-		
-		upgrade_vec = S * (Vt.transpose() * (Sigma_inv.asDiagonal() * (U.transpose() * ((jac * S).transpose()* (q_mat  * (corrected_residuals))))));
-		
+
+		upgrade_vec = S * (Vt.transpose() * (Sigma_inv.asDiagonal() * (U.transpose() * (JS.transpose() * (q_mat * (corrected_residuals))))));
 	}
-	else if ((glm_normal_form == PestppOptions::GLMNormalForm::IDENT) ||
-		(glm_normal_form == PestppOptions::GLMNormalForm::PRIOR))
+	else if (glm_normal_form == PestppOptions::GLMNormalForm::IDENT)
 	{
-		JtQJ = jac.transpose() * q_mat * jac;
+		//lambda only enters through the singular values, so the factors are shared by all lambdas
+		JtQJFactors &factors = get_JtQJ_factors(jac, q_mat, obs_name_vec, numeric_par_names);
+		Eigen::VectorXd innovation = jac.transpose() * (q_mat * corrected_residuals);
+		//Only add lambda to singular values above the threshhold
+		Sigma = factors.Sigma.array() + (factors.Sigma.cwiseProduct(factors.Sigma).array() * lambda).sqrt();
+		output_file_writer.write_svd(Sigma, factors.Vt, lambda, prev_frozen_active_ctl_pars,
+			factors.Sigma_trunc);
+		VectorXd Sigma_inv = Sigma.array().inverse();
+
+		performance_log->log_event("commencing linear algebra multiplication to compute ugrade");
+		info_str << "Vt info: " << "rows = " << factors.Vt.rows() << ": cols = " << factors.Vt.cols() << ": size = " << factors.Vt.size() << ": nonzeros = " << factors.Vt.nonZeros();
+		performance_log->log_event(info_str.str());
+		info_str.str("");
+		info_str << "U info: " << "rows = " << factors.U.rows() << ": cols = " << factors.U.cols() << ": size = " << factors.U.size() << ": nonzeros = " << factors.U.nonZeros();
+		performance_log->log_event(info_str.str());
+		info_str.str("");
+		info_str << "jac info: " << "rows = " << jac.rows() << ": cols = " << jac.cols() << ": size = " << jac.size() << ": nonzeros = " << jac.nonZeros();
+		performance_log->log_event(info_str.str());
+		upgrade_vec = factors.Vt.transpose() * (Sigma_inv.asDiagonal() * (factors.U.transpose() * innovation));
+	}
+	else if (glm_normal_form == PestppOptions::GLMNormalForm::PRIOR)
+	{
+		//lambda is added to every element of the regularized normal matrix here, which is not a
+		//diagonal shift, so this form is still factored for each lambda
+		performance_log->log_event("forming JtQJ matrix");
+		Eigen::SparseMatrix<double> JtQJ = jac.transpose() * q_mat * jac;
 		Eigen::VectorXd innovation = jac.transpose() * (q_mat * corrected_residuals);
 		
-		if (glm_normal_form == PestppOptions::GLMNormalForm::IDENT)
-		{
-			//nothing to do here
-		}
-		
-		else if (glm_normal_form == PestppOptions::GLMNormalForm::PRIOR)
 		{
 			
+			//get the dss map to zero out insen pars
+			map<string, double> dss = pest_scenario.calc_par_dss(jacobian, par_transform);
+
 			//work up the inverse prior par cov
 			Covariance prior_inv = parcov.get(numeric_par_names);
 			prior_inv.inv_ip();
@@ -496,7 +568,7 @@ void SVDSolver::calc_lambda_upgrade_vec_JtQJ(const Jacobian &jacobian, const QSq
 			innovation = innovation + reg_innovation;
 		}
 
-		performance_log->log_event("commencing SVD factorization - using identity lambda scaling");
+		performance_log->log_event("commencing SVD factorization - using prior lambda scaling");
 		svd_package->solve_ip(JtQJ, Sigma, U, Vt, Sigma_trunc);
 		performance_log->log_event("SVD factorization complete");
 		//Only add lambda to singular values above the threshhold
@@ -505,7 +577,6 @@ void SVDSolver::calc_lambda_upgrade_vec_JtQJ(const Jacobian &jacobian, const QSq
 		VectorXd Sigma_inv = Sigma.array().inverse();
 
 		performance_log->log_event("commencing linear algebra multiplication to compute ugrade");
-		stringstream info_str;
 		info_str << "Vt info: " << "rows = " << Vt.rows() << ": cols = " << Vt.cols() << ": size = " << Vt.size() << ": nonzeros = " << Vt.nonZeros();
 		performance_log->log_event(info_str.str());
 		info_str.str("");
@@ -901,6 +972,7 @@ ModelRun SVDSolver::iteration_reuse_jac(RunManagerAbstract &run_manager, Termina
 
 bool SVDSolver::iteration_jac(RunManagerAbstract &run_manager, TerminationController &termination_ctl, ModelRun &base_run, bool calc_init_obs, bool restart_runs)
 {
+	PerformanceLog::Scope scope(performance_log, "glm jacobian");
 	ostream &os = file_manager.rec_ofstream();
 	ostream &fout_restart = file_manager.get_ofstream("rst");
 	set<string> out_ofbound_pars;
@@ -960,6 +1032,7 @@ bool SVDSolver::iteration_jac(RunManagerAbstract &run_manager, TerminationContro
 
 ModelRun SVDSolver::iteration_upgrd(RunManagerAbstract &run_manager, TerminationController &termination_ctl, ModelRun &base_run, bool restart_runs)
 {
+	PerformanceLog::Scope scope(performance_log, "glm upgrade");
 	ostream &os = file_manager.rec_ofstream();
 	ostream &fout_restart = file_manager.get_ofstream("rst");
 	int num_success_calc = 0;
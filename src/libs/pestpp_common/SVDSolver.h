@@ -104,6 +104,26 @@ protected:
 		vector<string> par_name_vec;
 		Parameters frozen_numeric_pars;
 	};
+	//lambda independent factors of JtQJ, shared by every lambda that sees the same jacobian,
+	//weights and set of free parameters: the truncated SVD for the IDENT form and the
+	//diagonal scaling matrix S for the DIAG form.  The inputs they were formed from are kept
+	//so reuse is decided by an exact comparison rather than a signature
+	class JtQJFactors {
+	public:
+		JtQJFactors() : valid(false), normal_form(PestppOptions::GLMNormalForm::IDENT) {}
+		bool valid;
+		PestppOptions::GLMNormalForm normal_form;
+		vector<string> obs_names;
+		vector<string> par_names;
+		Eigen::SparseMatrix<double> jac;
+		Eigen::SparseMatrix<double> q_mat;
+		Eigen::VectorXd Sigma;
+		Eigen::VectorXd Sigma_trunc;
+		Eigen::SparseMatrix<double> U;
+		Eigen::SparseMatrix<double> Vt;
+		Eigen::SparseMatrix<double> S;
+	};
+	JtQJFactors jtqj_factors;
 	std::mt19937* rand_gen_ptr;
 	Covariance& parcov;
 	Pest &pest_scenario;
@@ -154,6 +174,8 @@ protected:
 	void dynamic_weight_adj(const ModelRun &base_run, const Jacobian &jacobian, QSqrtMatrix &Q_sqrt,
 		const Eigen::VectorXd &Residuals, const vector<string> &obs_name_vec,
 		const Parameters &base_active_ctl_pars, const Parameters &freeze_active_ctl_pars);
+	JtQJFactors& get_JtQJ_factors(const Eigen::SparseMatrix<double> &jac, const Eigen::SparseMatrix<double> &q_mat,
+		const vector<string> &obs_name_vec, const vector<string> &numeric_par_names);
 	bool par_heading_out_bnd(double org_par, double new_par, double lower_bnd, double upper_bnd);
 	void save_frozen_pars(std::ostream &fout, const Parameters &frozen_pars, int id);
 	Parameters read_frozen_pars(std::istream &fin, int id);
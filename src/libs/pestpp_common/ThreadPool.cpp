@@ -0,0 +1,122 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace
+{
+	thread_local int tl_worker_id = -1;
+	thread_local ThreadPool* tl_pool = nullptr;
+}
+
+ThreadPool::ThreadPool(int _num_threads) : stop(false), pending(0), next_queue(0)
+{
+	num_threads = (_num_threads < 1) ? 1 : _num_threads;
+	for (int i = 0; i < num_threads; i++)
+		queues.push_back(unique_ptr<WorkQueue>(new WorkQueue()));
+	for (int i = 0; i < num_threads; i++)
+		workers.push_back(thread(&ThreadPool::worker_loop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> g(sleep_lock);
+		stop = true;
+	}
+	sleep_cv.notify_all();
+	for (auto& w : workers)
+		w.join();
+}
+
+int ThreadPool::get_worker_id()
+{
+	return tl_worker_id;
+}
+
+void ThreadPool::push(function<void()> task)
+{
+	int q;
+	{
+		lock_guard<mutex> g(sleep_lock);
+		if ((tl_pool == this) && (tl_worker_id >= 0))
+			q = tl_worker_id;
+		else
+			q = next_queue++ % num_threads;
+	}
+	{
+		lock_guard<mutex> g(queues[q]->lock);
+		queues[q]->tasks.push_back(task);
+		lock_guard<mutex> s(sleep_lock);
+		pending++;
+	}
+	sleep_cv.notify_one();
+}
+
+bool ThreadPool::pop(int worker_id, function<void()>& task, bool block_steal)
+{
+	//own queue first (fifo)
+	{
+		lock_guard<mutex> g(queues[worker_id]->lock);
+		if (queues[worker_id]->tasks.size() > 0)
+		{
+			task = move(queues[worker_id]->tasks.front());
+			queues[worker_id]->tasks.pop_front();
+			lock_guard<mutex> s(sleep_lock);
+			pending--;
+			return true;
+		}
+	}
+	//then try to steal from the back of the others
+	for (int i = 1; i < num_threads; i++)
+	{
+		int victim = (worker_id + i) % num_threads;
+		unique_lock<mutex> g(queues[victim]->lock, defer_lock);
+		if (block_steal)
+			g.lock();
+		else
+			g.try_lock();
+		if ((g.owns_lock()) && (queues[victim]->tasks.size() > 0))
+		{
+			task = move(queues[victim]->tasks.back());
+			queues[victim]->tasks.pop_back();
+			lock_guard<mutex> s(sleep_lock);
+			pending--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::worker_loop(int worker_id)
+{
+	tl_worker_id = worker_id;
+	tl_pool = this;
+	function<void()> task;
+	bool block_steal = false;
+	while (true)
+	{
+		if (pop(worker_id, task, block_steal))
+		{
+			block_steal = false;
+			//packaged_task captures any exception into the future
+			task();
+			task = nullptr;
+			continue;
+		}
+		unique_lock<mutex> g(sleep_lock);
+		//pending is the number of queued tasks, so if it is positive the failed pop() only
+		//skipped them on a try_lock - sweep once more, waiting for each queue lock.  if that
+		//also comes up empty, another worker took them in the meantime
+		if ((pending > 0) && (!block_steal))
+		{
+			block_steal = true;
+			continue;
+		}
+		block_steal = false;
+		if ((stop) && (pending == 0))
+			return;
+		sleep_cv.wait(g, [this] { return (stop) || (pending > 0); });
+		if ((stop) && (pending == 0))
+			return;
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+
+//a fixed-size work-stealing thread pool.  each worker owns a task queue; tasks submitted
+//from outside the pool are dealt round-robin across the queues and tasks submitted from
+//inside a worker go to that worker's own queue.  an idle worker takes from the front of
+//its own queue, then steals from the back of the others, then blocks until more work
+//arrives - no worker ever spins.  exceptions thrown by a task are propagated through
+//the future returned by submit()
+class ThreadPool
+{
+public:
+	ThreadPool(int _num_threads);
+	~ThreadPool();
+	template<typename F>
+	std::future<typename std::result_of<F()>::type> submit(F f);
+	int get_num_threads() const { return num_threads; }
+	//the index of the calling pool worker, or -1 if not called from a pool worker
+	static int get_worker_id();
+	//wait for all futures, collecting any exceptions into a single runtime_error
+	template<typename T>
+	static void wait_all(std::vector<std::future<T>>& futures, const std::string& tag="");
+
+private:
+	struct WorkQueue
+	{
+		std::mutex lock;
+		std::deque<std::function<void()>> tasks;
+	};
+	int num_threads;
+	bool stop;
+	//tasks in the queues - only changed while holding both the queue lock and sleep_lock
+	int pending;
+	unsigned int next_queue;
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex sleep_lock;
+	std::condition_variable sleep_cv;
+
+	void push(std::function<void()> task);
+	//take a task from the worker's own queue or steal one.  other queues that are busy are
+	//skipped unless block_steal is true
+	bool pop(int worker_id, std::function<void()>& task, bool block_steal);
+	void worker_loop(int worker_id);
+};
+
+template<typename F>
+std::future<typename std::result_of<F()>::type> ThreadPool::submit(F f)
+{
+	typedef typename std::result_of<F()>::type R;
+	std::shared_ptr<std::packaged_task<R()>> task = std::make_shared<std::packaged_task<R()>>(f);
+	std::future<R> result = task->get_future();
+	push([task]() { (*task)(); });
+	return result;
+}
+
+template<typename T>
+void ThreadPool::wait_all(std::vector<std::future<T>>& futures, const std::string& tag)
+{
+	std::stringstream ss;
+	int num_exp = 0;
+	for (int i = 0; i < futures.size(); i++)
+	{
+		try
+		{
+			futures[i].get();
+		}
+		catch (const std::exception& e)
+		{
+			ss << " " << tag << " task " << i << " raised an exception: " << e.what() << std::endl;
+			num_exp++;
+		}
+		catch (...)
+		{
+			ss << " " << tag << " task " << i << " raised an exception" << std::endl;
+			num_exp++;
+		}
+	}
+	if (num_exp > 0)
+		throw std::runtime_error(ss.str());
+}
+
+#endif //THREADPOOL_H_
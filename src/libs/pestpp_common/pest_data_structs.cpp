@@ -808,12 +808,36 @@ PestppOptions::ARG_STATUS PestppOptions::assign_value_by_key(string key, const s
 	{
 		ies_enforce_bounds = pest_utils::parse_string_arg_to_bool(value);
 	}
+	else if (key == "IES_DRAW_BLOCK_SIZE")
+	{
+		convert_ip(value, ies_draw_block_size);
+	}
+	else if (key == "IES_DRAW_CACHE_DIR")
+	{
+		ies_draw_cache_dir = org_value;
+	}
+	else if (key == "IES_DRAW_STREAM_FILE")
+	{
+		ies_draw_stream_file = org_value;
+	}
 	else if ((key == "IES_SAVE_BINARY") || (key == "SAVE_BINARY"))
 	{
 		passed_args.insert("IES_SAVE_BINARY");
 		passed_args.insert("SAVE_BINARY");
 		ies_save_binary = pest_utils::parse_string_arg_to_bool(value);
 	}
+	else if ((key == "IES_SAVE_COLUMNAR") || (key == "SAVE_COLUMNAR"))
+	{
+		passed_args.insert("IES_SAVE_COLUMNAR");
+		passed_args.insert("SAVE_COLUMNAR");
+		ies_save_columnar = pest_utils::parse_string_arg_to_bool(value);
+	}
+	else if ((key == "IES_COLUMNAR_FLOAT32") || (key == "COLUMNAR_FLOAT32"))
+	{
+		passed_args.insert("IES_COLUMNAR_FLOAT32");
+		passed_args.insert("COLUMNAR_FLOAT32");
+		ies_columnar_float32 = pest_utils::parse_string_arg_to_bool(value);
+	}
 	else if (key == "PAR_SIGMA_RANGE")
 	{
 		convert_ip(value, par_sigma_range);
@@ -952,6 +976,34 @@ PestppOptions::ARG_STATUS PestppOptions::assign_value_by_key(string key, const s
 	{
 		convert_ip(value, gsa_sobol_par_dist);
 	}
+	else if (key == "GSA_SOBOL_NUM_THREADS")
+	{
+		convert_ip(value, gsa_sobol_num_threads);
+	}
+	else if (key == "GSA_SOBOL_SAMPLING")
+	{
+		convert_ip(value, gsa_sobol_sampling);
+	}
+	else if (key == "GSA_SOBOL_SCRAMBLE")
+	{
+		gsa_sobol_scramble = pest_utils::parse_string_arg_to_bool(value);
+	}
+	else if (key == "GSA_SOBOL_SCHEME")
+	{
+		convert_ip(value, gsa_sobol_scheme);
+	}
+	else if (key == "GSA_SOBOL_BLOCK_SAMPLES")
+	{
+		convert_ip(value, gsa_sobol_block_samples);
+	}
+	else if (key == "GSA_SOBOL_CONF_WIDTH")
+	{
+		convert_ip(value, gsa_sobol_conf_width);
+	}
+	else if (key == "GSA_SOBOL_BOOTSTRAP")
+	{
+		convert_ip(value, gsa_sobol_bootstrap);
+	}
 	else if (key == "ENFORCE_TIED_BOUNDS")
 	{
 		enforce_tied_bounds = pest_utils::parse_string_arg_to_bool(value);
@@ -962,6 +1014,10 @@ PestppOptions::ARG_STATUS PestppOptions::assign_value_by_key(string key, const s
 		debug_parse_only = pest_utils::parse_string_arg_to_bool(value);
 	
 	}
+	else if (key == "MODEL_PLUGIN")
+	{
+		model_plugin = org_value;
+	}
 	
 	
 	else if (!assign_value_by_key_continued(key, value))
@@ -1033,6 +1089,38 @@ bool PestppOptions::assign_value_by_key_continued(const string& key, const strin
 		panther_echo = pest_utils::parse_string_arg_to_bool(value);
 		return true;
 	}
+	else if (key == "RUN_STORAGE_MMAP")
+	{
+		run_storage_mmap = pest_utils::parse_string_arg_to_bool(value);
+		return true;
+	}
+	else if (key == "PANTHER_SCHEDULE_POLICY")
+	{
+		panther_schedule_policy = pest_utils::lower_cp(value);
+		if ((panther_schedule_policy != "fifo") && (panther_schedule_policy != "fastest_agent") && (panther_schedule_policy != "longest_run"))
+			throw runtime_error("unrecognized panther_schedule_policy '" + value + "', should be 'fifo', 'fastest_agent' or 'longest_run'");
+		return true;
+	}
+	else if (key == "PANTHER_TAIL_RUNS")
+	{
+		convert_ip(value, panther_tail_runs);
+		return true;
+	}
+	else if (key == "PERF_TRACE")
+	{
+		perf_trace = pest_utils::parse_string_arg_to_bool(value);
+		return true;
+	}
+	else if (key == "MODEL_PLUGIN_THREADS")
+	{
+		convert_ip(value, model_plugin_threads);
+		return true;
+	}
+	else if (key == "SERIAL_NUM_SLOTS")
+	{
+		convert_ip(value, serial_num_slots);
+		return true;
+	}
 
 	return false;
 }
@@ -1077,6 +1165,13 @@ void PestppOptions::summary(ostream& os) const
 	os << "panther_agent_no_ping_timeout_secs: " << panther_agent_no_ping_timeout_secs << endl;
 	os << "panther_debug_loop: " << panther_debug_loop << endl;
 	os << "panther_echo: " << panther_echo << endl;
+	os << "run_storage_mmap: " << run_storage_mmap << endl;
+	os << "panther_schedule_policy: " << panther_schedule_policy << endl;
+	os << "panther_tail_runs: " << panther_tail_runs << endl;
+	os << "perf_trace: " << perf_trace << endl;
+	os << "model_plugin: " << model_plugin << endl;
+	os << "model_plugin_threads: " << model_plugin_threads << endl;
+	os << "serial_num_slots: " << serial_num_slots << endl;
 
 	os << endl;
 
@@ -1185,7 +1280,12 @@ void PestppOptions::summary(ostream& os) const
 	os << "ies_use_empirical_prior: " << ies_use_empirical_prior << endl;
 	os << "ies_group_draws: " << ies_group_draws << endl;
 	os << "ies_enforce_bounds: " << ies_enforce_bounds << endl;
+	os << "ies_draw_block_size: " << ies_draw_block_size << endl;
+	os << "ies_draw_cache_dir: " << ies_draw_cache_dir << endl;
+	os << "ies_draw_stream_file: " << ies_draw_stream_file << endl;
 	os << "ies_save_binary: " << ies_save_binary << endl;
+	os << "ies_save_columnar: " << ies_save_columnar << endl;
+	os << "ies_columnar_float32: " << ies_columnar_float32 << endl;
 	os << "ies_localizer: " << ies_localizer << endl;
 	os << "ies_accept_phi_fac: " << ies_accept_phi_fac << endl;
 	os << "ies_lambda_inc_fac: " << ies_lambda_inc_fac << endl;
@@ -1219,6 +1319,13 @@ void PestppOptions::summary(ostream& os) const
 	os << "gsa_morris_delta: " <<  gsa_morris_delta << endl;
 	os << "gsa_sobol_samples: " << gsa_sobol_samples << endl;
 	os << "gsa_sobol_par_dist: " << gsa_sobol_par_dist << endl;
+	os << "gsa_sobol_num_threads: " << gsa_sobol_num_threads << endl;
+	os << "gsa_sobol_sampling: " << gsa_sobol_sampling << endl;
+	os << "gsa_sobol_scramble: " << gsa_sobol_scramble << endl;
+	os << "gsa_sobol_scheme: " << gsa_sobol_scheme << endl;
+	os << "gsa_sobol_block_samples: " << gsa_sobol_block_samples << endl;
+	os << "gsa_sobol_conf_width: " << gsa_sobol_conf_width << endl;
+	os << "gsa_sobol_bootstrap: " << gsa_sobol_bootstrap << endl;
 
 	
 	os << "panther_agent_freeze_on_fail: " << panther_debug_fail_freeze << endl;
@@ -1309,8 +1416,13 @@ void PestppOptions::set_defaults()
 	set_ies_use_empirical_prior(false);
 	set_ies_group_draws(true);
 	set_ies_enforce_bounds(true);
+	set_ies_draw_block_size(0);
+	set_ies_draw_cache_dir("");
+	set_ies_draw_stream_file("");
 	set_par_sigma_range(4.0);
 	set_ies_save_binary(false);
+	set_ies_save_columnar(false);
+	set_ies_columnar_float32(false);
 	set_ies_localizer("");
 	set_ies_accept_phi_fac(1.05);
 	set_ies_lambda_inc_fac(10.0);
@@ -1345,6 +1457,13 @@ void PestppOptions::set_defaults()
 	set_gsa_morris_pooled_obs(false);
 	set_gsa_sobol_par_dist("norm");
 	set_gsa_sobol_samples(4);
+	set_gsa_sobol_num_threads(-1);
+	set_gsa_sobol_sampling("random");
+	set_gsa_sobol_scramble(true);
+	set_gsa_sobol_scheme("saltelli");
+	set_gsa_sobol_block_samples(0);
+	set_gsa_sobol_conf_width(0.05);
+	set_gsa_sobol_bootstrap(100);
 
 	set_condor_submit_file(string());
 	set_overdue_giveup_minutes(1.0e+30);
@@ -1363,6 +1482,13 @@ void PestppOptions::set_defaults()
 	set_panther_debug_loop(false);
 	set_panther_debug_fail_freeze(false);
 	set_panther_echo(true);
+	set_run_storage_mmap(false);
+	set_panther_schedule_policy("fifo");
+	set_panther_tail_runs(0);
+	set_perf_trace(false);
+	set_model_plugin("");
+	set_model_plugin_threads(-1);
+	set_serial_num_slots(1);
 }
 
 ostream& operator<< (ostream &os, const ParameterInfo& val)
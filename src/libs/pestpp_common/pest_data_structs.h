@@ -360,11 +360,21 @@ public:
 	void set_ies_group_draws(bool _ies_group_draws) { ies_group_draws = _ies_group_draws; }
 	bool get_ies_enforce_bounds() const { return ies_enforce_bounds; }
 	void set_ies_enforce_bounds(bool _ies_enforce_bounds) { ies_enforce_bounds = _ies_enforce_bounds; }
+	int get_ies_draw_block_size() const { return ies_draw_block_size; }
+	void set_ies_draw_block_size(int _block_size) { ies_draw_block_size = _block_size; }
+	string get_ies_draw_cache_dir() const { return ies_draw_cache_dir; }
+	void set_ies_draw_cache_dir(string _dir) { ies_draw_cache_dir = _dir; }
+	string get_ies_draw_stream_file() const { return ies_draw_stream_file; }
+	void set_ies_draw_stream_file(string _file) { ies_draw_stream_file = _file; }
 
 	double get_par_sigma_range() const { return par_sigma_range; }
 	void set_par_sigma_range(double _par_sigma_range) { par_sigma_range = _par_sigma_range; }
 	bool get_ies_save_binary() const { return ies_save_binary; }
 	void set_ies_save_binary(bool _ies_save_binary) { ies_save_binary = _ies_save_binary; }
+	bool get_ies_save_columnar() const { return ies_save_columnar; }
+	void set_ies_save_columnar(bool _ies_save_columnar) { ies_save_columnar = _ies_save_columnar; }
+	bool get_ies_columnar_float32() const { return ies_columnar_float32; }
+	void set_ies_columnar_float32(bool _ies_columnar_float32) { ies_columnar_float32 = _ies_columnar_float32; }
 	string get_ies_localizer() const { return ies_localizer; }
 	void set_ies_localizer(string _ies_localizer) { ies_localizer = _ies_localizer; }
 	double get_ies_accept_phi_fac() const { return ies_accept_phi_fac; }
@@ -434,6 +444,20 @@ public:
 	void set_gsa_sobol_samples(int _s) { gsa_sobol_samples = _s; }
 	string get_gsa_sobol_par_dist() const { return gsa_sobol_par_dist; }
 	void set_gsa_sobol_par_dist(string _d) { gsa_sobol_par_dist = _d; }
+	int get_gsa_sobol_num_threads() const { return gsa_sobol_num_threads; }
+	void set_gsa_sobol_num_threads(int _n) { gsa_sobol_num_threads = _n; }
+	string get_gsa_sobol_sampling() const { return gsa_sobol_sampling; }
+	void set_gsa_sobol_sampling(string _s) { gsa_sobol_sampling = _s; }
+	bool get_gsa_sobol_scramble() const { return gsa_sobol_scramble; }
+	void set_gsa_sobol_scramble(bool _flag) { gsa_sobol_scramble = _flag; }
+	string get_gsa_sobol_scheme() const { return gsa_sobol_scheme; }
+	void set_gsa_sobol_scheme(string _s) { gsa_sobol_scheme = _s; }
+	int get_gsa_sobol_block_samples() const { return gsa_sobol_block_samples; }
+	void set_gsa_sobol_block_samples(int _n) { gsa_sobol_block_samples = _n; }
+	double get_gsa_sobol_conf_width() const { return gsa_sobol_conf_width; }
+	void set_gsa_sobol_conf_width(double _w) { gsa_sobol_conf_width = _w; }
+	int get_gsa_sobol_bootstrap() const { return gsa_sobol_bootstrap; }
+	void set_gsa_sobol_bootstrap(int _n) { gsa_sobol_bootstrap = _n; }
 
 	set<string> get_passed_args() const { return passed_args; }
 	map<string, string> get_arg_map()const { return arg_map; }
@@ -467,6 +491,21 @@ public:
 	bool get_panther_echo() const { return panther_echo; }
 	void set_panther_echo(bool _flag) { panther_echo = _flag; }
 
+	bool get_run_storage_mmap() const { return run_storage_mmap; }
+	void set_run_storage_mmap(bool _flag) { run_storage_mmap = _flag; }
+	string get_panther_schedule_policy() const { return panther_schedule_policy; }
+	void set_panther_schedule_policy(string _policy) { panther_schedule_policy = _policy; }
+	int get_panther_tail_runs() const { return panther_tail_runs; }
+	void set_panther_tail_runs(int _tail_runs) { panther_tail_runs = _tail_runs; }
+	bool get_perf_trace() const { return perf_trace; }
+	void set_perf_trace(bool _flag) { perf_trace = _flag; }
+	string get_model_plugin() const { return model_plugin; }
+	void set_model_plugin(string _plugin) { model_plugin = _plugin; }
+	int get_model_plugin_threads() const { return model_plugin_threads; }
+	void set_model_plugin_threads(int _threads) { model_plugin_threads = _threads; }
+	int get_serial_num_slots() const { return serial_num_slots; }
+	void set_serial_num_slots(int _slots) { serial_num_slots = _slots; }
+
 	void set_forgive_unknown_args(bool _flag) { forgive_unknown_args = _flag; }
 	bool get_forgive_unknown_args() const { return forgive_unknown_args; }
 
@@ -571,8 +610,13 @@ private:
 	bool ies_group_draws;
 	//bool ies_num_reals_passed;
 	bool ies_enforce_bounds;
+	int ies_draw_block_size;
+	string ies_draw_cache_dir;
+	string ies_draw_stream_file;
 	double par_sigma_range;
 	bool ies_save_binary;
+	bool ies_save_columnar;
+	bool ies_columnar_float32;
 	string ies_localizer;
 	double ies_accept_phi_fac;
 	double ies_lambda_inc_fac;
@@ -607,12 +651,26 @@ private:
 	bool gsa_morris_obs_sen;
 	double gsa_morris_delta;
 	string gsa_sobol_par_dist;
+	int gsa_sobol_num_threads;
+	string gsa_sobol_sampling;
+	bool gsa_sobol_scramble;
+	string gsa_sobol_scheme;
+	int gsa_sobol_block_samples;
+	double gsa_sobol_conf_width;
+	int gsa_sobol_bootstrap;
 
 	bool panther_agent_restart_on_error;
 	int panther_agent_no_ping_timeout_secs;
 	bool panther_debug_loop;
 	bool panther_debug_fail_freeze;
 	bool panther_echo;
+	bool run_storage_mmap;
+	string panther_schedule_policy;
+	int panther_tail_runs;
+	bool perf_trace;
+	string model_plugin;
+	int model_plugin_threads;
+	int serial_num_slots;
 };
 //ostream& operator<< (ostream &os, const PestppOptions& val);
 ostream& operator<< (ostream &os, const ObservationInfo& val);
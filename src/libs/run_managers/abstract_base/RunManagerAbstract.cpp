@@ -33,7 +33,8 @@ RunManagerAbstract::RunManagerAbstract(const vector<string> _comline_vec,
 	const string &stor_filename, int _max_n_failure)
   : total_runs(0), max_n_failure(_max_n_failure), file_stor(stor_filename),
     comline_vec(_comline_vec), tplfile_vec(_tplfile_vec),
-    inpfile_vec(_inpfile_vec), insfile_vec(_insfile_vec), outfile_vec(_outfile_vec)
+    inpfile_vec(_inpfile_vec), insfile_vec(_insfile_vec), outfile_vec(_outfile_vec),
+    performance_log(nullptr)
 {
 	cout << endl;
 	cout << "             Generalized Run Manager Interface" << endl;
@@ -85,6 +86,11 @@ int RunManagerAbstract::add_run(const Eigen::VectorXd &model_pars, const string
 	return run_id;
 }
 
+vector<int> RunManagerAbstract::add_runs(const Eigen::MatrixXd &model_pars, const vector<string> &info_txt, const vector<double> &info_value)
+{
+	return file_stor.add_runs(model_pars, info_txt, info_value);
+}
+
 void RunManagerAbstract::update_run(int run_id, const Parameters &pars, const Observations &obs)
 {
 
@@ -164,7 +170,6 @@ bool  RunManagerAbstract::get_run(int run_id, double *pars, size_t npars, double
 	return get_run(run_id, pars, npars, obs, nobs, info_txt, info_value);
 }
 
-
 void  RunManagerAbstract::free_memory()
 {
 }
@@ -235,6 +240,14 @@ bool RunManagerAbstract::get_observations_vec(int run_id, vector<double> &data_v
 	return success;
 }
 
+bool RunManagerAbstract::get_observations_view(int run_id, const double* &obs_ptr)
+{
+	bool success = false;
+	int status = file_stor.get_observations_view(run_id, obs_ptr);
+	if (status > 0) success = true;
+	return success;
+}
+
  Observations RunManagerAbstract::get_obs_template(double value) const
  {
 	Observations ret_obs;
@@ -295,3 +308,8 @@ bool RunManagerAbstract::get_observations_vec(int run_id, vector<double> &data_v
 	 run();
 	 return RUN_UNTIL_COND::NORMAL;
  }
+
+ RunManagerAbstract::RUN_UNTIL_COND RunManagerAbstract::resume_run_until(RUN_UNTIL_COND condition, int n_nops, double sec)
+ {
+	 return run_until(condition, n_nops, sec);
+ }
@@ -31,6 +31,7 @@
 class ModelExecInfo;
 class Parameters;
 class Observations;
+class PerformanceLog;
 
 
 class RunManagerAbstract
@@ -49,9 +50,17 @@ public:
 	virtual int add_run(const Parameters &model_pars, const std::string &info_txt="", double info_value=RunStorage::no_data);
 	virtual int add_run(const std::vector<double> &model_pars, const std::string &info_txt="", double info_valuee=RunStorage::no_data);
 	virtual int add_run(const Eigen::VectorXd &model_pars, const std::string &info_txt="", double info_valuee=RunStorage::no_data);
+	//queue one run per row of model_pars (columns in get_par_name_vec() order) in a single
+	//batch and return the run ids.  info_txt and info_value are empty or one entry per row
+	virtual std::vector<int> add_runs(const Eigen::MatrixXd &model_pars, const std::vector<std::string> &info_txt = std::vector<std::string>(),
+		const std::vector<double> &info_value = std::vector<double>());
 	virtual void update_run(int run_id, const Parameters &pars, const Observations &obs);
 	virtual void run() = 0;
 	virtual RunManagerAbstract::RUN_UNTIL_COND run_until(RUN_UNTIL_COND condition, int n_nops = 0, double sec = 0.0);
+	//same as run_until(), except that a call following a TIME or NO_OPS return carries on with
+	//the runs still in flight instead of starting the run group over.  run managers that always
+	//run to completion just call run_until()
+	virtual RunManagerAbstract::RUN_UNTIL_COND resume_run_until(RUN_UNTIL_COND condition, int n_nops = 0, double sec = 0.0);
 	virtual const std::vector<std::string> &get_par_name_vec() const;
 	virtual const std::vector<std::string> &get_obs_name_vec() const;
 	virtual void get_info(int run_id, int &run_status, std::string &info_txt, double &info_value);
@@ -76,10 +85,14 @@ public:
 	virtual ~RunManagerAbstract(void) {}
 	virtual std::string get_run_filename() { return file_stor.get_filename(); }
 	virtual const RunStorage& get_runstorage_ref() const;
+	virtual void set_storage_engine(RunStorage::Engine engine) { file_stor.set_engine(engine); }
+	virtual bool get_observations_view(int run_id, const double* &obs_ptr);
 	virtual void print_run_summary(std::ostream &fout) { file_stor.print_run_summary(fout); }
 	//virtual Observations get_init_run_obs() { return init_run_obs; }
 	virtual std::vector<double> get_init_sim() { return init_sim;  }
 	virtual void set_init_sim(std::vector<double> _init_sim) { init_sim = _init_sim; }
+	//phase timings (and trace events) of the run manager go to this log, if set
+	void set_performance_log(PerformanceLog *_performance_log) { performance_log = _performance_log; }
 
 protected:
 	int total_runs;
@@ -94,6 +107,7 @@ protected:
 	bool run_requried(int run_id);
 	//Observations init_run_obs;
 	std::vector<double> init_sim;
+	PerformanceLog *performance_log;
 	virtual void update_run_failed(int run_id);
 };
 
@@ -21,47 +21,215 @@
 #include <sstream>
 #include <cstdio>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include "config_os.h"
 #include "RunStorage.h"
 #include "Serialization.h"
 #include "Transformable.h"
 #include <limits>
 
+#ifdef OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 using std::numeric_limits;
 
 using namespace std;
 
 const double RunStorage::no_data = -9999.0;
+const std::streamoff RunStorage::min_map_size = 1048576;
 
-RunStorage::RunStorage(const string &_filename) :filename(_filename), run_byte_size(0)
+RunStorage::RunStorage(const string &_filename, Engine _engine) :filename(_filename), engine(Engine::STREAM),
+	map_fd(-1), map_base(nullptr), map_size(0), run_byte_size(0)
 {
+	set_engine(_engine);
 }
 
-void RunStorage::reset(const vector<string> &_par_names, const vector<string> &_obs_names, const string &_filename)
+void RunStorage::set_engine(Engine _engine)
 {
-	par_names = _par_names;
-	obs_names = _obs_names;
-	// a file needs to exist before it can be opened it with read and write
-	// permission.   So open it with write permission to crteate it, close
-	// and then reopen it with read and write permisssion.
-	if (_filename.size() > 0)
+	if (is_open())
 	{
-		filename = _filename;
+		throw PestError("Error in RunStorage routine.  The storage engine can not be changed while the file is open");
+	}
+#ifndef OS_LINUX
+	if (_engine == Engine::MMAP)
+	{
+		cout << "WARNING: memory-mapped run storage is not supported on this platform, using stream-based run storage" << endl;
+		_engine = Engine::STREAM;
 	}
+#endif
+	engine = _engine;
+}
+
+bool RunStorage::is_open() const
+{
+	return buf_stream.is_open() || (map_base.load() != nullptr);
+}
+
+void RunStorage::open_file(bool truncate)
+{
+	close_file();
+	if (engine == Engine::MMAP)
+	{
+#ifdef OS_LINUX
+		int flags = O_RDWR;
+		if (truncate)
+		{
+			flags |= O_CREAT | O_TRUNC;
+		}
+		map_fd = ::open(filename.c_str(), flags, 0644);
+		struct stat f_stat;
+		if ((map_fd < 0) || (fstat(map_fd, &f_stat) != 0))
+		{
+			throw PestFileError(filename);
+		}
+		map_file(f_stat.st_size);
+#endif
+	}
+	else
+	{
+		// a file needs to exist before it can be opened it with read and write
+		// permission.   So open it with write permission to create it, close
+		// and then reopen it with read and write permisssion.
+		if (truncate)
+		{
+			buf_stream.open(filename.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+			buf_stream.close();
+		}
+		buf_stream.open(filename.c_str(), ios_base::out | ios_base::in | ios_base::binary);
+		assert(buf_stream.good() == true);
+		if (!buf_stream.good())
+		{
+			throw PestFileError(filename);
+		}
+	}
+}
+
+void RunStorage::close_file()
+{
 	if (buf_stream.is_open())
 	{
 		buf_stream.close();
 	}
-	buf_stream.open(filename.c_str(), ios_base::out |  ios_base::binary);
-        buf_stream.close();
-	buf_stream.open(filename.c_str(), ios_base::out | ios_base::in | ios_base::binary);
-	assert(buf_stream.good() == true);
-	if (!buf_stream.good())
+#ifdef OS_LINUX
+	char *base = map_base.load();
+	if (base != nullptr)
+	{
+		// trim the capacity padding so the closed file only holds the header, the runs and the end-of-file buffer
+		std::int64_t n_runs_64;
+		memcpy(&n_runs_64, base, sizeof(n_runs_64));
+		std::streamoff used_size = map_size;
+		if (run_byte_size > 0)
+		{
+			used_size = min(map_size, get_stream_pos(n_runs_64) + run_byte_size);
+		}
+		map_base.store(nullptr);
+		munmap(base, map_size);
+		for (auto &m : retired_maps)
+		{
+			munmap(m.first, m.second);
+		}
+		retired_maps.clear();
+		map_size = 0;
+		if (ftruncate(map_fd, used_size) != 0)
+		{
+			cout << "WARNING: unable to trim run storage file " << filename << endl;
+		}
+	}
+	if (map_fd >= 0)
+	{
+		::close(map_fd);
+		map_fd = -1;
+	}
+#endif
+}
+
+void RunStorage::map_file(std::streamoff min_size)
+{
+#ifdef OS_LINUX
+	// grow geometrically so that adding runs one at a time only remaps O(log(nruns)) times
+	std::streamoff new_size = max(min_size, max(2 * map_size, min_map_size));
+	if (ftruncate(map_fd, new_size) != 0)
+	{
+		throw PestError("Error in RunStorage routine.  Unable to resize memory-mapped file " + filename);
+	}
+	void *ptr = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, map_fd, 0);
+	if (ptr == MAP_FAILED)
+	{
+		throw PestError("Error in RunStorage routine.  Unable to memory-map file " + filename);
+	}
+	// the old mapping is retired rather than unmapped so that concurrent readers
+	// and outstanding observation views stay valid; both mappings share the page cache
+	char *old_base = map_base.load();
+	if (old_base != nullptr)
+	{
+		retired_maps.push_back(make_pair(old_base, map_size));
+	}
+	map_size = new_size;
+	map_base.store(static_cast<char*>(ptr));
+#endif
+}
+
+void RunStorage::read_bytes(std::streamoff pos, void *dest, std::streamoff n_bytes) const
+{
+	if (engine == Engine::MMAP)
+	{
+		memcpy(dest, map_base.load() + pos, n_bytes);
+	}
+	else
+	{
+		buf_stream.seekg(pos, ios_base::beg);
+		buf_stream.read(reinterpret_cast<char*>(dest), n_bytes);
+	}
+}
+
+void RunStorage::write_bytes(std::streamoff pos, const void *src, std::streamoff n_bytes)
+{
+	if (engine == Engine::MMAP)
+	{
+		if (pos + n_bytes > map_size)
+		{
+			map_file(pos + n_bytes);
+		}
+		memcpy(map_base.load() + pos, src, n_bytes);
+	}
+	else
 	{
-		throw PestFileError(filename);
+		buf_stream.seekp(pos, ios_base::beg);
+		buf_stream.write(reinterpret_cast<const char*>(src), n_bytes);
 	}
+}
+
+void RunStorage::flush_bytes()
+{
+	// dirty pages of a shared mapping are written back by the kernel even if the process dies,
+	// so only the stream engine needs an explicit flush
+	if (engine == Engine::STREAM)
+	{
+		buf_stream.flush();
+	}
+}
+
+void RunStorage::write_buf_status(std::int8_t buf_status)
+{
+	write_bytes(get_stream_pos(get_nruns()), &buf_status, sizeof(buf_status));
+}
+
+void RunStorage::reset(const vector<string> &_par_names, const vector<string> &_obs_names, const string &_filename)
+{
+	par_names = _par_names;
+	obs_names = _obs_names;
+	if (_filename.size() > 0)
+	{
+		filename = _filename;
+	}
+	open_file(true);
 	// calculate the number of bytes required to store parameter names
 	vector<int8_t> serial_pnames(Serialization::serialize(par_names));
 	std::int64_t p_name_size_64 = serial_pnames.size() * sizeof(char);
@@ -78,19 +246,21 @@ void RunStorage::reset(const vector<string> &_par_names, const vector<string> &_
 	beg_run0 = 4 * sizeof(std::int64_t) + serial_pnames.size() + serial_onames.size();
 	std::int64_t n_runs_64=0;
 	// write header to file
-	buf_stream.seekp(0, ios_base::beg);
-	buf_stream.write((char*) &n_runs_64, sizeof(n_runs_64));
-	buf_stream.write((char*) &run_size_64, sizeof(run_size_64));
-	buf_stream.write((char*) &p_name_size_64, sizeof(p_name_size_64));
-	buf_stream.write((char*) &o_name_size_64, sizeof(o_name_size_64));
-	buf_stream.write((char*)serial_pnames.data(), serial_pnames.size());
-	buf_stream.write((char*)serial_onames.data(), serial_onames.size());
+	std::streamoff pos = 0;
+	write_bytes(pos, &n_runs_64, sizeof(n_runs_64));
+	pos += sizeof(n_runs_64);
+	write_bytes(pos, &run_size_64, sizeof(run_size_64));
+	pos += sizeof(run_size_64);
+	write_bytes(pos, &p_name_size_64, sizeof(p_name_size_64));
+	pos += sizeof(p_name_size_64);
+	write_bytes(pos, &o_name_size_64, sizeof(o_name_size_64));
+	pos += sizeof(o_name_size_64);
+	write_bytes(pos, serial_pnames.data(), serial_pnames.size());
+	pos += serial_pnames.size();
+	write_bytes(pos, serial_onames.data(), serial_onames.size());
 	//add flag for double buffering
-	std::int8_t buf_status = 0;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	write_buf_status(0);
+	flush_bytes();
 }
 
 
@@ -100,41 +270,35 @@ void RunStorage::init_restart(const std::string &_filename)
 	par_names.clear();
 	obs_names.clear();
 
-	if (buf_stream.is_open())
-	{
-		buf_stream.close();
-	}
-
-	buf_stream.open(filename.c_str(), ios_base::out | ios_base::in | ios_base::binary | ios_base::ate);
-	assert(buf_stream.good() == true);
-	if (!buf_stream.good())
-	{
-		throw PestFileError(filename);
-	}
+	open_file(false);
 	// read header
-	buf_stream.seekg(0, ios_base::beg);
-
+	std::streamoff pos = 0;
 	std::int64_t n_runs_64;
-	buf_stream.read((char*) &n_runs_64, sizeof(n_runs_64));
+	read_bytes(pos, &n_runs_64, sizeof(n_runs_64));
+	pos += sizeof(n_runs_64);
 
 	std::int64_t  run_size_64;
-	buf_stream.read((char*) &run_size_64, sizeof(run_size_64));
+	read_bytes(pos, &run_size_64, sizeof(run_size_64));
+	pos += sizeof(run_size_64);
 	run_byte_size = run_size_64;
 
 	std::int64_t p_name_size_64;
-	buf_stream.read((char*) &p_name_size_64, sizeof(p_name_size_64));
+	read_bytes(pos, &p_name_size_64, sizeof(p_name_size_64));
+	pos += sizeof(p_name_size_64);
 
 	std::int64_t o_name_size_64;
-	buf_stream.read((char*) &o_name_size_64, sizeof(o_name_size_64));
+	read_bytes(pos, &o_name_size_64, sizeof(o_name_size_64));
+	pos += sizeof(o_name_size_64);
 
 	vector<int8_t> serial_pnames;
 	serial_pnames.resize(p_name_size_64);
-	buf_stream.read((char *)serial_pnames.data(), serial_pnames.size());
+	read_bytes(pos, serial_pnames.data(), serial_pnames.size());
+	pos += serial_pnames.size();
 	Serialization::unserialize(serial_pnames, par_names);
 
 	vector<int8_t> serial_onames;
 	serial_onames.resize(o_name_size_64);
-	buf_stream.read((char *)serial_onames.data(), serial_onames.size());
+	read_bytes(pos, serial_onames.data(), serial_onames.size());
 	Serialization::unserialize(serial_onames, obs_names);
 
 	beg_run0 = 4 * sizeof(std::int64_t) + serial_pnames.size() + serial_onames.size();
@@ -147,45 +311,42 @@ void RunStorage::init_restart(const std::string &_filename)
 	std::int32_t buf_run_id = 0;
 
 	int end_of_runs = get_nruns();
-	buf_stream.seekg(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
+	std::streamoff buf_pos = get_stream_pos(end_of_runs);
+	read_bytes(buf_pos, &buf_status, sizeof(buf_status));
 	if (buf_status == 1 || buf_status == 2)
 	{
-		buf_stream.read(reinterpret_cast<char*>(&buf_run_id), sizeof(buf_run_id));
-		buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
+		buf_pos += sizeof(buf_status);
+		read_bytes(buf_pos, &buf_run_id, sizeof(buf_run_id));
+		buf_pos += sizeof(buf_run_id);
+		read_bytes(buf_pos, &r_status, sizeof(r_status));
+		buf_pos += sizeof(r_status);
 		check_rec_id(buf_run_id);
 		size_t n_par = par_names.size();
 		size_t n_obs = obs_names.size();
 		vector<double> pars_vec(n_par, Parameters::no_data);
 		vector<double> obs_vec(n_obs, Observations::no_data);
 
-		buf_stream.read(reinterpret_cast<char*>(pars_vec.data()), n_par * sizeof(double));
-		buf_stream.read(reinterpret_cast<char*>(obs_vec.data()), n_obs * sizeof(double));
+		read_bytes(buf_pos, pars_vec.data(), n_par * sizeof(double));
+		read_bytes(buf_pos + n_par * sizeof(double), obs_vec.data(), n_obs * sizeof(double));
 
-		//write data
-		buf_stream.seekp(get_stream_pos(buf_run_id), ios_base::beg);
-		buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-		//skip over info_txt and info_value fields
-		buf_stream.seekp(sizeof(char)*info_txt_length + sizeof(double), ios_base::cur);
-		buf_stream.write(reinterpret_cast<char*>(pars_vec.data()), pars_vec.size() * sizeof(double));
-		buf_stream.write(reinterpret_cast<char*>(obs_vec.data()), obs_vec.size() * sizeof(double));
-		buf_stream.flush();
+		//write data, skipping over info_txt and info_value fields
+		std::streamoff run_pos = get_stream_pos(buf_run_id);
+		std::streamoff data_pos = run_pos + sizeof(r_status) + sizeof(char)*info_txt_length + sizeof(double);
+		write_bytes(run_pos, &r_status, sizeof(r_status));
+		write_bytes(data_pos, pars_vec.data(), pars_vec.size() * sizeof(double));
+		write_bytes(data_pos + pars_vec.size() * sizeof(double), obs_vec.data(), obs_vec.size() * sizeof(double));
+		flush_bytes();
 		//reset flag for buffer at end of file to 0 to signal it is no longer relavent
-		buf_status = 0;
-		buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-		buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-		buf_stream.flush();
+		write_buf_status(0);
+		flush_bytes();
 	}
 }
 
 int RunStorage::get_nruns()
 {
-	streamoff init_pos = buf_stream.tellg();
-	buf_stream.seekg(0, ios_base::beg);
 	std::int64_t n_runs_64;
-	buf_stream.read((char*) &n_runs_64, sizeof(n_runs_64));
+	read_bytes(0, &n_runs_64, sizeof(n_runs_64));
 	int n_runs = n_runs_64;
-	buf_stream.seekg(init_pos);
 	return n_runs;
 }
 
@@ -205,14 +366,12 @@ int RunStorage::get_num_good_runs()
 }
 int RunStorage::increment_nruns()
 {
-	buf_stream.seekg(0, ios_base::beg);
 	std::int64_t n_runs_64;
-	buf_stream.read((char*) &n_runs_64, sizeof(n_runs_64));
+	read_bytes(0, &n_runs_64, sizeof(n_runs_64));
 	++n_runs_64;
-	buf_stream.seekp(0, ios_base::beg);
-	buf_stream.write((char*) &n_runs_64, sizeof(n_runs_64));
+	write_bytes(0, &n_runs_64, sizeof(n_runs_64));
 	int n_runs = n_runs_64;
-	buf_stream.flush();
+	flush_bytes();
 	return n_runs;
 }
 const std::vector<string>& RunStorage::get_par_name_vec()const
@@ -231,46 +390,120 @@ streamoff RunStorage::get_stream_pos(int run_id)
 	return pos;
 }
 
- int RunStorage::add_run(const vector<double> &model_pars, const string &info_txt, double info_value)
- {
+streamoff RunStorage::get_obs_pos(int run_id)
+{
+	streamoff pos = get_stream_pos(run_id) + sizeof(std::int8_t) + sizeof(char)*info_txt_length + sizeof(double) + run_par_byte_size;
+	return pos;
+}
+
+int RunStorage::add_run(const double *model_pars, size_t npars, const string &info_txt, double info_value)
+{
 	std::int8_t r_status = 0;
-	int run_id = increment_nruns() - 1;
+	// write the record before publishing the new run count so concurrent readers never see a partial record
+	int run_id = get_nruns();
 	vector<char> info_txt_buf;
 	info_txt_buf.resize(info_txt_length, '\0');
 	copy_n(info_txt.begin(), min(info_txt.size(), size_t(info_txt_length)-1) , info_txt_buf.begin());
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.write(reinterpret_cast<char*>(info_txt_buf.data()), sizeof(char)*info_txt_buf.size());
-	buf_stream.write(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.write(reinterpret_cast<const char*>(&model_pars[0]), model_pars.size()*sizeof(double));
+	std::streamoff pos = get_stream_pos(run_id);
+	write_bytes(pos, &r_status, sizeof(r_status));
+	pos += sizeof(r_status);
+	write_bytes(pos, info_txt_buf.data(), sizeof(char)*info_txt_buf.size());
+	pos += sizeof(char)*info_txt_buf.size();
+	write_bytes(pos, &info_value, sizeof(double));
+	pos += sizeof(double);
+	write_bytes(pos, model_pars, npars*sizeof(double));
+	increment_nruns();
 	//add flag for double buffering
-	std::int8_t buf_status = 0;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	write_buf_status(0);
+	flush_bytes();
 	return run_id;
+}
+
+vector<int> RunStorage::add_runs(const Eigen::MatrixXd &model_pars, const vector<string> &info_txt, const vector<double> &info_value)
+{
+	//upper bound on the size of one block write
+	const std::streamoff max_block_bytes = 32 * 1024 * 1024;
+	size_t nruns = model_pars.rows();
+	size_t npars = par_names.size();
+	if ((nruns > 0) && (model_pars.cols() != npars))
+	{
+		throw(PestIndexError("RunStorage::add_runs: parameter dimension in incorrect"));
+	}
+	if ((!info_txt.empty()) && (info_txt.size() != nruns))
+	{
+		throw(PestIndexError("RunStorage::add_runs: info_txt dimension in incorrect"));
+	}
+	if ((!info_value.empty()) && (info_value.size() != nruns))
+	{
+		throw(PestIndexError("RunStorage::add_runs: info_value dimension in incorrect"));
+	}
+	vector<int> run_ids;
+	if (nruns == 0)
+		return run_ids;
+	int first_id = get_nruns();
+	std::streamoff head_byte_size = sizeof(std::int8_t) + sizeof(char)*info_txt_length + sizeof(double);
+	std::streamoff rec_used_size = head_byte_size + run_par_byte_size;
+	// whole records (including the empty observation space) are written back to back unless
+	// most of each record is observation space, in which case only the used part of each
+	// record is written so the batch costs no more file space than adding the runs one at a time
+	bool contiguous = (2 * rec_used_size >= run_byte_size);
+	std::streamoff rec_stride = contiguous ? run_byte_size : rec_used_size;
+	size_t block_runs = 1;
+	if (contiguous)
+		block_runs = max(size_t(1), min(nruns, size_t(max_block_bytes / run_byte_size)));
+	vector<char> block;
+	double par_val;
+	for (size_t first = 0; first < nruns; first += block_runs)
+	{
+		size_t n = min(block_runs, nruns - first);
+		//zero filled, so the run status flags are 0 (not run yet)
+		block.assign(n * rec_stride, '\0');
+		for (size_t k = 0; k < n; k++)
+		{
+			char *rec = block.data() + (k * rec_stride);
+			if (!info_txt.empty())
+			{
+				const string &txt = info_txt[first + k];
+				copy_n(txt.begin(), min(txt.size(), size_t(info_txt_length) - 1), rec + sizeof(std::int8_t));
+			}
+			double val = info_value.empty() ? no_data : info_value[first + k];
+			memcpy(rec + sizeof(std::int8_t) + sizeof(char)*info_txt_length, &val, sizeof(double));
+			char *par_rec = rec + head_byte_size;
+			for (size_t j = 0; j < npars; j++)
+			{
+				par_val = model_pars(first + k, j);
+				memcpy(par_rec + (j * sizeof(double)), &par_val, sizeof(double));
+			}
+		}
+		if (contiguous)
+		{
+			write_bytes(get_stream_pos(first_id + first), block.data(), n * rec_stride);
+		}
+		else
+		{
+			for (size_t k = 0; k < n; k++)
+				write_bytes(get_stream_pos(first_id + first + k), block.data() + (k * rec_stride), rec_stride);
+		}
+	}
+	// publish the new run count once, after all the records are written
+	std::int64_t n_runs_64 = first_id + nruns;
+	write_bytes(0, &n_runs_64, sizeof(n_runs_64));
+	write_buf_status(0);
+	flush_bytes();
+	run_ids.resize(nruns);
+	for (size_t i = 0; i < nruns; i++)
+		run_ids[i] = first_id + i;
+	return run_ids;
+}
+
+ int RunStorage::add_run(const vector<double> &model_pars, const string &info_txt, double info_value)
+ {
+	return add_run(model_pars.data(), model_pars.size(), info_txt, info_value);
  }
 
  int RunStorage::add_run(const Eigen::VectorXd &model_pars, const string &info_txt, double info_value)
  {
-	std::int8_t r_status = 0;
-	int run_id = increment_nruns() - 1;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
-	copy_n(info_txt.begin(), min(info_txt.size(), size_t(info_txt_length)-1) , info_txt_buf.begin());
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.write(reinterpret_cast<char*>(info_txt_buf.data()), sizeof(char)*info_txt_buf.size());
-	buf_stream.write(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.write(reinterpret_cast<const char*>(&model_pars(0)), model_pars.size()*sizeof(model_pars(0)));
-	//add flag for double buffering
-	std::int8_t buf_status = 0;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
-	return run_id;
+	return add_run(model_pars.data(), model_pars.size(), info_txt, info_value);
  }
 
 
@@ -283,144 +516,96 @@ int RunStorage::add_run(const Parameters &pars, const string &info_txt, double i
 
 void RunStorage::copy(const RunStorage &rhs_rs)
 {
-	if (buf_stream.is_open())
-	{
-		buf_stream.close();
-	}
-	// std::ofstream::trunc will delete the file if it already exist
-	// a file needs to exist before it can be opened it with read and write
-	// permission.   So open it with write permission to create it, close
-	// and then reopen it with read and write permisssion.
-	buf_stream.open(filename.c_str(), ios_base::out | ios_base::binary | std::ofstream::trunc);
-	buf_stream.close();
-	buf_stream.open(filename.c_str(), ios_base::out | ios_base::in | ios_base::binary);
-	assert(buf_stream.good() == true);
-	if (!buf_stream.good())
+	close_file();
+	// copy rhs runstorage information
 	{
-		throw PestFileError(filename);
+		ifstream f_in(rhs_rs.filename.c_str(), ios_base::in | ios_base::binary);
+		ofstream f_out(filename.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+		if ((!f_in.good()) || (!f_out.good()))
+		{
+			throw PestFileError(filename);
+		}
+		f_out << f_in.rdbuf();
 	}
-
-	// copy rhs runstorage information
-	std::streampos rhs_initial_pos = rhs_rs.buf_stream.tellg();
-	rhs_rs.buf_stream.seekg(0, ios_base::beg);
-	buf_stream << rhs_rs.buf_stream.rdbuf();
-	rhs_rs.buf_stream.seekg(rhs_initial_pos);
+	open_file(false);
 	beg_run0 = rhs_rs.beg_run0;
 	run_byte_size = rhs_rs.run_byte_size;
 	run_par_byte_size = rhs_rs.run_par_byte_size;
-	run_data_byte_size = rhs_rs.run_par_byte_size;
+	run_data_byte_size = rhs_rs.run_data_byte_size;
 	par_names = rhs_rs.par_names;
 	obs_names = rhs_rs.obs_names;
 }
 
-void RunStorage::update_run(int run_id, const Parameters &pars, const Observations &obs)
+void RunStorage::commit_run(int run_id, std::int8_t buf_flag, const void *par_data, const void *obs_data)
 {
 	//set run status flage to complete
 	std::int8_t r_status = 1;
 	check_rec_id(run_id);
-	vector<double> par_data(pars.get_data_vec(par_names));
-	vector<double> obs_data(obs.get_data_vec(obs_names));
-	//write data to buffer at end of file and set buffer flag to 1
-	std::int8_t buf_status = 0;
+	std::streamoff run_obs_byte_size = run_data_byte_size - run_par_byte_size;
+	std::streamoff run_pos = get_stream_pos(run_id);
+	//skip over info_txt and info_value fields
+	std::streamoff data_pos = run_pos + sizeof(r_status) + sizeof(char)*info_txt_length + sizeof(double);
+	if (engine == Engine::MMAP)
+	{
+		// write the results straight into the mapped record and set the status flag last,
+		// an interrupted write then leaves the run flagged as incomplete so the end-of-file buffer is not needed
+		if (par_data) write_bytes(data_pos, par_data, run_par_byte_size);
+		if (obs_data) write_bytes(data_pos + run_par_byte_size, obs_data, run_obs_byte_size);
+		write_bytes(run_pos, &r_status, sizeof(r_status));
+		return;
+	}
+	//write data to buffer at end of file and set buffer flag
 	std::int32_t buf_run_id = run_id;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.write(reinterpret_cast<char*>(&buf_run_id), sizeof(buf_run_id));
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.write(reinterpret_cast<char*>(par_data.data()), par_data.size() * sizeof(double));
-	buf_stream.write(reinterpret_cast<char*>(obs_data.data()), obs_data.size() * sizeof(double));
-	buf_status = 1;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	std::streamoff buf_pos = get_stream_pos(get_nruns());
+	std::streamoff buf_data_pos = buf_pos + 2 * sizeof(std::int8_t) + sizeof(buf_run_id);
+	write_buf_status(0);
+	write_bytes(buf_pos + sizeof(std::int8_t), &buf_run_id, sizeof(buf_run_id));
+	write_bytes(buf_pos + sizeof(std::int8_t) + sizeof(buf_run_id), &r_status, sizeof(r_status));
+	if (par_data) write_bytes(buf_data_pos, par_data, run_par_byte_size);
+	if (obs_data) write_bytes(buf_data_pos + run_par_byte_size, obs_data, run_obs_byte_size);
+	write_buf_status(buf_flag);
+	flush_bytes();
 	//write data
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	//skip over info_txt and info_value fields
-	buf_stream.seekp(sizeof(char)*info_txt_length+sizeof(double), ios_base::cur);
-	buf_stream.write(reinterpret_cast<char*>(par_data.data()), par_data.size() * sizeof(double));
-	buf_stream.write(reinterpret_cast<char*>(obs_data.data()), obs_data.size() * sizeof(double));
-	buf_stream.flush();
+	write_bytes(run_pos, &r_status, sizeof(r_status));
+	if (par_data) write_bytes(data_pos, par_data, run_par_byte_size);
+	if (obs_data) write_bytes(data_pos + run_par_byte_size, obs_data, run_obs_byte_size);
+	flush_bytes();
 	//reset flag for buffer at end of file to 0 to signal it is no longer relavent
-	buf_status = 0;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	write_buf_status(0);
+	flush_bytes();
+}
+
+void RunStorage::update_run(int run_id, const Parameters &pars, const Observations &obs)
+{
+	vector<double> par_data(pars.get_data_vec(par_names));
+	vector<double> obs_data(obs.get_data_vec(obs_names));
+	commit_run(run_id, 1, par_data.data(), obs_data.data());
 }
 
 
 void RunStorage::update_run(int run_id, const Observations &obs)
 {
-	//set run status flage to complete
-	std::int8_t r_status = 1;
-	check_rec_id(run_id);
 	vector<double> obs_data(obs.get_data_vec(obs_names));
-	size_t n_pars = par_names.size();
-
-	//write data to buffer at end of file and set buffer flag to 1
-	std::int8_t buf_status = 0;
-	std::int32_t buf_run_id = run_id;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.write(reinterpret_cast<char*>(&buf_run_id), sizeof(buf_run_id));
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	//skip over parameter section
-	buf_stream.seekp(n_pars * sizeof(double), ios_base::cur);
-	buf_stream.write(reinterpret_cast<char*>(obs_data.data()), obs_data.size() * sizeof(double));
-	buf_status = 1;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
-
-	//write data to main part of file
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	//skip over info_txt and info_value fields
-	buf_stream.seekp(sizeof(char)*info_txt_length + sizeof(double), ios_base::cur);
-	//skip over parameter section
-	buf_stream.seekp(n_pars * sizeof(double), ios_base::cur);
-	buf_stream.write(reinterpret_cast<char*>(obs_data.data()), obs_data.size() * sizeof(double));
-	buf_stream.flush();
-	//reset flag for buffer at end of file to 0 to signal it is no longer relavent
-	buf_status = 0;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	commit_run(run_id, 1, nullptr, obs_data.data());
 }
 
 void RunStorage::update_run(int run_id, const vector<char> serial_data)
 {
-	//set run status flage to complete
-	std::int8_t r_status = 1;
 	check_rec_size(serial_data);
-	check_rec_id(run_id);
-	//write data to buffer at end of file and set buffer flag to 2
-	std::int8_t buf_status = 0;
-	std::int32_t buf_run_id = run_id;
-	int end_of_runs = get_nruns();
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.write(reinterpret_cast<char*>(&buf_run_id), sizeof(buf_run_id));
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.write(serial_data.data(), serial_data.size());
-	buf_status = 2;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
-	//write data
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	//skip over info_txt and info_value fields
-	buf_stream.seekp(sizeof(char)*info_txt_length+sizeof(double), ios_base::cur);
-	buf_stream.write(serial_data.data(), serial_data.size());
-	buf_stream.flush();
-	//reset flag for buffer at end of file to 0 to signal it is no longer relavent
-	buf_status = 0;
-	buf_stream.seekp(get_stream_pos(end_of_runs), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&buf_status), sizeof(buf_status));
-	buf_stream.flush();
+	commit_run(run_id, 2, serial_data.data(), serial_data.data() + run_par_byte_size);
+}
+
+void RunStorage::update_run(int run_id, const double *pars, size_t npars, const double *obs, size_t nobs)
+{
+	if (npars != par_names.size())
+	{
+		throw(PestIndexError("RunStorage::update_run: parameter dimension in incorrect"));
+	}
+	if (nobs != obs_names.size())
+	{
+		throw(PestIndexError("RunStorage::update_run: observation dimension in incorrect"));
+	}
+	commit_run(run_id, 1, pars, obs);
 }
 
 
@@ -432,9 +617,8 @@ void RunStorage::update_run_failed(int run_id)
 		--r_status;
 		check_rec_id(run_id);
 		//update run status flag
-		buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-		buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-		buf_stream.flush();
+		write_bytes(get_stream_pos(run_id), &r_status, sizeof(r_status));
+		flush_bytes();
 	}
 }
 
@@ -443,17 +627,15 @@ void RunStorage::set_run_nfailed(int run_id, int nfail)
 	std::int8_t r_status = -nfail;
 	check_rec_id(run_id);
 	//update run status flag
-	buf_stream.seekp(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.write(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.flush();
+	write_bytes(get_stream_pos(run_id), &r_status, sizeof(r_status));
+	flush_bytes();
 }
 
 std::int8_t RunStorage::get_run_status_native(int run_id)
 {
 	std::int8_t  r_status;
 	check_rec_id(run_id);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
+	read_bytes(get_stream_pos(run_id), &r_status, sizeof(r_status));
 	return r_status;
 }
 
@@ -469,10 +651,12 @@ void RunStorage::get_info(int run_id, int &run_status, string &info_txt, double
 	vector<char> info_txt_buf;
 	info_txt_buf.resize(info_txt_length, '\0');
 
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
+	std::streamoff pos = get_stream_pos(run_id);
+	read_bytes(pos, &r_status, sizeof(r_status));
+	pos += sizeof(r_status);
+	read_bytes(pos, &info_txt_buf[0], sizeof(char)*info_txt_length);
+	pos += sizeof(char)*info_txt_length;
+	read_bytes(pos, &info_value, sizeof(double));
 
 	run_status = r_status;
 	info_txt = info_txt_buf.data();
@@ -506,9 +690,7 @@ int RunStorage::get_run(int run_id, Parameters &pars, Observations &obs, bool cl
 
 int RunStorage::get_run(int run_id, double *pars, size_t npars, double *obs, size_t nobs, string &info_txt, double &info_value)
 {
-	std::int8_t r_status;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
+	int status;
 
 	check_rec_id(run_id);
 
@@ -527,40 +709,22 @@ int RunStorage::get_run(int run_id, double *pars, size_t npars, double *obs, siz
 
 	p_size = min(p_size, npars);
 	o_size = min(o_size, nobs);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.read(reinterpret_cast<char*>(pars), p_size * sizeof(double));
-	buf_stream.read(reinterpret_cast<char*>(obs), o_size * sizeof(double));
-	int status = r_status;
-	info_txt = info_txt_buf.data();
+	get_info(run_id, status, info_txt, info_value);
+	std::streamoff obs_pos = get_obs_pos(run_id);
+	read_bytes(obs_pos - run_par_byte_size, pars, p_size * sizeof(double));
+	read_bytes(obs_pos, obs, o_size * sizeof(double));
 	return status;
 }
 
 int RunStorage::get_run(int run_id, vector<double> &pars_vec, vector<double> &obs_vec, string &info_txt, double &info_value)
 {
-	std::int8_t  r_status;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
-
 	size_t n_par = par_names.size();
 	size_t n_obs = obs_names.size();
 
 	pars_vec.resize(n_par);
 	obs_vec.resize(n_obs);
 
-	check_rec_id(run_id);
-
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.read(reinterpret_cast<char*>(&pars_vec[0]), n_par * sizeof(double));
-	buf_stream.read(reinterpret_cast<char*>(&obs_vec[0]), n_obs * sizeof(double));
-	int status = r_status;
-	info_txt = info_txt_buf.data();
-	return status;
+	return get_run(run_id, pars_vec.data(), n_par, obs_vec.data(), n_obs, info_txt, info_value);
 }
 
 int RunStorage::get_run(int run_id, vector<double> &pars_vec, vector<double> &obs_vec)
@@ -580,60 +744,30 @@ int RunStorage::get_run(int run_id, double *pars, size_t npars, double *obs, siz
 vector<char> RunStorage::get_serial_pars(int run_id)
 {
 	check_rec_id(run_id);
-	std::int8_t r_status;
 
 	vector<char> serial_data;
 	serial_data.resize(run_par_byte_size);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.seekg(sizeof(r_status)+sizeof(char)*info_txt_length+sizeof(double), ios_base::cur);
-	buf_stream.read(serial_data.data(), serial_data.size());
+	read_bytes(get_obs_pos(run_id) - run_par_byte_size, serial_data.data(), serial_data.size());
 	return serial_data;
 }
 
 int  RunStorage::get_parameters(int run_id, Parameters &pars)
 {
-	std::int8_t r_status;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
-	double info_value;
-
-	check_rec_id(run_id);
-
 	size_t n_par = par_names.size();
 	vector<double> par_data;
 	par_data.resize(n_par);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
 
-	buf_stream.read(reinterpret_cast<char*>(par_data.data()), n_par*sizeof(double));
+	int status = get_run_status_native(run_id);
+	read_bytes(get_obs_pos(run_id) - run_par_byte_size, par_data.data(), n_par*sizeof(double));
 	pars.update(par_names, par_data);
-	int status = r_status;
 	return status;
 }
 
 
 int  RunStorage::get_observations(int run_id, Observations &obs)
 {
-	std::int8_t r_status;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
-	double info_value;
-
-	check_rec_id(run_id);
-
-	size_t n_par = par_names.size();
-	size_t n_obs = obs_names.size();
 	vector<double> obs_data;
-	obs_data.resize(n_obs);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.seekg(n_par*sizeof(double), ios_base::cur);
-	buf_stream.read(reinterpret_cast<char*>(obs_data.data()), n_obs*sizeof(double));
-	int status = r_status;
+	int status = get_observations_vec(run_id, obs_data);
 	obs.update(obs_names, obs_data);
 	return status;
 }
@@ -641,30 +775,37 @@ int  RunStorage::get_observations(int run_id, Observations &obs)
 
 int  RunStorage::get_observations_vec(int run_id, vector<double> &obs_data)
 {
-	std::int8_t r_status;
-	vector<char> info_txt_buf;
-	info_txt_buf.resize(info_txt_length, '\0');
-	double info_value;
-
-	check_rec_id(run_id);
-
-	size_t n_par = par_names.size();
 	size_t n_obs = obs_names.size();
 	obs_data.resize(n_obs);
-	buf_stream.seekg(get_stream_pos(run_id), ios_base::beg);
-	buf_stream.read(reinterpret_cast<char*>(&r_status), sizeof(r_status));
-	buf_stream.read(reinterpret_cast<char*>(&info_txt_buf[0]), sizeof(char)*info_txt_length);
-	buf_stream.read(reinterpret_cast<char*>(&info_value), sizeof(double));
-	buf_stream.seekg(n_par*sizeof(double), ios_base::cur);
-	buf_stream.read(reinterpret_cast<char*>(obs_data.data()), n_obs*sizeof(double));
-	int status = r_status;
+
+	int status = get_run_status_native(run_id);
+	read_bytes(get_obs_pos(run_id), obs_data.data(), n_obs*sizeof(double));
+	return status;
+}
+
+int RunStorage::get_observations_view(int run_id, const double* &obs_ptr)
+{
+	// with the memory-mapped engine this is a zero-copy view into the record, valid until the
+	// storage is closed.  Otherwise the values are read into an internal buffer that is reused
+	// by the next call
+	int status = get_run_status_native(run_id);
+	if (engine == Engine::MMAP)
+	{
+		obs_ptr = reinterpret_cast<const double*>(map_base.load() + get_obs_pos(run_id));
+	}
+	else
+	{
+		view_buf.resize(obs_names.size());
+		read_bytes(get_obs_pos(run_id), view_buf.data(), view_buf.size() * sizeof(double));
+		obs_ptr = view_buf.data();
+	}
 	return status;
 }
 
 void RunStorage::free_memory()
 {
-	if (buf_stream.is_open()) {
-		buf_stream.close();
+	if (is_open()) {
+		close_file();
 		remove(filename.c_str());
 	}
 }
@@ -794,4 +935,5 @@ void RunStorage::export_diff_to_text_file(const std::string &in1_filename, const
 RunStorage::~RunStorage()
 {
   //free_memory();
+  close_file();
 }
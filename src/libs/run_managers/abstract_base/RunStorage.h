@@ -25,6 +25,8 @@
 #include <ostream>
 #include <vector>
 #include <cstdint>
+#include <atomic>
+#include <utility>
 #include <Eigen/Dense>
 #include "network_package.h"
 
@@ -50,19 +52,35 @@ class RunStorage {
 	//                   depends on the type of model run being stored  )
 	//       parameter_values  (parameters values for model runs)                     double*number of parameters
 	//       observationn_values( observations results produced by the model run)     double*number of observations
+	//
+	// Two storage engines are available for accessing this layout:
+	//     STREAM  all access goes through a single seek/read/write std::fstream
+	//     MMAP    the file is memory-mapped and grown by remapping (POSIX only).  Reads are plain
+	//             copies out of the mapping and do not require a stream lock.  Previous mappings
+	//             are retired (not unmapped) when the file grows so that pointers returned by
+	//             get_observations_view() remain valid until the storage is closed.
 
 public:
+	enum class Engine { STREAM, MMAP };
 	static const double no_data;
-	RunStorage(const std::string &_filename);
+	RunStorage(const std::string &_filename, Engine _engine = Engine::STREAM);
+	void set_engine(Engine _engine);
+	Engine get_engine() const { return engine; }
 	void reset(const std::vector<std::string> &par_names, const std::vector<std::string> &obs_names, const std::string &_filename = std::string(""));
 	void init_restart(const std::string &_filename);
 	virtual int add_run(const std::vector<double> &model_pars, const std::string &info_txt="", double info_value=no_data);
 	virtual int add_run(const Parameters &pars, const std::string &info_txt="", double info_value=no_data);
 	virtual int add_run(const Eigen::VectorXd &model_pars, const std::string &info_txt="", double info_value=no_data);
+	//add one run per row of model_pars (in par_names order) and return the (consecutive) run ids.
+	//info_txt and info_value must be empty or hold one entry per row.  the records are written
+	//in large contiguous blocks and the run count is only published once all of them are written
+	std::vector<int> add_runs(const Eigen::MatrixXd &model_pars, const std::vector<std::string> &info_txt = std::vector<std::string>(),
+		const std::vector<double> &info_value = std::vector<double>());
 	void copy(const RunStorage &rhs_rs);
 	void update_run(int run_id, const Parameters &pars, const Observations &obs);
 	void update_run(int run_id, const Observations &obs);
 	void update_run(int run_id, const std::vector<char> serial_data);
+	void update_run(int run_id, const double *pars, size_t npars, const double *obs, size_t nobs);
 	void update_run_failed(int run_id);
 	void set_run_nfailed(int run_id, int nfail);
 	int get_nruns();
@@ -82,6 +100,7 @@ public:
 	int get_parameters(int run_id, Parameters &pars);
 	std::vector<char> get_serial_pars(int run_id);
 	int get_observations_vec(int run_id, std::vector<double> &data_vec);
+	int get_observations_view(int run_id, const double* &obs_ptr);
 	int get_observations(int run_id, Observations &obs);
 	static void export_diff_to_text_file(const std::string &in1_filename, const std::string &in2_filename, const std::string &out_filename);
 	void free_memory();
@@ -90,18 +109,36 @@ public:
 	~RunStorage();
 private:
 	static const int info_txt_length = NetPackage::DESC_LEN;
+	static const std::streamoff min_map_size;
 	std::string filename;
+	Engine engine;
 	mutable std::fstream buf_stream;
+	int map_fd;
+	std::atomic<char*> map_base;
+	std::streamoff map_size;
+	std::vector<std::pair<char*, std::streamoff>> retired_maps;
+	std::vector<double> view_buf;
 	std::streamoff beg_run0;
 	std::streamoff run_byte_size;
 	std::streamoff run_par_byte_size;
 	std::streamoff run_data_byte_size;
 	std::vector<std::string> par_names;
 	std::vector<std::string> obs_names;
+	int add_run(const double *model_pars, size_t npars, const std::string &info_txt, double info_value);
+	void commit_run(int run_id, std::int8_t buf_flag, const void *par_data, const void *obs_data);
 	void check_rec_size(const std::vector<char> &serial_data) const;
 	void check_rec_id(int run_id);
 	std::int8_t get_run_status_native(int run_id);
 	std::streamoff get_stream_pos(int run_id);
+	std::streamoff get_obs_pos(int run_id);
+	bool is_open() const;
+	void open_file(bool truncate);
+	void close_file();
+	void map_file(std::streamoff min_size);
+	void read_bytes(std::streamoff pos, void *dest, std::streamoff n_bytes) const;
+	void write_bytes(std::streamoff pos, const void *src, std::streamoff n_bytes);
+	void flush_bytes();
+	void write_buf_status(std::int8_t buf_status);
 };
 
 #endif //RUN_STORAGE_H_
@@ -38,6 +38,9 @@ public:
 	static std::vector<int8_t> serialize(const Parameters &pars, const Observations &obs);
 	static std::vector<int8_t> serialize(const Parameters &pars, const std::vector<std::string> &par_names_vec, const Observations &obs, const std::vector<std::string> &obs_names_vec, double run_time);
 	static std::vector<int8_t> serialize(const std::vector<std::string> &string_vec);
+	//binary run-result layout: [int64 npar][int64 nobs][npar doubles][nobs doubles][double run_time].
+	//values are in the par/obs name order exchanged during the handshake
+	static std::vector<int8_t> serialize_bin(const Parameters &pars, const std::vector<std::string> &par_names_vec, const Observations &obs, const std::vector<std::string> &obs_names_vec, double run_time);
 	static std::vector<int8_t> serialize(const std::vector<std::vector<std::string> const*> &string_vec_vec);
 	static unsigned long unserialize(const std::vector<int8_t> &ser_data, int64_t &data, unsigned long start_loc = 0);
 	static unsigned long unserialize(const std::vector<int8_t> &ser_data, Transformable &tr_data, unsigned long start_loc = 0);
@@ -46,6 +49,9 @@ public:
 	static unsigned long unserialize(const std::vector<int8_t> &ser_data, std::vector<std::string> &string_vec, unsigned long start_loc = 0, unsigned long max_read_bytes = ULONG_MAX);
 	static unsigned long unserialize(const std::vector<int8_t> &ser_data, Transformable &items, const std::vector<std::string> &names_vec, unsigned long start_loc = 0);
 	static unsigned long unserialize(const std::vector<int8_t> &ser_data, Parameters &pars, const std::vector<std::string> &par_names, Observations &obs, const std::vector<std::string> &obs_names, double &run_time);
+	//checks a serialize_bin() buffer against the expected counts and returns pointers into it - no copies are made,
+	//so the pointers are only valid while ser_data is alive and unmodified
+	static void unserialize_bin(const std::vector<int8_t> &ser_data, size_t npar, size_t nobs, const double* &par_data, const double* &obs_data, double &run_time);
 private:
 };
 
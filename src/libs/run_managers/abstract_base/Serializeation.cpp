@@ -155,6 +155,37 @@ vector<int8_t> Serialization::serialize(const Parameters &pars, const vector<str
 	return serial_data;
 }
 
+vector<int8_t> Serialization::serialize_bin(const Parameters &pars, const vector<string> &par_names_vec, const Observations &obs, const vector<string> &obs_names_vec, double run_time)
+{
+	if (pars.size() != par_names_vec.size())
+	{
+		throw runtime_error("Serialization::serialize_bin() error: pars.size() != par_names_vec.size()");
+	}
+	if (obs.size() != obs_names_vec.size())
+	{
+		throw runtime_error("Serialization::serialize_bin() error: obs.size() != obs_names_vec.size()");
+	}
+	int64_t npar = par_names_vec.size();
+	int64_t nobs = obs_names_vec.size();
+	size_t hdr_sz = 2 * sizeof(int64_t);
+	size_t par_buf_sz = npar * sizeof(double);
+	size_t obs_buf_sz = nobs * sizeof(double);
+	vector<int8_t> serial_data(hdr_sz + par_buf_sz + obs_buf_sz + sizeof(double));
+
+	//the header is a multiple of sizeof(double) so the value blocks stay aligned
+	int8_t *buf = &serial_data[0];
+	w_memcpy_s(buf, sizeof(int64_t), &npar, sizeof(int64_t));
+	w_memcpy_s(buf + sizeof(int64_t), sizeof(int64_t), &nobs, sizeof(int64_t));
+	buf += hdr_sz;
+	double *dbuf = (double*)buf;
+	for (auto &pname : par_names_vec)
+		*dbuf++ = pars.get_rec(pname);
+	for (auto &oname : obs_names_vec)
+		*dbuf++ = obs.get_rec(oname);
+	*dbuf = run_time;
+	return serial_data;
+}
+
 vector<int8_t> Serialization::serialize(const vector<string> &string_vec)
 {
 	vector<int8_t> serial_data;
@@ -286,3 +317,32 @@ unsigned long Serialization::unserialize(const vector<int8_t> &ser_data, Paramet
 	w_memcpy_s(&run_time, sizeof(double), ser_data.data() + bytes_read, sizeof(double));
 	return bytes_read;
 }
+
+void Serialization::unserialize_bin(const vector<int8_t> &ser_data, size_t npar, size_t nobs, const double* &par_data, const double* &obs_data, double &run_time)
+{
+	size_t hdr_sz = 2 * sizeof(int64_t);
+	if (ser_data.size() < hdr_sz)
+	{
+		throw runtime_error("Serialization::unserialize_bin() error: buffer too small for header");
+	}
+	int64_t s_npar, s_nobs;
+	w_memcpy_s(&s_npar, sizeof(int64_t), ser_data.data(), sizeof(int64_t));
+	w_memcpy_s(&s_nobs, sizeof(int64_t), ser_data.data() + sizeof(int64_t), sizeof(int64_t));
+	if ((s_npar < 0) || (size_t(s_npar) != npar) || (s_nobs < 0) || (size_t(s_nobs) != nobs))
+	{
+		stringstream ss;
+		ss << "Serialization::unserialize_bin() error: expected " << npar << " pars and " << nobs;
+		ss << " obs, buffer has " << s_npar << " pars and " << s_nobs << " obs";
+		throw runtime_error(ss.str());
+	}
+	size_t expected_sz = hdr_sz + (npar + nobs + 1) * sizeof(double);
+	if (ser_data.size() != expected_sz)
+	{
+		stringstream ss;
+		ss << "Serialization::unserialize_bin() error: expected " << expected_sz << " bytes, buffer has " << ser_data.size();
+		throw runtime_error(ss.str());
+	}
+	par_data = (const double*)(ser_data.data() + hdr_sz);
+	obs_data = par_data + npar;
+	run_time = obs_data[nobs];
+}
@@ -11,6 +11,7 @@
 #include <thread>
 #include <unordered_set>
 #include "model_interface.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
@@ -82,12 +83,14 @@ void ModelInterface::check_tplins(const vector<string> &par_names, const vector<
 {	
 	//rigorous checking of names in tpl and ins files vs control file
 	unordered_set<string> ins_obs_names, file_obs_names;
+	instructionfiles.clear();
 	for (auto ins_file : insfile_vec)
 	{
-		InstructionFile isf(ins_file);
+		InstructionFile isf(ins_file, additional_ins_delimiters);
 		file_obs_names = isf.parse_and_check();
 		ins_obs_names.insert(file_obs_names.begin(), file_obs_names.end());
-		//isf.read_output_file(model_exec_info.outfile_vec[0]);
+		//keep the compiled instructions for the model runs
+		instructionfiles.push_back(isf);
 	}
 	unordered_set<string> pst_obs_names, diff;
 	pst_obs_names.insert(obs_names.begin(), obs_names.end());
@@ -118,11 +121,13 @@ void ModelInterface::check_tplins(const vector<string> &par_names, const vector<
 
 
 	unordered_set<string> tpl_par_names, file_par_names;
+	templatefiles.clear();
 	for (auto tpl_file : tplfile_vec)
 	{
-		TemplateFile tf(tpl_file);
+		TemplateFile tf(tpl_file, fill_tpl_zeros);
 		file_par_names = tf.parse_and_check();
 		tpl_par_names.insert(file_par_names.begin(), file_par_names.end());
+		templatefiles.push_back(tf);
 	}
 	unordered_set<string> pst_par_names;
 	pst_par_names.insert(par_names.begin(), par_names.end());
@@ -154,138 +159,82 @@ void ModelInterface::check_tplins(const vector<string> &par_names, const vector<
 
 
 
-void ModelInterface::run(Parameters* pars, Observations* obs)
+void ModelInterface::set_additional_ins_delimiters(string delims)
 {
-
-	pest_utils::thread_flag terminate(false);
-	pest_utils::thread_flag finished(false);
-	pest_utils::thread_exceptions shared_exceptions;
-
-	run(&terminate, &finished, &shared_exceptions, pars, obs);
-	if (shared_exceptions.size() > 0)
-	{
-		//finalize();
-		shared_exceptions.rethrow();
-	}
-
+	additional_ins_delimiters = delims;
+	for (auto& i : instructionfiles)
+		i.set_additional_delimiters(delims);
 }
 
-void ThreadedInstructionProcess::work(int tid, vector<int>& ins_idx, Observations& obs, string additional_ins_delims)
+void ModelInterface::set_fill_tpl_zeros(bool _flag)
 {
-	int count = 0, i;
-	unique_lock<mutex> obs_guard(obs_lock, defer_lock);
-	unique_lock<mutex> idx_guard(idx_lock, defer_lock);
-	while (true)
-	{
-		i = -999;
-		while (true)
-		{
-			if (idx_guard.try_lock())
-			{
-				if (ins_idx.size() == 0)
-				{
-					cout << "thread " << tid << " processed " << count << " instruction files" << endl;
-					return;
-				}
-				i = ins_idx[ins_idx.size() - 1];
-				ins_idx.pop_back();
-				idx_guard.unlock();
-				break;
-			}
-		}
-		InstructionFile ins(insfile_vec[i]);
-		ins.set_additional_delimiters(additional_ins_delims);
-		Observations oobs = ins.read_output_file(outfile_vec[i]);
-		while (true)
-		{
-			if (obs_guard.try_lock())
-			{
-				//pro_par_vec.push_back(pro_pars);
-				obs.update_without_clear(oobs.get_keys(), oobs.get_data_vec(oobs.get_keys()));
-				obs_guard.unlock();
-				break;
-			}
-		}
-		count++;
-	}
+	fill_tpl_zeros = _flag;
+	for (auto& t : templatefiles)
+		t.set_fill_zeros(_flag);
 }
 
-void ThreadedTemplateProcess::work(int tid, vector<int>& tpl_idx, Parameters pars, Parameters& pro_pars)
+void ModelInterface::set_work_dir(const string &_work_dir)
 {
-	int count = 0, i;
-	unique_lock<mutex> par_guard(par_lock, defer_lock);
-	unique_lock<mutex> idx_guard(idx_lock, defer_lock);
-	while (true)
+	work_dir = _work_dir;
+	auto rebase = [this](vector<string> &file_vec)
 	{
-		i = -999;
-		while (true)
+		for (auto &f : file_vec)
 		{
-			if (idx_guard.try_lock())
-			{
-				if (tpl_idx.size() == 0)
-				{
-					cout << "thread " << tid << " processed " << count << " template files" << endl;
-					return;
-				}
-				i = tpl_idx[tpl_idx.size() - 1];
-				tpl_idx.pop_back();
-				idx_guard.unlock();
-				break;
-			}
-		}
-		TemplateFile tpl(tplfile_vec[i]);
-		tpl.set_fill_zeros(fill);
-		Parameters ppars = tpl.write_input_file(inpfile_vec[i], pars);
-		while (true)
-		{
-			if (par_guard.try_lock())
-			{
-				//pro_par_vec.push_back(pro_pars);
-				pro_pars.update_without_clear(ppars.get_keys(), ppars.get_data_vec(ppars.get_keys()));
-				par_guard.unlock();
-				break;
-			}
+			bool is_abs = (f.size() > 0) && ((f[0] == '/') || (f[0] == '\\'));
+			is_abs = is_abs || ((f.size() > 1) && (f[1] == ':'));
+			if (!is_abs)
+				f = work_dir + OperSys::DIR_SEP + f;
 		}
-		count++;
-	}
+	};
+	rebase(inpfile_vec);
+	rebase(outfile_vec);
 }
 
-void process_template_file_thread(int tid, vector<int>& tpl_idx, ThreadedTemplateProcess& ttp, Parameters pars, Parameters& pro_pars, exception_ptr& eptr)
+void ModelInterface::prep_interface_files()
 {
-	
-	try
-	{
-		ttp.work(tid, tpl_idx, pars, pro_pars);
-	}
-	catch (const std::exception& e)
+	//the template and instruction files are parsed once (lazily, by the worker threads
+	//on first use) and then reused for every subsequent model run
+	if (templatefiles.size() != tplfile_vec.size())
 	{
-		eptr = current_exception();
+		templatefiles.clear();
+		for (auto& t : tplfile_vec)
+			templatefiles.push_back(TemplateFile(t, fill_tpl_zeros));
 	}
-	catch (...)
+	if (instructionfiles.size() != insfile_vec.size())
 	{
-		eptr = current_exception();
+		instructionfiles.clear();
+		for (auto& i : insfile_vec)
+			instructionfiles.push_back(InstructionFile(i, additional_ins_delimiters));
 	}
-
-	return;
 }
 
-void process_instruction_file_thread(int tid, vector<int>& ins_idx, ThreadedInstructionProcess& tip, Observations& obs, string additional_ins_delims, exception_ptr& eptr)
+void ModelInterface::run(Parameters* pars, Observations* obs)
 {
 
-	try
-	{
-		tip.work(tid, ins_idx, obs, additional_ins_delims);
-	}
-	catch (const std::exception& e)
-	{
-		eptr = current_exception();
-	}
-	catch (...)
+	pest_utils::thread_flag terminate(false);
+	pest_utils::thread_flag finished(false);
+	pest_utils::thread_exceptions shared_exceptions;
+
+	run(&terminate, &finished, &shared_exceptions, pars, obs);
+	if (shared_exceptions.size() > 0)
 	{
-		eptr = current_exception();
+		//finalize();
+		shared_exceptions.rethrow();
 	}
 
-	return;
+}
+
+void ThreadedInstructionProcess::work(int i, vector<vector<double>>& ins_values)
+{
+	//each file has its own slot in ins_values, so no lock is needed here
+	instructionfiles[i].read_output_file(outfile_vec[i], ins_values[i]);
+}
+
+void ThreadedTemplateProcess::work(int i, const Parameters& pars, Parameters& pro_pars)
+{
+	Parameters ppars = templatefiles[i].write_input_file(inpfile_vec[i], pars);
+	lock_guard<mutex> par_guard(par_lock);
+	pro_pars.update_without_clear(ppars.get_keys(), ppars.get_data_vec(ppars.get_keys()));
 }
 
 
@@ -296,106 +245,37 @@ void ModelInterface::write_input_files(Parameters *pars_ptr)
 		num_threads = tplfile_vec.size();
 	std::chrono::system_clock::time_point start_time = chrono::system_clock::now();
 	cout << pest_utils::get_time_string() << " processing template files with " << num_threads << " threads..." << endl;
-	vector<thread> threads;
-	vector<exception_ptr> exception_ptrs;
 	Parameters pro_pars = *pars_ptr; //copy
-	ThreadedTemplateProcess ttp(tplfile_vec, inpfile_vec, fill_tpl_zeros);
+	prep_interface_files();
+	ThreadedTemplateProcess ttp(templatefiles, inpfile_vec);
+	const Parameters& pars = *pars_ptr;
 
-	for (int i = 0; i < num_threads; i++)
-	{
-		exception_ptrs.push_back(exception_ptr());
-	}
-
-	vector<int> tpl_idx;
+	ThreadPool pool(num_threads);
+	vector<future<void>> futures;
 	for (int i = 0; i < tplfile_vec.size(); i++)
-		tpl_idx.push_back(i);
-
-	for (int i = 0; i < num_threads; i++)
 	{
-		threads.push_back(thread(process_template_file_thread, i, std::ref(tpl_idx), std::ref(ttp), *pars_ptr, std::ref(pro_pars), std::ref(exception_ptrs[i])));
+		futures.push_back(pool.submit([&ttp, &pars, &pro_pars, i]() { ttp.work(i, pars, pro_pars); }));
 	}
 	stringstream ss;
 	int num_exp = 0;
-	for (int i = 0; i < num_threads; ++i)
+	for (int i = 0; i < futures.size(); ++i)
 	{
-		bool found = false;
-		if (exception_ptrs[i])
+		try
 		{
-			found = true;
-			try
-			{
-				rethrow_exception(exception_ptrs[i]);
-			}
-			catch (const std::exception& e)
-			{
-				//stringstream ss;
-				ss << " thread processing template file '" << tplfile_vec[i] << "' raised an exception: " << e.what() << endl;
-				num_exp++;
-				//cout << "Error: " << ss.str();
-				//throw runtime_error(ss.str());
-			}
-			catch (...)
-			{
-				//stringstream ss;
-				ss << " thread processing template file '" << tplfile_vec[i] << "' raised an exception" << endl;
-				num_exp++;
-				//cout << "Error: " << ss.str();
-				//throw runtime_error(ss.str());
-			}
+			futures[i].get();
 		}
-		threads[i].join();
-		if ((exception_ptrs[i]) && (!found))
+		catch (const std::exception& e)
 		{
-			try
-			{
-				rethrow_exception(exception_ptrs[i]);
-			}
-			catch (const std::exception& e)
-			{
-				//stringstream ss;
-				ss << " thread processing template file '" << tplfile_vec[i] << "' raised an exception: " << e.what() << endl;
-				num_exp++;
-				//cout << "Error: " << ss.str();
-				//throw runtime_error(ss.str());
-			}
-			catch (...)
-			{
-				//stringstream ss;
-				ss << " thread processing template file '" << tplfile_vec[i] << "' raised an exception" << endl;
-				num_exp++;
-				//cout << "Error: " << ss.str();
-				//throw runtime_error(ss.str());
-			}
+			ss << " thread processing template file '" << tplfile_vec[i] << "' raised an exception: " << e.what() << endl;
+			num_exp++;
+		}
+		catch (...)
+		{
+			ss << " thread processing template file '" << tplfile_vec[i] << "' raised an exception" << endl;
+			num_exp++;
 		}
 	}
 
-	//if (templatefiles.size() == 0)
-	//{
-	//	for (auto t : tplfile_vec)
-	//	{
-	//		TemplateFile tt(t);
-	//		tt.set_fill_zeros(fill_tpl_zeros);
-	//		templatefiles.push_back(tt);
-	//	}
-	//}
-
-	//
-	//vector<string> notnormal = pars_ptr->get_notnormal_keys();
-	//if (notnormal.size() > 0)
-	//{
-	//	throw runtime_error("denormal floating point parameter values found");
-	//}
-
-	//vector<Parameters> pro_par_vec;
-	//for (int i = 0; i < templatefiles.size(); i++)
-	//{
-	//	string name = templatefiles[i].get_tpl_filename();
-	//	//cout << name << endl;
-	//	pro_par_vec.push_back(templatefiles[i].write_input_file(inpfile_vec[i], *pars_ptr));
-	//}
-	//update pars to account for possibly truncated par values...important for jco calcs
-	//for (auto pro_pars : pro_par_vec)
-	//	pars_ptr->update_without_clear(pro_pars.get_keys(), pro_pars.get_data_vec(pro_pars.get_keys()));
 	if (num_exp > 0)
 	{
 		//cout << "errors processing template files: " << endl << ss.str();
@@ -413,99 +293,36 @@ void ModelInterface::read_output_files(Observations *obs)
 		num_threads = insfile_vec.size();
 	std::chrono::system_clock::time_point start_time = chrono::system_clock::now();
 	cout << pest_utils::get_time_string() <<  " processing instruction files with " << num_threads << " threads..." << endl;
-	vector<thread> threads;
-	vector<exception_ptr> exception_ptrs;
-	Observations temp_obs;
+	prep_interface_files();
+	vector<vector<double>> ins_values(instructionfiles.size());
 
-	ThreadedInstructionProcess tip(insfile_vec, outfile_vec);
+	ThreadedInstructionProcess tip(instructionfiles, outfile_vec);
 
-	for (int i = 0; i < num_threads; i++)
-	{
-		exception_ptrs.push_back(exception_ptr());
-	}
-
-	vector<int> ins_idx;
+	ThreadPool pool(num_threads);
+	vector<future<void>> futures;
 	for (int i = 0; i < insfile_vec.size(); i++)
-		ins_idx.push_back(i);
-
-	for (int i = 0; i < num_threads; i++)
 	{
-		threads.push_back(thread(process_instruction_file_thread, i, std::ref(ins_idx), std::ref(tip), std::ref(temp_obs), additional_ins_delimiters,
-			std::ref(exception_ptrs[i])));
+		futures.push_back(pool.submit([&tip, &ins_values, i]() { tip.work(i, ins_values); }));
 	}
 	stringstream ss;
 	int num_exp = 0;
-	for (int i = 0; i < num_threads; ++i)
+	for (int i = 0; i < futures.size(); ++i)
 	{
-		bool found = false;
-		if (exception_ptrs[i])
+		try
 		{
-			found = true;
-			try
-			{
-				rethrow_exception(exception_ptrs[i]);
-			}
-			catch (const std::exception& e)
-			{
-				//stringstream ss;
-				ss << " thread processing instruction file '" << insfile_vec[i] << "' raised an exception: " << e.what() << endl;
-				//cout << "Error: " << ss.str() << endl;
-				//throw runtime_error(ss.str());
-				num_exp++;
-			}
-			catch (...)
-			{
-				//stringstream ss;
-				ss << " thread processing instruction file '" << insfile_vec[i] << "' raised an exception" << endl;
-				//cout << "Error: " << ss.str() << endl;
-				//throw runtime_error(ss.str());
-				num_exp++;
-			}
+			futures[i].get();
 		}
-		threads[i].join();
-		if ((exception_ptrs[i]) && (!found))
+		catch (const std::exception& e)
 		{
-			try
-			{
-				rethrow_exception(exception_ptrs[i]);
-			}
-			catch (const std::exception& e)
-			{
-				//stringstream ss;
-				ss << " thread processing instruction file '" << insfile_vec[i] << "' raised an exception: " << e.what() << endl;
-				//cout << "Error: " << ss.str() << endl;
-				//throw runtime_error(ss.str());
-				num_exp++;
-			}
-			catch (...)
-			{
-				//stringstream ss;
-				ss << " thread processing instruction file '" << insfile_vec[i] << "' raised an exception" << endl;
-				//cout << "Error: " << ss.str() << endl;
-				//throw runtime_error(ss.str());
-				num_exp++;
-			}
+			ss << " thread processing instruction file '" << insfile_vec[i] << "' raised an exception: " << e.what() << endl;
+			num_exp++;
 		}
-	}
-	
-	
-	
-	/*if (instructionfiles.size() == 0)
-	{
-		for (auto i : insfile_vec)
+		catch (...)
 		{
-			InstructionFile ii(i);
-			ii.set_additional_delimiters(additional_ins_delimiters);
-			instructionfiles.push_back(ii);
+			ss << " thread processing instruction file '" << insfile_vec[i] << "' raised an exception" << endl;
+			num_exp++;
 		}
 	}
-	
-	Observations temp_obs, pro_obs;
-	for (int i = 0; i < instructionfiles.size(); i++)
-	{
-		pro_obs = instructionfiles[i].read_output_file(outfile_vec[i]);
-		temp_obs.update_without_clear(pro_obs.get_keys(), pro_obs.get_data_vec(pro_obs.get_keys()));
-	}*/
 
 	if (num_exp > 0)
 	{
@@ -513,47 +330,76 @@ void ModelInterface::read_output_files(Observations *obs)
 		throw runtime_error(ss.str());
 	}
 
-	unordered_set<string> ins_names, pst_names;
-	vector<string> t, diff;
-	t = obs->get_keys();
-	pst_names.insert(t.begin(), t.end());
-	t = temp_obs.get_keys();
-	ins_names.insert(t.begin(), t.end());
-	unordered_set<string>::iterator end = ins_names.end();
-	for (auto o : pst_names)
-	{
-		if (ins_names.find(o) == end)
-			diff.push_back(o);
-	}
-	if (diff.size() > 0)
-	{
-		stringstream ss;
-		ss << "ModelInterace error: the following instruction observations are not in the control file:";
-		for (auto d : diff)
-			ss << d << ",";
-		throw_mio_error(ss.str());
-	}
-	end = pst_names.end();
-	for (auto o : ins_names)
-	{
-		if (pst_names.find(o) == end)
-			diff.push_back(o);
-	}
-	if (diff.size() > 0)
+	vector<string> t, names;
+	vector<double> values;
+	for (int i = 0; i < instructionfiles.size(); i++)
 	{
-		stringstream ss;
-		ss << "ModelInterace error: the following control file observations are not in the instruction files:";
-		for (auto d : diff)
-			ss << d << ",";
-		throw_mio_error(ss.str());
+		const vector<string>& inames = instructionfiles[i].get_obs_names();
+		names.insert(names.end(), inames.begin(), inames.end());
+		values.insert(values.end(), ins_values[i].begin(), ins_values[i].end());
+	}
+	//the instruction names dont change between runs, so only check them
+	//against the incoming observations when those differ from the last checked names
+	if (!same_checked_obs_names(*obs))
+	{
+		unordered_set<string> ins_names, pst_names;
+		vector<string> diff;
+		t = obs->get_keys();
+		pst_names.insert(t.begin(), t.end());
+		ins_names.insert(names.begin(), names.end());
+		unordered_set<string>::iterator end = ins_names.end();
+		for (auto o : pst_names)
+		{
+			if (ins_names.find(o) == end)
+				diff.push_back(o);
+		}
+		if (diff.size() > 0)
+		{
+			stringstream ss;
+			ss << "ModelInterace error: the following instruction observations are not in the control file:";
+			for (auto d : diff)
+				ss << d << ",";
+			throw_mio_error(ss.str());
+		}
+		end = pst_names.end();
+		for (auto o : ins_names)
+		{
+			if (pst_names.find(o) == end)
+				diff.push_back(o);
+		}
+		if (diff.size() > 0)
+		{
+			stringstream ss;
+			ss << "ModelInterace error: the following control file observations are not in the instruction files:";
+			for (auto d : diff)
+				ss << d << ",";
+			throw_mio_error(ss.str());
+		}
+		checked_obs_names.clear();
+		for (auto &o : *obs)
+			checked_obs_names.push_back(o.first);
 	}
-	t = temp_obs.get_keys();
-	obs->update(t, temp_obs.get_data_vec(t));
+	obs->update(names, values);
 	cout << pest_utils::get_time_string() << " done, took " << pest_utils::get_duration_sec(start_time) << " seconds" << endl;
 
 }
 
 
+bool ModelInterface::same_checked_obs_names(const Observations &obs) const
+{
+	//exact, in iteration order - the run managers build the observations the same
+	//way for every run, so an equal set that iterates differently just gets rechecked
+	if (obs.size() != checked_obs_names.size())
+		return false;
+	size_t i = 0;
+	for (auto &o : obs)
+	{
+		if (o.first != checked_obs_names[i++])
+			return false;
+	}
+	return true;
+}
+
 void ModelInterface::remove_existing()
 {
 	//first delete any existing input and output files
@@ -630,7 +476,7 @@ void ModelInterface::run(pest_utils::thread_flag* terminate, pest_utils::thread_
 			PROCESS_INFORMATION pi;
 			try
 			{
-				pi = start(cmd_string);
+				pi = start(cmd_string, work_dir);
 			}
 			catch (...)
 			{
@@ -685,7 +531,7 @@ void ModelInterface::run(pest_utils::thread_flag* terminate, pest_utils::thread_
 		for (auto &cmd_string : comline_vec)
 		{
 			//start the command
-			int command_pid = start(cmd_string);
+			int command_pid = start(cmd_string, work_dir);
 			while (true)
 			{
 				//sleep
@@ -750,86 +596,64 @@ void ModelInterface::run(pest_utils::thread_flag* terminate, pest_utils::thread_
 
 unordered_set<string> TemplateFile::parse_and_check()
 {
-	ifstream f(tpl_filename);
-	prep_tpl_file_for_reading(f);
-	return get_names(f);
+	compile();
+	unordered_set<string> names;
+	for (auto& fields : plan_fields)
+		for (auto& t : fields)
+			names.insert(t.first);
+	return names;
 
 }
 
-Parameters TemplateFile::write_input_file(const string& input_filename, Parameters& pars)
+void TemplateFile::compile()
 {
+	//read and parse the template once - the resulting plan is
+	//reused by write_input_file() for every model run
 	ifstream f_tpl(tpl_filename);
+	line_num = 0;
 	prep_tpl_file_for_reading(f_tpl);
-	ofstream f_in(input_filename);
-	if (f_in.bad())
-		throw_tpl_error("couldn't open model input file '" + input_filename + "' for writing");
-	string line, val_str, name;
-	double val;
-	vector<pair<string, pair<int, int>>> tpl_line_map;
-	Parameters pro_pars;
-	//vector<string> t = pars.get_keys();
-	//unordered_set<string> pnames(t.begin(), t.end());
-	//unordered_set<string>::iterator end = pnames.end();
-	//t.resize(0);
+	plan_lines.clear();
+	plan_fields.clear();
+	string line;
 	while (true)
 	{
 		if (f_tpl.eof())
 			break;
 		line = read_line(f_tpl);
-		
 		if (line.size() == 0)
 		{
 			if (f_tpl.eof())
 				break;
-			f_in << endl;
+			plan_lines.push_back(line);
+			plan_fields.push_back(vector<pair<string, pair<int, int>>>());
 			continue;
 		}
-		tpl_line_map = parse_tpl_line(line);
-		for (auto t : tpl_line_map)
+		plan_fields.push_back(parse_tpl_line(line));
+		plan_lines.push_back(line);
+	}
+	f_tpl.close();
+	compiled = true;
+}
+
+Parameters TemplateFile::write_input_file(const string& input_filename, const Parameters& pars)
+{
+	if (!compiled)
+		compile();
+	ofstream f_in(input_filename);
+	if (f_in.bad())
+		throw_tpl_error("couldn't open model input file '" + input_filename + "' for writing");
+	string line, val_str, name;
+	double val;
+	Parameters pro_pars;
+	for (size_t i = 0; i < plan_lines.size(); i++)
+	{
+		line = plan_lines[i];
+		for (auto& t : plan_fields[i])
 		{
 			name = t.first;
-			//if (pnames.find(name) == end)
-			//	throw_tpl_error("parameter '" + name + "' not listed in control file");
-
-			/*val = 1.23456789123456789123456789E+100;
-			val_str = cast_to_fixed_len_string(200, val, name);
-			pest_utils::convert_ip(val_str, val);
-
-			val = 1.23456789123456789123456789E+100;
-			val_str = cast_to_fixed_len_string(8, val, name);
-			pest_utils::convert_ip(val_str, val);
-
-			val = 1.23456789123456789123456789E-100;
-			val_str = cast_to_fixed_len_string(8, val, name);
-			pest_utils::convert_ip(val_str, val);
-
-			val = -1.23456789123456789123456789E+100;
-			val_str = cast_to_fixed_len_string(9, val, name);
-			pest_utils::convert_ip(val_str, val);
-
-			val = -1.23456789123456789123456789E-100;
-			val_str = cast_to_fixed_len_string(9, val, name);
-			pest_utils::convert_ip(val_str, val);
-
-			val = 1.23456789123456789123456789E+10;
-			val_str = cast_to_fixed_len_string(7, val, name);
-			pest_utils::convert_ip(val_str, val);
-
-			val = 1.23456789123456789123456789E-10;
-			val_str = cast_to_fixed_len_string(7, val, name);
-			pest_utils::convert_ip(val_str, val);
-
-			val = 1.23456789123456789123456789;
-			val_str = cast_to_fixed_len_string(1, val, name);
-			pest_utils::convert_ip(val_str, val);
-
-			val = -1.23456789123456789123456789;
-			val_str = cast_to_fixed_len_string(2, val, name);
-			pest_utils::convert_ip(val_str, val);
-			*/
 			try
 			{
-				val = pars.get_rec(t.first);
+				val = pars.get_rec(name);
 			}
 			catch (...)
 			{
@@ -837,17 +661,15 @@ Parameters TemplateFile::write_input_file(const string& input_filename, Paramete
 			}
 			val_str = cast_to_fixed_len_string(t.second.second, val, name);
 			line.replace(t.second.first, t.second.second, val_str);
-			//pest_utils::convert_ip(val_str, val);
 			val = stod(val_str);
 			pro_pars.insert(name, val);
 		}
 		f_in << line << endl;
 		if (f_in.bad())
 		{
-			throw_tpl_error("ofstream is bad after writing line '" + line + "'", line_num);
+			throw_tpl_error("ofstream is bad after writing line '" + line + "'", i + 2);
 		}
 	}
-	f_tpl.close();
 	f_in.close();
 	if (f_in.bad())
 	{
@@ -878,23 +700,6 @@ void TemplateFile::prep_tpl_file_for_reading(ifstream& f_tpl)
 		throw_tpl_error("marker on first line should be one character, not: " + marker);
 }
 
-unordered_set<string> TemplateFile::get_names(ifstream& f)
-{
-	unordered_set<string> names;
-	string line;
-	vector<pair<string, pair<int, int>>> tpl_line_info;
-	while (true)
-	{
-		if (f.eof())
-			break;
-		line = read_line(f);
-		tpl_line_info = parse_tpl_line(line);
-		for (auto t : tpl_line_info)
-			names.insert(t.first);
-	}
-	return names;
-}
-
 vector<int> TemplateFile::find_all_marker_indices(const string& line, const string& marker)
 {
 	vector<int> indices;
@@ -1110,7 +915,7 @@ string InstructionFile::read_out_line(ifstream& f_out)
 
 
 InstructionFile::InstructionFile(string _ins_filename, string _addtitional_delimiters): ins_filename(_ins_filename), ins_line_num(0),
-out_line_num(0),last_ins_line(""),last_out_line(""), additional_delimiters(_addtitional_delimiters)
+out_line_num(0),last_ins_line(""),last_out_line(""), compiled(false), additional_delimiters(_addtitional_delimiters)
 {
 	obs_tags.push_back(pair<char, char>('(', ')'));
 	obs_tags.push_back(pair<char, char>('[', ']'));	
@@ -1121,6 +926,7 @@ unordered_set<string> InstructionFile::parse_and_check()
 {
 	unordered_set<string> names;
 	ifstream f_ins(ins_filename);
+	ins_line_num = 0;
 	prep_ins_file_for_reading(f_ins);
 	string line, name;
 	vector<string> tokens;
@@ -1154,10 +960,125 @@ unordered_set<string> InstructionFile::parse_and_check()
 		}
 	}
 	f_ins.close();
-	
+	compile();
 	return names;
 }
 
+void InstructionFile::compile()
+{
+	//tokenize and parse each instruction once - the resulting plan is
+	//reused by read_output_file() for every model run
+	ifstream f_ins(ins_filename);
+	ins_line_num = 0;
+	prep_ins_file_for_reading(f_ins);
+	plan.clear();
+	plan_obs_names.clear();
+	unordered_map<string, int> obs_map;
+	string ins_line;
+	vector<string> tokens;
+	while (true)
+	{
+		if (f_ins.eof())
+			break;
+		ins_line = read_ins_line(f_ins);
+		tokens = tokenize_ins_line(ins_line);
+		//check that the first token is either a marker or a line advance
+		if (tokens.size() > 0)
+		{
+			char first = tokens[0][0];
+			if ((first != 'L') && (first != marker))
+			{
+				stringstream ss;
+				ss << "first token on each instruction file line must be either a primary marker ";
+				ss << " or a line advance instruction, not '" << tokens[0] << "'";
+				throw_ins_error(ss.str());
+			}
+		}
+		InsLine ins;
+		ins.ins_lnum = ins_line_num;
+		ins.raw = ins_line;
+		for (int itoken = 0; itoken < tokens.size(); itoken++)
+			ins.ops.push_back(compile_token(tokens[itoken], itoken == 0, obs_map));
+		plan.push_back(ins);
+	}
+	f_ins.close();
+	compiled = true;
+}
+
+InstructionFile::InsOp InstructionFile::compile_token(const string& token, bool first, unordered_map<string, int>& obs_map)
+{
+	InsOp op;
+	op.token = token;
+	op.obs_idx = -1;
+	op.num = 0;
+	op.se = pair<int, int>(0, 0);
+	pair<string, pair<int, int>> info;
+	if (token[0] == 'L')
+	{
+		op.kind = 'L';
+		try
+		{
+			op.num = stoi(token.substr(1));
+		}
+		catch (...)
+		{
+			throw_ins_error("line advance instruction error: couldn't cast '" + token.substr(1) + "' to int", ins_line_num);
+		}
+		if (op.num < 1)
+			throw_ins_error("line advance instruction error: number of lines must be greater or equal to 1, not '" + token.substr(1) + "'", ins_line_num);
+		return op;
+	}
+	else if (token[0] == 'W')
+	{
+		op.kind = 'W';
+		return op;
+	}
+	else if (token[0] == '[')
+	{
+		op.kind = '[';
+		info = parse_obs_instruction(token, "]");
+		op.tag = info.first;
+		op.se = info.second;
+	}
+	else if (token[0] == '(')
+	{
+		op.kind = '(';
+		info = parse_obs_instruction(token, ")");
+		op.tag = info.first;
+		op.se = info.second;
+	}
+	else if (token[0] == '!')
+	{
+		op.kind = '!';
+		op.tag = token.substr(1, token.size() - 2);
+	}
+	else if (token[0] == marker)
+	{
+		if (token.size() == 1)
+		{
+			throw_ins_error("markers with spaces not supported...", ins_line_num);
+		}
+		//if this is the first instruction, its a primary search
+		op.kind = (first) ? 'P' : 'S';
+		if (token.substr(token.size() - 1, 1) != string(1, marker))
+			throw_ins_error("marker token '" + token + "' doesn't have a closing marker char", ins_line_num);
+		op.tag = token.substr(1, token.size() - 2);
+		return op;
+	}
+	else
+	{
+		throw_ins_error("unrecognized instruction '" + token + "'", ins_line_num);
+	}
+	//resolve the observation index - the first occurence of a name wins
+	if ((op.tag != "DUM") && (obs_map.find(op.tag) == obs_map.end()))
+	{
+		op.obs_idx = plan_obs_names.size();
+		obs_map[op.tag] = op.obs_idx;
+		plan_obs_names.push_back(op.tag);
+	}
+	return op;
+}
+
 void InstructionFile::prep_ins_file_for_reading(ifstream& f_ins)
 {
 	if (f_ins.bad())
@@ -1184,107 +1105,71 @@ void InstructionFile::prep_ins_file_for_reading(ifstream& f_ins)
 
 Observations InstructionFile::read_output_file(const string& output_filename)
 {
+	vector<double> values;
+	read_output_file(output_filename, values);
+	Observations obs;
+	obs.insert(plan_obs_names, values);
+	return obs;	
+}
+
+void InstructionFile::read_output_file(const string& output_filename, vector<double>& values)
+{
+	if (!compiled)
+		compile();
 	if (!pest_utils::check_exist_in(output_filename))
 		throw_ins_error("output file'" + output_filename + "' not found");
-	ifstream f_ins(ins_filename);
 	ifstream f_out(output_filename);
-	prep_ins_file_for_reading(f_ins);
 	if (f_out.bad())
 	{
 		throw_ins_error("can't open output file'" + output_filename + "' for reading");
 	}
-	string ins_line, out_line;
-	vector<string> tokens;
-	Observations obs;
-	pair<string, double> lhs;
-	while (true)
+	out_line_num = 0;
+	last_out_line = "";
+	values.assign(plan_obs_names.size(), 0.0);
+	string out_line;
+	double value;
+	for (auto& ins : plan)
 	{
-		if (f_ins.eof())
-			break;
-		tokens.clear();
-		ins_line = read_ins_line(f_ins);
-		tokens = tokenize_ins_line(ins_line);
-		//check that the first token is either a marker or a line advance
-		if (tokens.size() > 0)
-		{
-			char first = tokens[0][0];
-			if ((first != 'L') && (first != marker))
-			{
-				stringstream ss;
-				ss << "first token on each instruction file line must be either a primary marker ";
-				ss << " or a line advance instruction, not '" << tokens[0] << "'";
-				throw_ins_error(ss.str());
-			}
-		}
-		//int itoken = 0;
+		ins_line_num = ins.ins_lnum;
+		last_ins_line = ins.raw;
 		bool all_markers_so_far = true;
-		//for (auto token : tokens)
-		for (int itoken=0;itoken<tokens.size();itoken++)
+		for (int itoken = 0; itoken < ins.ops.size(); itoken++)
 		{
-			string token = tokens[itoken];
-
-			if (token[0] == 'L')
-			{
-				execute_line_advance(token, out_line, f_out);
-			}
-			else if (token[0] == 'W')
-			{
-				execute_whitespace(token, out_line, f_out);
-			}
-			else if (token[0] == '[')
-			{
-				lhs = execute_fixed(token, out_line, f_out);
-				if (lhs.first != "DUM")
-					obs.insert(lhs.first,lhs.second);
-				all_markers_so_far = false;
-			}
-			else if (token[0] == '!')
-			{
-				lhs = execute_free(token, out_line, f_out);
-				if (lhs.first != "DUM")
-					obs.insert(lhs.first, lhs.second);
-				all_markers_so_far = false;
-			}
-			else if (token[0] == '(')
-			{
-				lhs = execute_semi(token, out_line, f_out);
-				if (lhs.first != "DUM")
-					obs.insert(lhs.first, lhs.second);
-				all_markers_so_far = false;
-			}
-			else if (token[0] == marker)
+			const InsOp& op = ins.ops[itoken];
+			switch (op.kind)
 			{
-				if (token.size() == 1)
-				{
-					throw_ins_error("markers with spaces not supported...", ins_line_num);
-				}
-				//if this is the first instruction, its a primary search
-				//if (token == tokens[0])
-				if (itoken == 0)
-				{
-					execute_primary(token, out_line, f_out);
-				}
+			case 'L':
+				execute_line_advance(op, out_line, f_out);
+				break;
+			case 'W':
+				execute_whitespace(op, out_line, f_out);
+				break;
+			case '[':
+			case '!':
+			case '(':
+				if (op.kind == '[')
+					value = execute_fixed(op, out_line, f_out);
+				else if (op.kind == '!')
+					value = execute_free(op, out_line, f_out);
 				else
+					value = execute_semi(op, out_line, f_out);
+				if (op.obs_idx >= 0)
+					values[op.obs_idx] = value;
+				all_markers_so_far = false;
+				break;
+			case 'P':
+				execute_primary(op, out_line, f_out);
+				break;
+			case 'S':
+				if (execute_secondary(op, out_line, f_out, all_markers_so_far))
 				{
-					bool rewind = execute_secondary(token, out_line, f_out, all_markers_so_far);
-					if (rewind)
-					{
-						itoken = -1; //-1 so that when the for loop increments we are back to zero
-						continue;
-					}
-
+					itoken = -1; //-1 so that when the for loop increments we are back to zero
 				}
+				break;
 			}
-			else
-			{
-				throw_ins_error("unrecognized instruction '" + token + "'", ins_line_num);
-			}
-			//itoken++;
 		}
 	}
-	f_ins.close();
 	f_out.close();
-	return obs;	
 }
 
 
@@ -1420,11 +1305,12 @@ pair<string, pair<int, int>> InstructionFile::parse_obs_instruction(const string
 	return pair<string, pair<int, int>>(name,se);
 }
 
-pair<string, double> InstructionFile::execute_fixed(const string& token, string& line, ifstream& f_out)
+double InstructionFile::execute_fixed(const InsOp& op, string& line, ifstream& f_out)
 {
 	string temp;
 	double value;
-	pair<string, pair<int, int>> info = parse_obs_instruction(token, "]");
+	const string& token = op.token;
+	pair<string, pair<int, int>> info(op.tag, op.se);
 	//use the raw last_out_line since "line" has been getting progressively truncated
 	if (last_out_line.size() < info.second.second)
 	{
@@ -1451,15 +1337,16 @@ pair<string, double> InstructionFile::execute_fixed(const string& token, string&
 	}
 	line = line.substr(pos + temp.size());
 	
-	return pair<string, double>(info.first,value);
+	return value;
 }
 
-pair<string, double> InstructionFile::execute_semi(const string& token, string& line, ifstream& f_out)
+double InstructionFile::execute_semi(const InsOp& op, string& line, ifstream& f_out)
 {
 	string temp;
 	vector<string> tokens;
 	double value;
-	pair<string, pair<int, int>> info = parse_obs_instruction(token, ")");
+	const string& token = op.token;
+	pair<string, pair<int, int>> info(op.tag, op.se);
 	//use the raw last_out_line since "line" has been getting progressively truncated
 	if (last_out_line.size() < info.second.second)
 	{
@@ -1492,13 +1379,14 @@ pair<string, double> InstructionFile::execute_semi(const string& token, string&
 		throw_ins_error("casting '" + temp + "' to double yielded denormal value for semi-fixed instruction '" + token + "' on line: '" + line + "'", ins_line_num, out_line_num);
 	}
 	line = line.substr(pos + temp.size());
-	return pair<string, double>(info.first,value);
+	return value;
 }
 
 
 
-pair<string, double> InstructionFile::execute_free(const string& token, string& line, ifstream& f_out)
+double InstructionFile::execute_free(const InsOp& op, string& line, ifstream& f_out)
 {
+	const string& token = op.token;
 	int tsize = line.size() / 20;
 	if (tsize > 50)
 		tsize = 50;
@@ -1517,7 +1405,6 @@ pair<string, double> InstructionFile::execute_free(const string& token, string&
 	{
 		throw_ins_error("error converting '" + tokens[0] + "' to double on output line '" + last_out_line + "' for free instruciton: '"+token+"'", ins_line_num, out_line_num);
 	}
-	string name = token.substr(1, token.size() - 2);
 	int pos = line.find(tokens[0]);
 	if (pos == string::npos)
 	{
@@ -1529,7 +1416,7 @@ pair<string, double> InstructionFile::execute_free(const string& token, string&
 	}
 	line = line.substr(pos + tokens[0].size());
 
-	return pair<string, double>(name,value);
+	return value;
 }
 
 void InstructionFile::tokenize(const std::string& str, vector<string>& tokens, const std::string& delimiters, const bool trimEmpty)
@@ -1557,14 +1444,11 @@ void InstructionFile::tokenize(const std::string& str, vector<string>& tokens, c
 	}
 }
 
-void InstructionFile::execute_primary(const string& token, string& line, ifstream& f_out)
+void InstructionFile::execute_primary(const InsOp& op, string& line, ifstream& f_out)
 {
-	//check that a closing marker is found
-	//this shouldnt be a prob,but good to check
-	if (token.substr(token.size()-1,1) != string(1,marker))
-		throw_ins_error("primary marker token '" + token + "' doesn't have a closing marker char", ins_line_num);
 	int pos;
-	string primary_tag = token.substr(1, token.size() - 2);
+	const string& token = op.token;
+	const string& primary_tag = op.tag;
 	while (true)
 	{
 		if (f_out.eof())
@@ -1582,13 +1466,10 @@ void InstructionFile::execute_primary(const string& token, string& line, ifstrea
 }
 
 
-bool InstructionFile::execute_secondary(const string& token, string& line, ifstream& f_out, bool all_markers_so_far)
+bool InstructionFile::execute_secondary(const InsOp& op, string& line, ifstream& f_out, bool all_markers_so_far)
 {
-	//check that a closing marker is found
 	int pos;
-	if (token.substr(token.size()-1,1) != string(1,marker))
-		throw_ins_error("secondary marker token '" + token + "' doesnt have a closing marker char");
-	string secondary_tag = token.substr(1, token.size()-2);
+	const string& secondary_tag = op.tag;
 	pos = line.find(secondary_tag);
 	if (pos == string::npos)
 	{
@@ -1602,7 +1483,7 @@ bool InstructionFile::execute_secondary(const string& token, string& line, ifstr
 }
 
 
-void InstructionFile::execute_whitespace(const string& token, string& line, ifstream& f_out)
+void InstructionFile::execute_whitespace(const InsOp& op, string& line, ifstream& f_out)
 {
 	string delims = " \t" + additional_delimiters;
 
@@ -1634,14 +1515,9 @@ void InstructionFile::execute_whitespace(const string& token, string& line, ifst
 }
 
 
-void InstructionFile::execute_line_advance(const string& token, string& line, ifstream& f_out)
+void InstructionFile::execute_line_advance(const InsOp& op, string& line, ifstream& f_out)
 {
-	stringstream ss;
-	int num;
-	//pest_utils::convert_ip(token.substr(1), num);
-	num = stoi(token.substr(1));
-	if (num < 1)
-		throw_ins_error("line advance instruction error: number of lines must be greater or equal to 1, not '" + token.substr(1) + "'",ins_line_num,out_line_num);
+	int num = op.num;
 	for (int i = 0; i < num; i++)
 	{
 		if (f_out.bad())
@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include <unordered_set>
+#include <unordered_map>
 #include <mutex>
 #include "Transformable.h"
 #include "utilities.h"
@@ -15,9 +16,11 @@ class TemplateFile {
 public:
 	static vector<int> find_all_marker_indices(const string& line, const string& marker);
 	TemplateFile(string _tpl_filename, bool _fill_zeros=false): tpl_filename(_tpl_filename),line_num(0),
-	fill_zeros(_fill_zeros){ ; }
+	fill_zeros(_fill_zeros),compiled(false){ ; }
 	unordered_set<string> parse_and_check();
-	Parameters write_input_file(const string& input_filename, Parameters& pars);
+	void compile();
+	bool get_compiled() { return compiled; }
+	Parameters write_input_file(const string& input_filename, const Parameters& pars);
 	void throw_tpl_error(const string& message, int lnum=0, bool warn=false);
 	void set_fill_zeros(bool _flag) { fill_zeros = _flag; }
 	string get_tpl_filename() { return tpl_filename; }
@@ -29,32 +32,24 @@ private:
 	string cast_to_fixed_len_string(int size, double value, string& name);
 	string read_line(ifstream& f_tpl);
 	void prep_tpl_file_for_reading(ifstream& f_tpl);
-	unordered_set<string> get_names(ifstream& f);
 	bool fill_zeros;
+	//the compiled template: the raw text of each line and the (name,(start,len)) of each
+	//parameter field on that line.  built once and reused for every model run
+	bool compiled;
+	vector<string> plan_lines;
+	vector<vector<pair<string, pair<int, int>>>> plan_fields;
 	
 };
 
 class ThreadedTemplateProcess {
 public:
-	ThreadedTemplateProcess(vector<string> _tplfile_vec, vector<string> _inpfile_vec, bool _fill) : 
-		tplfile_vec(_tplfile_vec), inpfile_vec(_inpfile_vec), fill(_fill) {;};
-	void work(int tid, vector<int>& tpl_idx, Parameters pars, Parameters& pro_pars);
+	ThreadedTemplateProcess(vector<TemplateFile>& _templatefiles, const vector<string>& _inpfile_vec) :
+		templatefiles(_templatefiles), inpfile_vec(_inpfile_vec) {;};
+	void work(int i, const Parameters& pars, Parameters& pro_pars);
 private:
-	vector<string> tplfile_vec;
-	vector<string> inpfile_vec;
-	bool fill;
-	mutex par_lock, idx_lock;
-};
-
-class ThreadedInstructionProcess {
-public:
-	ThreadedInstructionProcess(vector<string> _insfile_vec, vector<string> _outfile_vec) :
-		insfile_vec(_insfile_vec), outfile_vec(_outfile_vec){;};
-	void work(int tid, vector<int>& ins_idx, Observations& obs, string additional_ins_delims);
-private:
-	vector<string> insfile_vec;
-	vector<string> outfile_vec;
-	mutex obs_lock, idx_lock;
+	vector<TemplateFile>& templatefiles;
+	const vector<string>& inpfile_vec;
+	mutex par_lock;
 };
 
 
@@ -63,20 +58,45 @@ class InstructionFile {
 public:
 	InstructionFile(string _ins_filename, string _additional_delimiters="");
 	unordered_set<string> parse_and_check();
+	void compile();
+	bool get_compiled() { return compiled; }
 	Observations read_output_file(const string& output_filename);
+	void read_output_file(const string& output_filename, vector<double>& values);
+	const vector<string>& get_obs_names() { return plan_obs_names; }
 	void set_additional_delimiters(string delims) { additional_delimiters = delims; }
 private:
+	//a single pre-parsed instruction.  kind is one of 'L','W','[','(','!','P' (primary marker)
+	//or 'S' (secondary marker).  obs_idx indexes plan_obs_names (-1 for dum/repeated obs)
+	struct InsOp
+	{
+		char kind;
+		string token;
+		string tag;
+		int obs_idx;
+		pair<int, int> se;
+		int num;
+	};
+	struct InsLine
+	{
+		int ins_lnum;
+		string raw;
+		vector<InsOp> ops;
+	};
 	int ins_line_num, out_line_num;
 	char marker;
 	string ins_filename, last_out_line, last_ins_line;
 	vector<pair<char, char>> obs_tags;
-	pair<string, double> execute_fixed(const string& token, string& line, ifstream& f_out);
-	pair<string, double> execute_semi(const string& token, string& line, ifstream& f_out);
-	pair<string, double> execute_free(const string& token, string& line, ifstream& f_out);
-	void execute_primary(const string& token, string& line, ifstream& f_out);
-	bool execute_secondary(const string& token, string& line, ifstream& f_out,bool all_markers_so_far);
-	void execute_whitespace(const string& token, string& line, ifstream& f_out);
-	void execute_line_advance(const string& token, string& line, ifstream& f_out);
+	bool compiled;
+	vector<InsLine> plan;
+	vector<string> plan_obs_names;
+	double execute_fixed(const InsOp& op, string& line, ifstream& f_out);
+	double execute_semi(const InsOp& op, string& line, ifstream& f_out);
+	double execute_free(const InsOp& op, string& line, ifstream& f_out);
+	void execute_primary(const InsOp& op, string& line, ifstream& f_out);
+	bool execute_secondary(const InsOp& op, string& line, ifstream& f_out,bool all_markers_so_far);
+	void execute_whitespace(const InsOp& op, string& line, ifstream& f_out);
+	void execute_line_advance(const InsOp& op, string& line, ifstream& f_out);
+	InsOp compile_token(const string& token, bool first, unordered_map<string,int>& obs_map);
 	void prep_ins_file_for_reading(ifstream& f_ins);
 	string read_ins_line(ifstream& f_ins);
 	string read_out_line(ifstream& f_out);
@@ -91,10 +111,20 @@ private:
 
 };
 
+class ThreadedInstructionProcess {
+public:
+	ThreadedInstructionProcess(vector<InstructionFile>& _instructionfiles, const vector<string>& _outfile_vec) :
+		instructionfiles(_instructionfiles), outfile_vec(_outfile_vec){;};
+	void work(int i, vector<vector<double>>& ins_values);
+private:
+	vector<InstructionFile>& instructionfiles;
+	const vector<string>& outfile_vec;
+};
+
 
 class ModelInterface{
 public:
-	ModelInterface() { ; }
+	ModelInterface() : fill_tpl_zeros(false) { ; }
 	//ModelInterface(Pest* _pest_scenario_ptr) { pest_scenario_ptr = _pest_scenario_ptr; }
 	ModelInterface(vector<string> _tplfile_vec, vector<string> _inpfile_vec, vector<string>
 		_insfile_vec, vector<string> _outfile_vec, vector<string> _comline_vec) :
@@ -107,8 +137,12 @@ public:
 		Parameters* par, Observations* obs);
 	void check_io_access();
 	void check_tplins(const vector<string> &par_names, const vector<string> &obs_names);
-	void set_additional_ins_delimiters(string delims) { additional_ins_delimiters = delims; }
-	void set_fill_tpl_zeros(bool _flag) { fill_tpl_zeros = _flag; }
+	void set_additional_ins_delimiters(string delims);
+	void set_fill_tpl_zeros(bool _flag);
+	//run the model in work_dir: relative model input and output file names are taken as
+	//relative to work_dir and the commands are started there.  templates and instructions
+	//are still read from the current directory
+	void set_work_dir(const string &_work_dir);
 
 private:
 	//Pest* pest_scenario_ptr;
@@ -121,9 +155,14 @@ private:
 	vector<string> comline_vec; 
 	bool fill_tpl_zeros;
 	string additional_ins_delimiters;
+	//names of the observation set last checked against the instruction files
+	vector<string> checked_obs_names;
+	string work_dir;
 
+	void prep_interface_files();
 	void write_input_files(Parameters *pars_ptr);
 	void read_output_files(Observations *obs_ptr);
+	bool same_checked_obs_names(const Observations &obs) const;
 	void remove_existing();
 
 };
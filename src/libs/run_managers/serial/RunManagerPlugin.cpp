@@ -0,0 +1,298 @@
+/*
+
+
+	This file is part of PEST++.
+
+	PEST++ is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PEST++ is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+#include "RunManagerPlugin.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <future>
+#include <stdexcept>
+#include "config_os.h"
+#include "utilities.h"
+#include "ThreadPool.h"
+#include "PerformanceLog.h"
+
+#ifdef OS_WIN
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+using namespace std;
+
+
+RunManagerPlugin::RunManagerPlugin(const string &_plugin_filename, const string &stor_filename,
+	int _max_run_fail, int _num_threads, int _batch_size)
+	: RunManagerAbstract(vector<string>(), vector<string>(), vector<string>(),
+	vector<string>(), vector<string>(), stor_filename, _max_run_fail),
+	plugin_filename(_plugin_filename), lib_handle(nullptr), evaluate_func(nullptr),
+	initialize_func(nullptr), plugin_initialized(false), num_threads(_num_threads),
+	batch_size(_batch_size)
+{
+	if (num_threads <= 0)
+		num_threads = max((int)thread::hardware_concurrency(), 1);
+	if (batch_size <= 0)
+		batch_size = 1000;
+	load_plugin();
+	pool.reset(new ThreadPool(num_threads));
+
+	cout << "              starting plugin run manager using " << plugin_filename
+		<< " on " << num_threads << " threads ..." << endl << endl;
+}
+
+void RunManagerPlugin::load_plugin()
+{
+#ifdef OS_WIN
+	lib_handle = (void*)LoadLibraryA(plugin_filename.c_str());
+	if (lib_handle == nullptr)
+	{
+		stringstream ss;
+		ss << "RunManagerPlugin error loading '" << plugin_filename << "', error code: " << GetLastError();
+		throw runtime_error(ss.str());
+	}
+#else
+	lib_handle = dlopen(plugin_filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (lib_handle == nullptr)
+	{
+		const char *err = dlerror();
+		throw runtime_error("RunManagerPlugin error loading '" + plugin_filename + "': " + string(err == nullptr ? "" : err));
+	}
+#endif
+	evaluate_func = (EvaluateFunc)find_symbol("evaluate");
+	if (evaluate_func == nullptr)
+		throw runtime_error("RunManagerPlugin error: '" + plugin_filename + "' does not export 'evaluate'");
+	//optional
+	initialize_func = (InitializeFunc)find_symbol("initialize");
+}
+
+void *RunManagerPlugin::find_symbol(const char *name)
+{
+#ifdef OS_WIN
+	return (void*)GetProcAddress((HMODULE)lib_handle, name);
+#else
+	return dlsym(lib_handle, name);
+#endif
+}
+
+void RunManagerPlugin::initialize_plugin(int npar, int nobs)
+{
+	if (plugin_initialized)
+		return;
+	if (initialize_func != nullptr)
+	{
+		int status = initialize_func(npar, nobs);
+		if (status != 0)
+		{
+			stringstream ss;
+			ss << "RunManagerPlugin error: initialize(" << npar << "," << nobs << ") in '" << plugin_filename << "' returned " << status;
+			throw runtime_error(ss.str());
+		}
+	}
+	plugin_initialized = true;
+}
+
+void RunManagerPlugin::set_model_order(const vector<string> &_par_names, const vector<string> &_obs_names)
+{
+	model_par_names = _par_names;
+	model_obs_names = _obs_names;
+}
+
+void RunManagerPlugin::build_model_map(const vector<string> &model_names, const vector<string> &stor_names,
+	const string &tag, vector<int> &model_map)
+{
+	model_map.clear();
+	if (model_names.empty())
+		return;
+	if (model_names.size() != stor_names.size())
+	{
+		stringstream ss;
+		ss << "RunManagerPlugin error: model order has " << model_names.size() << " " << tag << " but the run storage has " << stor_names.size();
+		throw runtime_error(ss.str());
+	}
+	unordered_map<string, int> stor_index;
+	stor_index.reserve(stor_names.size());
+	for (int i = 0; i < stor_names.size(); i++)
+		stor_index[stor_names[i]] = i;
+	bool identity = true;
+	model_map.resize(model_names.size());
+	for (int k = 0; k < model_names.size(); k++)
+	{
+		auto it = stor_index.find(model_names[k]);
+		if (it == stor_index.end())
+			throw runtime_error("RunManagerPlugin error: model order name '" + model_names[k] + "' not found in the run storage " + tag);
+		model_map[k] = it->second;
+		identity = identity && (it->second == k);
+	}
+	if (identity)
+		model_map.clear();
+}
+
+void RunManagerPlugin::run_batch(const vector<int> &run_ids, vector<double> &par_data,
+	vector<double> &obs_data, vector<int> &run_status)
+{
+	PerformanceLog::Scope scope(performance_log, "plugin evaluate batch");
+	size_t npar = file_stor.get_par_name_vec().size();
+	size_t nobs = file_stor.get_obs_name_vec().size();
+	int nb = run_ids.size();
+	//a few chunks per thread so a slow run does not hold up a whole thread's share
+	int nchunks = min(nb, num_threads * 4);
+	int chunk_size = (nb + nchunks - 1) / nchunks;
+	EvaluateFunc eval = evaluate_func;
+	const vector<int> &par_map = model_par_map;
+	const vector<int> &obs_map = model_obs_map;
+	vector<future<void>> futures;
+	for (int first = 0; first < nb; first += chunk_size)
+	{
+		int last = min(first + chunk_size, nb);
+		futures.push_back(pool->submit([eval, first, last, npar, nobs, &par_map, &obs_map, &par_data, &obs_data, &run_status]()
+		{
+			vector<double> model_pars, model_obs;
+			if (!par_map.empty())
+				model_pars.resize(npar);
+			if (!obs_map.empty())
+				model_obs.resize(nobs);
+			for (int k = first; k < last; k++)
+			{
+				const double *pars = par_data.data() + (k * npar);
+				double *obs = obs_data.data() + (k * nobs);
+				if (!par_map.empty())
+				{
+					for (size_t i = 0; i < npar; i++)
+						model_pars[i] = pars[par_map[i]];
+					pars = model_pars.data();
+				}
+				if (obs_map.empty())
+					run_status[k] = eval(pars, obs);
+				else
+				{
+					fill(model_obs.begin(), model_obs.end(), RunStorage::no_data);
+					run_status[k] = eval(pars, model_obs.data());
+					for (size_t i = 0; i < nobs; i++)
+						obs[obs_map[i]] = model_obs[i];
+				}
+			}
+		}));
+	}
+	ThreadPool::wait_all(futures, "RunManagerPlugin::run_batch()");
+	scope.add_counter("runs", nb);
+}
+
+void RunManagerPlugin::run()
+{
+	PerformanceLog::Scope scope(performance_log, "plugin run");
+	int success_runs = 0;
+	int failed_runs = 0;
+	size_t npar = file_stor.get_par_name_vec().size();
+	size_t nobs = file_stor.get_obs_name_vec().size();
+	build_model_map(model_par_names, file_stor.get_par_name_vec(), "parameters", model_par_map);
+	build_model_map(model_obs_names, file_stor.get_obs_name_vec(), "observations", model_obs_map);
+	initialize_plugin(npar, nobs);
+
+	stringstream message;
+	vector<double> par_data, obs_data;
+	vector<int> run_status;
+	vector<int> run_id_vec;
+	int nruns = get_outstanding_run_ids().size();
+	std::chrono::system_clock::time_point start_time_all = std::chrono::system_clock::now();
+	while (!(run_id_vec = get_outstanding_run_ids()).empty())
+	{
+		for (size_t first = 0; first < run_id_vec.size(); first += batch_size)
+		{
+			std::chrono::system_clock::time_point start_time = std::chrono::system_clock::now();
+			vector<int> batch_ids(run_id_vec.begin() + first, run_id_vec.begin() + min(first + batch_size, run_id_vec.size()));
+			int nb = batch_ids.size();
+			par_data.resize(nb * npar);
+			obs_data.resize(nb * nobs);
+			run_status.assign(nb, -1);
+			for (int k = 0; k < nb; k++)
+				file_stor.get_run(batch_ids[k], par_data.data() + (k * npar), npar, obs_data.data() + (k * nobs), nobs);
+			fill(obs_data.begin(), obs_data.end(), RunStorage::no_data);
+
+			run_batch(batch_ids, par_data, obs_data, run_status);
+
+			for (int k = 0; k < nb; k++)
+			{
+				if (run_status[k] == 0)
+				{
+					file_stor.update_run(batch_ids[k], par_data.data() + (k * npar), npar, obs_data.data() + (k * nobs), nobs);
+					success_runs++;
+				}
+				else
+				{
+					update_run_failed(batch_ids[k]);
+					failed_runs++;
+					cerr << "  Error running model: evaluate() returned " << run_status[k] << " for run " << batch_ids[k] << endl;
+				}
+			}
+			message.str("");
+			message << endl << "-->" << pest_utils::get_time_string() << " batch of " << nb << " runs complete, took: " << pest_utils::get_duration_sec(start_time) << " seconds";
+			message << endl << "-->" << success_runs << " of " << nruns << " complete, " << failed_runs << " failed" << endl;
+			std::cout << message.str();
+		}
+	}
+	total_runs += success_runs;
+	message.str("");
+	message << endl << endl << "    ---  plugin run manager runs summary:  ---    " << endl;
+	message << "    " << success_runs << " of " << nruns << " complete, " << failed_runs << " failed" << endl;
+	message << "    " << "process took : " << pest_utils::get_duration_sec(start_time_all) << " seconds" << endl << endl << endl;
+	std::cout << message.str();
+	scope.add_counter("runs", success_runs);
+	scope.add_counter("failed", failed_runs);
+
+	if (failed_runs > 0)
+	{
+		cout << "WARNING: " << failed_runs << " out of " << nruns << " runs failed" << endl << endl;
+		cout << "    failed run ids:" << endl;
+		int i = 1;
+		for (auto id : get_failed_run_ids())
+		{
+			cout << id << ",";
+			i++;
+			if (i > 10)
+			{
+				cout << endl << "    ";
+				i = 1;
+			}
+		}
+		std::cout << endl << endl;
+	}
+	if ((init_sim.size() == 0) && (file_stor.get_nruns() > 0))
+	{
+		vector<double> pars;
+		file_stor.get_run(0, pars, init_sim);
+	}
+}
+
+
+RunManagerPlugin::~RunManagerPlugin(void)
+{
+	//stop the workers before the library they call into goes away
+	pool.reset();
+	if (lib_handle != nullptr)
+	{
+#ifdef OS_WIN
+		FreeLibrary((HMODULE)lib_handle);
+#else
+		dlclose(lib_handle);
+#endif
+	}
+}
@@ -0,0 +1,82 @@
+/*
+
+
+	This file is part of PEST++.
+
+	PEST++ is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PEST++ is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+#ifndef RUNMANAGERPLUGIN_H
+#define RUNMANAGERPLUGIN_H
+
+#include "RunManagerAbstract.h"
+#include <string>
+#include <memory>
+
+class ThreadPool;
+
+//runs the model in-process through a shared library (.so/.dylib/.dll) instead of through
+//template/instruction files and a command line.  the library must export the C function
+//
+//    int evaluate(const double *pars, double *obs)
+//
+//which fills obs from pars (the model parameters as added to the run storage) and returns 0
+//on success.  both are in run storage order unless set_model_order() has been called, in
+//which case they are in the given order (e.g. control file order).  it may also export
+//
+//    int initialize(int npar, int nobs)
+//
+//which is called once before the first evaluation and can reject the problem dimensions
+//by returning non-zero.  evaluate() is called concurrently from several threads, so it
+//must be reentrant.  runs are read from the run storage in batches, evaluated on a
+//thread pool and written straight back to the run storage
+class RunManagerPlugin : public RunManagerAbstract
+{
+public:
+	typedef int(*EvaluateFunc)(const double*, double*);
+	typedef int(*InitializeFunc)(int, int);
+
+	RunManagerPlugin(const std::string &_plugin_filename, const std::string &stor_filename,
+		int _max_run_fail = 1, int _num_threads = -1, int _batch_size = 1000);
+	virtual void run();
+	//order of the pars and obs arrays handed to evaluate().  each must hold exactly the
+	//run storage names; the mapping is checked on the next call to run()
+	void set_model_order(const std::vector<std::string> &_par_names, const std::vector<std::string> &_obs_names);
+	int get_num_threads() const { return num_threads; }
+	~RunManagerPlugin(void);
+private:
+	std::string plugin_filename;
+	void *lib_handle;
+	EvaluateFunc evaluate_func;
+	InitializeFunc initialize_func;
+	bool plugin_initialized;
+	int num_threads;
+	int batch_size;
+	std::unique_ptr<ThreadPool> pool;
+	std::vector<std::string> model_par_names;
+	std::vector<std::string> model_obs_names;
+	//model_par_map[k] is the run storage index of the k-th model parameter (same for obs).
+	//empty if the model order is the run storage order
+	std::vector<int> model_par_map;
+	std::vector<int> model_obs_map;
+
+	void load_plugin();
+	void *find_symbol(const char *name);
+	void initialize_plugin(int npar, int nobs);
+	void build_model_map(const std::vector<std::string> &model_names, const std::vector<std::string> &stor_names,
+		const std::string &tag, std::vector<int> &model_map);
+	void run_batch(const std::vector<int> &run_ids, std::vector<double> &par_data,
+		std::vector<double> &obs_data, std::vector<int> &run_status);
+};
+
+#endif /* RUNMANAGERPLUGIN_H */
@@ -26,10 +26,14 @@
 #include <cstring>
 #include <map>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <future>
 #include "system_variables.h"
 #include "Transformable.h"
 #include "utilities.h"
 #include "model_interface.h"
+#include "ThreadPool.h"
 
 using namespace std;
 using namespace pest_utils;
@@ -39,15 +43,109 @@ RunManagerSerial::RunManagerSerial(const vector<string> _comline_vec,
 	const vector<string> _tplfile_vec, const vector<string> _inpfile_vec,
 	const vector<string> _insfile_vec, const vector<string> _outfile_vec,
 	const string &stor_filename, const string &_run_dir, int _max_run_fail,
-	bool fill_tpl_zeros, string additional_ins_delimiters)
+	bool fill_tpl_zeros, string additional_ins_delimiters, int _num_slots)
 	: RunManagerAbstract(_comline_vec, _tplfile_vec, _inpfile_vec,
 	_insfile_vec, _outfile_vec, stor_filename, _max_run_fail),
-	run_dir(_run_dir), mi(_tplfile_vec,_inpfile_vec,_insfile_vec,_outfile_vec, _comline_vec)
+	run_dir(_run_dir), mi(_tplfile_vec,_inpfile_vec,_insfile_vec,_outfile_vec, _comline_vec),
+	num_slots(max(_num_slots, 1))
 {
 	mi.set_additional_ins_delimiters(additional_ins_delimiters);
 	mi.set_fill_tpl_zeros(fill_tpl_zeros);
 
-	cout << "              starting serial run manager ..." << endl << endl;
+	if (num_slots > 1)
+	{
+		cout << "              starting serial run manager with " << num_slots << " local slots ..." << endl << endl;
+		prep_slots(stor_filename, fill_tpl_zeros, additional_ins_delimiters);
+	}
+	else
+		cout << "              starting serial run manager ..." << endl << endl;
+}
+
+void RunManagerSerial::prep_slots(const string &stor_filename, bool fill_tpl_zeros, const string &additional_ins_delimiters)
+{
+	string src_dir = run_dir.empty() ? OperSys::getcwd() : run_dir;
+	string slot_root_name = "pestpp_slots";
+	string slot_root = src_dir + OperSys::DIR_SEP + slot_root_name;
+	//dont clone the slots into themselves or copy the (possibly large) run storage file
+	vector<string> skip_names{ slot_root_name };
+	size_t pos = stor_filename.find_last_of("/\\");
+	skip_names.push_back(pos == string::npos ? stor_filename : stor_filename.substr(pos + 1));
+	if (!OperSys::make_dir(slot_root))
+		throw runtime_error("RunManagerSerial error creating slot directory '" + slot_root + "'");
+	for (int i = 0; i < num_slots; i++)
+	{
+		stringstream ss;
+		ss << slot_root << OperSys::DIR_SEP << "slot_" << i;
+		string slot_dir = ss.str();
+		cout << "              cloning '" << src_dir << "' into '" << slot_dir << "'" << endl;
+		OperSys::copy_dir(src_dir, slot_dir, skip_names);
+		slot_dirs.push_back(slot_dir);
+		slot_mi.push_back(unique_ptr<ModelInterface>(new ModelInterface(tplfile_vec, inpfile_vec, insfile_vec, outfile_vec, comline_vec)));
+		slot_mi.back()->set_additional_ins_delimiters(additional_ins_delimiters);
+		slot_mi.back()->set_fill_tpl_zeros(fill_tpl_zeros);
+		slot_mi.back()->set_work_dir(slot_dir);
+	}
+	cout << endl;
+}
+
+void RunManagerSerial::run_slots(const vector<int> &run_id_vec, int nruns, int &success_runs, int &failed_runs)
+{
+	const vector<string> &obs_name_vec = file_stor.get_obs_name_vec();
+	//the run storage and the counters are shared by all the slots
+	mutex stor_lock;
+	atomic<int> next_run(0);
+	ThreadPool pool(num_slots);
+	vector<future<void>> futures;
+	for (int islot = 0; islot < num_slots; islot++)
+	{
+		futures.push_back(pool.submit([this, islot, &run_id_vec, nruns, &obs_name_vec, &stor_lock, &next_run, &success_runs, &failed_runs]()
+		{
+			int k;
+			while ((k = next_run.fetch_add(1)) < (int)run_id_vec.size())
+			{
+				int i_run = run_id_vec[k];
+				std::chrono::system_clock::time_point start_time = std::chrono::system_clock::now();
+				Parameters pars;
+				Observations obs;
+				{
+					lock_guard<mutex> guard(stor_lock);
+					file_stor.get_parameters(i_run, pars);
+				}
+				obs.insert(obs_name_vec, vector<double>(obs_name_vec.size(), RunStorage::no_data));
+				stringstream message;
+				try
+				{
+					slot_mi[islot]->run(&pars, &obs);
+					lock_guard<mutex> guard(stor_lock);
+					file_stor.update_run(i_run, pars, obs);
+					success_runs++;
+				}
+				catch (const std::exception& ex)
+				{
+					lock_guard<mutex> guard(stor_lock);
+					update_run_failed(i_run);
+					failed_runs++;
+					message << "  Error running model in slot " << islot << ": " << ex.what() << endl;
+					message << "  Aborting model run" << endl << endl;
+				}
+				catch (...)
+				{
+					lock_guard<mutex> guard(stor_lock);
+					update_run_failed(i_run);
+					failed_runs++;
+					message << "  Error running model in slot " << islot << endl;
+					message << "  Aborting model run" << endl << endl;
+				}
+				lock_guard<mutex> guard(stor_lock);
+				cerr << message.str();
+				message.str("");
+				message << endl << endl << "-->" << pest_utils::get_time_string() << " run " << i_run << " complete in slot " << islot << ", took: " << pest_utils::get_duration_sec(start_time) << " seconds";
+				message << endl << "-->" << success_runs << " of " << nruns << " complete, " << failed_runs << " failed" << endl << endl << endl;
+				std::cout << message.str();
+			}
+		}));
+	}
+	ThreadPool::wait_all(futures, "RunManagerSerial::run_slots()");
 }
 
 void RunManagerSerial::run()
@@ -65,6 +163,11 @@ void RunManagerSerial::run()
 	std::chrono::system_clock::time_point start_time_all = std::chrono::system_clock::now();
 	while (!(run_id_vec = get_outstanding_run_ids()).empty())
 	{
+		if (num_slots > 1)
+		{
+			run_slots(run_id_vec, nruns, success_runs, failed_runs);
+			continue;
+		}
 		for (int i_run : run_id_vec)
 		{
 			std::chrono::system_clock::time_point start_time = std::chrono::system_clock::now();
@@ -21,6 +21,8 @@
 
 #include "RunManagerAbstract.h"
 #include <string>
+#include <vector>
+#include <memory>
 #include "model_interface.h"
 
 class RunManagerSerial : public RunManagerAbstract
@@ -30,12 +32,21 @@ public:
 		const std::vector<std::string> _tplfile_vec, const std::vector<std::string> _inpfile_vec,
 		const std::vector<std::string> _insfile_vec, const std::vector<std::string> _outfile_vec,
 		const std::string &stor_filename, const std::string &run_dir, int _max_run_fail=1,
-		bool fill_tpl_zeros=false, string additional_ins_delimiters="");
+		bool fill_tpl_zeros=false, string additional_ins_delimiters="", int _num_slots=1);
 	virtual void run();
+	int get_num_slots() const { return num_slots; }
 	~RunManagerSerial(void);
 private:
 	ModelInterface mi;
 	std::string run_dir;
+	//with more than one slot, run_dir is cloned into one directory per slot and the queued
+	//runs are shared out across the slots, each running the model on its own thread
+	int num_slots;
+	std::vector<std::string> slot_dirs;
+	std::vector<std::unique_ptr<ModelInterface>> slot_mi;
+
+	void prep_slots(const std::string &stor_filename, bool fill_tpl_zeros, const string &additional_ins_delimiters);
+	void run_slots(const std::vector<int> &run_id_vec, int nruns, int &success_runs, int &failed_runs);
 };
 
 #endif /* RUNMANAGERSERIAL_H */
@@ -3,6 +3,7 @@
 #include "utilities.h"
 #include "RunManagerPanther.h"
 #include "RunManagerSerial.h"
+#include "RunManagerPlugin.h"
 #include "pest_error.h"
 
 typedef class RunManagerAbstract RunManagerAbstract;
@@ -53,6 +54,25 @@ RunManager* rmic_create_panther(
 }
 
 
+RunManager* rmic_create_plugin(
+	char *storfile,
+	char *plugin_filename,
+	int n_max_fail,
+	int n_threads)
+{
+	RunManager *run_manager_ptr = nullptr;
+	try {
+		run_manager_ptr = new RunManagerPlugin(plugin_filename, storfile, n_max_fail, n_threads);
+	}
+	catch (const std::exception &e)
+	{
+		cerr << e.what() << endl;
+		run_manager_ptr = nullptr;
+	}
+	return run_manager_ptr;
+}
+
+
 int rmic_initialize(RunManager *run_manager_ptr,
 	char **pname, int pname_array_len,
 	char **oname, int oname_array_len)
@@ -28,6 +28,15 @@ RunManager* rmic_create_panther(char *storfile,
 	double overdue_reched_fac, double overdue_giveup_fac,
 	double overdue_giveup_minutes);
 
+//returns a null pointer if the plugin library can not be loaded or does not export evaluate()
+#ifdef OS_WIN
+extern __declspec(dllexport)
+#endif
+RunManager* rmic_create_plugin(char *storfile,
+	char *plugin_filename,
+	int n_max_fail,
+	int n_threads);
+
 #ifdef OS_WIN
 extern __declspec(dllexport)
 #endif
@@ -486,6 +486,8 @@ void PANTHERAgent::start_impl(const string &host, const string &port)
 	vector<int8_t> serialized_data;
 	pair<int,string> err;
 	vector<string> par_name_vec, obs_name_vec;
+	//set when the master advertises the binary run-result format with PAR_NAMES
+	bool bin_results = false;
 	stringstream ss;
 	//class attribute - can be modified in run_model()
 	terminate = false;
@@ -586,6 +588,9 @@ void PANTHERAgent::start_impl(const string &host, const string &port)
 				terminate_or_restart(-1);
 			}
 			Serialization::unserialize(net_pack.get_data(), par_name_vec);
+			bin_results = (net_pack.get_info_txt() == NetPackage::BIN_RESULTS_TAG);
+			if (bin_results)
+				report("master supports binary run results", true);
 			//make sure all par names are found in the scenario
 			vector<string> vnames = pest_scenario.get_ctl_ordered_par_names();
 			set<string> snames(vnames.begin(), vnames.end());
@@ -871,7 +876,10 @@ void PANTHERAgent::start_impl(const string &host, const string &port)
 				ss << "PANTHER_DEBUG_LOOP = true, returning ctl obs values";
 				
 				report(ss.str(), true);
-				serialized_data = Serialization::serialize(pars, par_name_vec, obs, obs_name_vec, run_time);
+				if (bin_results)
+					serialized_data = Serialization::serialize_bin(pars, par_name_vec, obs, obs_name_vec, run_time);
+				else
+					serialized_data = Serialization::serialize(pars, par_name_vec, obs, obs_name_vec, run_time);
 				ss.str("");
 				double rd = ((double)rand() / (double)RAND_MAX);
 				if (rd < 0.1)
@@ -882,7 +890,7 @@ void PANTHERAgent::start_impl(const string &host, const string &port)
 				else
 				{
 					ss << "debug loop returning ctl obs for run_id, group_id: " << run_id << "," << group_id;
-					net_pack.reset(NetPackage::PackType::RUN_FINISHED, group_id, run_id, ss.str());
+					net_pack.reset(bin_results ? NetPackage::PackType::RUN_FINISHED_BIN : NetPackage::PackType::RUN_FINISHED, group_id, run_id, ss.str());
 				}
 				err = send_message(net_pack, serialized_data.data(), serialized_data.size());
 				if (err.first != 1)
@@ -949,8 +957,16 @@ void PANTHERAgent::start_impl(const string &host, const string &port)
 				ss.str("");
 				ss << ", run took " << run_time << " seconds";
 				string message = final_run_status.second + ss.str();
-				serialized_data = Serialization::serialize(pars, par_name_vec, obs, obs_name_vec, run_time);
-				net_pack.reset(NetPackage::PackType::RUN_FINISHED, group_id, run_id, message);
+				if (bin_results)
+				{
+					serialized_data = Serialization::serialize_bin(pars, par_name_vec, obs, obs_name_vec, run_time);
+					net_pack.reset(NetPackage::PackType::RUN_FINISHED_BIN, group_id, run_id, message);
+				}
+				else
+				{
+					serialized_data = Serialization::serialize(pars, par_name_vec, obs, obs_name_vec, run_time);
+					net_pack.reset(NetPackage::PackType::RUN_FINISHED, group_id, run_id, message);
+				}
 				err = send_message(net_pack, serialized_data.data(), serialized_data.size());
 				if (err.first != 1)
 				{
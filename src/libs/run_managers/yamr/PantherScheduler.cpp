@@ -0,0 +1,255 @@
+/*
+
+
+	This file is part of PEST++.
+
+	PEST++ is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PEST++ is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include "PantherScheduler.h"
+#include "pest_error.h"
+#include "utilities.h"
+
+using namespace std;
+
+PantherSchedulePolicy::PantherSchedulePolicy(Type _type, int _tail_runs) : type(_type), tail_runs(max(0, _tail_runs))
+{
+}
+
+PantherSchedulePolicy::Type PantherSchedulePolicy::parse_type(const string &type_str)
+{
+	string s = pest_utils::upper_cp(type_str);
+	if ((s.size() == 0) || (s == "FIFO"))
+		return Type::FIFO;
+	if (s == "FASTEST_AGENT")
+		return Type::FASTEST_AGENT;
+	if (s == "LONGEST_RUN")
+		return Type::LONGEST_RUN;
+	throw PestError("PantherSchedulePolicy error: unrecognized schedule policy '" + type_str + "', should be 'fifo', 'fastest_agent' or 'longest_run'");
+}
+
+string PantherSchedulePolicy::type_to_string(Type _type)
+{
+	if (_type == Type::FASTEST_AGENT)
+		return "fastest_agent";
+	if (_type == Type::LONGEST_RUN)
+		return "longest_run";
+	return "fifo";
+}
+
+string PantherSchedulePolicy::get_description() const
+{
+	stringstream ss;
+	ss << "schedule policy: " << type_to_string(type);
+	if (tail_runs > 0)
+		ss << ", speculative duplication of the last " << tail_runs << " runs";
+	return ss.str();
+}
+
+void PantherSchedulePolicy::add_run(int run_id, const string &run_key)
+{
+	if ((type != Type::LONGEST_RUN) || (run_key.size() == 0))
+		return;
+	run_keys[run_id] = run_key;
+}
+
+double PantherSchedulePolicy::normalized_cost(const AgentInfoRec &agent, double sec) const
+{
+	//normalize to a pool-average agent so costs seen on slow and fast agents are comparable
+	double e = expected_runtime_sec(agent);
+	double avg = pool_avg_runtime_sec();
+	if ((e > 0.0) && (avg > 0.0))
+		return sec * avg / e;
+	return sec;
+}
+
+void PantherSchedulePolicy::record_run_complete(int run_id, const AgentInfoRec &agent, double run_sec)
+{
+	if (run_sec <= 0.0)
+		return;
+	auto ik = run_keys.find(run_id);
+	if (ik != run_keys.end())
+	{
+		//normalized against the agent history before this run is added to it
+		double cost = normalized_cost(agent, run_sec);
+		auto it = key_cost_sec.find(ik->second);
+		if (it == key_cost_sec.end())
+			key_cost_sec[ik->second] = cost;
+		else
+			it->second = 0.5 * (it->second + cost);
+	}
+	string key = agent.get_socket_name();
+	auto it = agent_runtime_sec.find(key);
+	//same weighting as AgentInfoRec::end_run()
+	if (it == agent_runtime_sec.end())
+		agent_runtime_sec[key] = run_sec;
+	else
+		it->second = 0.5 * (it->second + run_sec);
+	double lp = agent.get_linpack_time_sec();
+	if (lp > 0.0)
+		agent_linpack_sec[key] = lp;
+}
+
+void PantherSchedulePolicy::record_run_interrupted(int run_id, const AgentInfoRec &agent, double elapsed_sec)
+{
+	if (elapsed_sec <= 0.0)
+		return;
+	double cost = normalized_cost(agent, elapsed_sec);
+	auto it = run_cost_sec.find(run_id);
+	if (it == run_cost_sec.end())
+		run_cost_sec[run_id] = cost;
+	else
+		it->second = max(it->second, cost);
+	//the run takes at least this long, whatever it took before
+	auto ik = run_keys.find(run_id);
+	if (ik != run_keys.end())
+	{
+		auto ic = key_cost_sec.find(ik->second);
+		if (ic == key_cost_sec.end())
+			key_cost_sec[ik->second] = cost;
+		else
+			ic->second = max(ic->second, cost);
+	}
+}
+
+void PantherSchedulePolicy::start_group()
+{
+	//run ids are only unique within a group.  agent histories and run key costs carry over
+	run_keys.clear();
+	run_cost_sec.clear();
+}
+
+double PantherSchedulePolicy::get_run_cost(int run_id) const
+{
+	//normalized expected time of a run, or a negative value if nothing is known
+	double cost = -1.0;
+	auto ik = run_keys.find(run_id);
+	if (ik != run_keys.end())
+	{
+		auto ic = key_cost_sec.find(ik->second);
+		if (ic != key_cost_sec.end())
+			cost = ic->second;
+	}
+	auto it = run_cost_sec.find(run_id);
+	if (it != run_cost_sec.end())
+		cost = max(cost, it->second);
+	return cost;
+}
+
+double PantherSchedulePolicy::pool_avg_runtime_sec() const
+{
+	if (agent_runtime_sec.size() == 0)
+		return -1.0;
+	double sum = 0.0;
+	for (auto &a : agent_runtime_sec)
+		sum += a.second;
+	return sum / (double)agent_runtime_sec.size();
+}
+
+double PantherSchedulePolicy::pool_runtime_per_linpack() const
+{
+	double sum = 0.0;
+	int count = 0;
+	for (auto &a : agent_linpack_sec)
+	{
+		auto it = agent_runtime_sec.find(a.first);
+		if ((it != agent_runtime_sec.end()) && (a.second > 0.0))
+		{
+			sum += it->second / a.second;
+			count++;
+		}
+	}
+	if (count == 0)
+		return -1.0;
+	return sum / (double)count;
+}
+
+double PantherSchedulePolicy::expected_runtime_sec(const AgentInfoRec &agent) const
+{
+	auto it = agent_runtime_sec.find(agent.get_socket_name());
+	if (it != agent_runtime_sec.end())
+		return it->second;
+	double lp = agent.get_linpack_time_sec();
+	double ratio = pool_runtime_per_linpack();
+	if ((lp > 0.0) && (ratio > 0.0))
+		return lp * ratio;
+	return pool_avg_runtime_sec();
+}
+
+double PantherSchedulePolicy::expected_remaining_sec(const AgentInfoRec &agent) const
+{
+	double e = expected_runtime_sec(agent);
+	if (e <= 0.0)
+		return -1.0;
+	double cost = get_run_cost(agent.get_run_id());
+	double avg = pool_avg_runtime_sec();
+	if ((cost > 0.0) && (avg > 0.0))
+		e = max(e, cost * e / avg);
+	double remaining = e - agent.get_duration_sec();
+	//an overdue run has already beaten the estimate, so assume it still needs a full run
+	if (remaining <= 0.0)
+		remaining = e;
+	return remaining;
+}
+
+void PantherSchedulePolicy::order_agents(list<list<AgentInfoRec>::iterator> &free_agents) const
+{
+	if (type == Type::FIFO)
+		return;
+	//stable, so agents without any history keep their connection order at the back
+	free_agents.sort([this](const list<AgentInfoRec>::iterator &a, const list<AgentInfoRec>::iterator &b)
+	{
+		double ea = expected_runtime_sec(*a);
+		double eb = expected_runtime_sec(*b);
+		if (ea <= 0.0)
+			return false;
+		if (eb <= 0.0)
+			return true;
+		return ea < eb;
+	});
+}
+
+void PantherSchedulePolicy::order_runs(deque<int> &waiting_runs) const
+{
+	if ((type != Type::LONGEST_RUN) || ((key_cost_sec.size() == 0) && (run_cost_sec.size() == 0)))
+		return;
+	//look each cost up once rather than in every comparison
+	vector<pair<double, int>> costs;
+	costs.reserve(waiting_runs.size());
+	for (int run_id : waiting_runs)
+		costs.push_back(make_pair(get_run_cost(run_id), run_id));
+	stable_sort(costs.begin(), costs.end(), [](const pair<double, int> &a, const pair<double, int> &b)
+	{
+		return a.first > b.first;
+	});
+	for (size_t i = 0; i < costs.size(); i++)
+		waiting_runs[i] = costs[i].second;
+}
+
+bool PantherSchedulePolicy::tail_active(size_t n_waiting, size_t n_active_runs) const
+{
+	return (tail_runs > 0) && (n_waiting == 0) && (n_active_runs > 0) && (n_active_runs <= (size_t)tail_runs);
+}
+
+bool PantherSchedulePolicy::should_duplicate(double remaining_sec, const AgentInfoRec &free_agent) const
+{
+	if (remaining_sec <= 0.0)
+		return false;
+	double f = expected_runtime_sec(free_agent);
+	if (f <= 0.0)
+		return false;
+	return f < remaining_sec;
+}
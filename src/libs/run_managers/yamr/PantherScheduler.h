@@ -0,0 +1,88 @@
+/*
+
+
+	This file is part of PEST++.
+
+	PEST++ is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PEST++ is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
+*/
+#ifndef PANTHERSCHEDULER_H
+#define PANTHERSCHEDULER_H
+#include <string>
+#include <list>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include "RunManagerPanther.h"
+
+//run scheduling policy for RunManagerPanther.  the policy keeps its own history of
+//model run times per agent connection (AgentInfoRec run times are reset at the start
+//of each run group) and of how long runs were seen to take, and uses them to order the
+//free agents and the waiting runs before RunManagerPanther::schedule_run() hands the
+//first waiting run to the first suitable agent.  run costs are kept per run key (the
+//run's info_txt, e.g. the perturbed parameter of a jacobian run or the realization name
+//of an ensemble run), so they carry over to the same kind of run in later groups.
+//  FIFO: the original behavior - runs in queue order, agents in connection order
+//  FASTEST_AGENT: agents with the shortest expected run time first
+//  LONGEST_RUN: FASTEST_AGENT plus runs with the longest expected time first, so the
+//    expensive runs go to the fast agents.  runs without a key or without any history
+//    keep their queue order behind the ones with a known cost
+//with tail_runs > 0, once no runs are waiting and at most tail_runs runs of the group are
+//still active, runs whose expected remaining time exceeds the expected time on a free agent
+//are speculatively duplicated there; the first copy to finish wins and the others are killed
+class PantherSchedulePolicy
+{
+public:
+	enum class Type { FIFO, FASTEST_AGENT, LONGEST_RUN };
+	PantherSchedulePolicy(Type _type = Type::FIFO, int _tail_runs = 0);
+	static Type parse_type(const std::string &type_str);
+	static std::string type_to_string(Type _type);
+	Type get_type() const { return type; }
+	int get_tail_runs() const { return tail_runs; }
+	std::string get_description() const;
+
+	//history updates from RunManagerPanther
+	void add_run(int run_id, const std::string &run_key);
+	void record_run_complete(int run_id, const AgentInfoRec &agent, double run_sec);
+	void record_run_interrupted(int run_id, const AgentInfoRec &agent, double elapsed_sec);
+	void start_group();
+
+	//expected model run time in seconds on an agent - its own history, then its linpack
+	//time scaled by the pool-average ratio of run time to linpack time, then the pool average.
+	//returns a negative value if nothing is known yet
+	double expected_runtime_sec(const AgentInfoRec &agent) const;
+	//expected remaining time in seconds of the run active on an agent
+	double expected_remaining_sec(const AgentInfoRec &agent) const;
+	void order_agents(std::list<std::list<AgentInfoRec>::iterator> &free_agents) const;
+	void order_runs(std::deque<int> &waiting_runs) const;
+	bool tail_active(size_t n_waiting, size_t n_active_runs) const;
+	bool should_duplicate(double remaining_sec, const AgentInfoRec &free_agent) const;
+
+private:
+	Type type;
+	int tail_runs;
+	//exponentially weighted run time and linpack time per agent connection (host:port)
+	std::map<std::string, double> agent_runtime_sec;
+	std::map<std::string, double> agent_linpack_sec;
+	//run keys of the current group (run ids are only unique within a group)
+	std::unordered_map<int, std::string> run_keys;
+	//longest time (normalized to a pool-average agent) an interrupted run was seen to take
+	std::unordered_map<int, double> run_cost_sec;
+	//expected time (normalized to a pool-average agent) of a run, by run key, over all groups
+	std::unordered_map<std::string, double> key_cost_sec;
+	double normalized_cost(const AgentInfoRec &agent, double sec) const;
+	double get_run_cost(int run_id) const;
+	double pool_avg_runtime_sec() const;
+	double pool_runtime_per_linpack() const;
+};
+#endif /* PANTHERSCHEDULER_H */
@@ -39,6 +39,8 @@
 #include "Transformable.h"
 #include "utilities.h"
 #include "Serialization.h"
+#include "PantherScheduler.h"
+#include "PerformanceLog.h"
 
 
 using namespace std;
@@ -220,6 +222,11 @@ double AgentInfoRec::get_linpack_time() const
 	return double(linpack_time.count());
 }
 
+double AgentInfoRec::get_linpack_time_sec() const
+{
+	return (double)std::chrono::duration_cast<std::chrono::milliseconds>(linpack_time).count() / 1000.0;
+}
+
 
 void AgentInfoRec::reset_failed_pings()
 {
@@ -270,16 +277,18 @@ int AgentInfoRec::seconds_since_last_ping_time() const
 
 
 RunManagerPanther::RunManagerPanther(const string& stor_filename, const string& _port, ofstream& _f_rmr, int _max_n_failure,
-	double _overdue_reched_fac, double _overdue_giveup_fac, double _overdue_giveup_minutes, bool _should_echo)
+	double _overdue_reched_fac, double _overdue_giveup_fac, double _overdue_giveup_minutes, bool _should_echo,
+	const string &_schedule_policy, int _tail_runs)
 	: RunManagerAbstract(vector<string>(), vector<string>(), vector<string>(),
 		vector<string>(), vector<string>(), stor_filename, _max_n_failure),
 	overdue_reched_fac(_overdue_reched_fac), overdue_giveup_fac(_overdue_giveup_fac),
 	port(_port), f_rmr(_f_rmr), n_no_ops(0), overdue_giveup_minutes(_overdue_giveup_minutes),
 	terminate_idle_thread(false), currently_idle(true), idling(false), idle_thread_finished(false),
-	idle_thread(nullptr), idle_thread_raii(nullptr), should_echo(_should_echo)
+	idle_thread(nullptr), idle_thread_raii(nullptr), should_echo(_should_echo), run_interrupted(false)
 {
 	cout << "          starting PANTHER master..." << endl << endl;
 	max_concurrent_runs = max(MAX_CONCURRENT_RUNS_LOWER_LIMIT, _max_n_failure);
+	scheduler.reset(new PantherSchedulePolicy(PantherSchedulePolicy::parse_type(_schedule_policy), _tail_runs));
 	w_init();
 	std::pair<int, string> status;
 	struct addrinfo hints;
@@ -315,14 +324,15 @@ RunManagerPanther::RunManagerPanther(const string& stor_filename, const string&
 	w_listen(listener, BACKLOG);
 	//free servinfo
 	freeaddrinfo(servinfo);
-	fdmax = listener;
-	FD_ZERO(&master);
-	FD_SET(listener, &master);
+	poller = SocketPoller::create();
+	poller->add(listener);
 	//cant do this here because the run manager doesnt yet know the par and obs names
 	//resume_idle();
 	f_rmr << endl;
 	cout << "PANTHER master listening on socket: " << w_get_addrinfo_string(connect_addr) << endl;
 	f_rmr << "PANTHER master listening on socket:" << w_get_addrinfo_string(connect_addr) << endl;
+	f_rmr << "PANTHER master socket poller: " << poller->get_name() << endl;
+	f_rmr << "PANTHER master " << scheduler->get_description() << endl;
 	
 	
 }
@@ -360,6 +370,7 @@ void RunManagerPanther::initialize(const Parameters &model_pars, const Observati
 {
 	RunManagerAbstract::initialize(model_pars, obs, _filename);
 	cur_group_id = NetPackage::get_new_group_id();
+	scheduler->start_group();
 }
 
 void RunManagerPanther::initialize_restart(const std::string &_filename)
@@ -367,9 +378,14 @@ void RunManagerPanther::initialize_restart(const std::string &_filename)
 	file_stor.init_restart(_filename);
 	free_memory();
 	vector<int> waiting_run_id_vec = get_outstanding_run_ids();
+	int status;
+	string info_txt;
+	double info_value;
 	for (int &id : waiting_run_id_vec)
 	{
 		waiting_runs.push_back(id);
+		file_stor.get_info(id, status, info_txt, info_value);
+		scheduler->add_run(id, info_txt);
 	}
 }
 
@@ -384,14 +400,17 @@ void  RunManagerPanther::free_memory()
 {
 	waiting_runs.clear();
 	model_runs_done = 0;
+	run_interrupted = false;
 	failure_map.clear();
 	active_runid_to_iterset_map.clear();
+	scheduler->start_group();
 }
 
 int RunManagerPanther::add_run(const Parameters &model_pars, const string &info_txt, double info_value)
 {
 	int run_id = file_stor.add_run(model_pars, info_txt, info_value);
 	waiting_runs.push_back(run_id);
+	scheduler->add_run(run_id, info_txt);
 	return run_id;
 }
 
@@ -399,6 +418,7 @@ int RunManagerPanther::add_run(const std::vector<double> &model_pars, const stri
 {
 	int run_id = file_stor.add_run(model_pars, info_txt, info_value);
 	waiting_runs.push_back(run_id);
+	scheduler->add_run(run_id, info_txt);
 	return run_id;
 }
 
@@ -406,9 +426,20 @@ int RunManagerPanther::add_run(const Eigen::VectorXd &model_pars, const string &
 {
 	int run_id = file_stor.add_run(model_pars, info_txt, info_value);
 	waiting_runs.push_back(run_id);
+	scheduler->add_run(run_id, info_txt);
 	return run_id;
 }
 
+vector<int> RunManagerPanther::add_runs(const Eigen::MatrixXd &model_pars, const vector<string> &info_txt, const vector<double> &info_value)
+{
+	vector<int> run_ids = file_stor.add_runs(model_pars, info_txt, info_value);
+	waiting_runs.insert(waiting_runs.end(), run_ids.begin(), run_ids.end());
+	if (info_txt.size() == run_ids.size())
+		for (size_t i = 0; i < run_ids.size(); i++)
+			scheduler->add_run(run_ids[i], info_txt[i]);
+	return run_ids;
+}
+
 void RunManagerPanther::update_run(int run_id, const Parameters &pars, const Observations &obs)
 {
 
@@ -435,6 +466,16 @@ void RunManagerPanther::run()
 }
 
 RunManagerAbstract::RUN_UNTIL_COND RunManagerPanther::run_until(RUN_UNTIL_COND condition, int max_no_ops, double max_time_sec)
+{
+	return run_until_impl(condition, max_no_ops, max_time_sec, false);
+}
+
+RunManagerAbstract::RUN_UNTIL_COND RunManagerPanther::resume_run_until(RUN_UNTIL_COND condition, int max_no_ops, double max_time_sec)
+{
+	return run_until_impl(condition, max_no_ops, max_time_sec, true);
+}
+
+RunManagerAbstract::RUN_UNTIL_COND RunManagerPanther::run_until_impl(RUN_UNTIL_COND condition, int max_no_ops, double max_time_sec, bool resume)
 {
 	RUN_UNTIL_COND terminate_reason = RUN_UNTIL_COND::NORMAL;
 	stringstream message;
@@ -443,38 +484,43 @@ RunManagerAbstract::RUN_UNTIL_COND RunManagerPanther::run_until(RUN_UNTIL_COND c
 	// Pause idle pinging thread
 	pause_idle();
 
-	model_runs_done = 0;
-	model_runs_failed = 0;
-	model_runs_timed_out = 0;
-	failure_map.clear();
-	active_runid_to_iterset_map.clear();
-	int num_runs = waiting_runs.size();
-	cout << "    running model " << num_runs << " times" << endl;
-	f_rmr << "running model " << num_runs << " times" << endl;
-	cout << "    starting at " << pest_utils::get_time_string() << endl;
-	if (agent_info_set.size() == 0) // first entry is the listener, slave apears after this
-	{
-		cout << endl << "      waiting for agents to appear..." << endl << endl;
-		//f_rmr << endl << "    waiting for agents to appear..." << endl << endl;
-		report("waiting for agents to appear", false);
-	}
-	else
-	{
-		for (auto &si : agent_info_set)
-			si.reset_runtime();
-	}
-	cout << endl;
-	f_rmr << endl;
-	if (should_echo)
-	{
-		cout << "PANTHER progress" << endl;
-		cout << "   runs(C = completed | F = failed | T = timed out)" << endl;
-		cout << "   agents(R = running | W = waiting | U = unavailable)" << endl;
-		cout << "------------------------------------------------------------------------------" << endl;
-	}
-	else
-	{
-		cout << "'panther_echo' is 'false', running in silent mode - see rmr file for details" << endl;
+	//a resume call that picks up after a TIME or NO_OPS return keeps the runs that are still
+	//in flight, along with their failure history and the progress counters
+	if (!(resume && run_interrupted))
+	{
+		model_runs_done = 0;
+		model_runs_failed = 0;
+		model_runs_timed_out = 0;
+		failure_map.clear();
+		active_runid_to_iterset_map.clear();
+		int num_runs = waiting_runs.size();
+		cout << "    running model " << num_runs << " times" << endl;
+		f_rmr << "running model " << num_runs << " times" << endl;
+		cout << "    starting at " << pest_utils::get_time_string() << endl;
+		if (agent_info_set.size() == 0) // first entry is the listener, slave apears after this
+		{
+			cout << endl << "      waiting for agents to appear..." << endl << endl;
+			//f_rmr << endl << "    waiting for agents to appear..." << endl << endl;
+			report("waiting for agents to appear", false);
+		}
+		else
+		{
+			for (auto &si : agent_info_set)
+				si.reset_runtime();
+		}
+		cout << endl;
+		f_rmr << endl;
+		if (should_echo)
+		{
+			cout << "PANTHER progress" << endl;
+			cout << "   runs(C = completed | F = failed | T = timed out)" << endl;
+			cout << "   agents(R = running | W = waiting | U = unavailable)" << endl;
+			cout << "------------------------------------------------------------------------------" << endl;
+		}
+		else
+		{
+			cout << "'panther_echo' is 'false', running in silent mode - see rmr file for details" << endl;
+		}
 	}
 
 	std::chrono::system_clock::time_point start_time = std::chrono::system_clock::now();
@@ -544,9 +590,12 @@ RunManagerAbstract::RUN_UNTIL_COND RunManagerPanther::run_until(RUN_UNTIL_COND c
 			int status = file_stor.get_run(0, pars, init_sim);
 		}
 	}
+	run_interrupted = resume && (terminate_reason != RUN_UNTIL_COND::NORMAL);
 
-	// Resume idle pinging thread
-	resume_idle();
+	// Resume idle pinging thread - unless a resume call left runs in flight, in which case their
+	// results are left on the sockets for the next call rather than processed by the idle thread
+	if (!run_interrupted)
+		resume_idle();
 
 	return terminate_reason;
 }
@@ -752,9 +801,8 @@ bool RunManagerPanther::ping(int i_sock)
 	}
 
 	string sock_hostname = agent_info_iter->get_hostname();
-	fd_set read_fds = master;
 	//if the agent hasn't communicated since the last ping request
-	if ((!FD_ISSET(i_sock, &read_fds)) && agent_info_iter->get_ping())
+	if ((!poller->contains(i_sock)) && agent_info_iter->get_ping())
 	{
 		int fails = agent_info_iter->add_failed_ping();
 		report("failed to receive ping response from agent: " + sock_hostname + "$" + agent_info_iter->get_work_dir(), false);
@@ -775,7 +823,7 @@ bool RunManagerPanther::ping(int i_sock)
 		const char* data = "\0";
 
 		NetPackage net_pack(NetPackage::PackType::PING, 0, 0, "");
-		pair<int,string> err = net_pack.send(i_sock, data, 0);
+		pair<int,string> err = send_message(i_sock, net_pack, data, 0);
 		
 		if (err.first <= 0)
 		{
@@ -801,20 +849,19 @@ bool RunManagerPanther::listen(pest_utils::thread_flag* terminate/* = nullptr*/)
 {
 	bool got_message = false;
 	struct sockaddr_storage remote_addr;
-	fd_set read_fds; // temp file descriptor list for select()
 	socklen_t addr_len;
-	timeval tv;
-	tv.tv_sec = 1;
-	tv.tv_usec = 0;
-	read_fds = master; // copy it
-	if (w_select(fdmax+1, &read_fds, NULL, NULL, &tv) == -1)
+	vector<int> ready_fds;
+	vector<int> write_fds;
+	if (poller->wait(ready_fds, write_fds, 1000) == -1)
 	{
 		// there are no slaves available.  W need to keep listening until at least one appears
 		got_message = true;
 		return got_message;
 	}
-	// run through the existing connections looking for data to read
-	for (int i = 0; i <= fdmax; i++)
+	//only the message handling is timed, not the wait
+	PerformanceLog::Scope scope(performance_log, "panther listen");
+	// run through the connections that have data to read
+	for (int i : ready_fds)
 	{
 		// Stop early if we're requested to terminate
 	 	if(terminate && terminate->get())
@@ -822,31 +869,86 @@ bool RunManagerPanther::listen(pest_utils::thread_flag* terminate/* = nullptr*/)
 	 		break;
 	 	}
 
-		if (FD_ISSET(i, &read_fds)) { // we got one!!
-			got_message = true;
-			if (i == listener)  // handle new connections
+		got_message = true;
+		if (i == listener)  // handle new connections
+		{
+			int newfd;
+			addr_len = sizeof remote_addr;
+			newfd = w_accept(listener,(struct sockaddr *)&remote_addr, &addr_len);
+			if (newfd == -1) {}
+			else
 			{
-				int newfd;
-				addr_len = sizeof remote_addr;
-				newfd = w_accept(listener,(struct sockaddr *)&remote_addr, &addr_len);
-				if (newfd == -1) {}
-				else
-				{
-					add_agent(newfd);
-				}
+				add_agent(newfd);
 			}
-			else  // handle data from a client
+		}
+		else  // handle data from a client
+		{
+			//agent sockets are edge triggered, so keep reading until the socket is drained
+			//or the agent has been closed while processing a message.  a message that has
+			//not fully arrived stays in the agent's receive buffer until the next call
+			while (true)
 			{
+				auto iter = socket_to_iter_map.find(i);
+				if (iter == socket_to_iter_map.end())
+					break;
 				//set the ping flag since the slave sent something back
-				list<AgentInfoRec>::iterator iter = socket_to_iter_map.at(i);
-				iter->set_ping(false);
-				process_message(i);
-			} // END handle data from client
-		} // END got new incoming connection
-	} // END looping through file descriptors
+				iter->second->set_ping(false);
+				if (!process_message(i))
+					break;
+				scope.add_counter("messages", 1);
+			}
+		} // END handle data from client
+	} // END looping through ready sockets
+	// send what is left of the queued messages to agents that can take more
+	for (int i : write_fds)
+	{
+		flush_agent(i);
+	}
 	return got_message;
 }
 
+pair<int, string> RunManagerPanther::send_message(int i_sock, NetPackage &net_pack, const void *data, int64_t data_len)
+{
+	auto iter = socket_to_iter_map.find(i_sock);
+	if (iter == socket_to_iter_map.end())
+	{
+		return net_pack.send(i_sock, data, data_len);
+	}
+	NetSendQueue &send_queue = iter->second->get_send_queue();
+	send_queue.push(net_pack.pack(data, data_len));
+	int n = send_queue.flush(i_sock);
+	if (n == NetRecvBuffer::INCOMPLETE)
+	{
+		poller->set_write_wait(i_sock, true);
+		stringstream ss;
+		ss << send_queue.size() << " message(s) queued";
+		return pair<int, string>(1, ss.str());
+	}
+	if (n <= 0)
+	{
+		send_queue.clear();
+		return pair<int, string>(n, "RunManagerPanther::send_message error: could not send data: " + w_get_error_msg());
+	}
+	return pair<int, string>(1, "sent");
+}
+
+void RunManagerPanther::flush_agent(int i_sock)
+{
+	auto iter = socket_to_iter_map.find(i_sock);
+	if (iter == socket_to_iter_map.end())
+		return;
+	int n = iter->second->get_send_queue().flush(i_sock);
+	if (n == 1)
+	{
+		poller->set_write_wait(i_sock, false);
+	}
+	else if (n <= 0)
+	{
+		report("error sending queued messages to agent: " + iter->second->get_hostname() + "$" + iter->second->get_work_dir() + ": " + w_get_error_msg(), false);
+		close_agent(i_sock);
+	}
+}
+
 void RunManagerPanther::close_agents()
 {
 	/*for (int i = 0; i <= fdmax; i++)
@@ -881,8 +983,8 @@ void RunManagerPanther::close_agent(list<AgentInfoRec>::iterator agent_info_iter
 	AgentInfoRec::State state = agent_info_iter->get_state();
 
 	string socket_name = agent_info_iter->get_socket_name();
+	poller->remove(i_sock); // remove from the polled set
 	w_close(i_sock); // bye!
-	FD_CLR(i_sock, &master); // remove from master set
 	// remove run from active_runid_to_iterset_map
 	unschedule_run(agent_info_iter);
 
@@ -905,9 +1007,13 @@ void RunManagerPanther::close_agent(list<AgentInfoRec>::iterator agent_info_iter
 void RunManagerPanther::schedule_runs()
 {
 	NetPackage net_pack;
+	PerformanceLog::Scope scope(performance_log, "panther schedule_runs");
+	size_t n_waiting = waiting_runs.size();
 
 	std::list<list<AgentInfoRec>::iterator> free_agent_list = get_free_agent_list();
 	int n_responsive_agents = get_n_responsive_agents();
+	scheduler->order_agents(free_agent_list);
+	scheduler->order_runs(waiting_runs);
 	//first try to schedule waiting runs
 	for (auto it_run = waiting_runs.begin(); !free_agent_list.empty() && it_run != waiting_runs.end();)
 	{
@@ -922,6 +1028,11 @@ void RunManagerPanther::schedule_runs()
 		}
 	}
 
+	scope.add_counter("runs_dispatched", n_waiting - waiting_runs.size());
+
+	//then speculatively duplicate stragglers at the end of the group
+	schedule_tail_runs(free_agent_list, n_responsive_agents);
+
 	//check for overdue runs if there are no runs waiting to be processed
 	if (n_no_ops > 0)
 	{
@@ -1031,9 +1142,67 @@ void RunManagerPanther::schedule_runs()
 	}
 }
 
+void RunManagerPanther::schedule_tail_runs(std::list<list<AgentInfoRec>::iterator> &free_agent_list, int n_responsive_agents)
+{
+	if (free_agent_list.empty())
+		return;
+	//the active runs and the best expected remaining time over their concurrent copies
+	map<int, double> remaining_map;
+	for (auto &active : active_runid_to_iterset_map)
+	{
+		if (active.second->get_state() != AgentInfoRec::State::ACTIVE)
+			continue;
+		double remaining = scheduler->expected_remaining_sec(*active.second);
+		auto it = remaining_map.find(active.first);
+		if (it == remaining_map.end())
+			remaining_map[active.first] = remaining;
+		else if ((remaining > 0.0) && ((it->second <= 0.0) || (remaining < it->second)))
+			it->second = remaining;
+	}
+	if (!scheduler->tail_active(waiting_runs.size(), remaining_map.size()))
+		return;
+	vector<pair<double, int>> tail_runs;
+	for (auto &r : remaining_map)
+		tail_runs.push_back(make_pair(r.second, r.first));
+	//longest remaining first
+	sort(tail_runs.rbegin(), tail_runs.rend());
+	for (auto &r : tail_runs)
+	{
+		if (free_agent_list.empty())
+			break;
+		int run_id = r.second;
+		if (get_n_concurrent(run_id) >= max_concurrent_runs)
+			continue;
+		//the agent the copy would go to - the duplication decision and the run use the same one
+		int scheduled;
+		auto it_agent = select_agent(run_id, free_agent_list, n_responsive_agents, scheduled);
+		if (it_agent == free_agent_list.end())
+			continue;
+		if (!scheduler->should_duplicate(r.first, **it_agent))
+			continue;
+		stringstream ss;
+		ss << "speculatively duplicating tail run " << run_id << " (expected remaining " << r.first << " sec) on: ";
+		ss << (*it_agent)->get_hostname() << "$" << (*it_agent)->get_work_dir();
+		report(ss.str(), false);
+		send_run(run_id, it_agent, free_agent_list);
+	}
+}
+
 int RunManagerPanther::schedule_run(int run_id, std::list<list<AgentInfoRec>::iterator> &free_agent_list, int n_responsive_agents)
 {
-	int scheduled = -1;
+	int scheduled;
+	auto it_agent = select_agent(run_id, free_agent_list, n_responsive_agents, scheduled);
+	if (it_agent != free_agent_list.end())
+	{
+		scheduled = send_run(run_id, it_agent, free_agent_list);
+	}
+	return scheduled;  // 1 = run scheduled; -1 failed to schedule run; 0 run not needed
+}
+
+std::list<list<AgentInfoRec>::iterator>::iterator RunManagerPanther::select_agent(int run_id, std::list<list<AgentInfoRec>::iterator> &free_agent_list,
+	int n_responsive_agents, int &scheduled)
+{
+	scheduled = -1;
 	auto it_agent = free_agent_list.end(); // iterator to current socket
 	int n_concurrent = get_n_concurrent(run_id);
 
@@ -1080,42 +1249,45 @@ int RunManagerPanther::schedule_run(int run_id, std::list<list<AgentInfoRec>::it
 			}
 		}
 	}
-	if (it_agent != free_agent_list.end())
+	return it_agent;
+}
+
+int RunManagerPanther::send_run(int run_id, std::list<list<AgentInfoRec>::iterator>::iterator it_agent, std::list<list<AgentInfoRec>::iterator> &free_agent_list)
+{
+	int scheduled = -1;
+	int socket_fd = (*it_agent)->get_socket_fd();
+	vector<char> data = file_stor.get_serial_pars(run_id);
+	string info_txt;
+	double info_val;
+	int rstat;
+	file_stor.get_info(run_id, rstat, info_txt, info_val);
+	string host_name = (*it_agent)->get_hostname();
+	//  info_txt = "sending run to " + host_name + ":" + (*it_agent)->get_work_dir() + " at " + pest_utils::get_time_string();
+	NetPackage net_pack(NetPackage::PackType::START_RUN, cur_group_id, run_id, info_txt);
+	pair<int,string> err = send_message(socket_fd, net_pack, &data[0], data.size());
+	if (err.first > 0)
+	{
+		(*it_agent)->set_state(AgentInfoRec::State::ACTIVE, run_id, cur_group_id);
+		//report("changed agent " + host_name + ":" + (*it_agent)->get_work_dir() + " to 'active'",false);
+		//start run timer
+		(*it_agent)->start_timer();
+		//reset the last ping time so we don't ping immediately after run is started
+		(*it_agent)->reset_last_ping_time();
+		active_runid_to_iterset_map.insert(make_pair(run_id, *it_agent));
+		stringstream ss;
+		ss << "Sending run " << run_id << " to: " << host_name << "$" << (*it_agent)->get_work_dir() <<
+			"  (group id:" << cur_group_id << ", run id:" << run_id << ", concurrent runs:" << get_n_concurrent(run_id) << ")";
+		report(ss.str(), false);
+		free_agent_list.erase(it_agent);
+		scheduled = 1;
+	}
+	else
 	{
-		int socket_fd = (*it_agent)->get_socket_fd();
-		vector<char> data = file_stor.get_serial_pars(run_id);
-		string info_txt;
-		double info_val;
-		int rstat;
-		file_stor.get_info(run_id, rstat, info_txt, info_val);
-		string host_name = (*it_agent)->get_hostname();
-		//  info_txt = "sending run to " + host_name + ":" + (*it_agent)->get_work_dir() + " at " + pest_utils::get_time_string();
-		NetPackage net_pack(NetPackage::PackType::START_RUN, cur_group_id, run_id, info_txt);
-		pair<int,string> err = net_pack.send(socket_fd, &data[0], data.size());
-		if (err.first > 0)
-		{
-			(*it_agent)->set_state(AgentInfoRec::State::ACTIVE, run_id, cur_group_id);
-			//report("changed agent " + host_name + ":" + (*it_agent)->get_work_dir() + " to 'active'",false);
-			//start run timer
-			(*it_agent)->start_timer();
-			//reset the last ping time so we don't ping immediately after run is started
-			(*it_agent)->reset_last_ping_time();
-			active_runid_to_iterset_map.insert(make_pair(run_id, *it_agent));
-			stringstream ss;
-			ss << "Sending run " << run_id << " to: " << host_name << "$" << (*it_agent)->get_work_dir() <<
-				"  (group id:" << cur_group_id << ", run id:" << run_id << ", concurrent runs:" << get_n_concurrent(run_id) << ")";
-			report(ss.str(), false);
-			free_agent_list.erase(it_agent);
-			scheduled = 1;
-		}
-		else
-		{
-			stringstream ss;
-			ss << "error sending run " << run_id << "to: " << host_name << "$" << (*it_agent)->get_work_dir() + ": " + err.second;
-			report(ss.str(), false);
-		}
+		stringstream ss;
+		ss << "error sending run " << run_id << "to: " << host_name << "$" << (*it_agent)->get_work_dir() + ": " + err.second;
+		report(ss.str(), false);
 	}
-	return scheduled;  // 1 = run scheduled; -1 failed to schedule run; 0 run not needed
+	return scheduled;  // 1 = run sent; -1 failed to send run
 }
 
 
@@ -1140,7 +1312,7 @@ void RunManagerPanther::report(std::string message,bool to_cout)
 	if (to_cout) cout << endl << t_str << "->" << message << endl;
 }
 
-void RunManagerPanther::process_message(int i_sock)
+bool RunManagerPanther::process_message(int i_sock)
 {
 	NetPackage net_pack;
 	pair<int,string>  err;
@@ -1149,7 +1321,11 @@ void RunManagerPanther::process_message(int i_sock)
 	string host_name = agent_info_iter->get_hostname();
 	string port_name = agent_info_iter->get_port();
 	string socket_name = agent_info_iter->get_socket_name();
-	err = net_pack.recv(i_sock);
+	err = agent_info_iter->get_recv_buffer().recv(i_sock, net_pack);
+	if (err.first == NetRecvBuffer::INCOMPLETE)
+	{
+		return false;
+	}
 	if( err.first <=0) // error or lost connection
 	{
 		if (err.first  == -2) {
@@ -1206,6 +1382,7 @@ void RunManagerPanther::process_message(int i_sock)
 	}
 
 	else if ( (net_pack.get_type() == NetPackage::PackType::RUN_FINISHED
+		|| net_pack.get_type() == NetPackage::PackType::RUN_FINISHED_BIN
 		|| net_pack.get_type() == NetPackage::PackType::RUN_FAILED
 		|| net_pack.get_type() == NetPackage::PackType::RUN_KILLED)
 			&& net_pack.get_group_id() != cur_group_id)
@@ -1220,7 +1397,8 @@ void RunManagerPanther::process_message(int i_sock)
 		report(ss.str(), false);
 		//throw PestError(ss.str());
 	}
-	else if (net_pack.get_type() == NetPackage::PackType::RUN_FINISHED)
+	else if ((net_pack.get_type() == NetPackage::PackType::RUN_FINISHED)
+		|| (net_pack.get_type() == NetPackage::PackType::RUN_FINISHED_BIN))
 	{
 		int run_id = net_pack.get_run_id();
 		int group_id = net_pack.get_group_id();
@@ -1237,7 +1415,9 @@ void RunManagerPanther::process_message(int i_sock)
 		else
 		{
 			// keep track of model run time
+			double run_sec = agent_info_iter->get_duration_sec();
 			agent_info_iter->end_run();
+			scheduler->record_run_complete(run_id, *agent_info_iter, run_sec);
 			stringstream ss;
 			ss << "run " << run_id << " received from: " << host_name << "$" << agent_info_iter->get_work_dir() <<
 				"  (run time:" << agent_info_iter->get_runtime_minute() << " min, avg run time:" << get_global_runtime_minute() << " min, group id:" << group_id <<
@@ -1317,6 +1497,7 @@ void RunManagerPanther::process_message(int i_sock)
 		net_pack.print_header(f_rmr);
 		//save results from model run
 	}
+	return true;
 }
 
 bool RunManagerPanther::process_model_run(int sock_id, NetPackage &net_pack)
@@ -1328,11 +1509,42 @@ bool RunManagerPanther::process_model_run(int sock_id, NetPackage &net_pack)
 	//check if another instance of this model run has already completed
 	if (!run_finished(run_id))
 	{
-		Parameters pars;
-		Observations obs;
 		double run_time = 0;
-		Serialization::unserialize(net_pack.get_data(), pars, get_par_name_vec(), obs, get_obs_name_vec(), run_time);
-		file_stor.update_run(run_id, pars, obs);
+		if (net_pack.get_type() == NetPackage::PackType::RUN_FINISHED_BIN)
+		{
+			//values arrive in the handshake name order, which is the storage order,
+			//so they go straight from the packet buffer into the run storage
+			const double *par_data = nullptr;
+			const double *obs_data = nullptr;
+			size_t npar = get_par_name_vec().size();
+			size_t nobs = get_obs_name_vec().size();
+			try
+			{
+				Serialization::unserialize_bin(net_pack.get_data(), npar, nobs, par_data, obs_data, run_time);
+			}
+			catch (exception &e)
+			{
+				stringstream ss;
+				ss << "malformed results for run " << run_id << " from " << agent_info_iter->get_hostname() << "$";
+				ss << agent_info_iter->get_work_dir() << ": " << e.what() << ", marking run as failed";
+				report(ss.str(), true);
+				model_runs_failed++;
+				update_run_failed(run_id, sock_id);
+				auto it = get_active_run_iter(sock_id);
+				unschedule_run(it);
+				if ((get_n_concurrent(run_id) == 0) && (failure_map.count(run_id) < max_n_failure))
+					waiting_runs.push_front(run_id);
+				return false;
+			}
+			file_stor.update_run(run_id, par_data, npar, obs_data, nobs);
+		}
+		else
+		{
+			Parameters pars;
+			Observations obs;
+			Serialization::unserialize(net_pack.get_data(), pars, get_par_name_vec(), obs, get_obs_name_vec(), run_time);
+			file_stor.update_run(run_id, pars, obs);
+		}
 		agent_info_iter->set_state(AgentInfoRec::State::COMPLETE);
 		//slave_info_iter->set_state(SlaveInfoRec::State::WAITING);
 		use_run = true;
@@ -1369,7 +1581,7 @@ void RunManagerPanther::kill_run(list<AgentInfoRec>::iterator agent_info_iter, c
 		report(ss.str(), false);
 		NetPackage net_pack(NetPackage::PackType::REQ_KILL, 0, 0, "");
 		char data = '\0';
-		pair<int,string> err = net_pack.send(socket_id, &data, sizeof(data));
+		pair<int,string> err = send_message(socket_id, net_pack, &data, sizeof(data));
 		if (err.first == 1)
 		{
 			agent_info_iter->set_state(AgentInfoRec::State::KILLED);
@@ -1443,7 +1655,7 @@ void RunManagerPanther::kill_all_active_runs()
 		{
 			NetPackage net_pack(NetPackage::PackType::REQ_RUNDIR, 0, 0, "");
 			char data = '\0';
-			pair<int,string> err = net_pack.send(i_sock, &data, sizeof(data));
+			pair<int,string> err = send_message(i_sock, net_pack, &data, sizeof(data));
 			if (err.first > 0)
 			{
 				i_agent.set_state(AgentInfoRec::State::CWD_REQ);
@@ -1452,18 +1664,19 @@ void RunManagerPanther::kill_all_active_runs()
 		else if (cur_state == AgentInfoRec::State::CWD_RCV)
 		{
 			// send parameter and observation names
-			NetPackage net_pack(NetPackage::PackType::PAR_NAMES, 0, 0, "");
+			//advertise the binary run-result format - agents that do not know the tag ignore it
+			NetPackage net_pack(NetPackage::PackType::PAR_NAMES, 0, 0, NetPackage::BIN_RESULTS_TAG);
 			vector<int8_t> data;
 			vector<string> tmp_vec;
 			// send parameter names
 			tmp_vec = file_stor.get_par_name_vec();
 			data = Serialization::serialize(tmp_vec);
-			pair<int,string> err_par = net_pack.send(i_sock, &data[0], data.size());
+			pair<int,string> err_par = send_message(i_sock, net_pack, &data[0], data.size());
 			//send observation names
 			net_pack = NetPackage(NetPackage::PackType::OBS_NAMES, 0, 0, "");
 			tmp_vec = file_stor.get_obs_name_vec();
 			data = Serialization::serialize(tmp_vec);
-			pair<int,string> err_obs = net_pack.send(i_sock, &data[0], data.size());
+			pair<int,string> err_obs = send_message(i_sock, net_pack, &data[0], data.size());
 
 			if (err_par.first > 0 && err_obs.first > 0)
 			{
@@ -1482,7 +1695,7 @@ void RunManagerPanther::kill_all_active_runs()
 		{
 			NetPackage net_pack(NetPackage::PackType::REQ_LINPACK, 0, 0, "");
 			char data = '\0';
-			pair<int,string> err = net_pack.send(i_sock, &data, sizeof(data));
+			pair<int,string> err = send_message(i_sock, net_pack, &data, sizeof(data));
 			if (err.first  > 0)
 			{
 				i_agent.set_state(AgentInfoRec::State::LINPACK_REQ);
@@ -1551,9 +1764,11 @@ void RunManagerPanther::kill_all_active_runs()
 	 stringstream ss;
 	 ss << "new connection from: " << w_getnameinfo_string(sock_id);
 	 report(ss.str(), false);
-	 FD_SET(sock_id, &master); // add to master set
-	 if (sock_id > fdmax) { // keep track of the max
-		 fdmax = sock_id;
+	 poller->add(sock_id, true); // add to the polled set
+	 // messages are assembled and sent incrementally so one agent can not stall the others
+	 if (w_set_nonblocking(sock_id) != 0)
+	 {
+		 report("could not set agent socket to non-blocking mode: " + w_get_error_msg(), false);
 	 }
 
 	 //list<SlaveInfoRec>::iterator
@@ -1591,6 +1806,9 @@ void RunManagerPanther::kill_all_active_runs()
 	 {
 		 if (iter->second == agent_info_iter)
 		 {
+			 //a run that is given up on before it completes tells the scheduler it takes at least this long
+			 if (!run_finished(run_id))
+				 scheduler->record_run_interrupted(run_id, *agent_info_iter, agent_info_iter->get_duration_sec());
 			 iter = active_runid_to_iterset_map.erase(iter);
 			 return;
 		 }
@@ -1695,20 +1913,22 @@ RunManagerPanther::~RunManagerPanther(void)
 
 	//close sockets and cleanup
 	int err;
+	poller->remove(listener);
 	err = w_close(listener);
-	FD_CLR(listener, &master);
 	// this is needed to ensure that the first slave closes properly
 	w_sleep(2000);
-	for (int i = 0; i <= fdmax; i++)
-	{
-		if (FD_ISSET(i, &master))
-		{
-			NetPackage netpack(NetPackage::PackType::TERMINATE, 0, 0,"");
-			char data;
-			netpack.send(i, &data, 0);
-			err = w_close(i);
-			FD_CLR(i, &master);
-		}
+	for (int i : poller->get_fds())
+	{
+		//finish any queued messages before terminating the agent
+		w_set_nonblocking(i, false);
+		auto iter = socket_to_iter_map.find(i);
+		if (iter != socket_to_iter_map.end())
+			iter->second->get_send_queue().flush(i);
+		NetPackage netpack(NetPackage::PackType::TERMINATE, 0, 0,"");
+		char data;
+		netpack.send(i, &data, 0);
+		poller->remove(i);
+		err = w_close(i);
 	}
 	w_cleanup();
 }
@@ -61,6 +61,7 @@ public:
 	double get_runtime_sec() const;
 	double get_runtime_minute() const;
 	double get_linpack_time() const;
+	double get_linpack_time_sec() const;
 	int add_failed_ping();
 	int add_failed_run();
 	int get_failed_runs() const { return failed_runs; }
@@ -71,6 +72,9 @@ public:
 	void reset_last_ping_time();
 	void reset_runtime() { run_time = std::chrono::system_clock::duration::zero(); }
 	int seconds_since_last_ping_time() const;
+	//partially received message and unsent messages of the non-blocking agent socket
+	NetRecvBuffer &get_recv_buffer() { return recv_buffer; }
+	NetSendQueue &get_send_queue() { return send_queue; }
 	~AgentInfoRec(){}
 private:
 	int socket_fd;
@@ -86,6 +90,8 @@ private:
 	std::chrono::system_clock::time_point last_ping_time;
 	std::string work_dir;
 	std::vector<string> name_info_vec;
+	NetRecvBuffer recv_buffer;
+	NetSendQueue send_queue;
 public:
 	class CompareTimes
 	{
@@ -96,11 +102,14 @@ public:
 };
 
 
+class PantherSchedulePolicy;
+
 class RunManagerPanther : public RunManagerAbstract
 {
 public:
 	RunManagerPanther(const std::string &stor_filename, const std::string &port, std::ofstream &_f_rmr, int _max_n_failure,
-		double overdue_reched_fac, double overdue_giveup_fac, double overdue_giveup_minutes, bool _should_echo=true);
+		double overdue_reched_fac, double overdue_giveup_fac, double overdue_giveup_minutes, bool _should_echo=true,
+		const std::string &_schedule_policy="fifo", int _tail_runs=0);
 	virtual void initialize(const Parameters &model_pars, const Observations &obs, const std::string &_filename = std::string(""));
 	virtual void initialize_restart(const std::string &_filename);
 	virtual void reinitialize(const std::string &_filename = std::string(""));
@@ -108,9 +117,12 @@ public:
 	virtual int add_run(const Parameters &model_pars, const std::string &info_txt="", double info_value=RunStorage::no_data);
 	virtual int add_run(const std::vector<double> &model_pars, const std::string &info_txt="", double info_valuee=RunStorage::no_data);
 	virtual int add_run(const Eigen::VectorXd &model_pars, const std::string &info_txt="", double info_valuee=RunStorage::no_data);
+	virtual std::vector<int> add_runs(const Eigen::MatrixXd &model_pars, const std::vector<std::string> &info_txt = std::vector<std::string>(),
+		const std::vector<double> &info_value = std::vector<double>());
 	virtual void update_run(int run_id, const Parameters &pars, const Observations &obs);
 	virtual void run();
 	virtual RunManagerAbstract::RUN_UNTIL_COND run_until(RUN_UNTIL_COND condition, int n_nops = 0, double sec = 0.0);
+	virtual RunManagerAbstract::RUN_UNTIL_COND resume_run_until(RUN_UNTIL_COND condition, int n_nops = 0, double sec = 0.0);
 	~RunManagerPanther(void);
 	int get_n_waiting_runs() { return waiting_runs.size(); }
 	void close_agents();
@@ -131,12 +143,13 @@ private:
 	int max_concurrent_runs;
 	int n_no_ops;  //number of consecutive times tcp/ip has looked for slave communciations and not found any
 	int listener;
-	int fdmax;
 	int model_runs_done;
 	int model_runs_failed;
 	int model_runs_timed_out;
 	bool should_echo;
-	fd_set master; // master file descriptor list
+	bool run_interrupted; //the last resume_run_until() returned on a TIME or NO_OPS condition with runs still in flight
+	std::unique_ptr<SocketPoller> poller; // listener and agent sockets
+	std::unique_ptr<PantherSchedulePolicy> scheduler;
 	list<AgentInfoRec> agent_info_set;
 	map<int, list<AgentInfoRec>::iterator> socket_to_iter_map;
 	multimap<int, list<AgentInfoRec>::iterator> active_runid_to_iterset_map;
@@ -150,6 +163,13 @@ private:
 	pest_utils::thread_RAII* idle_thread_raii;
 
 	int schedule_run(int run_id, std::list<list<AgentInfoRec>::iterator> &free_agent_list, int n_responsive_agents);
+	//the free agent a run should go to, or free_agent_list.end() if it cannot be scheduled now.  scheduled is
+	//set to 0 if the run is no longer needed and -1 otherwise
+	std::list<list<AgentInfoRec>::iterator>::iterator select_agent(int run_id, std::list<list<AgentInfoRec>::iterator> &free_agent_list,
+		int n_responsive_agents, int &scheduled);
+	//send a run to a free agent and take the agent off the free list
+	int send_run(int run_id, std::list<list<AgentInfoRec>::iterator>::iterator it_agent, std::list<list<AgentInfoRec>::iterator> &free_agent_list);
+	void schedule_tail_runs(std::list<list<AgentInfoRec>::iterator> &free_agent_list, int n_responsive_agents);
 	void unschedule_run(list<AgentInfoRec>::iterator agent_info_iter);
 	void kill_run(list<AgentInfoRec>::iterator agent_info_iter, const std::string &reason="UNKNOWN");
 	void kill_runs(int run_id, bool update_failure_map, const std::string &reason = "UNKNOWN");
@@ -162,11 +182,17 @@ private:
 	void end_run_idle_async();
 	void pause_idle();
 	void resume_idle();
+	RunManagerAbstract::RUN_UNTIL_COND run_until_impl(RUN_UNTIL_COND condition, int max_no_ops, double max_time_sec, bool resume);
 
 	std::ofstream &f_rmr;
 	bool listen(pest_utils::thread_flag* terminate = nullptr);
 	bool process_model_run(int sock_id, NetPackage &net_pack);
-	void process_message(int i);
+	//returns false once the socket has no complete message left to process
+	bool process_message(int i);
+	//queue a message to an agent and send as much of it as the socket accepts now, the
+	//rest goes out from listen() when the socket can be written to
+	std::pair<int, std::string> send_message(int i_sock, NetPackage &net_pack, const void *data, int64_t data_len);
+	void flush_agent(int i_sock);
 	void schedule_runs();
 	void init_agents(pest_utils::thread_flag* terminate = nullptr);
 	list<AgentInfoRec>::iterator add_agent(int sock_id);
@@ -1,10 +1,13 @@
 #include <iostream>
 #include <list>
 #include <iomanip>
+#include <limits>
+#include <algorithm>
 #include "GsaAbstractBase.h"
 #include "utilities.h"
 #include "FileManager.h"
 #include "ParamTransformSeq.h"
+#include "ModelRunPP.h"
 
 using namespace std;
 using namespace pest_utils;
@@ -73,6 +76,11 @@ GsaAbstractBase::GsaAbstractBase(Pest &_pest_scenario,
 }
 
 
+bool GsaAbstractBase::assemble_more_runs(RunManagerAbstract &run_manager, ModelRun model_run)
+{
+	return false;
+}
+
 GsaAbstractBase::~GsaAbstractBase(void)
 {
 }
@@ -132,6 +140,61 @@ map<string, double> GsaAbstractBase::calc_parameter_unif_std_dev()
 	return std_dev_map;
 }
 
+void GsaAbstractBase::prep_phi_weights(const vector<string> &obs_names)
+{
+	const ObservationInfo &obs_info = pest_scenario_ptr->get_ctl_observation_info();
+	const Observations &obs_vals = pest_scenario_ptr->get_ctl_observations();
+	size_t nobs = obs_names.size();
+	phi_weight = VectorXd::Zero(nobs);
+	phi_obs_val = VectorXd::Zero(nobs);
+	phi_is_regul.assign(nobs, false);
+	for (size_t i = 0; i < nobs; i++)
+	{
+		const ObservationRec *rec = obs_info.get_observation_rec_ptr(obs_names[i]);
+		auto it = obs_vals.find(obs_names[i]);
+		if ((rec == nullptr) || (it == obs_vals.end()))
+			continue;
+		phi_weight[i] = rec->weight;
+		phi_obs_val[i] = it->second;
+		phi_is_regul[i] = ObservationGroupRec::is_regularization(rec->group);
+	}
+}
+
+double GsaAbstractBase::calc_phi(const double *sim_obs, const Parameters *pars)
+{
+	//ObjectiveFunc::get_phi() with the zero regularization instance, over the observations
+	//in run storage order
+	double meas = 0.0;
+	double regul = 0.0;
+	double r;
+	for (int i = 0; i < phi_weight.size(); i++)
+	{
+		r = (sim_obs[i] - phi_obs_val[i]) * phi_weight[i];
+		if (phi_is_regul[i])
+			regul += r * r;
+		else
+			meas += r * r;
+	}
+	if (pars != nullptr)
+	{
+		for (const auto &i_prior : pest_scenario_ptr->get_prior_info())
+		{
+			r = i_prior.second.calc_residual(*pars) * i_prior.second.get_weight();
+			if (i_prior.second.is_regularization())
+				regul += r * r;
+			else
+				meas += r * r;
+		}
+	}
+	if (meas <= numeric_limits<double>::min())
+		meas = 0.0;
+	if (regul <= numeric_limits<double>::min())
+		regul = 0.0;
+	meas = min(numeric_limits<double>::max(), meas);
+	regul = min(numeric_limits<double>::max(), regul);
+	return meas + regul;
+}
+
 void GsaAbstractBase::parce_line(const string &line, map<string, string> &arg_map)
 {
 	string key;
@@ -33,6 +33,9 @@ public:
 		const ParamTransformSeq &_par_transform, PARAM_DIST _par_dist, unsigned int seed);
 	virtual void assemble_runs(RunManagerAbstract &run_manager) = 0;
 	virtual void calc_sen(RunManagerAbstract &run_manager, ModelRun model_run) = 0;
+	//called after each round of model runs; may queue more runs (e.g. to converge the
+	//sensitivities) and returns true if it did
+	virtual bool assemble_more_runs(RunManagerAbstract &run_manager, ModelRun model_run);
 	static std::map<std::string, std::string>  process_gsa_file(std::ifstream &fin, FileManager &file_manager);
 	std::vector<double> calc_interval_midpoints(int n_interval, double min, double max);
 	double ltqnorm(double p);
@@ -55,6 +58,14 @@ protected:
 	Parameters max_numeric_pars;
 	Parameters min_numeric_pars;
 	unsigned int seed;
+	//weights and observed values in run storage order for calc_phi()
+	VectorXd phi_weight;
+	VectorXd phi_obs_val;
+	std::vector<bool> phi_is_regul;
+	void prep_phi_weights(const std::vector<std::string> &obs_names);
+	//zero regularization phi of one run from its simulated values in run storage order
+	//(and its control parameters, for the prior information, if not null)
+	double calc_phi(const double *sim_obs, const Parameters *pars);
 };
 
 std::ostream& operator<< (std::ostream& out, const std::vector<double> &rhs);
@@ -31,61 +31,59 @@ void MorrisObsSenFile::initialize(const vector<string> &_par_names_vec, const ve
 	obs_names_vec = _obs_names_vec;
 	gsa_abstract_base = _gsa_abstract_base;
 	no_data = _no_data;
+	parname_to_indexmap.clear();
+	for (int i = 0; i < par_names_vec.size(); ++i)
+	{
+		parname_to_indexmap[par_names_vec[i]] = i;
+	}
+	obs_stats.reset(par_names_vec.size(), obs_names_vec.size());
+	isen.resize(obs_names_vec.size());
 }
 
-void MorrisObsSenFile::add_sen_run_pair(const std::string &par_name, double p1, Observations &obs1, double p2, Observations &obs2)
+void MorrisObsSenFile::add_sen_run_pair(const std::string &par_name, double p1, const double *obs1, double p2, const double *obs2)
 {
-	assert (obs1.size() == obs2.size());
-
-	// compute sensitivities of individual observations
-	double isen;
-	double del_par = p2 - p1;
-
-	for (const auto &iobs : obs_names_vec)
+	auto it_par = parname_to_indexmap.find(par_name);
+	if (it_par == parname_to_indexmap.end())
 	{
-		isen = (obs2[iobs] - obs1[iobs]) / del_par;
-		const auto id = make_pair(par_name, iobs);
-		if (map_obs_stats.find(id) == map_obs_stats.end())
-		{
-			map_obs_stats[id] = RunningStats();
-		}
-		map_obs_stats[make_pair(par_name, iobs)].add(isen);
+		return;
 	}
+	// compute sensitivities of individual observations
+	double del_par = p2 - p1;
+	Eigen::Map<const Eigen::ArrayXd> o1(obs1, isen.size());
+	Eigen::Map<const Eigen::ArrayXd> o2(obs2, isen.size());
+	isen = (o2 - o1) / del_par;
+	obs_stats.add(it_par->second, isen.data());
 }
 
-void MorrisObsSenFile::calc_pooled_obs_sen(ofstream &fout_obs_sen, map<string, double> &obs_2_sen_weight,
+void MorrisObsSenFile::calc_pooled_obs_sen(ofstream &fout_obs_sen, const vector<double> &obs_sen_weight,
 	map<string, double> &par_2_sen_weight)
 {
 	fout_obs_sen << "par_name, n_samples, obs_name, mean, abs_mean, sigma, scaled_sen" << endl;
-	for (const auto &ip : par_names_vec)
+	for (int i_par = 0; i_par < par_names_vec.size(); ++i_par)
 	{
-		string ipar = ip;
-		for (const auto &iobs : obs_names_vec)
+		const string &ipar = par_names_vec[i_par];
+		int n_samples = obs_stats.comp_nsamples(i_par);
+		auto it_par = par_2_sen_weight.find(ipar);
+		for (int i_obs = 0; i_obs < obs_names_vec.size(); ++i_obs)
 		{
 			double mean = no_data;
 			double abs_mean = no_data;
 			double sigma = no_data;
-			int n_samples = 0;
-			const auto id = make_pair(ipar, iobs);
-			auto sen_itr = map_obs_stats.find(id);
-			if (sen_itr != map_obs_stats.end() && sen_itr->second.comp_nsamples() > 0)
+			if (n_samples > 0)
 			{
-				mean = sen_itr->second.comp_mean();
-				abs_mean = sen_itr->second.comp_abs_mean();
-				sigma = sen_itr->second.comp_sigma();
-				n_samples = sen_itr->second.comp_nsamples();
+				mean = obs_stats.comp_mean(i_par, i_obs);
+				abs_mean = obs_stats.comp_abs_mean(i_par, i_obs);
+				sigma = obs_stats.comp_sigma(i_par, i_obs);
 			}
 			string weighted_sen = "N/A";
-			auto it_obs = obs_2_sen_weight.find(iobs);
-			auto it_par = par_2_sen_weight.find(ipar);
-			if (it_obs != obs_2_sen_weight.end() && it_par != par_2_sen_weight.end() && abs_mean != no_data)
+			if (obs_sen_weight[i_obs] != no_data && it_par != par_2_sen_weight.end() && abs_mean != no_data)
 			{
 				stringstream sstr;
-				double value = abs_mean * it_par->second / it_obs->second;
+				double value = abs_mean * it_par->second / obs_sen_weight[i_obs];
 				sstr << value;
 				weighted_sen = sstr.str();
 			}
-			fout_obs_sen << ipar << ", " << n_samples << ", " << iobs << ", " << mean << ", " << abs_mean << ", " << sigma << ", " << weighted_sen << endl;
+			fout_obs_sen << ipar << ", " << n_samples << ", " << obs_names_vec[i_obs] << ", " << mean << ", " << abs_mean << ", " << sigma << ", " << weighted_sen << endl;
 		}
 	}
 }
@@ -148,7 +146,8 @@ MorrisMethod::MorrisMethod(Pest &_pest_scenario,
 	bool _calc_pooled_obs, bool _calc_morris_obs_sen, PARAM_DIST _par_dist, unsigned int _seed)
 	: GsaAbstractBase(_pest_scenario, _file_manager, _obj_func_ptr, _par_transform,
 		_par_dist, _seed),
-	calc_obs_sen(_calc_pooled_obs), calc_morris_obs_sen(_calc_morris_obs_sen)
+	calc_obs_sen(_calc_pooled_obs), calc_morris_obs_sen(_calc_morris_obs_sen),
+	obs_info_ptr(&_pest_scenario.get_ctl_observation_info())
 {
 	rand_gen = mt19937(_pest_scenario.get_pestpp_options().get_random_seed());
 	initialize(_p, _r, _delta);
@@ -329,71 +328,93 @@ void  MorrisMethod::calc_sen(RunManagerAbstract &run_manager, ModelRun model_run
 	ofstream &fout_morris = file_manager_ptr->open_ofile_ext("msn");
 	ofstream &fout_raw = file_manager_ptr->open_ofile_ext("raw.csv");
 
-	ModelRun run0 = model_run;
-	ModelRun run1 = model_run;
-	Parameters pars0;
-	Observations obs0;
-	Parameters pars1;
-	Observations obs1;
+	const vector<string> &run_mngr_par_name_vec = run_manager.get_par_name_vec();
+	const vector<string> &run_mngr_obs_name_vec = run_manager.get_obs_name_vec();
+	size_t npar = run_mngr_par_name_vec.size();
+	size_t nobs = run_mngr_obs_name_vec.size();
+	bool prior_info = pest_scenario_ptr->get_prior_info().size() > 0;
 
 	map<string, RunningStats > sen_map;
-	map<string, RunningStats> obs_stats_map;
-
 	for (auto &it_p : adj_par_name_vec)
 	{
 		sen_map[it_p] = RunningStats();
 	}
-
-	for (auto &it_obs : obs_name_vec)
+	// statistics of each observation over the successful runs, in run storage order
+	vector<RunningStats> obs_stats_vec(calc_obs_sen ? nobs : 0);
+	bool obs_sen = calc_morris_obs_sen || calc_obs_sen;
+	if (obs_sen)
 	{
-		obs_stats_map[it_obs] = RunningStats();
+		obs_sen_file.initialize(adj_par_name_vec, run_mngr_obs_name_vec, Observations::no_data, this);
 	}
-
-	const vector<string> &run_mngr_obs_name_vec = run_manager.get_obs_name_vec();
-	obs_sen_file.initialize(adj_par_name_vec, run_mngr_obs_name_vec, Observations::no_data, this);
+	prep_phi_weights(run_mngr_obs_name_vec);
+
+	// the runs are read in order into two alternating buffers, so each run is read once and
+	// paired with the run before it
+	VectorXd par_buf[2];
+	vector<double> obs_buf[2];
+	Parameters pars[2];
+	bool run_ok[2];
+	for (int k = 0; k < 2; ++k)
+	{
+		par_buf[k].resize(npar);
+		obs_buf[k].resize(nobs);
+	}
+	auto read_run = [&](int run_id, int k, string &info_txt)
+	{
+		double null_value;
+		run_ok[k] = run_manager.get_run(run_id, par_buf[k].data(), npar, obs_buf[k].data(), nobs, info_txt, null_value);
+		pars[k] = Parameters(run_mngr_par_name_vec, par_buf[k]);
+		base_partran_seq_ptr->model2numeric_ip(pars[k]);
+	};
+	auto add_obs_stats = [&](int k)
+	{
+		const double *obs = obs_buf[k].data();
+		for (size_t i_obs = 0; i_obs < obs_stats_vec.size(); ++i_obs)
+		{
+			if (obs[i_obs] != Observations::no_data)
+			{
+				obs_stats_vec[i_obs].add(obs[i_obs]);
+			}
+		}
+	};
 
 	fout_raw << "parameter_name, phi_0, phi_1, par_0, par_1, elem_effect" << endl;
 	int n_runs = run_manager.get_nruns();
-	bool run0_ok = false;
-	bool run1_ok = false;
 	string par_name_1;
-	double null_value;
 	stringstream message;
 	cout << endl;
-	run1_ok = run_manager.get_run(0, pars1, obs1);
-	base_partran_seq_ptr->model2numeric_ip(pars1);
+	int i1 = 0;
+	read_run(0, i1, par_name_1);
 	for (int i_run=1; i_run<n_runs; ++i_run)
 	{
-
-
-		run0_ok = run1_ok;
-		pars0 = pars1;
-		obs0 = obs1;
-		run1_ok = run_manager.get_run(i_run, pars1, obs1, par_name_1, null_value);
-		base_partran_seq_ptr->model2numeric_ip(pars1);
+		int i0 = i1;
+		i1 = 1 - i0;
+		read_run(i_run, i1, par_name_1);
 		// Add run0 to obs_stats
-		if (run0_ok)
+		if (run_ok[i0])
 		{
-			for (const auto &i_obs : run_mngr_obs_name_vec)
-			{
-				auto it = obs0.find(i_obs);
-				if (it != obs0.end() && it->second != Observations::no_data)
-				{
-					obs_stats_map[i_obs].add(obs0[i_obs]);
-				}
-			}
+			add_obs_stats(i0);
 		}
 
-		if (run0_ok && run1_ok && !par_name_1.empty())
+		if (run_ok[i0] && run_ok[i1] && !par_name_1.empty())
 		{
-			Parameters tmp_ctl_par = base_partran_seq_ptr->numeric2ctl_cp(pars0);
-			run0.update_ctl(tmp_ctl_par, obs0);
-			double phi0 = run0.get_phi(DynamicRegularization::get_zero_reg_instance());
-			tmp_ctl_par = base_partran_seq_ptr->numeric2ctl_cp(pars1);
-			run1.update_ctl(tmp_ctl_par, obs1);
-			double phi1 = run1.get_phi(DynamicRegularization::get_zero_reg_instance());
-			double p0 = pars0[par_name_1];
-			double p1 = pars1[par_name_1];
+			const double *obs0 = obs_buf[i0].data();
+			const double *obs1 = obs_buf[i1].data();
+			double phi0, phi1;
+			if (prior_info)
+			{
+				Parameters tmp_ctl_par = base_partran_seq_ptr->numeric2ctl_cp(pars[i0]);
+				phi0 = calc_phi(obs0, &tmp_ctl_par);
+				tmp_ctl_par = base_partran_seq_ptr->numeric2ctl_cp(pars[i1]);
+				phi1 = calc_phi(obs1, &tmp_ctl_par);
+			}
+			else
+			{
+				phi0 = calc_phi(obs0, nullptr);
+				phi1 = calc_phi(obs1, nullptr);
+			}
+			double p0 = pars[i0].get_rec(par_name_1);
+			double p1 = pars[i1].get_rec(par_name_1);
 			// compute standard Morris Sensitivity on the global objective function
 			double sen = (phi1 - phi0) / delta;
 			fout_raw << pest_utils::lower_cp(par_name_1) << ",  " << phi1 << ",  " << phi0 << ",  " << p1 << ",  " << p0 << ", " << sen << endl;
@@ -405,20 +426,16 @@ void  MorrisMethod::calc_sen(RunManagerAbstract &run_manager, ModelRun model_run
 			}
 
 			//Compute sensitvities of indiviual observations
-			obs_sen_file.add_sen_run_pair(par_name_1, p0, obs0, p1, obs1);
+			if (obs_sen)
+			{
+				obs_sen_file.add_sen_run_pair(par_name_1, p0, obs0, p1, obs1);
+			}
 		}
 	}
 	// Add final run to obs_stats
-	if (run1_ok)
+	if (run_ok[i1])
 	{
-		for (const auto &i_obs : run_mngr_obs_name_vec)
-		{
-			auto it = obs1.find(i_obs);
-			if (it != obs1.end() && it->second != Observations::no_data)
-			{
-				obs_stats_map[i_obs].add(obs0[i_obs]);
-			}
-		}
+		add_obs_stats(i1);
 	}
 	cout << endl;
 	cout << "writing output files" << endl;
@@ -443,60 +460,7 @@ void  MorrisMethod::calc_sen(RunManagerAbstract &run_manager, ModelRun model_run
 	if (calc_obs_sen)
 	{
 		ofstream &fout_mos = file_manager_ptr->open_ofile_ext("mos");
-		////compute pooled standard deviations
-		map<string, double> obs_2_sen_weight;
-		{
-			//Compute Pooled Standard Deviations
-			map<string, vector<RunningStats> > tmp_pool_grps;
-			for (const auto &it : obs_stats_map)
-			{
-				const string &obs_name = it.first;
-				const string &obs_group = obs_info_ptr->get_group(obs_name);
-				auto it_pg = group_2_pool_group_map.find(obs_group);
-				if (it_pg != group_2_pool_group_map.end())
-				{
-					const string &pool_group = it_pg->second;
-					if (tmp_pool_grps.find(pool_group) == tmp_pool_grps.end())
-					{
-						tmp_pool_grps[pool_group] = vector<RunningStats>();
-					}
-					tmp_pool_grps[pool_group].push_back(it.second);
-				}
-			}
-			////compute pooled standard deviations
-			map<string, double> obs_pooled_grp_std_dev;
-			for (const auto &i_pgrp : tmp_pool_grps)
-			{
-				const string &pool_group = i_pgrp.first;
-				double var_sum = 0;
-				long int weight_sum = 0;
-				for (const auto &istat : i_pgrp.second)
-				{
-					long int weight = istat.comp_nsamples() - 1;
-					var_sum += weight * istat.comp_var();
-					weight_sum += weight;
-				}
-				if (weight_sum > 0)
-				{
-					obs_pooled_grp_std_dev[pool_group] = sqrt(var_sum / weight_sum);
-				}
-			}
-			for (const auto &iobs : obs_name_vec)
-			{
-				const string &obs_name = iobs;
-				const string &obs_group = obs_info_ptr->get_group(obs_name);
-				auto it_pg = group_2_pool_group_map.find(obs_group);
-				if (it_pg != group_2_pool_group_map.end())
-				{
-					const string &pool_group = it_pg->second;
-					if (obs_pooled_grp_std_dev.find(pool_group) != obs_pooled_grp_std_dev.end())
-					{
-						obs_2_sen_weight[iobs] = obs_pooled_grp_std_dev[pool_group];
-					}
-				}
-			}
-		}
-
+		vector<double> obs_2_sen_weight = calc_pooled_obs_std_dev(run_mngr_obs_name_vec, obs_stats_vec);
 		//compute parameter standard deviations
 		map<string, double> par_std_dev;
 		par_std_dev = calc_parameter_unif_std_dev();
@@ -507,25 +471,72 @@ void  MorrisMethod::calc_sen(RunManagerAbstract &run_manager, ModelRun model_run
 	file_manager_ptr->close_file("raw");
 }
 
+vector<double> MorrisMethod::calc_pooled_obs_std_dev(const vector<string> &obs_names, const vector<RunningStats> &obs_stats)
+{
+	size_t nobs = obs_names.size();
+	// pool group of each observation, -1 if it is not pooled
+	map<string, int> pool_grp_index;
+	vector<int> obs_pool_grp(nobs, -1);
+	for (size_t i_obs = 0; i_obs < nobs; ++i_obs)
+	{
+		auto it_pg = group_2_pool_group_map.find(obs_info_ptr->get_group(obs_names[i_obs]));
+		if (it_pg != group_2_pool_group_map.end())
+		{
+			auto it_idx = pool_grp_index.insert(make_pair(it_pg->second, (int)pool_grp_index.size())).first;
+			obs_pool_grp[i_obs] = it_idx->second;
+		}
+	}
+	//Compute Pooled Standard Deviations, summing over the observations in name order
+	vector<int> name_order(nobs);
+	iota(name_order.begin(), name_order.end(), 0);
+	sort(name_order.begin(), name_order.end(), [&obs_names](int a, int b) { return obs_names[a] < obs_names[b]; });
+	vector<double> var_sum(pool_grp_index.size(), 0.0);
+	vector<long int> weight_sum(pool_grp_index.size(), 0);
+	for (int i_obs : name_order)
+	{
+		int i_pgrp = obs_pool_grp[i_obs];
+		if (i_pgrp < 0)
+		{
+			continue;
+		}
+		long int weight = obs_stats[i_obs].comp_nsamples() - 1;
+		var_sum[i_pgrp] += weight * obs_stats[i_obs].comp_var();
+		weight_sum[i_pgrp] += weight;
+	}
+	vector<double> obs_std_dev(nobs, Observations::no_data);
+	for (size_t i_obs = 0; i_obs < nobs; ++i_obs)
+	{
+		int i_pgrp = obs_pool_grp[i_obs];
+		if (i_pgrp >= 0 && weight_sum[i_pgrp] > 0)
+		{
+			obs_std_dev[i_obs] = sqrt(var_sum[i_pgrp] / weight_sum[i_pgrp]);
+		}
+	}
+	return obs_std_dev;
+}
+
 void MorrisMethod::calc_morris_obs(ostream &fout, MorrisObsSenFile &morris_sen_file)
 {
 	// write standard Morris Sensitivity
 	fout << "observation_name,parameter_name,n_samples,sen_mean,sen_mean_abs,sen_std_dev" << endl;
 
-	for (const auto &i_obs : morris_sen_file.obs_names_vec)
+	const RunningStatsRows &obs_stats = morris_sen_file.obs_stats;
+	vector<string> par_names;
+	for (const auto &i_par : morris_sen_file.par_names_vec)
+	{
+		par_names.push_back(pest_utils::lower_cp(i_par));
+	}
+	for (int i_obs = 0; i_obs < morris_sen_file.obs_names_vec.size(); ++i_obs)
 	{
-		//fout << "Method of Morris for observation: " << i_obs << endl;
-		//fout << "parameter_name, n_samples, sen_mean, sen_mean_abs, sen_std_dev" << endl;
-		//fout << i_obs;
-		for (const auto &i_par : morris_sen_file.par_names_vec)
+		string obs_name = pest_utils::lower_cp(morris_sen_file.obs_names_vec[i_obs]);
+		for (int i_par = 0; i_par < par_names.size(); ++i_par)
 		{
-			const auto &it_senmap = morris_sen_file.map_obs_stats.find(make_pair(i_par, i_obs));
-			if (it_senmap != morris_sen_file.map_obs_stats.end())
+			long n_samples = obs_stats.comp_nsamples(i_par);
+			if (n_samples > 0)
 			{
-				fout << pest_utils::lower_cp(i_obs) <<"," << pest_utils::lower_cp(i_par) << "," << it_senmap->second.comp_nsamples() << "," << it_senmap->second.comp_mean() << "," << it_senmap->second.comp_abs_mean() << "," << sqrt(it_senmap->second.comp_var()) << endl;
+				fout << obs_name << "," << par_names[i_par] << "," << n_samples << "," << obs_stats.comp_mean(i_par, i_obs) << "," << obs_stats.comp_abs_mean(i_par, i_obs) << "," << obs_stats.comp_sigma(i_par, i_obs) << endl;
 			}
 		}
-		//fout << endl;
 	}
 }
 
@@ -12,6 +12,7 @@
 #include "Transformable.h"
 #include "GsaAbstractBase.h"
 #include "pest_data_structs.h"
+#include "Stats.h"
 
 using Eigen::MatrixXd;
 using Eigen::VectorXd;
@@ -20,21 +21,26 @@ class ParamTransformSeq;
 class RunManagerAbstract;
 class ModelRun;
 class FileManager;
-class RunningStats;
 
 class MorrisObsSenFile
 {
 	friend class MorrisMethod;
 public:
 	void initialize(const std::vector<std::string> &par_names_vec, const std::vector<std::string> &obs_names_vec, double _no_data, const GsaAbstractBase *_gsa_abstract_base);
-	void add_sen_run_pair(const std::string &par_name, double p1, Observations &obs1, double p2, Observations &obs2);
-	void calc_pooled_obs_sen(std::ofstream &fout_obs_sen, map<string, double> &obs_2_sen_weight, map<string, double> &par_2_sen_weight);
+	//obs1 and obs2 are the simulated values of a run pair in run storage order
+	void add_sen_run_pair(const std::string &par_name, double p1, const double *obs1, double p2, const double *obs2);
+	//obs_sen_weight is the pooled standard deviation of each observation, or no_data if it
+	//has none
+	void calc_pooled_obs_sen(std::ofstream &fout_obs_sen, const vector<double> &obs_sen_weight, map<string, double> &par_2_sen_weight);
 private:
 	double no_data;
 	vector<string> par_names_vec;
 	vector<string> obs_names_vec;
 	const GsaAbstractBase *gsa_abstract_base;
-	map< pair<string,string>, RunningStats> map_obs_stats;
+	//elementary effects, one row per parameter (in par_names_vec order) and one column per
+	//observation (in obs_names_vec order)
+	RunningStatsRows obs_stats;
+	Eigen::ArrayXd isen;
 	map<string, int> parname_to_indexmap;
 };
 
@@ -71,6 +77,7 @@ private:
 	MorrisObsSenFile obs_sen_file;
 	const ObservationInfo *obs_info_ptr;
 	map<std::string, std::string> group_2_pool_group_map;
+	std::vector<double> calc_pooled_obs_std_dev(const std::vector<std::string> &obs_names, const std::vector<RunningStats> &obs_stats);
 };
 
 
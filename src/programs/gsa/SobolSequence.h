@@ -0,0 +1,42 @@
+#ifndef SOBOL_SEQUENCE_H_
+#define SOBOL_SEQUENCE_H_
+
+#include <vector>
+#include <cstdint>
+
+//Sobol' low-discrepancy sequence on [0,1)^ndim, generated in gray code order (Antonov &
+//Saleev).  the primitive polynomials and initial direction numbers are the Joe & Kuo
+//(new-joe-kuo-6.21201) ones, tabulated up to MAX_NDIM dimensions.  the sequence can be
+//scrambled with a random linear matrix scramble plus digital shift (Matousek), which keeps
+//its net structure.  the unscrambled sequence skips the origin; the scrambled one does not,
+//so the first 2^m points stay a balanced net
+class SobolSequence
+{
+public:
+	//dimensions covered by the direction number table
+	static const int MAX_NDIM = 1111;
+	SobolSequence(int _ndim, bool _scramble = false, unsigned int _seed = 1);
+	//write the next point of the sequence into point[0..ndim-1]
+	void next(double *point);
+	//advance the sequence by n points without returning them
+	void skip(long long n);
+	int get_ndim() const { return ndim; }
+	//number of points returned (or skipped) so far
+	long long get_count() const { return count; }
+
+private:
+	static const int NBITS = 32;
+	int ndim;
+	bool scramble;
+	long long count;
+	//gray code index of the next point
+	uint32_t index;
+	//direction numbers, NBITS per dimension
+	std::vector<uint32_t> direction;
+	std::vector<uint32_t> state;
+	void init_direction();
+	void scramble_direction(unsigned int seed);
+	void advance();
+};
+
+#endif /* SOBOL_SEQUENCE_H_ */
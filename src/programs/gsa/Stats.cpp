@@ -210,3 +210,42 @@ void RunningStatsMissingData::add(const std::vector<double> &sample)
 		add(s);
 	}
 }
+
+void RunningStatsRows::reset(int nrow, int ncol)
+{
+	n.assign(nrow, 0);
+	mk = RowArray::Zero(nrow, ncol);
+	mk_abs = RowArray::Zero(nrow, ncol);
+	qk = RowArray::Zero(nrow, ncol);
+}
+
+void RunningStatsRows::add(int row, const double *sample)
+{
+	Eigen::Map<const Eigen::Array<double, 1, Eigen::Dynamic>> s(sample, mk.cols());
+	long nk = ++n[row];
+	if (nk == 1)
+	{
+		mk.row(row) = s;
+		mk_abs.row(row) = s.abs();
+		qk.row(row).setZero();
+	}
+	else
+	{
+		//same recurrence as RunningStats::add(), qk must be updated before mk
+		double w = nk - 1;
+		double dn = nk;
+		qk.row(row) += (w * (s - mk.row(row)).square()) / dn;
+		mk.row(row) += (s - mk.row(row)) / dn;
+		mk_abs.row(row) += (s.abs() - mk_abs.row(row)) / dn;
+	}
+}
+
+double RunningStatsRows::comp_var(int row, int col) const
+{
+	return qk(row, col) / (n[row] - 1);
+}
+
+double RunningStatsRows::comp_sigma(int row, int col) const
+{
+	return sqrt(comp_var(row, col));
+}
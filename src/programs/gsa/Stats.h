@@ -1,6 +1,10 @@
+#ifndef STATS_H_
+#define STATS_H_
+
 #include <vector>
 #include <map>
 #include <string>
+#include <Eigen/Dense>
 
 std::vector<double> vec_array_prod(const std::vector<double> &data_vec1, const std::vector<double> &data_vec2, double missing_val);
 
@@ -45,3 +49,29 @@ public:
 private:
 	double missing_value;
 };
+
+class RunningStatsRows
+{
+	//RunningStats for a dense nrow x ncol block of outputs where each sample is a whole row,
+	//e.g. the elementary effects of one parameter on every observation.  rows are updated
+	//with vector operations and give the same values as a RunningStats per element
+public:
+	RunningStatsRows() {}
+	void reset(int nrow, int ncol);
+	void add(int row, const double *sample);
+	double comp_var(int row, int col) const;
+	double comp_sigma(int row, int col) const;
+	double comp_mean(int row, int col) const { return mk(row, col); }
+	double comp_abs_mean(int row, int col) const { return mk_abs(row, col); }
+	long comp_nsamples(int row) const { return n[row]; }
+	int rows() const { return n.size(); }
+	int cols() const { return mk.cols(); }
+private:
+	typedef Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowArray;
+	std::vector<long> n;
+	RowArray mk;
+	RowArray mk_abs;
+	RowArray qk;
+};
+
+#endif /* STATS_H_ */
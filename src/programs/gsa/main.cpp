@@ -172,7 +172,9 @@ int main(int argc, char* argv[])
 			pest_scenario.get_pestpp_options().get_overdue_reched_fac(),
 			pest_scenario.get_pestpp_options().get_overdue_giveup_fac(),
 			pest_scenario.get_pestpp_options().get_overdue_giveup_minutes(),
-			pest_scenario.get_pestpp_options().get_panther_echo());
+			pest_scenario.get_pestpp_options().get_panther_echo(),
+			pest_scenario.get_pestpp_options().get_panther_schedule_policy(),
+			pest_scenario.get_pestpp_options().get_panther_tail_runs());
 	}
 	else
 	{
@@ -182,7 +184,8 @@ int main(int argc, char* argv[])
 			file_manager.build_filename("rns"), pathname,
 			pest_scenario.get_pestpp_options().get_max_run_fail(),
 			pest_scenario.get_pestpp_options().get_fill_tpl_zeros(),
-			pest_scenario.get_pestpp_options().get_additional_ins_delimiters());
+			pest_scenario.get_pestpp_options().get_additional_ins_delimiters(),
+			pest_scenario.get_pestpp_options().get_serial_num_slots());
 	}
 
 	cout << endl;
@@ -327,13 +330,90 @@ int main(int argc, char* argv[])
 			}
 		}
 
-		gsa_method = new Sobol(pest_scenario, file_manager, &obj_func,
-			base_partran_seq, n_sample, par_dist, 1.0);
+		int num_threads = -1;
+		auto sob_n_thr_it = gsa_opt_map.find("GSA_SOBOL_NUM_THREADS");
+		if (sob_n_thr_it != gsa_opt_map.end())
+		{
+			convert_ip(sob_n_thr_it->second, num_threads);
+		}
+
+		Sobol::SAMPLING sampling = Sobol::SAMPLING::random;
+		string sampling_str = "RANDOM";
+		auto sob_samp_it = gsa_opt_map.find("GSA_SOBOL_SAMPLING");
+		if (sob_samp_it != gsa_opt_map.end())
+		{
+			sampling_str = sob_samp_it->second;
+			upper_ip(sampling_str);
+			if (sampling_str == "QMC") sampling = Sobol::SAMPLING::qmc;
+			else if (sampling_str != "RANDOM")
+			{
+				ostringstream str;
+				str << "GSA_SOBOL_SAMPLING(" << sampling_str << "):  \"" << sampling_str << "\" is an invalid sampling type, should be \"random\" or \"qmc\"";
+				throw PestError(str.str());
+			}
+		}
+		bool scramble = true;
+		auto sob_scr_it = gsa_opt_map.find("GSA_SOBOL_SCRAMBLE");
+		if (sob_scr_it != gsa_opt_map.end())
+		{
+			scramble = pest_utils::parse_string_arg_to_bool(sob_scr_it->second);
+		}
+		Sobol::SCHEME scheme = Sobol::SCHEME::saltelli;
+		string scheme_str = "SALTELLI";
+		auto sob_sch_it = gsa_opt_map.find("GSA_SOBOL_SCHEME");
+		if (sob_sch_it != gsa_opt_map.end())
+		{
+			scheme_str = sob_sch_it->second;
+			upper_ip(scheme_str);
+			if (scheme_str == "JANSEN") scheme = Sobol::SCHEME::jansen;
+			else if (scheme_str != "SALTELLI")
+			{
+				ostringstream str;
+				str << "GSA_SOBOL_SCHEME(" << scheme_str << "):  \"" << scheme_str << "\" is an invalid scheme, should be \"saltelli\" or \"jansen\"";
+				throw PestError(str.str());
+			}
+		}
+		int block_samples = 0;
+		double conf_width = 0.05;
+		int n_bootstrap = 100;
+		auto sob_blk_it = gsa_opt_map.find("GSA_SOBOL_BLOCK_SAMPLES");
+		if (sob_blk_it != gsa_opt_map.end())
+		{
+			convert_ip(sob_blk_it->second, block_samples);
+		}
+		auto sob_ci_it = gsa_opt_map.find("GSA_SOBOL_CONF_WIDTH");
+		if (sob_ci_it != gsa_opt_map.end())
+		{
+			convert_ip(sob_ci_it->second, conf_width);
+		}
+		auto sob_boot_it = gsa_opt_map.find("GSA_SOBOL_BOOTSTRAP");
+		if (sob_boot_it != gsa_opt_map.end())
+		{
+			convert_ip(sob_boot_it->second, n_bootstrap);
+		}
+
+		Sobol *s_ptr = new Sobol(pest_scenario, file_manager, &obj_func,
+			base_partran_seq, n_sample, par_dist, 1.0, num_threads);
+		s_ptr->set_sampling(sampling, scramble);
+		s_ptr->set_scheme(scheme);
+		s_ptr->set_convergence(block_samples, conf_width, n_bootstrap);
+		gsa_method = s_ptr;
 
 		frec << endl << endl << endl << "Method of Sobol settings:" << endl;
 
 		frec << scientific << left << setw(30) << " n_sample " << n_sample << endl;
 		frec << scientific << left << setw(30) << " sobol par dist " <<par_dist_str << endl;
+		frec << scientific << left << setw(30) << " sobol num threads " << num_threads << endl;
+		frec << scientific << left << setw(30) << " sobol sampling " << sampling_str << endl;
+		if (sampling == Sobol::SAMPLING::qmc)
+			frec << scientific << left << setw(30) << " sobol scramble " << scramble << endl;
+		frec << scientific << left << setw(30) << " sobol scheme " << scheme_str << endl;
+		frec << scientific << left << setw(30) << " sobol block samples " << block_samples << endl;
+		if (block_samples > 0)
+		{
+			frec << scientific << left << setw(30) << " sobol conf width " << conf_width << endl;
+			frec << scientific << left << setw(30) << " sobol bootstrap " << n_bootstrap << endl;
+		}
 		
 	}
 	else
@@ -349,6 +429,10 @@ int main(int argc, char* argv[])
 	}
 	//gsa_method->set_seed(2);
 	frec << scientific << left << setw(30) << " gsa random seed " << gsa_method->get_seed() << endl;
+	if (pest_scenario.get_pestpp_options().get_run_storage_mmap())
+	{
+		run_manager_ptr->set_storage_engine(RunStorage::Engine::MMAP);
+	}
 	// make model runs
 	if (gsa_restart == GSA_RESTART::NONE)
 	{
@@ -369,6 +453,12 @@ int main(int argc, char* argv[])
 	cout << endl;
 	cout << "Performing model runs..." << endl;
 	run_manager_ptr->run();
+	while (gsa_method->assemble_more_runs(*run_manager_ptr, model_run))
+	{
+		cout << endl;
+		cout << "Performing model runs..." << endl;
+		run_manager_ptr->run();
+	}
 
 	cout << "Calculating sensitivities..." << endl;
 	gsa_method->calc_sen(*run_manager_ptr, model_run);
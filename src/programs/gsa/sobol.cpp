@@ -1,11 +1,17 @@
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <Eigen/Dense>
 #include <cassert>
 #include <algorithm>
 #include <cmath>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
 #include "sobol.h"
 #include "Transformable.h"
 #include "RunManagerAbstract.h"
@@ -15,6 +21,7 @@
 #include "FileManager.h"
 #include "utilities.h"
 #include "eigen_tools.h"
+#include "ThreadPool.h"
 
 using namespace std;
 using namespace Eigen;
@@ -23,12 +30,36 @@ using namespace Eigen;
 Sobol::Sobol(Pest &_pest_scenario,
 	FileManager &_file_manager, ObjectiveFunc *_obj_func_ptr,
 	const ParamTransformSeq &_par_transform,
-	int _n_sample, PARAM_DIST _par_dist, unsigned int _seed)
+	int _n_sample, PARAM_DIST _par_dist, unsigned int _seed, int _num_threads)
 	: GsaAbstractBase(_pest_scenario, _file_manager, _obj_func_ptr, _par_transform,
-		_par_dist, _seed), n_sample(_n_sample)
+		_par_dist, _seed), n_sample(_n_sample), num_threads(_num_threads),
+		sampling(SAMPLING::random), scramble(true), scheme(SCHEME::saltelli), block_samples(0),
+		conf_width(0.05), n_bootstrap(100), par_csv_open(false), conv_csv_open(false)
 	{
+		if (num_threads <= 0)
+			num_threads = max((int)thread::hardware_concurrency(), 1);
 	}
 
+void Sobol::set_sampling(SAMPLING _sampling, bool _scramble)
+{
+	if ((_sampling == SAMPLING::qmc) && (2 * (int)adj_par_name_vec.size() > SobolSequence::MAX_NDIM))
+	{
+		stringstream ss;
+		ss << "Sobol error: qmc sampling supports at most " << SobolSequence::MAX_NDIM / 2 << " adjustable parameters, ";
+		ss << adj_par_name_vec.size() << " found; use gsa_sobol_sampling(random)";
+		throw PestError(ss.str());
+	}
+	sampling = _sampling;
+	scramble = _scramble;
+}
+
+void Sobol::set_convergence(int _block_samples, double _conf_width, int _n_bootstrap)
+{
+	block_samples = _block_samples;
+	conf_width = _conf_width;
+	n_bootstrap = max(_n_bootstrap, 2);
+}
+
 VectorXd Sobol::gen_rand_vec(long nsample, double min, double max)
 {
 	VectorXd v(nsample);
@@ -55,7 +86,23 @@ VectorXd Sobol::gen_rand_vec(long nsample, double min, double max)
 	return v;
 }
 
-void Sobol::gen_m1_m2()
+double Sobol::qmc_to_par(double u, double min, double max)
+{
+	if (par_dist == PARAM_DIST::normal)
+	{
+		//inverse cdf of the same truncated normal gen_rand_vec() samples from
+		double mean = (max + min) / 2.0;
+		double sd = (max - min) / 4.0;
+		double p_lo = 0.5 * erfc(-((min - mean) / sd) / sqrt(2.0));
+		double p_hi = 0.5 * erfc(-((max - mean) / sd) / sqrt(2.0));
+		double p = p_lo + u * (p_hi - p_lo);
+		p = std::min(std::max(p, p_lo), p_hi);
+		return std::min(std::max(mean + sd * ltqnorm(p), min), max);
+	}
+	return min + u * (max - min);
+}
+
+void Sobol::gen_m1_m2(int nrow)
 {
 	long npar = adj_par_name_vec.size();
 	//generate random matrices
@@ -63,15 +110,35 @@ void Sobol::gen_m1_m2()
 	double par_max;
 	VectorXd v1;
 	VectorXd v2;
-	m1 = MatrixXd::Zero(n_sample, npar);
-	m2 = MatrixXd::Zero(n_sample, npar);
+	m1 = MatrixXd::Zero(nrow, npar);
+	m2 = MatrixXd::Zero(nrow, npar);
+	if (sampling == SAMPLING::qmc)
+	{
+		//m1 from the first npar dimensions of each point and m2 from the rest
+		if (!qmc_seq)
+			qmc_seq.reset(new SobolSequence(2 * npar, scramble, seed));
+		vector<double> u(2 * npar);
+		for (int r = 0; r < nrow; ++r)
+		{
+			qmc_seq->next(u.data());
+			for (int i = 0; i < npar; ++i)
+			{
+				string &p_name = adj_par_name_vec[i];
+				par_min = min_numeric_pars[p_name];
+				par_max = max_numeric_pars[p_name];
+				m1(r, i) = qmc_to_par(u[i], par_min, par_max);
+				m2(r, i) = qmc_to_par(u[npar + i], par_min, par_max);
+			}
+		}
+		return;
+	}
 	for (int i=0; i<npar; ++i)
 	{
 		string &p_name = adj_par_name_vec[i];
 		par_min = min_numeric_pars[p_name];
 		par_max = max_numeric_pars[p_name];
-		v1 = gen_rand_vec(n_sample, par_min, par_max);
-		v2 = gen_rand_vec(n_sample, par_min, par_max);
+		v1 = gen_rand_vec(nrow, par_min, par_max);
+		v2 = gen_rand_vec(nrow, par_min, par_max);
 		m1.col(i) = v1;
 		m2.col(i) = v2;
 	}
@@ -90,7 +157,7 @@ MatrixXd Sobol::gen_N_matrix(const MatrixXd &m1, const MatrixXd &m2, const vecto
 void Sobol::add_model_runs(RunManagerAbstract &run_manager, const MatrixXd &n, ofstream &f_out)
 {
 	int run_id;
-	for (int i=0; i<n_sample; ++i)
+	for (int i=0; i<n.rows(); ++i)
 	{
 		VectorXd tmp_vec =  n.row(i);
 		Parameters tmp_pars(adj_par_name_vec, tmp_vec);
@@ -106,17 +173,33 @@ void Sobol::add_model_runs(RunManagerAbstract &run_manager, const MatrixXd &n, o
 
 void Sobol::assemble_runs(RunManagerAbstract &run_manager)
 {
-	MatrixXd c;
 	run_manager.reinitialize();
-	gen_m1_m2();
+	block_sizes.clear();
 
 	//open csv par file
 	ofstream &f_out = file_manager_ptr->open_ofile_ext("sobol.par.csv");
+	par_csv_open = true;
 	f_out << "run_id";
 	for (auto pname : adj_par_name_vec)
 		f_out << "," << pest_utils::lower_cp(pname);
 	f_out << endl;
 
+	int nrow = n_sample;
+	if (block_samples > 0)
+		nrow = min(block_samples, n_sample);
+	queue_block(run_manager, nrow);
+}
+
+void Sobol::queue_block(RunManagerAbstract &run_manager, int nrow)
+{
+	MatrixXd c;
+	gen_m1_m2(nrow);
+	if (!par_csv_open)
+	{
+		file_manager_ptr->open_ofile_ext("sobol.par.csv", ofstream::app);
+		par_csv_open = true;
+	}
+	ofstream &f_out = file_manager_ptr->get_ofstream("sobol.par.csv");
 
 	//calculate a0
 	int n_adj_par = adj_par_name_vec.size();
@@ -136,95 +219,276 @@ void Sobol::assemble_runs(RunManagerAbstract &run_manager)
 		//cout << c << endl << endl;
 		add_model_runs(run_manager, c, f_out);
 	}
-	f_out.close();
+	block_sizes.push_back(nrow);
 }
 
+int Sobol::get_n_queued() const
+{
+	int n = 0;
+	for (int nb : block_sizes)
+		n += nb;
+	return n;
+}
 
-vector<double> Sobol::get_obs_vec(RunManagerAbstract &run_manager, int run_set, ModelRun &model_run, const string &obs_name)
+void Sobol::restore_blocks(int nruns)
 {
-	ModelRun run0 = model_run;
-	int run_b = run_set * n_sample;
-	int run_e = run_b + n_sample;
-	Parameters pars0;
-	Observations obs0;
-	int nrun = 0;
-	vector<double> obs_vec = vector<double>(n_sample, MISSING_DATA);
-	for (int run_id = run_b; run_id<run_e; ++run_id)
+	//rebuild the block layout of a restarted analysis, replaying the sampling so any further
+	//blocks continue the same random (or quasi-random) sequence
+	block_sizes.clear();
+	int nset = adj_par_name_vec.size() + 2;
+	int nrun_done = 0;
+	while ((nrun_done < nruns) && (get_n_queued() < n_sample))
 	{
-		double obs = MISSING_DATA;
-		
-		//bool success = run_manager.get_run(run_id, pars0, obs0);
-		//if (success)
-		if (run_map.find(run_id) != run_map.end())
-		{
-			//obs0 = run_map[run_id];
-			//run0.update_ctl(pars0, obs0);
-			obs = run_map[run_id].get_rec(obs_name);
-			if (obs == Observations::no_data) obs = MISSING_DATA;
-		}
-		obs_vec[nrun] = obs;
-		nrun++;
+		int nrow = n_sample - get_n_queued();
+		if (block_samples > 0)
+			nrow = min(block_samples, nrow);
+		gen_m1_m2(nrow);
+		block_sizes.push_back(nrow);
+		nrun_done += nset * nrow;
+	}
+	if (nrun_done != nruns)
+	{
+		stringstream ss;
+		ss << "Sobol error: the " << nruns << " runs in the run storage do not match the sobol sampling blocks";
+		throw PestError(ss.str());
 	}
-	return obs_vec;
 }
 
 
-vector<double> Sobol::get_phi_vec(RunManagerAbstract &run_manager, int run_set, ModelRun &model_run)
+void Sobol::read_run(RunManagerAbstract &run_manager, int run_id, double *row, int ncol, ofstream *f_obs)
 {
-	ModelRun run0 = model_run;
+	const vector<string> &par_names = run_manager.get_par_name_vec();
+	size_t npar = par_names.size();
+	size_t nobs = ncol - 1;
+	par_buf.resize(npar);
+	if (f_obs != nullptr)
+		*f_obs << run_id;
+	bool success = run_manager.get_run(run_id, par_buf.data(), npar, row + 1, nobs);
+	if (!success)
+	{
+		if (f_obs != nullptr)
+		{
+			*f_obs << "," << 1;
+			for (size_t j = 0; j < nobs; j++)
+				*f_obs << ",1e10";
+			*f_obs << endl;
+		}
+		fill(row, row + ncol, MISSING_DATA);
+		return;
+	}
+	if (f_obs != nullptr)
+	{
+		*f_obs << "," << 0;
+		for (size_t j = 1; j <= nobs; j++)
+			*f_obs << "," << row[j];
+		*f_obs << endl;
+	}
+	if (pest_scenario_ptr->get_prior_info().size() > 0)
+	{
+		Parameters pars(par_names, par_buf);
+		row[0] = calc_phi(row + 1, &pars);
+	}
+	else
+		row[0] = calc_phi(row + 1, nullptr);
+	for (size_t j = 1; j <= nobs; j++)
+	{
+		if (row[j] == Observations::no_data)
+			row[j] = MISSING_DATA;
+	}
+}
 
-	int run_b = run_set * n_sample;
-	int run_e = run_b + n_sample;
+void Sobol::read_run_set(RunManagerAbstract &run_manager, int run_set, RunBlock &block, ofstream &f_obs)
+{
+	int nset = adj_par_name_vec.size() + 2;
+	int block_first = 0;
+	int i = 0;
+	for (int nb : block_sizes)
+	{
+		for (int k = 0; k < nb; k++, i++)
+			read_run(run_manager, block_first + (run_set * nb) + k, block.data() + (i * block.cols()), block.cols(), &f_obs);
+		block_first += nset * nb;
+	}
+}
 
-	Parameters pars0;
-	Observations obs0;
-	int nrun = 0;
-	vector<double> phi_vec = vector<double>(n_sample, MISSING_DATA);
-	DynamicRegularization zero_reg = DynamicRegularization::get_zero_reg_instance();
-	for(int run_id=run_b; run_id<run_e; ++run_id)
+void Sobol::calc_var(int col_first, int col_last)
+{
+	//same recurrences as vec_mean_missing_data() and sum_of_prod_missing_data() over y_a
+	//followed by y_b, run along the rows so the inner loop is over contiguous outputs
+	int nc = col_last - col_first;
+	vector<double> mk(nc, 0.0), m_sq(nc, 0.0);
+	vector<long> n_mean(nc, 0), n_sq(nc, 0);
+	double y;
+	int nrow = ya.rows();
+	for (int k = 1; k <= 2 * nrow; k++)
 	{
-		double phi = MISSING_DATA;
-		bool success = run_manager.get_run(run_id, pars0, obs0);
-		if (success)
+		const double *row = (k <= nrow) ? ya.data() + ((k - 1) * ya.cols()) : yb.data() + ((k - 1 - nrow) * yb.cols());
+		row += col_first;
+		for (int j = 0; j < nc; j++)
 		{
-			run0.update_ctl(pars0, obs0);
-			phi = run0.get_phi(zero_reg);
+			y = row[j];
+			if (y == MISSING_DATA)
+				continue;
+			++n_mean[j];
+			if (n_mean[j] == 1)
+				mk[j] = y;
+			else
+				mk[j] += (y - mk[j]) / n_mean[j];
+			if (n_sq[j] == 0)
+				m_sq[j] = y * y;
+			else
+				m_sq[j] += (y * y - m_sq[j]) / k;
+			++n_sq[j];
 		}
-		phi_vec[nrun] = phi;
-		nrun++;
 	}
-	return phi_vec;
+	for (int j = 0; j < nc; j++)
+	{
+		mean_sq[col_first + j] = pow(mk[j], 2.0);
+		var[col_first + j] = ((m_sq[j] * n_sq[j]) / n_sq[j]) - mean_sq[col_first + j];
+	}
 }
 
-void Sobol::process_runs(RunManagerAbstract& run_manager, ModelRun &model_run)
+void Sobol::accum_set(const RunBlock &yci, int ipar, int col_first, int col_last, MatrixXd &si, MatrixXd &sti)
 {
-	run_map.clear();
-	Parameters pars;
-	Observations obs;
-	ModelRun run = model_run;
-	for (int run_id = 0; run_id < run_manager.get_nruns(); run_id++)
+	//si_saltelli_numer() (or the jansen equivalent) and sti_saltelli_numer() for a block of
+	//outputs at once.  runs with missing data add zero rather than being skipped so the
+	//inner loops have no branches
+	int nc = col_last - col_first;
+	vector<double> si_sum(nc, 0.0), sti_sum(nc, 0.0);
+	vector<int> si_count(nc, 0), sti_count(nc, 0);
+	int ncol = yci.cols();
+	bool jansen = (scheme == SCHEME::jansen);
+	for (int r = 0; r < yci.rows(); r++)
 	{
-		bool success = run_manager.get_run(run_id, pars, obs);
-		if (success)
+		const double *a = ya.data() + (r * ncol) + col_first;
+		const double *b = yb.data() + (r * ncol) + col_first;
+		const double *c = yci.data() + (r * ncol) + col_first;
+		for (int j = 0; j < nc; j++)
+		{
+			bool ac = (a[j] != MISSING_DATA) && (c[j] != MISSING_DATA);
+			double d = a[j] - c[j];
+			sti_sum[j] += ac ? d * d : 0.0;
+			sti_count[j] += ac;
+		}
+		if (jansen)
 		{
-			//run.update_ctl(pars, obs);
-			run_map[run_id] = obs;
+			for (int j = 0; j < nc; j++)
+			{
+				bool bc = (b[j] != MISSING_DATA) && (c[j] != MISSING_DATA);
+				double d = b[j] - c[j];
+				si_sum[j] += bc ? d * d : 0.0;
+				si_count[j] += bc;
+			}
+		}
+		else
+		{
+			for (int j = 0; j < nc; j++)
+			{
+				bool abc = (a[j] != MISSING_DATA) && (b[j] != MISSING_DATA) && (c[j] != MISSING_DATA);
+				si_sum[j] += abc ? b[j] * (c[j] - a[j]) : 0.0;
+				si_count[j] += abc;
+			}
 		}
 	}
+	for (int j = 0; j < nc; j++)
+	{
+		int col = col_first + j;
+		if (var[col] == 0.0)
+		{
+			si(ipar, col) = 0.0;
+			sti(ipar, col) = 0.0;
+			continue;
+		}
+		if (jansen)
+			si(ipar, col) = 1.0 - ((si_sum[j] / (2.0 * si_count[j])) / var[col]);
+		else
+			si(ipar, col) = (si_sum[j] / si_count[j]) / var[col];
+		sti(ipar, col) = (sti_sum[j] / (2.0 * sti_count[j])) / var[col];
+	}
+}
+
+vector<pair<int, int>> Sobol::get_col_blocks(int ncol)
+{
+	//a few blocks per thread, but not so small that the threading overhead dominates
+	const int min_block_size = 256;
+	int block_size = max(min_block_size, (ncol + (num_threads * 4) - 1) / (num_threads * 4));
+	vector<pair<int, int>> blocks;
+	for (int first = 0; first < ncol; first += block_size)
+		blocks.push_back(make_pair(first, min(first + block_size, ncol)));
+	return blocks;
 }
 
 void Sobol::calc_sen(RunManagerAbstract &run_manager, ModelRun model_run)
 {
-	process_runs(run_manager, model_run);
+	const vector<string> &obs_names = run_manager.get_obs_name_vec();
+	int ncol = obs_names.size() + 1;
+	int npar = adj_par_name_vec.size();
+	if (block_sizes.empty())
+		restore_blocks(run_manager.get_nruns());
+	int nrow = get_n_queued();
+	prep_phi_weights(obs_names);
+	if (par_csv_open)
+		file_manager_ptr->close_file("sobol.par.csv");
+	par_csv_open = false;
+	if (conv_csv_open)
+		file_manager_ptr->close_file("sobol.conv.csv");
+	conv_csv_open = false;
 
 	ofstream &fout_sbl = file_manager_ptr->open_ofile_ext("sbl");
 	ofstream &f_out = file_manager_ptr->open_ofile_ext("sobol.obs.csv");
 	ofstream& f_si = file_manager_ptr->open_ofile_ext("sobol.si.csv");
 	ofstream& f_sti = file_manager_ptr->open_ofile_ext("sobol.sti.csv");
 
+	f_out << "run_id,failed_flag";
+	for (auto oname : obs_names)
+		f_out << "," << pest_utils::lower_cp(oname);
+	f_out << endl;
+
+	vector<pair<int, int>> col_blocks = get_col_blocks(ncol);
+	unique_ptr<ThreadPool> pool;
+	if (col_blocks.size() > 1)
+		pool.reset(new ThreadPool(min(num_threads, (int)col_blocks.size())));
+	//runs work over all the column blocks, on the pool if there is one
+	auto launch = [&pool, &col_blocks](function<void(int, int)> work)
+	{
+		vector<future<void>> futures;
+		for (auto &b : col_blocks)
+		{
+			if (pool)
+				futures.push_back(pool->submit([work, b]() { work(b.first, b.second); }));
+			else
+				work(b.first, b.second);
+		}
+		return futures;
+	};
+
+	ya.resize(nrow, ncol);
+	yb.resize(nrow, ncol);
+	read_run_set(run_manager, 0, ya, f_out);
+	read_run_set(run_manager, 1, yb, f_out);
+	mean_sq.resize(ncol);
+	var.resize(ncol);
+	vector<future<void>> futures = launch([this](int first, int last) { calc_var(first, last); });
+	ThreadPool::wait_all(futures, "Sobol::calc_var()");
+
+	//double buffered so the next run set is read while the current one is accumulated
+	MatrixXd si(npar, ncol), sti(npar, ncol);
+	RunBlock yci[2];
+	yci[0].resize(nrow, ncol);
+	yci[1].resize(nrow, ncol);
+	if (npar > 0)
+		read_run_set(run_manager, 2, yci[0], f_out);
+	for (int i = 0; i < npar; ++i)
+	{
+		const RunBlock &cur = yci[i % 2];
+		futures = launch([this, &cur, i, &si, &sti](int first, int last) { accum_set(cur, i, first, last, si, sti); });
+		if (i + 1 < npar)
+			read_run_set(run_manager, i + 3, yci[(i + 1) % 2], f_out);
+		ThreadPool::wait_all(futures, "Sobol::accum_set()");
+	}
+	file_manager_ptr->close_file("sobol.obs.csv");
+
 	f_si << "output";
 	f_sti << "output";
-
 	for (auto pname : pest_scenario_ptr->get_ctl_ordered_adj_par_names())
 	{
 		f_si << "," << pest_utils::lower_cp(pname);
@@ -233,209 +497,189 @@ void Sobol::calc_sen(RunManagerAbstract &run_manager, ModelRun model_run)
 	f_si << endl;
 	f_sti << endl;
 
-	//phi
-	fout_sbl << "Sobol Sensitivity for PHI" << endl;
-	pair<vector<double>, vector<double>> vals;
-	vals = calc_sen_single(run_manager, model_run, fout_sbl, string());
-	f_si << "phi";
-	f_sti << "phi";
-	for (auto v : vals.first)
-		f_si << "," << v;
-	f_si << endl;
-	for (auto v : vals.second)
-		f_sti << "," << v;
-	f_sti << endl;
-
-
-	vector<string> obs_names = run_manager.get_obs_name_vec();
-	f_out << "run_id,failed_flag";
-	for (auto oname : obs_names)
-		f_out << "," << pest_utils::lower_cp(oname);
-	f_out << endl;
-	Observations obs0;
-	Parameters pars0;
-	for (int i=0; i < run_manager.get_nruns(); i++)
+	for (int col = 0; col < ncol; col++)
 	{
-		f_out << i;
-		bool success = run_manager.get_run(i, pars0, obs0);
-		if (success)
+		string out_name;
+		if (col == 0)
 		{
-			f_out << "," << 0;
-			for (auto oname : obs_names)
-				f_out << "," << obs0.get_rec(oname);
+			fout_sbl << "Sobol Sensitivity for PHI" << endl;
+			out_name = "phi";
 		}
 		else
 		{
-			f_out << "," << 1;
-			for (auto oname : obs_names)
-				f_out << ",1e10";
+			fout_sbl << endl << endl;
+			fout_sbl << "Sobol Sensitivity for observation \"" << obs_names[col - 1] << "\"" << endl;
+			out_name = pest_utils::lower_cp(obs_names[col - 1]);
 		}
-		f_out << endl;
-	}
-	file_manager_ptr->close_file("sobol.obs.csv");
-	
-	for (const string &iobs : obs_names)
-	{
-		fout_sbl << endl << endl;
-		fout_sbl << "Sobol Sensitivity for observation \"" << iobs <<"\"" << endl;
-		vals = calc_sen_single(run_manager, model_run, fout_sbl, iobs);
-		string low_obs = pest_utils::lower_cp(iobs);
-		f_si << low_obs;
-		f_sti << low_obs;
-		for (auto v : vals.first)
-			f_si << "," << v;
+		fout_sbl << "parameter_name, s_i, st_i, n_runs" << endl;
+		for (int i = 0; i < npar; ++i)
+			fout_sbl << adj_par_name_vec[i] << ", " << si(i, col) << ", " << sti(i, col) << ", " << 0 << endl;
+		f_si << out_name;
+		f_sti << out_name;
+		for (int i = 0; i < npar; ++i)
+			f_si << "," << si(i, col);
 		f_si << endl;
-		for (auto v : vals.second)
-			f_sti << "," << v;
+		for (int i = 0; i < npar; ++i)
+			f_sti << "," << sti(i, col);
 		f_sti << endl;
 	}
 
 	file_manager_ptr->close_file("sbl");
 	file_manager_ptr->close_file("sobol.si.csv");
 	file_manager_ptr->close_file("sobol.sti.csv");
-
 }
 
-
-void Sobol::calc_sen_single_old(RunManagerAbstract& run_manager, ModelRun model_run, ofstream& fout_sbl, const string& obs_name)
+void Sobol::update_phi_cache(RunManagerAbstract &run_manager)
 {
-	vector<double> ya;
-	vector<double> yb;
-	if (obs_name.empty())
+	int nruns = run_manager.get_nruns();
+	int first = phi_cache.size();
+	phi_cache.resize(nruns, MISSING_DATA);
+	vector<double> row(run_manager.get_obs_name_vec().size() + 1);
+	for (int run_id = first; run_id < nruns; run_id++)
 	{
-		ya = get_phi_vec(run_manager, 0, model_run);
-		yb = get_phi_vec(run_manager, 1, model_run);
+		read_run(run_manager, run_id, row.data(), row.size(), nullptr);
+		phi_cache[run_id] = row[0];
 	}
-	else
+}
+
+double Sobol::calc_phi_conf_width()
+{
+	//bootstrap the phi s_i and st_i over the samples (rows of m1, m2 and the C_i together)
+	//and return the widest 95% percentile interval
+	int npar = adj_par_name_vec.size();
+	int nset = npar + 2;
+	int nrow = get_n_queued();
+	//y(k, s) is phi of sample k in run set s
+	MatrixXd y(nrow, nset);
+	int block_first = 0;
+	int k = 0;
+	for (int nb : block_sizes)
 	{
-		ya = get_obs_vec(run_manager, 0, model_run, obs_name);
-		yb = get_obs_vec(run_manager, 1, model_run, obs_name);
+		for (int r = 0; r < nb; r++, k++)
+		{
+			for (int iset = 0; iset < nset; iset++)
+				y(k, iset) = phi_cache[block_first + (iset * nb) + r];
+		}
+		block_first += nset * nb;
 	}
 
-	vector<double> ya_yb_prod = vec_array_prod(ya, yb, MISSING_DATA);
-	vector<double> y_ab;
-	y_ab.reserve(ya.size() + yb.size()); // preallocate memory
-	y_ab.insert(y_ab.end(), ya.begin(), ya.end());
-	y_ab.insert(y_ab.end(), yb.begin(), yb.end());
-
-
-	//Compute Mean for the S_i's
-	double mean_sq_si = vec_mean_missing_data(ya_yb_prod, MISSING_DATA);
-	// Compute Var for S_i's
-	pair<double, size_t> data = sum_of_prod_missing_data(y_ab, y_ab, MISSING_DATA);
-	//double var_si = data.first / (data.second - 2.0) - mean_sq_si;
-	double var_si = (data.first / data.second) - mean_sq_si;
-
-	//Compute Mean for the S_ti's
-	double mean_sq_sti = pow(vec_mean_missing_data(y_ab, MISSING_DATA), 2.0);
-	// Compute Var for S_ti's
-	double sti_u = sobol_u_missing_data(yb, yb, MISSING_DATA);
-	double var_sti = sti_u - mean_sq_sti;
-	fout_sbl << "E(Y) = " << sqrt(mean_sq_si) << ";  Var(Y) = " << var_si << " (for S_i calculations)" << endl;
-	fout_sbl << "E(Y) = " << sqrt(mean_sq_sti) << ";  Var(Y) = " << var_sti << " (for S_ti calculations)" << endl;
-	size_t npar = adj_par_name_vec.size();
-
-	fout_sbl << "parameter_name, s_i, st_i, n_runs" << endl;
-	for (size_t i = 0; i < npar; ++i)
+	bool jansen = (scheme == SCHEME::jansen);
+	uniform_int_distribution<int> pick(0, nrow - 1);
+	vector<int> idx(nrow);
+	//si and st_i of each parameter for each bootstrap sample
+	vector<vector<double>> boot_vals(2 * npar);
+	for (int ib = 0; ib < n_bootstrap; ib++)
 	{
-		vector<double> yci;
-		if (obs_name.empty())
+		for (auto &i : idx)
+			i = pick(boot_engine);
+		double sum = 0.0, sum_sq = 0.0;
+		int n = 0;
+		for (int i : idx)
 		{
-			yci = get_phi_vec(run_manager, i + 2, model_run);
+			for (int iset = 0; iset < 2; iset++)
+			{
+				double v = y(i, iset);
+				if (v == MISSING_DATA)
+					continue;
+				sum += v;
+				sum_sq += v * v;
+				n++;
+			}
 		}
-		else
+		if (n == 0)
+			continue;
+		double mean = sum / n;
+		double var_y = (sum_sq / n) - (mean * mean);
+		if (var_y <= 0.0)
+			continue;
+		for (int ipar = 0; ipar < npar; ipar++)
 		{
-			yci = get_obs_vec(run_manager, i + 2, model_run, obs_name);
+			double si_sum = 0.0, sti_sum = 0.0;
+			int si_count = 0, sti_count = 0;
+			for (int i : idx)
+			{
+				double a = y(i, 0), b = y(i, 1), c = y(i, ipar + 2);
+				if (c == MISSING_DATA)
+					continue;
+				if (a != MISSING_DATA)
+				{
+					sti_sum += (a - c) * (a - c);
+					sti_count++;
+				}
+				if (b == MISSING_DATA)
+					continue;
+				if (jansen)
+				{
+					si_sum += (b - c) * (b - c);
+					si_count++;
+				}
+				else if (a != MISSING_DATA)
+				{
+					si_sum += b * (c - a);
+					si_count++;
+				}
+			}
+			if ((si_count == 0) || (sti_count == 0))
+				continue;
+			if (jansen)
+				boot_vals[ipar].push_back(1.0 - ((si_sum / (2.0 * si_count)) / var_y));
+			else
+				boot_vals[ipar].push_back((si_sum / si_count) / var_y);
+			boot_vals[npar + ipar].push_back((sti_sum / (2.0 * sti_count)) / var_y);
 		}
+	}
 
-		pair<double, int> sumprod_num = sum_of_prod_missing_data(ya, yci, MISSING_DATA);
-		long int n_runs = sumprod_num.second;
-		double sobol_uj = sumprod_num.first / (sumprod_num.second - 1.0);
-		double si = (sobol_uj - mean_sq_si) / var_si;
-
-		double sobol_umj = sobol_u_missing_data(yb, yci, MISSING_DATA);
-		double sti = 1 - ((sobol_umj - mean_sq_sti) / var_sti);
-
-		fout_sbl << adj_par_name_vec[i] << ", " << si << ", " << sti << ", " << n_runs << endl;
+	double max_width = 0.0;
+	for (auto &vals : boot_vals)
+	{
+		//too few usable bootstrap samples to say anything
+		if (vals.size() < 2)
+			return numeric_limits<double>::max();
+		sort(vals.begin(), vals.end());
+		double lo = vals[(size_t)floor(0.025 * (vals.size() - 1))];
+		double hi = vals[(size_t)ceil(0.975 * (vals.size() - 1))];
+		max_width = max(max_width, hi - lo);
 	}
+	return max_width;
 }
 
-
-pair<vector<double>, vector<double>> Sobol::calc_sen_single(RunManagerAbstract &run_manager, ModelRun model_run, ofstream &fout_sbl, const string &obs_name)
+bool Sobol::assemble_more_runs(RunManagerAbstract &run_manager, ModelRun model_run)
 {
-	vector<double> ya;
-	vector<double> yb;
-	if (obs_name.empty())
+	if (block_samples <= 0)
+		return false;
+	if (block_sizes.empty())
+		restore_blocks(run_manager.get_nruns());
+	if (phi_cache.empty())
 	{
-		ya = get_phi_vec(run_manager, 0, model_run);
-		yb = get_phi_vec(run_manager, 1, model_run);
+		prep_phi_weights(run_manager.get_obs_name_vec());
+		boot_engine.seed(seed);
 	}
-	else
-	{
-		ya = get_obs_vec(run_manager, 0, model_run, obs_name);
-		yb = get_obs_vec(run_manager, 1, model_run, obs_name);
-	}
-
-	vector<double> y_ab;
-	y_ab.reserve(ya.size() + yb.size()); // preallocate memory
-	y_ab.insert(y_ab.end(), ya.begin(), ya.end());
-	y_ab.insert(y_ab.end(), yb.begin(), yb.end());
+	update_phi_cache(run_manager);
+	int n_queued = get_n_queued();
+	double width = calc_phi_conf_width();
 
-	size_t npar = adj_par_name_vec.size();
-	
-
-	//Compute Mean for the S_i's
-	double mean_sq_si = pow(vec_mean_missing_data(y_ab, MISSING_DATA),2.0);
-	// Compute Var for S_i's
-	pair<double, size_t> data = sum_of_prod_missing_data(y_ab, y_ab, MISSING_DATA);
-	//double var_si = data.first / (data.second - 2.0) - mean_sq_si;
-	double var_si = (data.first / data.second) - mean_sq_si;
-
-	fout_sbl << "parameter_name, s_i, st_i, n_runs" << endl;
-	vector<double> si_vals, sti_vals,r_yci, r_ya, r_yb;
-	si_vals.reserve(npar);
-	sti_vals.reserve(npar);
-	double si, sti, numer;
-	pair<double, int> sumprod;
-	long int n_runs = 0;
-	int r;
-	for (size_t i=0; i<npar; ++i)
+	if (!conv_csv_open)
 	{
-		vector<double> yci;
-		if (obs_name.empty())
-		{
-			yci = get_phi_vec(run_manager, i + 2, model_run);
-		}
-		else
-		{
-			yci = get_obs_vec(run_manager, i + 2, model_run, obs_name);
-		}
-		
-		if (var_si == 0)
-		{
-			si = 0.0;
-		}
-
-		else
-		{
-			numer = si_saltelli_numer(ya, yb, yci, MISSING_DATA);
-			si = numer / var_si;
-		}
-
-		
-		if (var_si == 0.0)
-			sti = 0.0;
-		else
-		{
-			numer = sti_saltelli_numer(ya, yci, MISSING_DATA);
-			sti = numer / var_si;
-		}
-		fout_sbl << adj_par_name_vec[i] << ", " << si << ", " << sti << ", " << n_runs << endl;
-		si_vals.push_back(si);
-		sti_vals.push_back(sti);
+		ofstream &f = file_manager_ptr->open_ofile_ext("sobol.conv.csv");
+		f << "n_sample,max_phi_ci_width" << endl;
+		conv_csv_open = true;
 	}
-
-	pair<vector<double>, vector<double>> vals(si_vals, sti_vals);
-	return vals;
-
+	ofstream &f_conv = file_manager_ptr->get_ofstream("sobol.conv.csv");
+	f_conv << n_queued << "," << width << endl;
+	ofstream &frec = file_manager_ptr->rec_ofstream();
+	stringstream ss;
+	ss << "Sobol convergence: " << n_queued << " samples, widest phi s_i/st_i 95% confidence interval " << width;
+	if (width <= conf_width)
+		ss << " <= " << conf_width << ", converged";
+	else if (n_queued >= n_sample)
+		ss << ", gsa_sobol_samples (" << n_sample << ") reached";
+	cout << ss.str() << endl;
+	frec << ss.str() << endl;
+	if ((width <= conf_width) || (n_queued >= n_sample))
+		return false;
+
+	int nrow = min(block_samples, n_sample - n_queued);
+	cout << "Building " << nrow << " more samples..." << endl;
+	queue_block(run_manager, nrow);
+	return true;
 }
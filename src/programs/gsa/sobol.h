@@ -3,9 +3,12 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <random>
 #include <Eigen/Dense>
 #include "GsaAbstractBase.h"
 #include "Transformable.h"
+#include "SobolSequence.h"
 using Eigen::MatrixXd;
 using Eigen::VectorXd;
 
@@ -16,25 +19,72 @@ class ModelRun;
 class Sobol : public GsaAbstractBase
 {
 public:
+	//how m1 and m2 are drawn: pseudo-random or from a sobol' low-discrepancy sequence
+	enum class SAMPLING { random, qmc };
+	//estimators used with the m1, m2, C_i design: saltelli (2010) s_i or jansen (1999) s_i,
+	//with jansen st_i for both
+	enum class SCHEME { saltelli, jansen };
 	Sobol(Pest &_pest_scenario,
 		FileManager &_file_manager, ObjectiveFunc *_obj_func_ptr,
 		const ParamTransformSeq &_par_transform,
-		int _n_sample, PARAM_DIST _par_dist, unsigned int _seed);
+		int _n_sample, PARAM_DIST _par_dist, unsigned int _seed, int _num_threads=-1);
+	//qmc sampling uses two sobol' dimensions per adjustable parameter, so it is limited to
+	//SobolSequence::MAX_NDIM / 2 parameters
+	void set_sampling(SAMPLING _sampling, bool _scramble);
+	void set_scheme(SCHEME _scheme) { scheme = _scheme; }
+	//queue the samples in blocks of _block_samples (0 queues all n_sample at once) and stop
+	//adding blocks once the bootstrap 95% confidence interval of every phi s_i and st_i is
+	//narrower than _conf_width
+	void set_convergence(int _block_samples, double _conf_width, int _n_bootstrap);
 	void assemble_runs(RunManagerAbstract &run_manager);
+	bool assemble_more_runs(RunManagerAbstract &run_manager, ModelRun model_run);
+	//streams the runs out of the run storage one run set at a time (each run is read once)
+	//and accumulates s_i and st_i for phi and every observation together
 	void calc_sen(RunManagerAbstract &run_manager, ModelRun model_run);
-	pair<vector<double>,vector<double>> calc_sen_single(RunManagerAbstract &run_manager, ModelRun model_run, std::ofstream &fout_sbl, const std::string &obs_name);
-	void calc_sen_single_old(RunManagerAbstract& run_manager, ModelRun model_run, std::ofstream& fout_sbl, const std::string& obs_name);
 
 private:
+	//one row per run of a run set, column 0 is phi and column j+1 is observation j (in
+	//run storage order)
+	typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RunBlock;
 	VectorXd gen_rand_vec(long nsample, double min, double max);
-	void gen_m1_m2();
+	void gen_m1_m2(int nrow);
+	double qmc_to_par(double u, double min, double max);
+	void queue_block(RunManagerAbstract &run_manager, int nrow);
+	void restore_blocks(int nruns);
+	int get_n_queued() const;
+	void update_phi_cache(RunManagerAbstract &run_manager);
+	double calc_phi_conf_width();
 	MatrixXd gen_N_matrix(const MatrixXd &m1, const MatrixXd &m2, const vector<int> &idx_vec);
 	void add_model_runs(RunManagerAbstract &run_manager, const MatrixXd &n, ofstream &f_out);
-	vector<double> get_obs_vec(RunManagerAbstract &run_manager, int run_set, ModelRun &model_run, const string &obs_name );
-	vector<double> get_phi_vec(RunManagerAbstract &run_manager, int run_set, ModelRun &model_run);
+	void read_run(RunManagerAbstract &run_manager, int run_id, double *row, int ncol, ofstream *f_obs);
+	void read_run_set(RunManagerAbstract &run_manager, int run_set, RunBlock &block, ofstream &f_obs);
+	void calc_var(int col_first, int col_last);
+	void accum_set(const RunBlock &yci, int ipar, int col_first, int col_last, MatrixXd &si, MatrixXd &sti);
+	vector<pair<int, int>> get_col_blocks(int ncol);
+	//maximum number of samples
 	int n_sample;
-	void process_runs(RunManagerAbstract& run_manager, ModelRun &model_run);
-	map<int, Observations> run_map;
+	int num_threads;
+	SAMPLING sampling;
+	bool scramble;
+	SCHEME scheme;
+	int block_samples;
+	double conf_width;
+	int n_bootstrap;
+	std::unique_ptr<SobolSequence> qmc_seq;
+	std::mt19937_64 boot_engine;
+	//samples in each block queued so far.  block b holds the runs of m1, m2 and each C_i for
+	//its samples, one run set after the other
+	std::vector<int> block_sizes;
+	bool par_csv_open;
+	bool conv_csv_open;
+	//phi of each run, filled as the blocks complete when checking convergence
+	std::vector<double> phi_cache;
+	VectorXd par_buf;
+	RunBlock ya;
+	RunBlock yb;
+	//E(Y)^2 and Var(Y) of each output over the runs of m1 and m2
+	VectorXd mean_sq;
+	VectorXd var;
 	Eigen::MatrixXd m1;
 	Eigen::MatrixXd m2;
 };
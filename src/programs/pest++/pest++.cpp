@@ -35,6 +35,7 @@
 #include "FileManager.h"
 #include "TerminationController.h"
 #include "RunManagerSerial.h"
+#include "RunManagerPlugin.h"
 #include "RunManagerExternal.h"
 #include "SVD_PROPACK.h"
 #include "OutputFileWriter.h"
@@ -198,6 +199,8 @@ int main(int argc, char* argv[])
 	 	}
 #endif
 		pest_scenario.check_inputs(fout_rec);
+		if (pest_scenario.get_pestpp_options().get_perf_trace())
+			performance_log.enable_trace(file_manager.build_filename("trace.json"));
 		// reset this here because we want to draw from the FOSM posterior as a whole matrix
 		pest_scenario.get_pestpp_options_ptr()->set_ies_group_draws(false);
 		
@@ -267,7 +270,9 @@ int main(int argc, char* argv[])
 					pest_scenario.get_pestpp_options().get_overdue_reched_fac(),
 					pest_scenario.get_pestpp_options().get_overdue_giveup_fac(),
 					pest_scenario.get_pestpp_options().get_overdue_giveup_minutes(),
-					pest_scenario.get_pestpp_options().get_panther_echo());
+					pest_scenario.get_pestpp_options().get_panther_echo(),
+					pest_scenario.get_pestpp_options().get_panther_schedule_policy(),
+					pest_scenario.get_pestpp_options().get_panther_tail_runs());
 			}
 		}
 		
@@ -280,6 +285,16 @@ int main(int argc, char* argv[])
 				file_manager.build_filename("exi"),
 				pest_scenario.get_pestpp_options().get_max_run_fail());
 		}
+		else if (!pest_scenario.get_pestpp_options().get_model_plugin().empty())
+		{
+			//the model is evaluated in-process, so there are no model IO files to check
+			RunManagerPlugin *plugin_ptr = new RunManagerPlugin(pest_scenario.get_pestpp_options().get_model_plugin(),
+				file_manager.build_filename("rns"),
+				pest_scenario.get_pestpp_options().get_max_run_fail(),
+				pest_scenario.get_pestpp_options().get_model_plugin_threads());
+			plugin_ptr->set_model_order(pest_scenario.get_ctl_ordered_par_names(), pest_scenario.get_ctl_ordered_obs_names());
+			run_manager_ptr = plugin_ptr;
+		}
 		else
 		{
 			performance_log.log_event("starting basic model IO error checking");
@@ -293,7 +308,8 @@ int main(int argc, char* argv[])
 				file_manager.build_filename("rns"), pathname,
 				pest_scenario.get_pestpp_options().get_max_run_fail(),
 				pest_scenario.get_pestpp_options().get_fill_tpl_zeros(),
-				pest_scenario.get_pestpp_options().get_additional_ins_delimiters());
+				pest_scenario.get_pestpp_options().get_additional_ins_delimiters(),
+				pest_scenario.get_pestpp_options().get_serial_num_slots());
 		}
 
 		const ParamTransformSeq &base_trans_seq = pest_scenario.get_base_par_tran_seq();
@@ -353,6 +369,12 @@ int main(int argc, char* argv[])
 		//Allocates Space for Run Manager.  This initializes the model parameter names and observations names.
 		//Neither of these will change over the course of the simulation
 
+		if (pest_scenario.get_pestpp_options().get_run_storage_mmap())
+		{
+			run_manager_ptr->set_storage_engine(RunStorage::Engine::MMAP);
+		}
+		run_manager_ptr->set_performance_log(&performance_log);
+
 		if (restart_ctl.get_restart_option() == RestartController::RestartOption::RESUME_JACOBIAN_RUNS)
 		{
 			run_manager_ptr->initialize_restart(file_manager.build_filename("rnj"));
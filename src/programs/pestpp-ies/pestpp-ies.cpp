@@ -17,6 +17,7 @@
 #include "ModelRunPP.h"
 #include "FileManager.h"
 #include "RunManagerSerial.h"
+#include "RunManagerPlugin.h"
 #include "OutputFileWriter.h"
 #include "PantherAgent.h"
 #include "Serialization.h"
@@ -175,6 +176,8 @@ int main(int argc, char* argv[])
 		}
 		//pest_scenario.clear_ext_files();
 		pest_scenario.check_inputs(fout_rec);
+		if (pest_scenario.get_pestpp_options().get_perf_trace())
+			performance_log.enable_trace(file_manager.build_filename("trace.json"));
 
 		//Initialize OutputFileWriter to handle IO of suplementary files (.par, .par, .svd)
 		//bool save_eign = pest_scenario.get_svd_info().eigwrite > 0;
@@ -222,7 +225,19 @@ int main(int argc, char* argv[])
 				pest_scenario.get_pestpp_options().get_overdue_reched_fac(),
 				pest_scenario.get_pestpp_options().get_overdue_giveup_fac(),
 				pest_scenario.get_pestpp_options().get_overdue_giveup_minutes(),
-				pest_scenario.get_pestpp_options().get_panther_echo());
+				pest_scenario.get_pestpp_options().get_panther_echo(),
+				pest_scenario.get_pestpp_options().get_panther_schedule_policy(),
+				pest_scenario.get_pestpp_options().get_panther_tail_runs());
+		}
+		else if (!pest_scenario.get_pestpp_options().get_model_plugin().empty())
+		{
+			//the model is evaluated in-process, so there are no model IO files to check
+			RunManagerPlugin *plugin_ptr = new RunManagerPlugin(pest_scenario.get_pestpp_options().get_model_plugin(),
+				file_manager.build_filename("rns"),
+				pest_scenario.get_pestpp_options().get_max_run_fail(),
+				pest_scenario.get_pestpp_options().get_model_plugin_threads());
+			plugin_ptr->set_model_order(pest_scenario.get_ctl_ordered_par_names(), pest_scenario.get_ctl_ordered_obs_names());
+			run_manager_ptr = plugin_ptr;
 		}
 		else
 		{
@@ -238,7 +253,8 @@ int main(int argc, char* argv[])
 				file_manager.build_filename("rns"), pathname,
 				pest_scenario.get_pestpp_options().get_max_run_fail(),
 				pest_scenario.get_pestpp_options().get_fill_tpl_zeros(),
-				pest_scenario.get_pestpp_options().get_additional_ins_delimiters());
+				pest_scenario.get_pestpp_options().get_additional_ins_delimiters(),
+				pest_scenario.get_pestpp_options().get_serial_num_slots());
 		}
 
 		const ParamTransformSeq &base_trans_seq = pest_scenario.get_base_par_tran_seq();
@@ -249,6 +265,12 @@ int main(int argc, char* argv[])
 		//Neither of these will change over the course of the simulation
 
 
+		if (pest_scenario.get_pestpp_options().get_run_storage_mmap())
+		{
+			run_manager_ptr->set_storage_engine(RunStorage::Engine::MMAP);
+		}
+		run_manager_ptr->set_performance_log(&performance_log);
+
 		run_manager_ptr->initialize(base_trans_seq.ctl2model_cp(cur_ctl_parameters), pest_scenario.get_ctl_observations());
 		
 		IterEnsembleSmoother ies(pest_scenario, file_manager, output_file_writer, &performance_log, run_manager_ptr);
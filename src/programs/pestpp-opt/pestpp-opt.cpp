@@ -212,7 +212,9 @@ int main(int argc, char* argv[])
 				pest_scenario.get_pestpp_options().get_overdue_reched_fac(),
 				pest_scenario.get_pestpp_options().get_overdue_giveup_fac(),
 				pest_scenario.get_pestpp_options().get_overdue_giveup_minutes(),
-				pest_scenario.get_pestpp_options().get_panther_echo());
+				pest_scenario.get_pestpp_options().get_panther_echo(),
+				pest_scenario.get_pestpp_options().get_panther_schedule_policy(),
+				pest_scenario.get_pestpp_options().get_panther_tail_runs());
 		}
 
 		else
@@ -247,7 +249,8 @@ int main(int argc, char* argv[])
 				file_manager.build_filename("rns"), pathname,
 				pest_scenario.get_pestpp_options().get_max_run_fail(),
 				pest_scenario.get_pestpp_options().get_fill_tpl_zeros(),
-				pest_scenario.get_pestpp_options().get_additional_ins_delimiters());
+				pest_scenario.get_pestpp_options().get_additional_ins_delimiters(),
+				pest_scenario.get_pestpp_options().get_serial_num_slots());
 		}
 
 		//setup the parcov, if needed
@@ -273,6 +276,11 @@ int main(int argc, char* argv[])
 		//Allocates Space for Run Manager.  This initializes the model parameter names and observations names.
 		//Neither of these will change over the course of the simulation
 
+		if (pest_scenario.get_pestpp_options().get_run_storage_mmap())
+		{
+			run_manager_ptr->set_storage_engine(RunStorage::Engine::MMAP);
+		}
+
 		if (restart_ctl.get_restart_option() == RestartController::RestartOption::RESUME_JACOBIAN_RUNS)
 		{
 			run_manager_ptr->initialize_restart(file_manager.build_filename("rnj"));
@@ -24,6 +24,9 @@ along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
 #include <algorithm>
 #include <iterator>
 #include <unordered_set>
+#include <unordered_map>
+#include <deque>
+#include <future>
 #include "config_os.h"
 #include "Pest.h"
 #include "Transformable.h"
@@ -44,6 +47,16 @@ along with PEST++.  If not, see<http://www.gnu.org/licenses/>.
 #include "debug.h"
 #include "logger.h"
 #include "Jacobian.h"
+#include "ThreadPool.h"
+
+#ifdef OS_WIN
+#include <io.h>
+#include <fcntl.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
 
 
 using namespace std;
@@ -204,61 +217,263 @@ void load_parameters_from_csv(map<string, int>& header_info, ifstream& csv, int
 }
 
 
-void prep_sweep_output_file(Pest &pest_scenario, ofstream &csv)
+//model parameters of one chunk of sweep runs, one row per run in run storage order
+struct SweepChunk
+{
+	vector<string> listed_run_ids;
+	Eigen::MatrixXd run_pars;
+};
+
+//simulated results of one chunk, copied out of the run storage so the output file can be
+//written while the next chunk runs
+struct SweepChunkResults
+{
+	typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrix;
+	int first_run_id;
+	vector<string> listed_run_ids;
+	vector<bool> success;
+	RowMatrix pars;
+	RowMatrix obs;
+};
+
+//a chunk whose runs have been queued with the run manager
+struct QueuedSweepChunk
+{
+	int first_run_id;
+	vector<string> listed_run_ids;
+	vector<int> run_ids;
+};
+
+//where the sweep parameter values come from (a parameter csv file or the rows of a binary
+//jco-type file) and the input_run_ids to skip when resuming
+struct SweepSource
+{
+	bool use_jco;
+	Eigen::MatrixXd jco_mat;
+	vector<string> jco_col_names;
+	int jco_row;
+	map<string, int> header_info;
+	ifstream *par_stream;
+	unordered_map<string, int> done_counts;
+	int nskipped;
+};
+
+
+void read_sweep_chunk(SweepSource &source, int chunk, Pest &pest_scenario, const ParamTransformSeq &base_trans_seq,
+	const vector<string> &run_par_names, SweepChunk &sweep_chunk)
+{
+	vector<string> run_ids;
+	vector<Parameters> sweep_pars;
+	vector<int> keep;
+	sweep_chunk.listed_run_ids.clear();
+	//keep reading until there is a run that has not been done before or the input is exhausted
+	while (keep.empty())
+	{
+		if (source.use_jco)
+		{
+			//just use the jco row counter as the run id
+			vector<string> par_names = pest_scenario.get_ctl_ordered_par_names();
+			Parameters par;
+			sweep_pars.clear();
+			sweep_pars.reserve(chunk);
+			run_ids.clear();
+			for (int i = 0; i < chunk; i++)
+			{
+				if (source.jco_row >= source.jco_mat.rows())
+					break;
+				par.update_without_clear(par_names, source.jco_mat.row(source.jco_row));
+				sweep_pars.push_back(par);
+				run_ids.push_back(source.jco_col_names[source.jco_row]);
+				source.jco_row++;
+			}
+		}
+		else
+		{
+			load_parameters_from_csv(source.header_info, *source.par_stream, chunk, pest_scenario.get_ctl_parameters(), run_ids, sweep_pars);
+		}
+		if (run_ids.size() == 0)
+			break;
+		for (int i = 0; i < run_ids.size(); i++)
+		{
+			auto it = source.done_counts.find(run_ids[i]);
+			if ((it != source.done_counts.end()) && (it->second > 0))
+			{
+				it->second--;
+				source.nskipped++;
+				continue;
+			}
+			keep.push_back(i);
+		}
+	}
+	sweep_chunk.run_pars.resize(keep.size(), run_par_names.size());
+	vector<double> run_vec;
+	int irow = 0;
+	for (int i : keep)
+	{
+		run_vec = base_trans_seq.active_ctl2model_cp(sweep_pars[i]).get_data_vec(run_par_names);
+		sweep_chunk.run_pars.row(irow++) = Eigen::Map<Eigen::VectorXd>(run_vec.data(), run_vec.size());
+		sweep_chunk.listed_run_ids.push_back(run_ids[i]);
+	}
+}
+
+
+string get_sweep_output_header(Pest &pest_scenario)
+{
+	stringstream ss;
+	ss << "run_id,input_run_id,failed_flag";
+	ss << ",phi,meas_phi,regul_phi";
+	for (auto &ogrp : pest_scenario.get_ctl_ordered_obs_group_names())
+	{
+		ss << ',' << pest_utils::lower_cp(ogrp);
+	}
+	for (auto &oname : pest_scenario.get_ctl_ordered_obs_names())
+		ss << ',' << pest_utils::lower_cp(oname);
+	return ss.str();
+}
+
+
+void truncate_file(const string &filename, long long size)
+{
+#ifdef OS_WIN
+	int fd;
+	bool ok = (_sopen_s(&fd, filename.c_str(), _O_RDWR | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE) == 0);
+	if (ok)
+	{
+		ok = (_chsize_s(fd, size) == 0);
+		_close(fd);
+	}
+#else
+	bool ok = (truncate(filename.c_str(), size) == 0);
+#endif
+	if (!ok)
+		throw runtime_error("could not truncate file " + filename);
+}
+
+
+//reads the input_run_ids already recorded in the output file of an interrupted sweep so the
+//resumed sweep can skip them.  a partly written last line is cut off.  returns the number of
+//runs recorded, or -1 if there is no output file to resume from
+int read_completed_sweep_runs(Pest &pest_scenario, unordered_map<string, int> &done_counts)
+{
+	string filename = pest_scenario.get_pestpp_options().get_sweep_output_csv_file();
+	done_counts.clear();
+	ifstream csv(filename, ios::binary);
+	if (!csv.good())
+		return -1;
+	string line;
+	if (!getline(csv, line))
+		return -1;
+	long long complete_size = line.size() + 1;
+	strip_ip(line);
+	if (line != get_sweep_output_header(pest_scenario))
+		throw runtime_error("the header of sweep_output_csv_file " + filename + " does not match the control file, cannot resume the sweep");
+	int nrows = 0;
+	while (getline(csv, line))
+	{
+		//getline() only hits eof on a line without a newline, i.e. an interrupted write
+		if (csv.eof())
+			break;
+		complete_size += line.size() + 1;
+		size_t first = line.find(',');
+		size_t second = (first == string::npos) ? string::npos : line.find(',', first + 1);
+		if (second == string::npos)
+			throw runtime_error("error parsing input_run_id on line " + to_string(nrows + 2) + " of sweep_output_csv_file " + filename);
+		done_counts[line.substr(first + 1, second - first - 1)]++;
+		nrows++;
+	}
+	csv.close();
+	ifstream size_check(filename, ios::binary | ios::ate);
+	long long file_size = size_check.tellg();
+	size_check.close();
+	if (file_size > complete_size)
+		truncate_file(filename, complete_size);
+	return nrows;
+}
+
+
+void prep_sweep_output_file(Pest &pest_scenario, ofstream &csv, bool append)
 {
-	//ofstream csv(pest_scenario.get_pestpp_options().get_sweep_output_csv_file());
-	csv.open(pest_scenario.get_pestpp_options().get_sweep_output_csv_file());	
+	if (append)
+		csv.open(pest_scenario.get_pestpp_options().get_sweep_output_csv_file(), ios::app);
+	else
+		csv.open(pest_scenario.get_pestpp_options().get_sweep_output_csv_file());
 	if (!csv.good())
 	{
 		throw runtime_error("could not open sweep_output_csv_file for writing: " +
 			pest_scenario.get_pestpp_options().get_sweep_output_csv_file());
 	}
 	csv.precision(numeric_limits<double>::digits10);
-	csv << "run_id,input_run_id,failed_flag";
-	csv << ",phi,meas_phi,regul_phi";
-	for (auto &ogrp : pest_scenario.get_ctl_ordered_obs_group_names())
+	if (!append)
 	{
-		csv << ',' << pest_utils::lower_cp(ogrp);
+		csv << get_sweep_output_header(pest_scenario) << endl;
+		csv.flush();
 	}
-	for (auto &oname : pest_scenario.get_ctl_ordered_obs_names())
-		csv << ',' << pest_utils::lower_cp(oname);
-	csv << endl;
-	csv.flush();
-	//return csv;
+}
+
+
+void get_sweep_results(RunManagerAbstract* run_manager_ptr, const vector<int> &run_ids, SweepChunkResults &results)
+{
+	size_t npar = run_manager_ptr->get_par_name_vec().size();
+	size_t nobs = run_manager_ptr->get_obs_name_vec().size();
+	int nruns = run_ids.size();
+	results.success.assign(nruns, false);
+	results.pars.resize(nruns, npar);
+	results.obs.resize(nruns, nobs);
+	for (int i = 0; i < nruns; ++i)
+	{
+		results.success[i] = run_manager_ptr->get_run(run_ids[i], results.pars.row(i).data(), npar, results.obs.row(i).data(), nobs);
+	}
+}
 
+
+bool sweep_chunk_finished(RunManagerAbstract* run_manager_ptr, const vector<int> &run_ids)
+{
+	//a run is finished once it has succeeded or used up its allowed failures
+	for (int run_id : run_ids)
+	{
+		if ((!run_manager_ptr->run_finished(run_id)) && (!run_manager_ptr->n_run_failures_exceeded(run_id)))
+			return false;
+	}
+	return true;
 }
 
 
-void process_sweep_runs(ofstream &csv, Pest &pest_scenario, RunManagerAbstract* run_manager_ptr, vector<int> run_ids, vector<string> listed_run_ids, ObjectiveFunc obj_func,int total_runs_done)
+void process_sweep_runs(ofstream &csv, Pest &pest_scenario, const vector<string> &run_par_names, const vector<string> &run_obs_names,
+	const SweepChunkResults &results, ObjectiveFunc obj_func)
 {
-	Parameters pars;
-	Observations obs;
 	double fail_val = -1.0E+10;
-	int run_id;
-	string listed_run_id;
-	//for (auto &run_id : run_ids)
-	for (int i = 0;i <run_ids.size();++i)
+	const vector<string> &ogrp_names = pest_scenario.get_ctl_ordered_obs_group_names();
+	const vector<string> &obs_names = pest_scenario.get_ctl_ordered_obs_names();
+	//run storage index of each control file observation
+	unordered_map<string, int> obs_idx_map;
+	for (int i = 0; i < run_obs_names.size(); ++i)
+		obs_idx_map[run_obs_names[i]] = i;
+	vector<int> obs_idx;
+	for (auto &oname : obs_names)
+		obs_idx.push_back(obs_idx_map.at(oname));
+	for (int i = 0; i < results.listed_run_ids.size(); ++i)
 	{
-		run_id = run_ids[i];
-		listed_run_id = listed_run_ids[i];
-		csv << run_id + total_runs_done;
-		csv << ',' << listed_run_id;
+		csv << results.first_run_id + i;
+		csv << ',' << results.listed_run_ids[i];
 		// if the run was successful
-		if (run_manager_ptr->get_run(run_id, pars, obs))
+		if (results.success[i])
 		{
+			Parameters pars(run_par_names, results.pars.row(i).transpose());
+			Observations obs(run_obs_names, results.obs.row(i).transpose());
 			PhiData phi_data = obj_func.phi_report(obs, pars, *(pest_scenario.get_regul_scheme_ptr()));
 			csv << ",0";
 
 			csv << ',' << phi_data.total();
 			csv << ',' << phi_data.meas;
 			csv << ',' << phi_data.regul;
-			for (auto &obs_grp : pest_scenario.get_ctl_ordered_obs_group_names())
+			for (auto &obs_grp : ogrp_names)
 			{
 				csv << ',' << phi_data.group_phi.at(obs_grp);
 			}
-			for (auto oname : pest_scenario.get_ctl_ordered_obs_names())
+			const double *sim = results.obs.row(i).data();
+			for (int idx : obs_idx)
 			{
-				csv << ',' << obs[oname];
+				csv << ',' << sim[idx];
 			}
 			csv << endl;
 		}
@@ -267,17 +482,19 @@ void process_sweep_runs(ofstream &csv, Pest &pest_scenario, RunManagerAbstract*
 		{
 			csv << ",1";
 			csv << ",,,";
-			for (auto &ogrp : pest_scenario.get_ctl_ordered_obs_group_names())
+			for (auto &ogrp : ogrp_names)
 			{
 				csv << ',';
 			}
-			for (int i = 0; i < pest_scenario.get_ctl_ordered_obs_names().size(); i++)
+			for (int j = 0; j < obs_names.size(); j++)
 			{
 				csv << ',' << fail_val;
 			}
 			csv << endl;
 		}
 	}
+	//flush each chunk so an interrupted sweep can be resumed from the output file
+	csv.flush();
 }
 
 
@@ -371,10 +588,8 @@ int main(int argc, char* argv[])
 		{
 			throw runtime_error("/j option not supported by sweep");
 		}
-		if (cmdline.restart)
-		{
-			throw runtime_error("/r option not supported by sweep");
-		}
+		//restart resumes an interrupted sweep, skipping the runs already in the output file
+		bool resume = cmdline.restart;
 		
 		
 		restart_ctl.get_restart_option() = RestartController::RestartOption::NONE;
@@ -468,7 +683,9 @@ int main(int argc, char* argv[])
 				pest_scenario.get_pestpp_options().get_overdue_reched_fac(),
 				pest_scenario.get_pestpp_options().get_overdue_giveup_fac(),
 				pest_scenario.get_pestpp_options().get_overdue_giveup_minutes(),
-				pest_scenario.get_pestpp_options().get_panther_echo());
+				pest_scenario.get_pestpp_options().get_panther_echo(),
+				pest_scenario.get_pestpp_options().get_panther_schedule_policy(),
+				pest_scenario.get_pestpp_options().get_panther_tail_runs());
 		}
 		else
 		{
@@ -484,7 +701,8 @@ int main(int argc, char* argv[])
 				file_manager.build_filename("rns"), pathname,
 				pest_scenario.get_pestpp_options().get_max_run_fail(),
 				pest_scenario.get_pestpp_options().get_fill_tpl_zeros(),
-				pest_scenario.get_pestpp_options().get_additional_ins_delimiters());
+				pest_scenario.get_pestpp_options().get_additional_ins_delimiters(),
+				pest_scenario.get_pestpp_options().get_serial_num_slots());
 		}
 
 
@@ -495,6 +713,11 @@ int main(int argc, char* argv[])
 		//Allocates Space for Run Manager.  This initializes the model parameter names and observations names.
 		//Neither of these will change over the course of the simulation
 
+		if (pest_scenario.get_pestpp_options().get_run_storage_mmap())
+		{
+			run_manager_ptr->set_storage_engine(RunStorage::Engine::MMAP);
+		}
+
 		if (restart_ctl.get_restart_option() == RestartController::RestartOption::RESUME_JACOBIAN_RUNS)
 		{
 			run_manager_ptr->initialize_restart(file_manager.build_filename("rnj"));
@@ -504,24 +727,25 @@ int main(int argc, char* argv[])
 			run_manager_ptr->initialize(base_trans_seq.ctl2model_cp(cur_ctl_parameters), pest_scenario.get_ctl_observations());
 		}
 
-		map<string, int> header_info;
+		SweepSource source;
+		source.use_jco = false;
+		source.jco_row = 0;
+		source.par_stream = &par_stream;
+		source.nskipped = 0;
 
 		string par_ext = par_csv_file.substr(par_csv_file.size() - 3, par_csv_file.size());
 		pest_utils::lower_ip(par_ext);
 
-		Eigen::MatrixXd jco_mat;
-		bool use_jco = false;
-		vector<string> jco_col_names;
 		if ((par_ext.compare("jcb") == 0) || (par_ext.compare("jco") == 0))
 		{
 			cout << "  ---  binary jco-type file detected for par_csv" << endl;
-			use_jco = true;
+			source.use_jco = true;
 			Jacobian jco(file_manager);
 			jco.read(par_csv_file);
 			cout << jco.get_matrix_ptr()->rows() << " runs found in binary jco-type file" << endl;
 			//check that the jco is compatible with the control file
 			vector<string> names = jco.get_base_numeric_par_names();
-			jco_col_names = jco.get_sim_obs_names();
+			source.jco_col_names = jco.get_sim_obs_names();
 			set<string> jset(names.begin(), names.end());
 			set<string> pset(pest_scenario.get_ctl_ordered_par_names().begin(), pest_scenario.get_ctl_ordered_par_names().end());
 			vector<string> missing;
@@ -537,21 +761,38 @@ int main(int argc, char* argv[])
 			/*for (int i = 0; i < names.size(); i++)
 				header_info[names[i]] = i;*/
 			cout << "  --- converting sparse JCO matrix to dense" << endl;
-			jco_mat = jco.get_matrix(jco.get_sim_obs_names(), pest_scenario.get_ctl_ordered_par_names()).toDense();
+			source.jco_mat = jco.get_matrix(jco.get_sim_obs_names(), pest_scenario.get_ctl_ordered_par_names()).toDense();
 		}
 
 		else
 		{
-			header_info = prepare_parameter_csv(pest_scenario.get_ctl_parameters(),
+			source.header_info = prepare_parameter_csv(pest_scenario.get_ctl_parameters(),
 				par_stream, pest_scenario.get_pestpp_options().get_sweep_forgive());
 		}
 
+		int total_runs_queued = 0;
+		if (resume)
+		{
+			int nrecorded = read_completed_sweep_runs(pest_scenario, source.done_counts);
+			if (nrecorded < 0)
+			{
+				cout << "no sweep output file to resume from, starting a new sweep" << endl;
+				fout_rec << "    no sweep output file to resume from, starting a new sweep" << endl;
+				resume = false;
+			}
+			else
+			{
+				cout << "resuming sweep, " << nrecorded << " runs already recorded in " << ppopt.get_sweep_output_csv_file() << endl;
+				fout_rec << "    resuming sweep, " << nrecorded << " runs already recorded in " << ppopt.get_sweep_output_csv_file() << endl;
+				total_runs_queued = nrecorded;
+			}
+		}
+
 		// prepare the output file
 		ofstream obs_stream;
-		prep_sweep_output_file(pest_scenario,obs_stream);
+		prep_sweep_output_file(pest_scenario, obs_stream, resume);
 
 		int chunk = pest_scenario.get_pestpp_options().get_sweep_chunk();
-		//pair<vector<string>,vector<Parameters>> sweep_par_info;
 
 		//if desired, add the base run to the list of runs
 		if (pest_scenario.get_pestpp_options().get_sweep_base_run())
@@ -559,42 +800,45 @@ int main(int argc, char* argv[])
 			throw runtime_error("base runs no longer supported by sweep");
 			//sweep_pars[-999] = pest_scenario.get_ctl_parameters();
 		}
-		int total_runs_done = 0;
-		vector<string> run_ids;
-		vector<Parameters> sweep_pars;
-		vector<int> irun_ids;
+
+		//the sweep is pipelined: chunks are read and converted to model parameters on a background
+		//thread and queued with the run manager as soon as they are ready, so the next chunk is
+		//waiting before the current one drains.  the results of a chunk are written, also on a
+		//background thread, once all of its runs have finished.  the run storage can only be reset
+		//when no runs are in flight, so at most max_stored_chunks chunks are queued on top of
+		//each other before the runs are allowed to drain
+		const int max_stored_chunks = 10;
+		const double poll_sec = 1.0;
+		//copies, since the run storage names are reassigned when it is reset
+		const vector<string> run_par_names = run_manager_ptr->get_par_name_vec();
+		const vector<string> run_obs_names = run_manager_ptr->get_obs_name_vec();
+		SweepChunk next_chunk;
+		SweepChunkResults results;
+		deque<QueuedSweepChunk> queued;
+		int n_stored_chunks = 0;
+		bool input_done = false;
+		//declared last so it is destroyed (and its tasks finished) before the data they use
+		ThreadPool pool(2);
+		auto read_next = [&]()
+		{
+			read_sweep_chunk(source, chunk, pest_scenario, base_trans_seq, run_par_names, next_chunk);
+		};
+		auto write_results = [&]()
+		{
+			process_sweep_runs(obs_stream, pest_scenario, run_par_names, run_obs_names, results, obj_func);
+		};
+		performance_log.log_event("starting to read parameter csv file");
+		future<void> read_future = pool.submit(read_next);
+		future<void> write_future;
 		while (true)
 		{
-			//read some realizations
-			//sweep_pars.clear();
-			cout << "reading par values...";
-			if (use_jco)
-			{
-				//just use the total_runs_done counter as the run id
-				vector<string> par_names = pest_scenario.get_ctl_ordered_par_names();
-				Parameters par;
-				//vector<Parameters> pars;
-				sweep_pars.clear();
-				sweep_pars.reserve(chunk);
-				run_ids.clear();
-				for (int i = 0; i < chunk; i++)
-				{
-					if (total_runs_done + i >= jco_mat.rows())
-						break;
-					par.update_without_clear(par_names, jco_mat.row(total_runs_done + i));
-					sweep_pars.push_back(par);
-					//run_ids.push_back(total_runs_done + i);
-					run_ids.push_back(jco_col_names[total_runs_done + i]);
-
-				}
-				//sweep_par_info = pair<vector<string>, vector<Parameters>>(run_ids, pars);
-
-			}
-			else
+			//queue the next chunk once it has been read - if nothing is in flight, wait for it
+			if ((!input_done) && (queued.empty() || ((n_stored_chunks < max_stored_chunks) &&
+				(read_future.wait_for(chrono::seconds(0)) == future_status::ready))))
 			{
+				cout << "reading par values...";
 				try {
-					performance_log.log_event("starting to read parameter csv file");
-					load_parameters_from_csv(header_info, par_stream, chunk, pest_scenario.get_ctl_parameters(), run_ids,sweep_pars);
+					read_future.get();
 					performance_log.log_event("finished reading parameter csv file");
 				}
 				catch (exception &e)
@@ -604,42 +848,70 @@ int main(int argc, char* argv[])
 					performance_log.log_event(ss.str());
 					fout_rec << endl << ss.str() << endl;
 					fout_rec.close();
-
+					if (write_future.valid())
+						write_future.wait();
 					throw runtime_error(ss.str());
 				}
+				cout << "done" << endl;
+				// if there are no parameters to run, there is nothing left to queue
+				if (next_chunk.listed_run_ids.size() == 0)
+				{
+					cout << "no more runs to queue" << endl;
+					input_done = true;
+				}
+				else
+				{
+					if (queued.empty())
+					{
+						run_manager_ptr->reinitialize();
+						n_stored_chunks = 0;
+					}
+					cout << "queuing runs " << total_runs_queued << " --> " << total_runs_queued + next_chunk.listed_run_ids.size() << endl;
+					QueuedSweepChunk qchunk;
+					qchunk.first_run_id = total_runs_queued;
+					qchunk.run_ids = run_manager_ptr->add_runs(next_chunk.run_pars);
+					swap(qchunk.listed_run_ids, next_chunk.listed_run_ids);
+					total_runs_queued += qchunk.listed_run_ids.size();
+					queued.push_back(qchunk);
+					n_stored_chunks++;
+
+					//read the next chunk while these runs are made
+					performance_log.log_event("starting to read parameter csv file");
+					read_future = pool.submit(read_next);
+				}
 			}
-			cout << "done" << endl;
-			// if there are no parameters to run, we are done
-			//if (sweep_par_info.first.size() == 0)
-			if (run_ids.size() == 0)
+			if (queued.empty())
 			{
-				cout << "no more runs...done" << endl;
-				break;
+				if (input_done)
+					break;
+				continue;
 			}
-			run_manager_ptr->reinitialize();
 
-			cout << "starting runs " << total_runs_done << " --> " << total_runs_done + run_ids.size() << endl;
+			//make some runs, coming back periodically to queue the next chunk as soon as it has been
+			//read and to write out the chunks that have finished
+			RunManagerAbstract::RUN_UNTIL_COND cond = run_manager_ptr->resume_run_until(RunManagerAbstract::RUN_UNTIL_COND::TIME, 0, poll_sec);
 
-			// queue up some runs
-			irun_ids.clear();
-			for (auto &par : sweep_pars)
+			//process the leading chunks whose runs have all finished
+			while ((!queued.empty()) && ((cond == RunManagerAbstract::RUN_UNTIL_COND::NORMAL) ||
+				(sweep_chunk_finished(run_manager_ptr, queued.front().run_ids))))
 			{
-				//Parameters temp = base_trans_seq.active_ctl2model_cp(par);
-		        irun_ids.push_back(run_manager_ptr->add_run(base_trans_seq.active_ctl2model_cp(par)));
-
+				cout << "processing runs...";
+				if (write_future.valid())
+					write_future.get();
+				get_sweep_results(run_manager_ptr, queued.front().run_ids, results);
+				results.first_run_id = queued.front().first_run_id;
+				results.listed_run_ids = queued.front().listed_run_ids;
+				write_future = pool.submit(write_results);
+				queued.pop_front();
+				cout << "done" << endl;
 			}
-
-			//make some runs
-
-			run_manager_ptr->run();
-
-			//process the runs
-			cout << "processing runs...";
-			//process_sweep_runs(obs_stream, pest_scenario, run_manager_ptr, run_ids, obj_func,total_runs_done);
-			process_sweep_runs(obs_stream, pest_scenario, run_manager_ptr,irun_ids, run_ids, obj_func, total_runs_done);
-
-			cout << "done" << endl;
-			total_runs_done += run_ids.size();
+		}
+		if (write_future.valid())
+			write_future.get();
+		if (source.nskipped > 0)
+		{
+			cout << source.nskipped << " runs skipped, already recorded in " << ppopt.get_sweep_output_csv_file() << endl;
+			fout_rec << "    " << source.nskipped << " runs skipped, already recorded in " << ppopt.get_sweep_output_csv_file() << endl;
 		}
 
 		// clean up